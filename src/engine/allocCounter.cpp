@@ -0,0 +1,165 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// this file is only built with WITH_ALLOC_COUNTER.
+// it replaces every variant of the global operator new/delete so that the
+// chip benchmarks can count allocations made in the audio path.
+
+#include "allocCounter.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static std::atomic<bool> countAllocs(false);
+static std::atomic<unsigned long long> allocCount(0);
+
+void divAllocCounterEnable(bool enable) {
+  countAllocs=enable;
+}
+
+void divAllocCounterReset() {
+  allocCount=0;
+}
+
+unsigned long long divAllocCounterGet() {
+  return allocCount.load();
+}
+
+static inline void* countedAlloc(size_t size) {
+  if (countAllocs.load(std::memory_order_relaxed)) {
+    allocCount.fetch_add(1,std::memory_order_relaxed);
+  }
+  return malloc(size?size:1);
+}
+
+void* operator new(size_t size) {
+  void* ret=countedAlloc(size);
+  if (ret==NULL) throw std::bad_alloc();
+  return ret;
+}
+
+void* operator new[](size_t size) {
+  void* ret=countedAlloc(size);
+  if (ret==NULL) throw std::bad_alloc();
+  return ret;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return countedAlloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+static inline void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+  if (countAllocs.load(std::memory_order_relaxed)) {
+    allocCount.fetch_add(1,std::memory_order_relaxed);
+  }
+  size_t a=(size_t)align;
+  if (a<sizeof(void*)) a=sizeof(void*);
+#ifdef _WIN32
+  return _aligned_malloc(size?size:1,a);
+#else
+  void* ret=NULL;
+  if (posix_memalign(&ret,a,size?size:1)!=0) return NULL;
+  return ret;
+#endif
+}
+
+static inline void alignedFree(void* ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+  void* ret=countedAlignedAlloc(size,align);
+  if (ret==NULL) throw std::bad_alloc();
+  return ret;
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+  void* ret=countedAlignedAlloc(size,align);
+  if (ret==NULL) throw std::bad_alloc();
+  return ret;
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return countedAlignedAlloc(size,align);
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return countedAlignedAlloc(size,align);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  alignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  alignedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  alignedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+  alignedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  alignedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  alignedFree(ptr);
+}
+#endif
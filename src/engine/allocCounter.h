@@ -0,0 +1,44 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _ALLOC_COUNTER_H
+#define _ALLOC_COUNTER_H
+
+// heap allocation counter for benchmarks.
+// only available when building with WITH_ALLOC_COUNTER (which defines
+// HAVE_ALLOC_COUNTER), as it replaces the global operator new/delete.
+
+/**
+ * start or stop counting allocations.
+ * @param enable whether to count.
+ */
+void divAllocCounterEnable(bool enable);
+
+/**
+ * reset the allocation count to zero.
+ */
+void divAllocCounterReset();
+
+/**
+ * get the number of allocations made while counting was enabled.
+ * @return the count.
+ */
+unsigned long long divAllocCounterGet();
+
+#endif
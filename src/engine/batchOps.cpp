@@ -0,0 +1,268 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "engine.h"
+#include "workPool.h"
+#include "zlibOps.h"
+#include "../ta-log.h"
+#include "../fileutils.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+
+// shared state of a batch export
+struct DivBatchExportState {
+  struct Task {
+    DivBatchJob job;
+    // whether the output name gets the sub-song number appended
+    bool split;
+    Task(const DivBatchJob& j, bool s):
+      job(j),
+      split(s) {}
+  };
+
+  DivEngine* parent;
+  const DivAudioExportOptions& options;
+  bool vgmDirect;
+  std::deque<Task> tasks;
+  std::mutex lock;
+  std::condition_variable notify;
+  // tasks which are being run (they may add more tasks)
+  int running;
+  int done, total, failed;
+
+  DivBatchExportState(DivEngine* p, const DivAudioExportOptions& o, bool d):
+    parent(p),
+    options(o),
+    vgmDirect(d),
+    running(0),
+    done(0),
+    total(0),
+    failed(0) {}
+};
+
+static const char* batchFormatExt[]={
+  ".wav", ".vgm", ".vgz", ".bin"
+};
+
+static String getBatchOutPath(const DivBatchJob& job, bool split) {
+  String path=job.outPath;
+  if (path.empty()) {
+    path=job.inPath;
+    size_t sepPos=path.find_last_of("/" DIR_SEPARATOR_STR);
+    size_t extPos=path.rfind('.');
+    if (extPos!=String::npos && (sepPos==String::npos || extPos>sepPos)) {
+      path=path.substr(0,extPos);
+    }
+    path+=batchFormatExt[job.format];
+  }
+  if (split) {
+    size_t sepPos=path.find_last_of("/" DIR_SEPARATOR_STR);
+    size_t extPos=path.rfind('.');
+    String suffix=fmt::sprintf("_%d",job.subSong);
+    if (extPos!=String::npos && (sepPos==String::npos || extPos>sepPos)) {
+      path.insert(extPos,suffix);
+    } else {
+      path+=suffix;
+    }
+  }
+  return path;
+}
+
+static bool readBatchFile(const String& path, unsigned char*& data, size_t& len, String& error) {
+  FILE* f=ps_fopen(path.c_str(),"rb");
+  if (f==NULL) {
+    error=strerror(errno);
+    return false;
+  }
+  if (fseek(f,0,SEEK_END)<0) {
+    error=strerror(errno);
+    fclose(f);
+    return false;
+  }
+  long size=ftell(f);
+  if (size<1) {
+    error=(size==0)?"file is empty":strerror(errno);
+    fclose(f);
+    return false;
+  }
+  if (fseek(f,0,SEEK_SET)<0) {
+    error=strerror(errno);
+    fclose(f);
+    return false;
+  }
+  data=new unsigned char[size];
+  if (fread(data,1,(size_t)size,f)!=(size_t)size) {
+    error=strerror(errno);
+    delete[] data;
+    data=NULL;
+    fclose(f);
+    return false;
+  }
+  fclose(f);
+  len=size;
+  return true;
+}
+
+bool DivEngine::runBatchJob(const DivBatchJob& job, bool split, const DivAudioExportOptions& options, bool vgmDirect, int& subSongCount, String& outPath) {
+  unsigned char* data=NULL;
+  size_t len=0;
+  String error;
+  subSongCount=0;
+  outPath=getBatchOutPath(job,split);
+
+  if (!readBatchFile(job.inPath,data,len,error)) {
+    logE("%s: could not open file! (%s)",job.inPath,error);
+    return false;
+  }
+
+  DivEngine* worker=new DivEngine;
+  bool ok=false;
+  if (!worker->initWorker(this,data,len,job.inPath.c_str(),MAX(job.subSong,0),(job.format==DIV_BATCH_WAV)?options.sampleRate:0)) {
+    logE("%s: could not load song! (%s)",job.inPath,worker->getLastError());
+  } else {
+    subSongCount=worker->song.subsong.size();
+    // the caller splits the job if there are more sub-songs
+    if (job.subSong<0 && subSongCount>1) {
+      DivBatchJob first=job;
+      first.subSong=0;
+      outPath=getBatchOutPath(first,true);
+    }
+
+    SafeWriter* w=NULL;
+    switch (job.format) {
+      case DIV_BATCH_WAV:
+        worker->exportPath=outPath;
+        worker->exportMode=DIV_EXPORT_MODE_ONE;
+        worker->exportFormat=options.format;
+        worker->exportFadeOut=options.fadeOut;
+        worker->exportOutputs=MIN(MAX(options.chans,1),DIV_MAX_OUTPUTS);
+        worker->exportLoopCount=options.loops+1;
+        worker->exporting=true;
+        ok=worker->renderExportStem(-1,worker,false);
+        break;
+      case DIV_BATCH_VGM:
+      case DIV_BATCH_VGZ:
+        w=worker->saveVGM(NULL,true,0x171,false,vgmDirect);
+        if (w!=NULL && job.format==DIV_BATCH_VGZ) {
+          // we are already running in parallel
+          SafeWriter* compressed=divDeflate(w->getFinalBuf(),w->size(),9,true,1);
+          w->finish();
+          delete w;
+          w=compressed;
+        }
+        break;
+      case DIV_BATCH_CMD:
+        w=worker->saveCommand();
+        break;
+    }
+
+    if (job.format!=DIV_BATCH_WAV) {
+      if (w==NULL) {
+        logE("%s: could not export! (%s)",job.inPath,worker->getLastError());
+      } else {
+        FILE* f=ps_fopen(outPath.c_str(),"wb");
+        if (f==NULL) {
+          logE("%s: could not open file for writing! (%s)",outPath,strerror(errno));
+        } else {
+          ok=(fwrite(w->getFinalBuf(),1,w->size(),f)==w->size());
+          if (fclose(f)!=0) ok=false;
+          if (!ok) logE("%s: could not write file!",outPath);
+        }
+        w->finish();
+        delete w;
+      }
+    }
+  }
+  worker->quitExportWorker();
+  delete worker;
+  return ok;
+}
+
+int DivEngine::batchExport(const std::vector<DivBatchJob>& jobs, DivAudioExportOptions options, bool vgmDirect, unsigned int threads) {
+  if (jobs.empty()) return 0;
+  if (options.mode!=DIV_EXPORT_MODE_ONE) {
+    logW("batch export only supports one file per song. ignoring output mode.");
+  }
+
+  DivBatchExportState state(this,options,vgmDirect);
+  for (const DivBatchJob& i: jobs) {
+    // explicit output names are used as they are
+    state.tasks.push_back(DivBatchExportState::Task(i,i.subSong>=0 && i.outPath.empty()));
+  }
+  state.total=jobs.size();
+
+  if (threads==0) threads=std::thread::hardware_concurrency();
+  if (threads<1) threads=1;
+
+  logI("exporting %d songs using %d threads...",(int)jobs.size(),threads);
+  std::chrono::steady_clock::time_point batchStart=std::chrono::steady_clock::now();
+
+  auto runTasks=[](void* d) {
+    DivBatchExportState* s=(DivBatchExportState*)d;
+    std::unique_lock<std::mutex> lock(s->lock);
+    while (true) {
+      // wait for more tasks if a running one may still add sub-songs
+      while (s->tasks.empty() && s->running>0) {
+        s->notify.wait(lock);
+      }
+      if (s->tasks.empty()) break;
+      DivBatchExportState::Task task=s->tasks.front();
+      s->tasks.pop_front();
+      s->running++;
+      lock.unlock();
+
+      std::chrono::steady_clock::time_point jobStart=std::chrono::steady_clock::now();
+      int subSongCount=0;
+      String outPath;
+      bool ok=s->parent->runBatchJob(task.job,task.split,s->options,s->vgmDirect,subSongCount,outPath);
+      double jobTime=(double)(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-jobStart).count())/1000000.0;
+
+      lock.lock();
+      if (ok && task.job.subSong<0) {
+        for (int i=1; i<subSongCount; i++) {
+          DivBatchJob next=task.job;
+          next.subSong=i;
+          s->tasks.push_back(DivBatchExportState::Task(next,true));
+        }
+        if (subSongCount>1) s->total+=subSongCount-1;
+      }
+      s->done++;
+      if (!ok) s->failed++;
+      logI("[%d/%d] %s (sub-song %d) -> %s: %s in %.2fs",s->done,s->total,task.job.inPath,MAX(task.job.subSong,0),outPath,ok?"done":"FAILED",jobTime);
+      s->running--;
+      s->notify.notify_all();
+    }
+  };
+
+  if (threads<2) {
+    runTasks(&state);
+  } else {
+    DivWorkPool* batchPool=new DivWorkPool(threads);
+    for (unsigned int i=0; i<threads; i++) {
+      batchPool->push(runTasks,&state);
+    }
+    batchPool->wait();
+    delete batchPool;
+  }
+
+  double batchTime=(double)(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-batchStart).count())/1000000.0;
+  logI("batch export finished in %.2fs: %d done, %d failed.",batchTime,state.done-state.failed,state.failed);
+  return state.failed;
+}
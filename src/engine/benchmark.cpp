@@ -0,0 +1,398 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "engine.h"
+#include "../ta-log.h"
+#ifdef HAVE_ALLOC_COUNTER
+#include "allocCounter.h"
+#endif
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+#define BENCHMARK_BUFSIZE 2048
+// length of audio rendered for every chip/core combination
+#define BENCHMARK_SECONDS 4
+
+struct DivBenchmarkCore {
+  // configuration key and number of options
+  const char* key;
+  int options;
+  // option which must be set for this one to have any effect
+  const char* reqKey;
+  int reqVal;
+};
+
+// core selection/quality settings which apply to a chip (render variants).
+// keep in sync with DivDispatchContainer::init().
+static std::vector<DivBenchmarkCore> getBenchmarkCores(DivSystem sys) {
+  switch (sys) {
+    case DIV_SYSTEM_YM2612:
+    case DIV_SYSTEM_YM2612_EXT:
+    case DIV_SYSTEM_YM2612_CSM:
+    case DIV_SYSTEM_YM2612_DUALPCM:
+    case DIV_SYSTEM_YM2612_DUALPCM_EXT:
+      return {{"ym2612CoreRender",3,NULL,0}};
+    case DIV_SYSTEM_SMS:
+      return {{"snCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_GB:
+      return {{"gbQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_PCE:
+      return {{"pceQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_NES:
+    case DIV_SYSTEM_5E01:
+      return {{"nesCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_FDS:
+      return {{"fdsCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_C64_6581:
+    case DIV_SYSTEM_C64_8580:
+      return {{"c64CoreRender",3,NULL,0},{"dsidQualityRender",6,"c64CoreRender",2}};
+    case DIV_SYSTEM_YM2151:
+      return {{"arcadeCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_YM2203:
+    case DIV_SYSTEM_YM2203_EXT:
+      return {{"opn1CoreRender",3,NULL,0}};
+    case DIV_SYSTEM_YM2608:
+    case DIV_SYSTEM_YM2608_EXT:
+      return {{"opnaCoreRender",3,NULL,0}};
+    case DIV_SYSTEM_YM2610:
+    case DIV_SYSTEM_YM2610_FULL:
+    case DIV_SYSTEM_YM2610_EXT:
+    case DIV_SYSTEM_YM2610_FULL_EXT:
+    case DIV_SYSTEM_YM2610B:
+    case DIV_SYSTEM_YM2610B_EXT:
+      return {{"opnbCoreRender",3,NULL,0}};
+    case DIV_SYSTEM_AY8910:
+      return {{"ayCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_OPLL:
+    case DIV_SYSTEM_OPLL_DRUMS:
+    case DIV_SYSTEM_VRC7:
+      return {{"opllCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_OPL:
+    case DIV_SYSTEM_OPL_DRUMS:
+    case DIV_SYSTEM_OPL2:
+    case DIV_SYSTEM_OPL2_DRUMS:
+    case DIV_SYSTEM_Y8950:
+    case DIV_SYSTEM_Y8950_DRUMS:
+      return {{"opl2CoreRender",3,NULL,0}};
+    case DIV_SYSTEM_OPL3:
+    case DIV_SYSTEM_OPL3_DRUMS:
+      return {{"opl3CoreRender",3,NULL,0}};
+    case DIV_SYSTEM_OPL4:
+    case DIV_SYSTEM_OPL4_DRUMS:
+      return {{"opl4CoreRender",2,NULL,0}};
+    case DIV_SYSTEM_ESFM:
+      return {{"esfmCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_POKEY:
+      return {{"pokeyCoreRender",2,NULL,0}};
+    case DIV_SYSTEM_SAA1099:
+      return {{"saaQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_SWAN:
+      return {{"swanQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_VBOY:
+      return {{"vbQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_BUBSYS_WSG:
+      return {{"bubsysQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_SCC:
+    case DIV_SYSTEM_SCC_PLUS:
+      return {{"sccQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_SM8521:
+      return {{"smQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_POWERNOISE:
+      return {{"pnQualityRender",6,NULL,0}};
+    case DIV_SYSTEM_NDS:
+      return {{"ndsQualityRender",6,NULL,0}};
+    default:
+      break;
+  }
+  return {};
+}
+
+void DivEngine::createBenchmarkSong(DivSystem sys) {
+  quitDispatch();
+  BUSY_BEGIN;
+  saveLock.lock();
+  song.unload();
+  song=DivSong();
+  changeSong(0);
+  song.name="benchmark";
+  song.system[0]=sys;
+  song.systemLen=1;
+  song.systemName=getSystemName(sys);
+  recalcChans();
+
+  // a looping saw wave for sample-based chips
+  DivSample* sample=new DivSample;
+  sample->name="saw";
+  sample->init(4096);
+  for (int i=0; i<4096; i++) {
+    sample->data16[i]=(short)(((i*16)&0xffff)-32768);
+  }
+  sample->loop=true;
+  sample->loopStart=0;
+  sample->loopEnd=4096;
+  song.sample.push_back(sample);
+  song.sampleLen=1;
+  checkAssetDir(song.sampleDir,song.sample.size());
+
+  // one instrument per instrument type
+  int insOfChan[DIV_MAX_CHANS];
+  for (int i=0; i<chans; i++) {
+    DivInstrumentType type=getPreferInsType(i);
+    insOfChan[i]=-1;
+    for (size_t j=0; j<song.ins.size(); j++) {
+      if (song.ins[j]->type==type) {
+        insOfChan[i]=j;
+        break;
+      }
+    }
+    if (insOfChan[i]!=-1) continue;
+
+    DivInstrument* ins=new DivInstrument;
+    switch (type) {
+      case DIV_INS_OPLL:
+        *ins=song.nullInsOPLL;
+        break;
+      case DIV_INS_OPL:
+        *ins=song.nullInsOPL;
+        break;
+      case DIV_INS_OPL_DRUMS:
+        *ins=song.nullInsOPLDrums;
+        break;
+      case DIV_INS_ESFM:
+        *ins=song.nullInsESFM;
+        break;
+      default:
+        break;
+    }
+    if (sys==DIV_SYSTEM_QSOUND) {
+      *ins=song.nullInsQSound;
+    }
+    if (type!=DIV_INS_NULL) ins->type=type;
+    ins->name=fmt::sprintf("%d",(int)song.ins.size());
+    insOfChan[i]=song.ins.size();
+    song.ins.push_back(ins);
+  }
+  song.insLen=song.ins.size();
+  checkAssetDir(song.insDir,song.ins.size());
+
+  // a note every two ticks on every channel, with vibrato
+  curSubSong->speeds.val[0]=2;
+  curSubSong->speeds.len=1;
+  for (int i=0; i<chans; i++) {
+    DivPattern* pat=curPat[i].getPattern(0,true);
+    for (int j=0; j<curSubSong->patLen; j++) {
+      pat->data[j][0]=1+((i*3+j*5)%12);
+      pat->data[j][1]=2+((j>>4)&3);
+      pat->data[j][2]=insOfChan[i];
+    }
+    pat->data[0][4]=0x04;
+    pat->data[0][5]=0x48;
+  }
+
+  saveLock.unlock();
+  BUSY_END;
+}
+
+String DivEngine::runChipBenchmark(DivSystem sys, const char* coreKey, int coreOption, double& timeOut) {
+  float* outBuf[2];
+  outBuf[0]=new float[BENCHMARK_BUFSIZE];
+  outBuf[1]=new float[BENCHMARK_BUFSIZE];
+
+  quitDispatch();
+  initDispatch(true);
+  BUSY_BEGIN;
+  renderSamples();
+  reset();
+  BUSY_END;
+
+  curOrder=0;
+  prevOrder=0;
+  remainingLoops=-1;
+  playSub(false);
+
+  size_t totalSamples=(size_t)(got.rate*BENCHMARK_SECONDS);
+  size_t samples=0;
+  size_t buffers=0;
+
+#ifdef HAVE_ALLOC_COUNTER
+  divAllocCounterReset();
+  divAllocCounterEnable(true);
+#endif
+  std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
+
+  while (samples<totalSamples) {
+    nextBuf(NULL,outBuf,0,2,BENCHMARK_BUFSIZE);
+    samples+=BENCHMARK_BUFSIZE;
+    buffers++;
+  }
+
+  std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+#ifdef HAVE_ALLOC_COUNTER
+  divAllocCounterEnable(false);
+#endif
+
+  delete[] outBuf[0];
+  delete[] outBuf[1];
+
+  double t=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
+  double realtime=(t>0.0)?(((double)samples/got.rate)/t):0.0;
+  double samplesPerSec=(t>0.0)?((double)samples/t):0.0;
+  // allocations are only counted in builds with WITH_ALLOC_COUNTER
+#ifdef HAVE_ALLOC_COUNTER
+  String allocsPerBuf=fmt::sprintf("%.2f",(double)divAllocCounterGet()/(double)buffers);
+  String allocsText=fmt::sprintf(", %s allocs/buffer",allocsPerBuf);
+#else
+  String allocsPerBuf="null";
+  String allocsText="";
+#endif
+  DivRenderStats stats=getRenderStats();
+  timeOut=t;
+
+  if (coreKey==NULL) {
+    printf("[RESULT] %s: %fs (%.2fx realtime, %.0f samples/s%s)\n",getSystemName(sys),t,realtime,samplesPerSec,allocsText.c_str());
+  } else {
+    printf("[RESULT] %s (%s=%d): %fs (%.2fx realtime, %.0f samples/s%s)\n",getSystemName(sys),coreKey,coreOption,t,realtime,samplesPerSec,allocsText.c_str());
+  }
+
+  return fmt::sprintf(
+    "    {\"system\": \"%s\", \"id\": %d, \"core\": %s, \"option\": %d, \"time\": %f, \"realtime\": %f, \"samplesPerSec\": %f, \"allocsPerBuffer\": %s, \"p99\": %u}",
+    getSystemName(sys),
+    sysDefs[sys]->id,
+    (coreKey==NULL)?String("null"):fmt::sprintf("\"%s\"",coreKey),
+    coreOption,
+    t,
+    realtime,
+    samplesPerSec,
+    allocsPerBuf,
+    stats.stage[DIV_RENDER_STAGE_TOTAL].p99
+  );
+}
+
+double DivEngine::benchmarkChips() {
+  DivConfig oldConf=conf;
+  bool oldDisableStatusOut=disableStatusOut;
+  std::vector<String> results;
+  double ret=0.0;
+
+  // the status line would flood the results
+  disableStatusOut=true;
+
+  for (int i=0; i<DIV_MAX_CHIP_DEFS; i++) {
+    if (sysDefs[i]==NULL) continue;
+    if (sysDefs[i]->isCompound) continue;
+    DivSystem sys=(DivSystem)i;
+    if (sys==DIV_SYSTEM_NULL) continue;
+
+    createBenchmarkSong(sys);
+    std::vector<DivBenchmarkCore> cores=getBenchmarkCores(sys);
+    double t=0.0;
+    if (cores.empty()) {
+      results.push_back(runChipBenchmark(sys,NULL,0,t));
+      ret+=t;
+      continue;
+    }
+    for (DivBenchmarkCore& j: cores) {
+      conf=oldConf;
+      if (j.reqKey!=NULL) setConf(j.reqKey,j.reqVal);
+      for (int k=0; k<j.options; k++) {
+        setConf(j.key,k);
+        results.push_back(runChipBenchmark(sys,j.key,k,t));
+        ret+=t;
+      }
+    }
+    conf=oldConf;
+  }
+
+  conf=oldConf;
+  disableStatusOut=oldDisableStatusOut;
+
+  benchmarkJSON="{\n";
+  benchmarkJSON+=fmt::sprintf("  \"version\": \"%s\",\n",DIV_VERSION);
+  benchmarkJSON+=fmt::sprintf("  \"rate\": %d,\n",(int)got.rate);
+  benchmarkJSON+=fmt::sprintf("  \"bufferSize\": %d,\n",BENCHMARK_BUFSIZE);
+  benchmarkJSON+=fmt::sprintf("  \"seconds\": %d,\n",BENCHMARK_SECONDS);
+  benchmarkJSON+="  \"results\": [\n";
+  for (size_t i=0; i<results.size(); i++) {
+    benchmarkJSON+=results[i];
+    benchmarkJSON+=(i+1<results.size())?",\n":"\n";
+  }
+  benchmarkJSON+="  ]\n}\n";
+
+  printf("[RESULT] total: %fs\n",ret);
+  return ret;
+}
+
+String DivEngine::getBenchmarkJSON() {
+  return benchmarkJSON;
+}
+
+double DivEngine::benchmarkResample() {
+  static const int filters[3]={DIV_RESAMPLE_CUBIC, DIV_RESAMPLE_BLEP, DIV_RESAMPLE_SINC};
+  static const char* filterNames[3]={"cubic", "blep", "sinc"};
+  // upsampling and downsampling
+  static const double rates[2][2]={{32000.0,44100.0},{44100.0,32000.0}};
+  const unsigned int len=4000000;
+  double ret=0.0;
+
+  // the scalar single-threaded path does the same as the old resampler
+  auto resampleTimed=[&](DivSample* s, double sRate, double tRate, int filter, bool simd, unsigned int threads) {
+    blip_set_simd(simd);
+    std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
+    s->resample(sRate,tRate,filter,threads);
+    std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+    blip_set_simd(1);
+    return (double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
+  };
+
+  for (int depth: {DIV_SAMPLE_DEPTH_16BIT, DIV_SAMPLE_DEPTH_8BIT}) {
+    for (int i=0; i<3; i++) {
+      for (int j=0; j<2; j++) {
+        DivSample* sample[2];
+        for (int k=0; k<2; k++) {
+          sample[k]=new DivSample;
+          sample[k]->depth=(DivSampleDepth)depth;
+          sample[k]->init(len);
+          unsigned int seed=1;
+          for (unsigned int l=0; l<len; l++) {
+            seed=seed*1103515245+12345;
+            int val=sin((double)l*0.01)*24000.0+(int)((seed>>16)&4095)-2048;
+            if (depth==DIV_SAMPLE_DEPTH_16BIT) {
+              sample[k]->data16[l]=val;
+            } else {
+              sample[k]->data8[l]=val>>8;
+            }
+          }
+        }
+
+        double tOld=resampleTimed(sample[0],rates[j][0],rates[j][1],filters[i],false,1);
+        double tNew=resampleTimed(sample[1],rates[j][0],rates[j][1],filters[i],true,0);
+        bool same=(sample[0]->samples==sample[1]->samples && memcmp(sample[0]->getCurBuf(),sample[1]->getCurBuf(),sample[0]->getCurBufLen())==0);
+
+        printf("[RESULT] %d-bit %s %g->%gHz: %fs scalar, %fs SIMD+threads (%.1fx)%s\n",(depth==DIV_SAMPLE_DEPTH_16BIT)?16:8,filterNames[i],rates[j][0],rates[j][1],tOld,tNew,tOld/MAX(tNew,0.000001),same?"":" - OUTPUT DIFFERS!");
+        ret+=tNew;
+
+        delete sample[0];
+        delete sample[1];
+      }
+    }
+  }
+
+  return ret;
+}
@@ -7,6 +7,19 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define BLIP_SIMD_X86 1
+	#define BLIP_TARGET( x ) __attribute__((target(x)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#define BLIP_SIMD_X86 1
+	#define BLIP_TARGET( x )
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+	#include <arm_neon.h>
+	#define BLIP_SIMD_NEON 1
+#endif
+
 /* Library Copyright (C) 2003-2009 Shay Green. This library is free software;
 you can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -294,6 +307,45 @@ static short const bl_step [phase_count + 1] [half_width] =
 {    0,   43, -115,  350, -488, 1136, -914, 5861}
 };
 
+/* bl_step with every row reversed, so that the second half of the kernel can
+be applied with forward loads (used by blip_add_samples) */
+static short const bl_step_rev [phase_count + 1] [half_width] =
+{
+{21022, 5861, -914, 1136, -488,  350, -115,   43},
+{21001, 5274, -799, 1076, -473,  348, -118,   44},
+{20936, 4706, -677, 1011, -454,  344, -121,   45},
+{20829, 4156, -549,  942, -431,  336, -122,   46},
+{20679, 3629, -418,  868, -404,  327, -123,   47},
+{20488, 3124, -285,  792, -375,  316, -122,   47},
+{20256, 2644, -151,  714, -344,  303, -120,   47},
+{19985, 2188,  -17,  634, -310,  289, -117,   46},
+{19675, 1758,  117,  553, -275,  273, -114,   46},
+{19327, 1356,  247,  471, -237,  255, -108,   44},
+{18944,  981,  373,  390, -199,  237, -103,   43},
+{18527,  633,  495,  310, -160,  218,  -98,   42},
+{18078,  314,  611,  231, -121,  198,  -91,   40},
+{17599,   22,  722,  153,  -81,  178,  -84,   38},
+{17092, -241,  824,   80,  -43,  157,  -76,   36},
+{16558, -476,  919,    8,   -3,  135,  -68,   34},
+{16001, -683, 1006,  -60,   34,  115,  -61,   32},
+{15422, -862, 1083, -123,   70,   94,  -52,   29},
+{14824,-1015, 1152, -184,  106,   73,  -44,   27},
+{14210,-1142, 1211, -239,  139,   53,  -36,   25},
+{13582,-1244, 1261, -290,  170,   34,  -27,   22},
+{12942,-1322, 1301, -335,  199,   16,  -20,   20},
+{12293,-1376, 1331, -375,  226,   -3,  -12,   18},
+{11638,-1408, 1351, -410,  250,  -19,   -4,   15},
+{10979,-1419, 1361, -439,  272,  -35,    3,   13},
+{10319,-1410, 1362, -464,  292,  -49,    9,   11},
+{ 9660,-1383, 1354, -483,  309,  -63,   16,    9},
+{ 9005,-1339, 1337, -496,  322,  -75,   22,    7},
+{ 8355,-1280, 1312, -504,  333,  -85,   26,    6},
+{ 7713,-1205, 1278, -507,  341,  -94,   31,    4},
+{ 7082,-1119, 1238, -506,  347, -102,   35,    3},
+{ 6464,-1021, 1190, -499,  350, -110,   40,    1},
+{ 5861, -914, 1136, -488,  350, -115,   43,    0}
+};
+
 /* Shifting by pre_shift allows calculation using unsigned int rather than
 possibly-wider fixed_t. On 32-bit platforms, this is likely more efficient.
 And by having pre_shift 32, a 32-bit platform can easily do the shift by
@@ -350,3 +402,223 @@ void blip_add_delta_fast( blip_t* m, unsigned time, int delta )
 	out [7] += delta * delta_unit - delta2;
 	out [8] += delta2;
 }
+
+/* Batched synthesis. in [i] is the amplitude at clock time i; a delta is
+added wherever it changes. The 16-tap kernel is applied with SIMD where the
+CPU supports it (selected at run time). Integer math is the same as in
+blip_add_delta(), so output is bit-identical. */
+
+#define BLIP_ADD_SAMPLES_LOOP( kernel ) \
+	{\
+		buf_t* const base = SAMPLES( m ) + m->avail;\
+		fixed_t time = m->offset;\
+		int l = *last;\
+		int p = *prev;\
+		int i;\
+		for ( i = 0; i < count; i++, time += m->factor )\
+		{\
+			unsigned fixed;\
+			buf_t* out;\
+			int phase, interp, delta, delta2;\
+			if ( in [i] == l )\
+				continue;\
+			l = in [i];\
+			delta = l - p;\
+			p = l;\
+			fixed = (unsigned) (time >> pre_shift);\
+			out = base + (fixed >> frac_bits);\
+			phase = fixed >> (frac_bits - phase_bits) & (phase_count - 1);\
+			interp = fixed >> (frac_bits - phase_bits - delta_bits) & (delta_unit - 1);\
+			delta2 = (delta * interp) >> delta_bits;\
+			delta -= delta2;\
+			assert( out <= &SAMPLES( m ) [m->size + end_frame_extra] );\
+			kernel( out, phase, delta, delta2 );\
+		}\
+		*last = l;\
+		*prev = p;\
+	}
+
+#define BLIP_KERNEL_SCALAR( out, phase, delta, delta2 ) \
+	{\
+		short const* fwd  = bl_step [phase];\
+		short const* fwd2 = bl_step [phase + 1];\
+		short const* rev  = bl_step_rev [phase_count - phase];\
+		short const* rev2 = bl_step_rev [phase_count - 1 - phase];\
+		int k;\
+		for ( k = 0; k < half_width; k++ )\
+		{\
+			out [k] += fwd [k]*delta + fwd2 [k]*delta2;\
+			out [half_width + k] += rev [k]*delta + rev2 [k]*delta2;\
+		}\
+	}
+
+static void add_samples_scalar( blip_t* m, short const* in, int count, int* last, int* prev )
+BLIP_ADD_SAMPLES_LOOP( BLIP_KERNEL_SCALAR )
+
+#ifdef BLIP_SIMD_X86
+#define BLIP_KERNEL_SSE41_HALF( out, a, b, d, d2 ) \
+	{\
+		__m128i va = _mm_loadl_epi64( (__m128i const*) (a) );\
+		__m128i vb = _mm_loadl_epi64( (__m128i const*) (b) );\
+		__m128i va2 = _mm_loadl_epi64( (__m128i const*) ((a) + 4) );\
+		__m128i vb2 = _mm_loadl_epi64( (__m128i const*) ((b) + 4) );\
+		__m128i o0 = _mm_loadu_si128( (__m128i const*) (out) );\
+		__m128i o1 = _mm_loadu_si128( (__m128i const*) ((out) + 4) );\
+		o0 = _mm_add_epi32( o0, _mm_add_epi32( _mm_mullo_epi32( _mm_cvtepi16_epi32( va ), d ), _mm_mullo_epi32( _mm_cvtepi16_epi32( vb ), d2 ) ) );\
+		o1 = _mm_add_epi32( o1, _mm_add_epi32( _mm_mullo_epi32( _mm_cvtepi16_epi32( va2 ), d ), _mm_mullo_epi32( _mm_cvtepi16_epi32( vb2 ), d2 ) ) );\
+		_mm_storeu_si128( (__m128i*) (out), o0 );\
+		_mm_storeu_si128( (__m128i*) ((out) + 4), o1 );\
+	}
+
+#define BLIP_KERNEL_SSE41( out, phase, delta, delta2 ) \
+	{\
+		__m128i d  = _mm_set1_epi32( delta );\
+		__m128i d2 = _mm_set1_epi32( delta2 );\
+		BLIP_KERNEL_SSE41_HALF( out, bl_step [phase], bl_step [phase + 1], d, d2 );\
+		BLIP_KERNEL_SSE41_HALF( out + half_width, bl_step_rev [phase_count - phase], bl_step_rev [phase_count - 1 - phase], d, d2 );\
+	}
+
+#define BLIP_KERNEL_AVX2_HALF( out, a, b, d, d2 ) \
+	{\
+		__m256i va = _mm256_cvtepi16_epi32( _mm_loadu_si128( (__m128i const*) (a) ) );\
+		__m256i vb = _mm256_cvtepi16_epi32( _mm_loadu_si128( (__m128i const*) (b) ) );\
+		__m256i o = _mm256_loadu_si256( (__m256i const*) (out) );\
+		o = _mm256_add_epi32( o, _mm256_add_epi32( _mm256_mullo_epi32( va, d ), _mm256_mullo_epi32( vb, d2 ) ) );\
+		_mm256_storeu_si256( (__m256i*) (out), o );\
+	}
+
+#define BLIP_KERNEL_AVX2( out, phase, delta, delta2 ) \
+	{\
+		__m256i d  = _mm256_set1_epi32( delta );\
+		__m256i d2 = _mm256_set1_epi32( delta2 );\
+		BLIP_KERNEL_AVX2_HALF( out, bl_step [phase], bl_step [phase + 1], d, d2 );\
+		BLIP_KERNEL_AVX2_HALF( out + half_width, bl_step_rev [phase_count - phase], bl_step_rev [phase_count - 1 - phase], d, d2 );\
+	}
+
+BLIP_TARGET( "sse4.1" )
+static void add_samples_sse41( blip_t* m, short const* in, int count, int* last, int* prev )
+BLIP_ADD_SAMPLES_LOOP( BLIP_KERNEL_SSE41 )
+
+BLIP_TARGET( "avx2" )
+static void add_samples_avx2( blip_t* m, short const* in, int count, int* last, int* prev )
+BLIP_ADD_SAMPLES_LOOP( BLIP_KERNEL_AVX2 )
+#endif
+
+#ifdef BLIP_SIMD_NEON
+#define BLIP_KERNEL_NEON_HALF( out, a, b, d, d2 ) \
+	{\
+		int16x8_t va = vld1q_s16( a );\
+		int16x8_t vb = vld1q_s16( b );\
+		int32x4_t o0 = vld1q_s32( out );\
+		int32x4_t o1 = vld1q_s32( (out) + 4 );\
+		o0 = vmlaq_s32( vmlaq_s32( o0, vmovl_s16( vget_low_s16( va ) ), d ), vmovl_s16( vget_low_s16( vb ) ), d2 );\
+		o1 = vmlaq_s32( vmlaq_s32( o1, vmovl_s16( vget_high_s16( va ) ), d ), vmovl_s16( vget_high_s16( vb ) ), d2 );\
+		vst1q_s32( out, o0 );\
+		vst1q_s32( (out) + 4, o1 );\
+	}
+
+#define BLIP_KERNEL_NEON( out, phase, delta, delta2 ) \
+	{\
+		int32x4_t d  = vdupq_n_s32( delta );\
+		int32x4_t d2 = vdupq_n_s32( delta2 );\
+		BLIP_KERNEL_NEON_HALF( out, bl_step [phase], bl_step [phase + 1], d, d2 );\
+		BLIP_KERNEL_NEON_HALF( out + half_width, bl_step_rev [phase_count - phase], bl_step_rev [phase_count - 1 - phase], d, d2 );\
+	}
+
+static void add_samples_neon( blip_t* m, short const* in, int count, int* last, int* prev )
+BLIP_ADD_SAMPLES_LOOP( BLIP_KERNEL_NEON )
+#endif
+
+static int simd_enabled = 1;
+
+void blip_set_simd( int enable )
+{
+	simd_enabled = enable;
+}
+
+int blip_simd_level( void )
+{
+	if ( !simd_enabled )
+		return blip_simd_none;
+#if defined(BLIP_SIMD_X86) && !defined(_MSC_VER)
+	if ( __builtin_cpu_supports( "avx2" ) )
+		return blip_simd_avx2;
+	if ( __builtin_cpu_supports( "sse4.1" ) )
+		return blip_simd_sse41;
+#elif defined(BLIP_SIMD_X86)
+	{
+		int info [4];
+		__cpuid( info, 0 );
+		if ( info [0] >= 7 )
+		{
+			__cpuidex( info, 1, 0 );
+			/* AVX2 also needs OS support for the YMM state (OSXSAVE + XCR0) */
+			if ( (info [2] & (1 << 27)) && (info [2] & (1 << 28)) && (_xgetbv( 0 ) & 6) == 6 )
+			{
+				int info7 [4];
+				__cpuidex( info7, 7, 0 );
+				if ( info7 [1] & (1 << 5) )
+					return blip_simd_avx2;
+			}
+		}
+		__cpuid( info, 1 );
+		if ( info [2] & (1 << 19) )
+			return blip_simd_sse41;
+	}
+#elif defined(BLIP_SIMD_NEON)
+	return blip_simd_neon;
+#endif
+	return blip_simd_none;
+}
+
+void blip_add_samples( blip_t* m, short const* in, int count, int* last, int* prev )
+{
+	switch ( blip_simd_level() )
+	{
+#ifdef BLIP_SIMD_X86
+	case blip_simd_avx2:
+		add_samples_avx2( m, in, count, last, prev );
+		return;
+	case blip_simd_sse41:
+		add_samples_sse41( m, in, count, last, prev );
+		return;
+#endif
+#ifdef BLIP_SIMD_NEON
+	case blip_simd_neon:
+		add_samples_neon( m, in, count, last, prev );
+		return;
+#endif
+	default:
+		add_samples_scalar( m, in, count, last, prev );
+		return;
+	}
+}
+
+void blip_add_samples_fast( blip_t* m, short const* in, int count, int* last, int* prev )
+{
+	buf_t* const base = SAMPLES( m ) + m->avail;
+	fixed_t time = m->offset;
+	int l = *last;
+	int p = *prev;
+	int i;
+	for ( i = 0; i < count; i++, time += m->factor )
+	{
+		unsigned fixed;
+		buf_t* out;
+		int interp, delta, delta2;
+		if ( in [i] == l )
+			continue;
+		l = in [i];
+		delta = l - p;
+		p = l;
+		fixed = (unsigned) (time >> pre_shift);
+		out = base + (fixed >> frac_bits);
+		interp = fixed >> (frac_bits - delta_bits) & (delta_unit - 1);
+		delta2 = delta * interp;
+		assert( out <= &SAMPLES( m ) [m->size + end_frame_extra] );
+		out [7] += delta * delta_unit - delta2;
+		out [8] += delta2;
+	}
+	*last = l;
+	*prev = p;
+}
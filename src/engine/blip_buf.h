@@ -41,6 +41,29 @@ void blip_add_delta( blip_t*, unsigned int clock_time, int delta );
 /** Same as blip_add_delta(), but uses faster, lower-quality synthesis. */
 void blip_add_delta_fast( blip_t*, unsigned int clock_time, int delta );
 
+/** Adds a delta for every change in a run of amplitudes, where in [i] is the
+amplitude at clock time i. *last is the previous input amplitude and *prev the
+amplitude the buffer is at; both are updated. Same result as calling
+blip_add_delta() for every change, but faster (SIMD where available). */
+void blip_add_samples( blip_t*, short const* in, int count, int* last, int* prev );
+
+/** Same as blip_add_samples(), but uses faster, lower-quality synthesis. */
+void blip_add_samples_fast( blip_t*, short const* in, int count, int* last, int* prev );
+
+/** SIMD kernel used by blip_add_samples() */
+enum {
+	blip_simd_none = 0,
+	blip_simd_sse41,
+	blip_simd_avx2,
+	blip_simd_neon
+};
+
+/** Returns the SIMD kernel which blip_add_samples() will use. */
+int blip_simd_level( void );
+
+/** Enables/disables SIMD kernels (for testing). Enabled by default. */
+void blip_set_simd( int enable );
+
 /** Length of time frame, in clocks, needed to make sample_count additional
 samples available. */
 int blip_clocks_needed( const blip_t*, int sample_count );
@@ -21,9 +21,24 @@
  */
 
 #include "brrUtils.h"
+#include "blip_buf.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BRR_SIMD_X86 1
+#define BRR_TARGET(x) __attribute__((target(x)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BRR_SIMD_X86 1
+#define BRR_TARGET(x)
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BRR_SIMD_NEON 1
+#endif
+
 #define NEXT_SAMPLE buf[j]-(buf[j]>>3)
 
 #define DO_ONE_DEC(r) \
@@ -58,86 +73,357 @@
   last2=last1; \
   last1=nextDec; \
 
-void brrEncodeBlock(const short* buf, unsigned char* out, unsigned char range, unsigned char filter, short* last1, short* last2, int* errorSum) {
-  // encode one block using BRR
-  unsigned char nibble=0;
-  int preOut=0;
-  int pred=0;
-  int nextDec=0;
-  int nextError=0;
-  *errorSum=0;
-  for (int j=0; j<16; j++) {
-    short s=NEXT_SAMPLE;
-    switch (filter) {
-      case 0: // no filter
-        pred=s;
-        break;
-      case 1: // simple
-        pred=s-(((int)(*last1*2)*15)>>4);
-        break;
-      case 2: // complex
-        pred=s+(((int)(*last2*2)*15)>>4)-(((int)(*last1*2)*61)>>5);
-        break;
-      case 3:
-        pred=s+(((int)(*last2*2)*13)>>4)-(((int)(*last1*2)*115)>>6);
-        break;
-    }
+// search results for one block: the block encoded with every range (0-12)
+// using one filter, starting from the same decoder state.
+// lanes 13-15 are padding for the vector versions.
+typedef struct {
+  int error[16];
+  int last1[16];
+  int last2[16];
+  int nibble[16][16]; // [sample][range]
+} BRRSearch;
+
+typedef void (*BRRSearchFunc)(const short* buf, int last1, int last2, int filter, int exact, BRRSearch* r);
+
+// if exact is set, the decoder state is clamped like the S-DSP does.
+// the original encoder doesn't do this (brrEncode() keeps that behavior).
+static void brrSearchScalar(const short* buf, int last1, int last2, int filter, int exact, BRRSearch* r) {
+  for (int range=0; range<13; range++) {
+    int l1=last1;
+    int l2=last2;
+    int errorSum=0;
+    for (int j=0; j<16; j++) {
+      int s=NEXT_SAMPLE;
+      int pred=0;
+      switch (filter) {
+        case 0: // no filter
+          pred=s;
+          break;
+        case 1: // simple
+          pred=s-(((int)(l1*2)*15)>>4);
+          break;
+        case 2: // complex
+          pred=s+(((int)(l2*2)*15)>>4)-(((int)(l1*2)*61)>>5);
+          break;
+        case 3:
+          pred=s+(((int)(l2*2)*13)>>4)-(((int)(l1*2)*115)>>6);
+          break;
+      }
+
+      if (pred<-32768) pred=-32768;
+      if (pred>32767) pred=32767;
+
+      int preOut=pred>>range;
+      if (range) {
+        if (pred&(1<<(range>>1))) preOut++;
+        if (filter==0 && range>=12) if (preOut<-7) preOut=-7;
+      }
+      if (preOut>7) preOut=7;
+      if (preOut<-8) preOut=-8;
+
+      r->nibble[j][range]=preOut&15;
 
-    if (pred<-32768) pred=-32768;
-    if (pred>32767) pred=32767;
+      // roll last1/last2
+      int nextDec=preOut;
+      nextDec<<=range;
+      nextDec>>=1;
+
+      switch (filter) {
+        case 0:
+          break;
+        case 1:
+          nextDec+=l1+((-l1)>>4);
+          break;
+        case 2:
+          nextDec+=l1*2+((-l1*3)>>5)-l2+(l2>>4);
+          break;
+        case 3:
+          nextDec+=l1*2+((-l1*13)>>6)-l2+((l2*3)>>4);
+          break;
+      }
+
+      if (exact) {
+        if (nextDec>32767) nextDec=32767;
+        if (nextDec<-32768) nextDec=-32768;
+      }
+      nextDec&=0x7fff;
+      if (nextDec&0x4000) nextDec|=0xffff8000;
+
+      int nextError=s-(nextDec<<1);
+      if (nextError<0) nextError=-nextError;
+      errorSum+=nextError;
 
-    preOut=pred>>range;
-    if (range) {
-      if (pred&(1<<(range>>1))) preOut++;
-      if (filter==0 && range>=12) if (preOut<-7) preOut=-7;
+      l2=l1;
+      l1=nextDec;
     }
-    if (preOut>7) preOut=7;
-    if (preOut<-8) preOut=-8;
+    r->error[range]=errorSum;
+    r->last1[range]=l1;
+    r->last2[range]=l2;
+  }
+}
 
-    nibble=preOut&15;
-    if (j&1) {
-      out[j>>1]|=nibble;
-    } else {
-      out[j>>1]=nibble<<4;
+// the vector versions run all ranges at once (one per lane) and do the same
+// operations in the same order as the scalar one.
+static const int brrRanges[16]={0,1,2,3,4,5,6,7,8,9,10,11,12,12,12,12};
+static const int brrRoundBits[16]={0,1,2,2,4,4,8,8,16,16,32,32,64,64,64,64};
+
+#ifdef BRR_SIMD_X86
+BRR_TARGET("avx2")
+static void brrSearchAVX2(const short* buf, int last1, int last2, int filter, int exact, BRRSearch* r) {
+  const __m256i zero=_mm256_setzero_si256();
+  const __m256i minS=_mm256_set1_epi32(-32768);
+  const __m256i maxS=_mm256_set1_epi32(32767);
+  const __m256i maxN=_mm256_set1_epi32(7);
+  const __m256i mask=_mm256_set1_epi32(15);
+  __m256i range[2], roundBit[2], minN[2];
+  __m256i l1[2], l2[2], err[2];
+
+  for (int v=0; v<2; v++) {
+    range[v]=_mm256_loadu_si256((const __m256i*)&brrRanges[v<<3]);
+    roundBit[v]=_mm256_loadu_si256((const __m256i*)&brrRoundBits[v<<3]);
+    // filter 0 with range 12 may not go below -7
+    minN[v]=_mm256_set1_epi32(-8);
+    if (filter==0) {
+      minN[v]=_mm256_sub_epi32(minN[v],_mm256_cmpgt_epi32(range[v],_mm256_set1_epi32(11)));
     }
+    l1[v]=_mm256_set1_epi32(last1);
+    l2[v]=_mm256_set1_epi32(last2);
+    err[v]=zero;
+  }
 
-    // roll last1/last2
-    nextDec=nibble;
-    if (nextDec&8) nextDec|=0xfffffff0;
+  for (int j=0; j<16; j++) {
+    const __m256i s=_mm256_set1_epi32(NEXT_SAMPLE);
+    for (int v=0; v<2; v++) {
+      __m256i pred, dec;
+      switch (filter) {
+        case 1:
+          pred=_mm256_sub_epi32(s,_mm256_srai_epi32(_mm256_mullo_epi32(l1[v],_mm256_set1_epi32(30)),4));
+          break;
+        case 2:
+          pred=_mm256_sub_epi32(
+            _mm256_add_epi32(s,_mm256_srai_epi32(_mm256_mullo_epi32(l2[v],_mm256_set1_epi32(30)),4)),
+            _mm256_srai_epi32(_mm256_mullo_epi32(l1[v],_mm256_set1_epi32(122)),5)
+          );
+          break;
+        case 3:
+          pred=_mm256_sub_epi32(
+            _mm256_add_epi32(s,_mm256_srai_epi32(_mm256_mullo_epi32(l2[v],_mm256_set1_epi32(26)),4)),
+            _mm256_srai_epi32(_mm256_mullo_epi32(l1[v],_mm256_set1_epi32(230)),6)
+          );
+          break;
+        default:
+          pred=s;
+          break;
+      }
+      pred=_mm256_min_epi32(_mm256_max_epi32(pred,minS),maxS);
+
+      __m256i preOut=_mm256_srav_epi32(pred,range[v]);
+      preOut=_mm256_sub_epi32(preOut,_mm256_cmpgt_epi32(_mm256_and_si256(pred,roundBit[v]),zero));
+      preOut=_mm256_min_epi32(_mm256_max_epi32(preOut,minN[v]),maxN);
+      _mm256_storeu_si256((__m256i*)&r->nibble[j][v<<3],_mm256_and_si256(preOut,mask));
+
+      dec=_mm256_srai_epi32(_mm256_sllv_epi32(preOut,range[v]),1);
+      switch (filter) {
+        case 1:
+          dec=_mm256_add_epi32(dec,_mm256_add_epi32(l1[v],_mm256_srai_epi32(_mm256_sub_epi32(zero,l1[v]),4)));
+          break;
+        case 2:
+          dec=_mm256_add_epi32(dec,_mm256_add_epi32(
+            _mm256_sub_epi32(
+              _mm256_add_epi32(_mm256_add_epi32(l1[v],l1[v]),_mm256_srai_epi32(_mm256_mullo_epi32(l1[v],_mm256_set1_epi32(-3)),5)),
+              l2[v]
+            ),
+            _mm256_srai_epi32(l2[v],4)
+          ));
+          break;
+        case 3:
+          dec=_mm256_add_epi32(dec,_mm256_add_epi32(
+            _mm256_sub_epi32(
+              _mm256_add_epi32(_mm256_add_epi32(l1[v],l1[v]),_mm256_srai_epi32(_mm256_mullo_epi32(l1[v],_mm256_set1_epi32(-13)),6)),
+              l2[v]
+            ),
+            _mm256_srai_epi32(_mm256_mullo_epi32(l2[v],_mm256_set1_epi32(3)),4)
+          ));
+          break;
+        default:
+          break;
+      }
+      if (exact) {
+        dec=_mm256_min_epi32(_mm256_max_epi32(dec,minS),maxS);
+      }
+      // keep 15 bits and sign-extend
+      dec=_mm256_srai_epi32(_mm256_slli_epi32(dec,17),17);
 
-    if (range>=13) { /* invalid shift */
-      nextDec=(nextDec<0)?0xfffff800:0;
-    } else {
-      nextDec<<=range; /* range */
-      nextDec>>=1;
+      err[v]=_mm256_add_epi32(err[v],_mm256_abs_epi32(_mm256_sub_epi32(s,_mm256_add_epi32(dec,dec))));
+      l2[v]=l1[v];
+      l1[v]=dec;
     }
+  }
 
-    switch (filter) { /* filter */
-      case 0:
-        break;
-      case 1:
-        nextDec+=(*last1)+((-(*last1))>>4);
-        break;
-      case 2:
-        nextDec+=(*last1)*2+((-(*last1)*3)>>5)-(*last2)+((*last2)>>4);
-        break;
-      case 3:
-        nextDec+=(*last1)*2+((-(*last1)*13)>>6)-(*last2)+(((*last2)*3)>>4);
-        break;
+  for (int v=0; v<2; v++) {
+    _mm256_storeu_si256((__m256i*)&r->error[v<<3],err[v]);
+    _mm256_storeu_si256((__m256i*)&r->last1[v<<3],l1[v]);
+    _mm256_storeu_si256((__m256i*)&r->last2[v<<3],l2[v]);
+  }
+}
+#endif
+
+#ifdef BRR_SIMD_NEON
+static void brrSearchNEON(const short* buf, int last1, int last2, int filter, int exact, BRRSearch* r) {
+  const int32x4_t zero=vdupq_n_s32(0);
+  const int32x4_t minS=vdupq_n_s32(-32768);
+  const int32x4_t maxS=vdupq_n_s32(32767);
+  const int32x4_t maxN=vdupq_n_s32(7);
+  const int32x4_t mask=vdupq_n_s32(15);
+  int32x4_t range[4], rangeNeg[4], roundBit[4], minN[4];
+  int32x4_t l1[4], l2[4], err[4];
+
+  for (int v=0; v<4; v++) {
+    range[v]=vld1q_s32(&brrRanges[v<<2]);
+    rangeNeg[v]=vnegq_s32(range[v]);
+    roundBit[v]=vld1q_s32(&brrRoundBits[v<<2]);
+    // filter 0 with range 12 may not go below -7
+    minN[v]=vdupq_n_s32(-8);
+    if (filter==0) {
+      minN[v]=vsubq_s32(minN[v],vreinterpretq_s32_u32(vcgtq_s32(range[v],vdupq_n_s32(11))));
     }
+    l1[v]=vdupq_n_s32(last1);
+    l2[v]=vdupq_n_s32(last2);
+    err[v]=zero;
+  }
 
-    nextDec&=0x7fff;
-    if (nextDec&0x4000) nextDec|=0xffff8000;
+  for (int j=0; j<16; j++) {
+    const int32x4_t s=vdupq_n_s32(NEXT_SAMPLE);
+    for (int v=0; v<4; v++) {
+      int32x4_t pred, dec;
+      switch (filter) {
+        case 1:
+          pred=vsubq_s32(s,vshrq_n_s32(vmulq_n_s32(l1[v],30),4));
+          break;
+        case 2:
+          pred=vsubq_s32(vaddq_s32(s,vshrq_n_s32(vmulq_n_s32(l2[v],30),4)),vshrq_n_s32(vmulq_n_s32(l1[v],122),5));
+          break;
+        case 3:
+          pred=vsubq_s32(vaddq_s32(s,vshrq_n_s32(vmulq_n_s32(l2[v],26),4)),vshrq_n_s32(vmulq_n_s32(l1[v],230),6));
+          break;
+        default:
+          pred=s;
+          break;
+      }
+      pred=vminq_s32(vmaxq_s32(pred,minS),maxS);
+
+      // a negative shift count shifts right (arithmetic)
+      int32x4_t preOut=vshlq_s32(pred,rangeNeg[v]);
+      preOut=vsubq_s32(preOut,vreinterpretq_s32_u32(vcgtq_s32(vandq_s32(pred,roundBit[v]),zero)));
+      preOut=vminq_s32(vmaxq_s32(preOut,minN[v]),maxN);
+      vst1q_s32(&r->nibble[j][v<<2],vandq_s32(preOut,mask));
+
+      dec=vshrq_n_s32(vshlq_s32(preOut,range[v]),1);
+      switch (filter) {
+        case 1:
+          dec=vaddq_s32(dec,vaddq_s32(l1[v],vshrq_n_s32(vnegq_s32(l1[v]),4)));
+          break;
+        case 2:
+          dec=vaddq_s32(dec,vaddq_s32(vsubq_s32(vaddq_s32(vaddq_s32(l1[v],l1[v]),vshrq_n_s32(vmulq_n_s32(l1[v],-3),5)),l2[v]),vshrq_n_s32(l2[v],4)));
+          break;
+        case 3:
+          dec=vaddq_s32(dec,vaddq_s32(vsubq_s32(vaddq_s32(vaddq_s32(l1[v],l1[v]),vshrq_n_s32(vmulq_n_s32(l1[v],-13),6)),l2[v]),vshrq_n_s32(vmulq_n_s32(l2[v],3),4)));
+          break;
+        default:
+          break;
+      }
+      if (exact) {
+        dec=vminq_s32(vmaxq_s32(dec,minS),maxS);
+      }
+      // keep 15 bits and sign-extend
+      dec=vshrq_n_s32(vshlq_n_s32(dec,17),17);
 
-    nextError=s-(nextDec<<1);
-    if (nextError<0) nextError=-nextError;
-    *errorSum+=nextError;
+      err[v]=vaddq_s32(err[v],vabsq_s32(vsubq_s32(s,vaddq_s32(dec,dec))));
+      l2[v]=l1[v];
+      l1[v]=dec;
+    }
+  }
+
+  for (int v=0; v<4; v++) {
+    vst1q_s32(&r->error[v<<2],err[v]);
+    vst1q_s32(&r->last1[v<<2],l1[v]);
+    vst1q_s32(&r->last2[v<<2],l2[v]);
+  }
+}
+#endif
+
+static BRRSearchFunc brrGetSearchFunc() {
+  switch (blip_simd_level()) {
+#ifdef BRR_SIMD_X86
+    case blip_simd_avx2:
+      return brrSearchAVX2;
+#endif
+#ifdef BRR_SIMD_NEON
+    case blip_simd_neon:
+      return brrSearchNEON;
+#endif
+    default:
+      break;
+  }
+  return brrSearchScalar;
+}
+
+static void brrPackBlock(const BRRSearch* r, int range, unsigned char* out) {
+  for (int j=0; j<8; j++) {
+    out[j]=(r->nibble[j<<1][range]<<4)|r->nibble[(j<<1)+1][range];
+  }
+}
 
-    *last2=*last1;
-    *last1=nextDec;
+static void brrApplyEmphasis(short* in, short* x) {
+  for (int j=0; j<17; j++) {
+    x[0]=x[1];
+    x[1]=x[2];
+    x[2]=in[j];
+
+    if (j==0) continue;
+    int emphOut=((x[1]<<11)-x[0]*370-in[j]*374)/1305;
+    if (emphOut<-32768) emphOut=-32768;
+    if (emphOut>32767) emphOut=32767;
+    in[j-1]=emphOut;
   }
 }
 
+// read the block at i (plus one sample of look-ahead)
+static void brrReadBlock(const short* buf, short* in, long i, long len, long loopStart, unsigned char emphasis, short* x) {
+  if (i+17>len) {
+    long p=i;
+    for (int j=0; j<17; j++) {
+      if (p>=len) {
+        if (loopStart<0 || loopStart>=len) {
+          in[j]=0;
+        } else {
+          p=loopStart;
+          in[j]=buf[p++];
+        }
+      } else {
+        in[j]=buf[p++];
+      }
+    }
+  } else {
+    memcpy(in,&buf[i],17*sizeof(short));
+  }
+
+  if (emphasis) brrApplyEmphasis(in,x);
+}
+
+// read the extra block which is played when looping
+static void brrReadLoopBlock(const short* buf, short* in, long len, long loopStart, unsigned char emphasis, short* x) {
+  long p=loopStart;
+  for (int i=0; i<17; i++) {
+    if (p>=len) {
+      p=loopStart;
+    }
+    in[i]=buf[p++];
+  }
+
+  if (emphasis) brrApplyEmphasis(in,x);
+}
+
 long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigned char emphasis, unsigned char noFilter) {
   if (len==0) return 0;
 
@@ -159,63 +445,23 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
   unsigned char range=0;
   unsigned char numFilters=noFilter?2:4;
 
-  short x0=0;
-  short x1=0;
-  short x2=0;
-  int emphOut=0;
-
+  short x[3];
   short in[17];
+  short last1=0;
+  short last2=0;
 
-  short last1[4][13];
-  short last2[4][13];
-  int avgError[4][13];
-  unsigned char possibleOut[4][13][8];
+  BRRSearch cand[4];
+  BRRSearchFunc search=brrGetSearchFunc();
 
-  memset(in,0,16*sizeof(short));
-  memset(last1,0,4*13*sizeof(short));
-  memset(last2,0,4*13*sizeof(short));
-  memset(avgError,0,4*13*sizeof(int));
-  memset(possibleOut,0,4*13*8);
+  memset(x,0,3*sizeof(short));
+  memset(in,0,17*sizeof(short));
 
   for (long i=0; i<len; i+=16) {
-    if (i+17>len) {
-      long p=i;
-      for (int j=0; j<17; j++) {
-        if (p>=len) {
-          if (loopStart<0 || loopStart>=len) {
-            in[j]=0;
-          } else {
-            p=loopStart;
-            in[j]=buf[p++];
-          }
-        } else {
-          in[j]=buf[p++];
-        }
-      }
-    } else {
-      memcpy(in,&buf[i],17*sizeof(short));
-    }
-    
-    // emphasis
-    if (emphasis) {
-      for (int j=0; j<17; j++) {
-        x0=x1;
-        x1=x2;
-        x2=in[j];
-
-        if (j==0) continue;
-        emphOut=((x1<<11)-x0*370-in[j]*374)/1305;
-        if (emphOut<-32768) emphOut=-32768;
-        if (emphOut>32767) emphOut=32767;
-        in[j-1]=emphOut;
-      }
-    }
+    brrReadBlock(buf,in,i,len,loopStart,emphasis,x);
 
     // encode
     for (int j=0; j<numFilters; j++) {
-      for (int k=0; k<13; k++) {
-        brrEncodeBlock(in,possibleOut[j][k],k,j,&last1[j][k],&last2[j][k],&avgError[j][k]);
-      }
+      search(in,last1,last2,j,0,&cand[j]);
     }
 
     // find best filter/range
@@ -223,16 +469,16 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
     if (i==0) {
       filter=0;
       for (int k=0; k<13; k++) {
-        if (avgError[0][k]<candError) {
-          candError=avgError[0][k];
+        if (cand[0].error[k]<candError) {
+          candError=cand[0].error[k];
           range=k;
         }
       }
     } else {
       for (int j=0; j<numFilters; j++) {
         for (int k=0; k<13; k++) {
-          if (avgError[j][k]<candError) {
-            candError=avgError[j][k];
+          if (cand[j].error[k]<candError) {
+            candError=cand[j].error[k];
             filter=j;
             range=k;
           }
@@ -242,56 +488,28 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
 
     // write
     out[0]=(range<<4)|(filter<<2)|((i+16>=len && loopStart<0)?1:0);
-    for (int j=0; j<8; j++) {
-      out[j+1]=possibleOut[filter][range][j];
-    }
+    brrPackBlock(&cand[filter],range,&out[1]);
 
-    for (int j=0; j<numFilters; j++) {
-      for (int k=0; k<13; k++) {
-        last1[j][k]=last1[filter][range];
-        last2[j][k]=last2[filter][range];
-      }
-    }
+    last1=cand[filter].last1[range];
+    last2=cand[filter].last2[range];
     out+=9;
     total+=9;
   }
   // encode loop block
   if (loopStart>=0) {
-    long p=loopStart;
-    for (int i=0; i<17; i++) {
-      if (p>=len) {
-        p=loopStart;
-      }
-      in[i]=buf[p++];
-    }
-
-    if (emphasis) {
-      for (int j=0; j<17; j++) {
-        x0=x1;
-        x1=x2;
-        x2=in[j];
-
-        if (j==0) continue;
-        emphOut=((x1<<11)-x0*370-in[j]*374)/1305;
-        if (emphOut<-32768) emphOut=-32768;
-        if (emphOut>32767) emphOut=32767;
-        in[j-1]=emphOut;
-      }
-    }
+    brrReadLoopBlock(buf,in,len,loopStart,emphasis,x);
 
     // encode (filter 0/1 only)
     for (int j=0; j<2; j++) {
-      for (int k=0; k<13; k++) {
-        brrEncodeBlock(in,possibleOut[j][k],k,j,&last1[j][k],&last2[j][k],&avgError[j][k]);
-      }
+      search(in,last1,last2,j,0,&cand[j]);
     }
 
     // find best filter/range
     int candError=0x7fffffff;
     for (int j=0; j<2; j++) {
       for (int k=0; k<13; k++) {
-        if (avgError[j][k]<candError) {
-          candError=avgError[j][k];
+        if (cand[j].error[k]<candError) {
+          candError=cand[j].error[k];
           filter=j;
           range=k;
         }
@@ -300,19 +518,163 @@ long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigne
 
     // write
     out[0]=(range<<4)|(filter<<2)|3;
-    for (int j=0; j<8; j++) {
-      out[j+1]=possibleOut[filter][range][j];
+    brrPackBlock(&cand[filter],range,&out[1]);
+    out+=9;
+    total+=9;
+  }
+  return total;
+}
+
+#define BRR_MAX_PATHS 32
+
+typedef struct {
+  long long error;
+  short last1, last2;
+  // where this path comes from (index into the previous list) and how
+  int prev, filter, range;
+  // index of its last block in the node list
+  long node;
+} BRRPath;
+
+typedef struct {
+  unsigned char data[9];
+  long parent;
+} BRRNode;
+
+// add a candidate to the list of best paths (sorted by error).
+// paths ending in the same decoder state have the same future, so only the
+// best one of them is kept.
+static int brrAddPath(BRRPath* list, int count, int maxCount, const BRRPath* p) {
+  if (count>=maxCount && list[count-1].error<=p->error) return count;
+  for (int i=0; i<count; i++) {
+    if (list[i].last1==p->last1 && list[i].last2==p->last2) {
+      if (list[i].error<=p->error) return count;
+      memmove(&list[i],&list[i+1],(count-i-1)*sizeof(BRRPath));
+      count--;
+      break;
     }
+  }
+  if (count>=maxCount) count--;
+  int pos=count;
+  while (pos>0 && list[pos-1].error>p->error) pos--;
+  memmove(&list[pos+1],&list[pos],(count-pos)*sizeof(BRRPath));
+  list[pos]=*p;
+  return count+1;
+}
 
-    for (int j=0; j<4; j++) {
-      for (int k=0; k<13; k++) {
-        last1[j][k]=last1[filter][range];
-        last2[j][k]=last2[filter][range];
+long brrEncodeTrellis(short* buf, unsigned char* out, long len, long loopStart, unsigned char emphasis, unsigned char noFilter, int paths) {
+  if (len==0) return 0;
+  if (paths<1) paths=1;
+  if (paths>BRR_MAX_PATHS) paths=BRR_MAX_PATHS;
+
+  long blocks=(len+15)>>4;
+  unsigned char numFilters=noFilter?2:4;
+
+  BRRNode* nodes=(BRRNode*)malloc(blocks*paths*sizeof(BRRNode));
+  BRRSearch* cand=(BRRSearch*)malloc(paths*4*sizeof(BRRSearch));
+  if (nodes==NULL || cand==NULL) {
+    free(nodes);
+    free(cand);
+    return brrEncode(buf,out,len,loopStart,emphasis,noFilter);
+  }
+
+  BRRPath cur[BRR_MAX_PATHS];
+  BRRPath next[BRR_MAX_PATHS];
+  int curCount=1;
+  int nextCount=0;
+
+  short x[3];
+  short in[17];
+
+  BRRSearchFunc search=brrGetSearchFunc();
+
+  memset(x,0,3*sizeof(short));
+  memset(in,0,17*sizeof(short));
+  memset(cur,0,sizeof(cur));
+  cur[0].node=-1;
+
+  for (long b=0; b<blocks; b++) {
+    long i=b<<4;
+    // the first block may not use a filter
+    int blockFilters=(i==0)?1:numFilters;
+
+    brrReadBlock(buf,in,i,len,loopStart,emphasis,x);
+
+    nextCount=0;
+    for (int p=0; p<curCount; p++) {
+      for (int j=0; j<blockFilters; j++) {
+        BRRSearch* c=&cand[(p<<2)+j];
+        search(in,cur[p].last1,cur[p].last2,j,1,c);
+        for (int k=0; k<13; k++) {
+          BRRPath np;
+          np.error=cur[p].error+c->error[k];
+          np.last1=c->last1[k];
+          np.last2=c->last2[k];
+          np.prev=p;
+          np.filter=j;
+          np.range=k;
+          np.node=-1;
+          nextCount=brrAddPath(next,nextCount,paths,&np);
+        }
       }
     }
-    out+=9;
+
+    for (int p=0; p<nextCount; p++) {
+      BRRNode* n=&nodes[b*paths+p];
+      n->data[0]=(next[p].range<<4)|(next[p].filter<<2)|((i+16>=len && loopStart<0)?1:0);
+      brrPackBlock(&cand[(next[p].prev<<2)+next[p].filter],next[p].range,&n->data[1]);
+      n->parent=cur[next[p].prev].node;
+      next[p].node=b*paths+p;
+    }
+
+    memcpy(cur,next,nextCount*sizeof(BRRPath));
+    curCount=nextCount;
+  }
+
+  // pick the best path (taking the loop block into account)
+  int best=0;
+  unsigned char loopBlock[9];
+  if (loopStart>=0) {
+    long long bestError=0;
+    brrReadLoopBlock(buf,in,len,loopStart,emphasis,x);
+    for (int p=0; p<curCount; p++) {
+      int candError=0x7fffffff;
+      int filter=0;
+      int range=0;
+      // filter 0/1 only
+      for (int j=0; j<2; j++) {
+        search(in,cur[p].last1,cur[p].last2,j,1,&cand[j]);
+        for (int k=0; k<13; k++) {
+          if (cand[j].error[k]<candError) {
+            candError=cand[j].error[k];
+            filter=j;
+            range=k;
+          }
+        }
+      }
+      if (p==0 || cur[p].error+candError<bestError) {
+        bestError=cur[p].error+candError;
+        best=p;
+        loopBlock[0]=(range<<4)|(filter<<2)|3;
+        brrPackBlock(&cand[filter],range,&loopBlock[1]);
+      }
+    }
+  }
+
+  // write (backwards)
+  long n=cur[best].node;
+  for (long b=blocks-1; b>=0; b--) {
+    memcpy(&out[b*9],nodes[n].data,9);
+    n=nodes[n].parent;
+  }
+  long total=blocks*9;
+  if (loopStart>=0) {
+    memcpy(&out[total],loopBlock,9);
     total+=9;
   }
+
+  free(nodes);
+  free(cand);
   return total;
 }
 
@@ -39,6 +39,22 @@ extern "C" {
  */
 long brrEncode(short* buf, unsigned char* out, long len, long loopStart, unsigned char emphasis, unsigned char noFilter);
 
+/**
+ * like brrEncode(), but search for the sequence of blocks with the lowest total error.
+ * since the decoder state carries over between blocks, the locally best choice isn't always the best one.
+ * this keeps the best few candidate paths (beam search) and picks the best one at the end.
+ * output size is the same as brrEncode().
+ * @param buf input data.
+ * @param out output buffer. see brrEncode().
+ * @param len input length.
+ * @param loopStart beginning of loop area (may be -1 for no loop).
+ * @param emphasis apply filter to compensate for Gaussian interpolation high frequency loss.
+ * @param noFilter do not use filters in any block.
+ * @param paths number of paths to keep (1 to 32). higher is better but slower.
+ * @return number of written samples.
+ */
+long brrEncodeTrellis(short* buf, unsigned char* out, long len, long loopStart, unsigned char emphasis, unsigned char noFilter, int paths);
+
 /**
  * read len bytes from buf, decode BRR and output to out.
  * @param buf input data.
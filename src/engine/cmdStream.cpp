@@ -24,7 +24,7 @@
 #include "../ta-log.h"
 
 bool DivCSChannelState::doCall(unsigned int addr) {
-  if (callStackPos>=8) {
+  if (callStackPos>=DIV_MAX_CSSTACK) {
     readPos=0;
     return false;
   }
@@ -113,6 +113,7 @@ bool DivCSPlayer::tick() {
         case 0xb8: case 0xbe: case 0xc0: case 0xc2:
         case 0xc3: case 0xc4: case 0xc5: case 0xc6:
         case 0xc7: case 0xc8: case 0xc9: case 0xca:
+        case 0xcb:
           command=next-0xb4;
           break;
         case 0xf7:
@@ -120,23 +121,32 @@ bool DivCSPlayer::tick() {
           break;
         case 0xf8: {
           unsigned int callAddr=chan[i].readPos+2+stream.readS();
+          // return to the next command
+          chan[i].readPos=stream.tell();
           if (!chan[i].doCall(callAddr)) {
             logE("%d: (callb16) stack error!",i);
           }
+          mustTell=false;
           break;
         }
         case 0xf6: {
           unsigned int callAddr=chan[i].readPos+4+stream.readI();
+          // return to the next command
+          chan[i].readPos=stream.tell();
           if (!chan[i].doCall(callAddr)) {
             logE("%d: (callb32) stack error!",i);
           }
+          mustTell=false;
           break;
         }
         case 0xf5: {
           unsigned int callAddr=stream.readI();
+          // return to the next command
+          chan[i].readPos=stream.tell();
           if (!chan[i].doCall(callAddr)) {
             logE("%d: (call) stack error!",i);
           }
+          mustTell=false;
           break;
         }
         case 0xf4: {
@@ -18,7 +18,10 @@
  */
 
 #include "engine.h"
+#include "suffixArray.h"
 #include "../ta-log.h"
+#include <map>
+#include <queue>
 
 #define WRITE_TICK(x) \
   if (!wroteTick[x]) { \
@@ -203,6 +206,406 @@ void writePackedCommandValues(SafeWriter* w, const DivCommand& c) {
   }
 }
 
+// subroutines are made out of runs up to this many commands long
+#define DIV_CS_MAX_CALL_LEN 1024
+// every round may nest calls one level deeper
+#define DIV_CS_MAX_ROUNDS DIV_MAX_CSSTACK
+// at most this many lengths are tried for each candidate
+#define DIV_CS_MAX_LENGTHS 32
+// size of a short call (0xf8) and a long one (0xf5)
+#define DIV_CS_CALL_SIZE 3
+#define DIV_CS_LONG_CALL_SIZE 5
+
+// channel streams and subroutines, split into commands.
+// non-negative tokens are indices into cmds, negative ones are calls to stream -1-token.
+struct DivCSProgram {
+  std::vector<String> cmds;
+  std::vector<std::vector<int>> streams;
+  int chans;
+  // frames a call to each stream uses, and frames on the stack while each stream is running
+  std::vector<int> level, depth;
+  // who calls each stream and what each stream calls (may contain duplicates)
+  std::vector<std::vector<int>> callers, callees;
+
+  int getTokenSize(int token) {
+    return (token<0)?DIV_CS_CALL_SIZE:cmds[token].size();
+  }
+
+  void raiseLevel(int stream, int l) {
+    if (level[stream]>=l) return;
+    level[stream]=l;
+    for (int i: callers[stream]) {
+      raiseLevel(i,l+1);
+    }
+  }
+
+  void raiseDepth(int stream, int d) {
+    if (depth[stream]>=d) return;
+    depth[stream]=d;
+    for (int i: callees[stream]) {
+      raiseDepth(i,d+1);
+    }
+  }
+
+  void addCall(int from, int to) {
+    callees[from].push_back(to);
+    callers[to].push_back(from);
+    raiseDepth(to,depth[from]+1);
+    raiseLevel(from,level[to]+1);
+  }
+
+  void buildCallGraph() {
+    int count=streams.size();
+    level.assign(count,1);
+    depth.assign(count,0);
+    callers.assign(count,std::vector<int>());
+    callees.assign(count,std::vector<int>());
+    for (int i=0; i<count; i++) {
+      for (int j: streams[i]) {
+        if (j<0) addCall(i,-1-j);
+      }
+    }
+  }
+};
+
+struct DivCSCandidate {
+  // range in the suffix array and range of lengths sharing these positions
+  int lb, rb, minLen, maxLen;
+  int bytesSaved;
+  int length;
+  // pick count bytesSaved was computed for, or -1
+  int evalId;
+  DivCSCandidate(int l, int r, int minL, int maxL, int saved):
+    lb(l),
+    rb(r),
+    minLen(minL),
+    maxLen(maxL),
+    bytesSaved(saved),
+    length(maxL),
+    evalId(-1) {}
+};
+
+// all streams in a single sequence for finding repeats
+struct DivCSSequence {
+  std::vector<int> tokens;
+  std::vector<int> values;
+  // stream of each token (-1 for separators)
+  std::vector<int> stream;
+  std::vector<int> sizeSum;
+  std::vector<int> sa, rank, lcp;
+  // runs of commands put in a subroutine (start and end)
+  std::map<int,int> taken;
+
+  // number of commands from pos on which are not in a subroutine yet (up to max)
+  int getFreeLen(int pos, int max) const {
+    auto next=taken.upper_bound(pos);
+    if (next!=taken.begin()) {
+      auto prev=std::prev(next);
+      if (prev->second>pos) return 0;
+    }
+    if (next==taken.end()) return max;
+    return MIN(max,next->first-pos);
+  }
+};
+
+// compute the bytes saved by a candidate and the best length.
+// occurrences are picked from left to right, skipping those which overlap another one,
+// commands in a subroutine already or which would nest calls too deeply.
+static void evalCSCandidate(DivCSProgram& prog, const DivCSSequence& seq, DivCSCandidate& c, std::vector<int>& pos) {
+  std::vector<int> sorted(seq.sa.begin()+c.lb,seq.sa.begin()+c.rb+1);
+  std::sort(sorted.begin(),sorted.end());
+  int p=sorted[0];
+
+  // stack usage of the run for every length
+  std::vector<int> runLevel(c.maxLen+1,1);
+  for (int i=0; i<c.maxLen; i++) {
+    int t=seq.tokens[p+i];
+    runLevel[i+1]=MAX(runLevel[i],(t<0)?prog.level[-1-t]+1:1);
+  }
+
+  std::vector<int> freeLen(sorted.size());
+  std::vector<int> lengths;
+  lengths.push_back(c.maxLen);
+  for (size_t i=0; i<sorted.size(); i++) {
+    int len=seq.getFreeLen(sorted[i],c.maxLen);
+    freeLen[i]=len;
+    // the number of occurrences only changes past these lengths
+    if (len>=c.minLen) lengths.push_back(len);
+    if (i>0) {
+      int gap=sorted[i]-sorted[i-1];
+      if (gap>=c.minLen && gap<c.maxLen) lengths.push_back(gap);
+    }
+  }
+  std::sort(lengths.begin(),lengths.end());
+  lengths.erase(std::unique(lengths.begin(),lengths.end()),lengths.end());
+  if (lengths.size()>DIV_CS_MAX_LENGTHS) {
+    std::vector<int> fewer;
+    for (int i=0; i<DIV_CS_MAX_LENGTHS; i++) {
+      fewer.push_back(lengths[((lengths.size()-1)*i)/(DIV_CS_MAX_LENGTHS-1)]);
+    }
+    lengths=fewer;
+  }
+
+  // try the longest runs first, and stop once a shorter one cannot do better
+  // even if every occurrence were used
+  c.bytesSaved=0;
+  int maxCount=sorted.size();
+  for (int j=(int)lengths.size()-1; j>=0; j--) {
+    int len=lengths[j];
+    int maxSize=seq.sizeSum[p+len]-seq.sizeSum[p];
+    if (maxCount*maxSize-(maxCount*DIV_CS_CALL_SIZE+maxSize+1)<=c.bytesSaved) break;
+    int count=0;
+    int nextFree=0;
+    for (size_t i=0; i<sorted.size(); i++) {
+      if (sorted[i]<nextFree || freeLen[i]<len) continue;
+      if (prog.depth[seq.stream[sorted[i]]]+runLevel[len]>DIV_MAX_CSSTACK) continue;
+      count++;
+      nextFree=sorted[i]+len;
+    }
+    if (count<2) continue;
+    // calls, plus the subroutine and its return
+    int bytesSaved=count*maxSize-(count*DIV_CS_CALL_SIZE+maxSize+1);
+    if (bytesSaved>c.bytesSaved) {
+      c.bytesSaved=bytesSaved;
+      c.length=len;
+    }
+  }
+
+  pos.clear();
+  if (c.bytesSaved<=0) return;
+  int nextFree=0;
+  for (size_t i=0; i<sorted.size(); i++) {
+    if (sorted[i]<nextFree || freeLen[i]<c.length) continue;
+    if (prog.depth[seq.stream[sorted[i]]]+runLevel[c.length]>DIV_MAX_CSSTACK) continue;
+    pos.push_back(sorted[i]);
+    nextFree=sorted[i]+c.length;
+  }
+}
+
+// find repeated runs of commands in all streams and put them in subroutines.
+// returns whether any were found.
+static bool findCSSubroutines(DivCSProgram& prog) {
+  int streamCount=prog.streams.size();
+  int cmdCount=prog.cmds.size();
+
+  DivCSSequence seq;
+  seq.sizeSum.push_back(0);
+  for (int i=0; i<streamCount; i++) {
+    for (int j: prog.streams[i]) {
+      seq.tokens.push_back(j);
+      seq.values.push_back((j<0)?(cmdCount-1-j):j);
+      seq.stream.push_back(i);
+      seq.sizeSum.push_back(seq.sizeSum.back()+prog.getTokenSize(j));
+    }
+    // separators are unique so that runs don't cross streams
+    seq.tokens.push_back(0);
+    seq.values.push_back(cmdCount+streamCount+i);
+    seq.stream.push_back(-1);
+    seq.sizeSum.push_back(seq.sizeSum.back());
+  }
+  divBuildSuffixArray(seq.values,seq.sa,seq.rank,seq.lcp);
+
+  std::vector<DivCSCandidate> candidates;
+  divWalkLCPIntervals(seq.lcp,[&seq,&candidates](int lb, int rb, int len, int parentLen) {
+    int maxLen=MIN(len,DIV_CS_MAX_CALL_LEN);
+    if (maxLen<=parentLen) return;
+    int p=seq.sa[lb];
+    int size=seq.sizeSum[p+maxLen]-seq.sizeSum[p];
+    int count=rb-lb+1;
+    int upperBound=count*size-(count*DIV_CS_CALL_SIZE+size+1);
+    if (upperBound>0) {
+      candidates.push_back(DivCSCandidate(lb,rb,parentLen+1,maxLen,upperBound));
+    }
+  });
+
+  // pick the candidate saving the most bytes until none are left.
+  // savings only go down as commands are taken, so a candidate is only evaluated
+  // again when it reaches the top of the queue.
+  std::priority_queue<std::pair<int,int>> queue;
+  for (int i=0; i<(int)candidates.size(); i++) {
+    queue.push(std::pair<int,int>(candidates[i].bytesSaved,i));
+  }
+  std::vector<int> pos;
+  // start of every call site and the subroutine it calls
+  std::vector<int> siteLen(seq.tokens.size(),0);
+  std::vector<int> siteCall(seq.tokens.size(),0);
+  int picks=0;
+  while (!queue.empty()) {
+    int ci=queue.top().second;
+    queue.pop();
+    DivCSCandidate& c=candidates[ci];
+    if (c.evalId!=picks) {
+      evalCSCandidate(prog,seq,c,pos);
+      c.evalId=picks;
+      if (c.bytesSaved>0) queue.push(std::pair<int,int>(c.bytesSaved,ci));
+      continue;
+    }
+    evalCSCandidate(prog,seq,c,pos);
+    if (pos.size()<2) continue;
+
+    // make a subroutine out of it
+    int sub=prog.streams.size();
+    prog.streams.push_back(std::vector<int>(seq.tokens.begin()+pos[0],seq.tokens.begin()+pos[0]+c.length));
+    prog.level.push_back(1);
+    prog.depth.push_back(0);
+    prog.callers.push_back(std::vector<int>());
+    prog.callees.push_back(std::vector<int>());
+    for (int i: prog.streams[sub]) {
+      if (i<0) prog.addCall(sub,-1-i);
+    }
+    for (int i: pos) {
+      prog.addCall(seq.stream[i],sub);
+      siteLen[i]=c.length;
+      siteCall[i]=-1-sub;
+      seq.taken[i]=i+c.length;
+    }
+    picks++;
+
+    // shorter runs may still be worth it
+    c.evalId=-1;
+    queue.push(std::pair<int,int>(c.bytesSaved,ci));
+  }
+  if (picks==0) return false;
+
+  // replace the runs with calls
+  for (int i=0, p=0; i<streamCount; i++) {
+    std::vector<int>& stream=prog.streams[i];
+    int end=p+stream.size();
+    stream.clear();
+    while (p<end) {
+      if (siteLen[p]) {
+        stream.push_back(siteCall[p]);
+        p+=siteLen[p];
+      } else {
+        stream.push_back(seq.tokens[p++]);
+      }
+    }
+    // separator
+    p++;
+  }
+  return true;
+}
+
+// subroutines called from a single place are put back there
+static void inlineCSSubroutines(DivCSProgram& prog) {
+  int count=prog.streams.size();
+  std::vector<int> uses(count,0);
+  for (int i=0; i<count; i++) {
+    for (int j: prog.streams[i]) {
+      if (j<0) uses[-1-j]++;
+    }
+  }
+  for (int i=0; i<count; i++) {
+    std::vector<int> out;
+    for (int j: prog.streams[i]) {
+      if (j<0 && uses[-1-j]==1) {
+        // may contain other ones
+        std::vector<int> stack;
+        stack.push_back(j);
+        while (!stack.empty()) {
+          int t=stack.back();
+          stack.pop_back();
+          if (t<0 && uses[-1-t]==1) {
+            const std::vector<int>& body=prog.streams[-1-t];
+            for (int k=body.size()-1; k>=0; k--) {
+              stack.push_back(body[k]);
+            }
+          } else {
+            out.push_back(t);
+          }
+        }
+      } else {
+        out.push_back(j);
+      }
+    }
+    prog.streams[i]=out;
+  }
+
+  // remove the inlined ones
+  std::vector<int> newIndex(count,-1);
+  int next=prog.chans;
+  for (int i=prog.chans; i<count; i++) {
+    if (uses[i]<=1) continue;
+    newIndex[i]=next;
+    if (next!=i) prog.streams[next]=prog.streams[i];
+    next++;
+  }
+  prog.streams.resize(next);
+  for (std::vector<int>& i: prog.streams) {
+    for (int& j: i) {
+      if (j<0) j=-1-newIndex[-1-j];
+    }
+  }
+}
+
+// write all streams, using short calls where possible.
+// returns the offset of every stream.
+static std::vector<unsigned int> writeCSProgram(DivCSProgram& prog, SafeWriter* w) {
+  int count=prog.streams.size();
+  unsigned int base=w->tell();
+  std::vector<unsigned int> offsets(count,0);
+  std::vector<std::vector<bool>> longCall(count);
+  for (int i=0; i<count; i++) {
+    longCall[i].assign(prog.streams[i].size(),false);
+  }
+
+  // calls only grow, so this ends
+  bool changed=true;
+  while (changed) {
+    changed=false;
+    unsigned int pos=base;
+    for (int i=0; i<count; i++) {
+      offsets[i]=pos;
+      for (size_t j=0; j<prog.streams[i].size(); j++) {
+        int t=prog.streams[i][j];
+        if (t<0) {
+          pos+=longCall[i][j]?DIV_CS_LONG_CALL_SIZE:DIV_CS_CALL_SIZE;
+        } else {
+          pos+=prog.cmds[t].size();
+        }
+      }
+      // stop or return
+      pos++;
+    }
+    for (int i=0; i<count; i++) {
+      unsigned int callPos=offsets[i];
+      for (size_t j=0; j<prog.streams[i].size(); j++) {
+        int t=prog.streams[i][j];
+        if (t>=0) {
+          callPos+=prog.cmds[t].size();
+          continue;
+        }
+        if (!longCall[i][j]) {
+          // relative to the offset field
+          int offset=(int)offsets[-1-t]-(int)(callPos+2);
+          if (offset<-32768 || offset>32767) {
+            longCall[i][j]=true;
+            changed=true;
+          }
+        }
+        callPos+=longCall[i][j]?DIV_CS_LONG_CALL_SIZE:DIV_CS_CALL_SIZE;
+      }
+    }
+  }
+
+  for (int i=0; i<count; i++) {
+    for (size_t j=0; j<prog.streams[i].size(); j++) {
+      int t=prog.streams[i][j];
+      if (t>=0) {
+        w->write(prog.cmds[t].data(),prog.cmds[t].size());
+      } else if (longCall[i][j]) {
+        w->writeC(0xf5);
+        w->writeI(offsets[-1-t]);
+      } else {
+        w->writeC(0xf8);
+        w->writeS((int)offsets[-1-t]-(int)(w->tell()+1));
+      }
+    }
+    w->writeC((i<prog.chans)?0xff:0xf9);
+  }
+  return offsets;
+}
+
 SafeWriter* DivEngine::saveCommand() {
   stop();
   repeatPattern=false;
@@ -351,6 +754,12 @@ SafeWriter* DivEngine::saveCommand() {
     sortPos++;
   }
 
+  DivCSProgram prog;
+  std::map<String,int> cmdIndex;
+  size_t flatSize=0;
+  prog.chans=chans;
+  prog.streams.resize(chans);
+
   for (int i=0; i<chans; i++) {
     chanStream[i]->writeC(0xff);
     // optimize stream
@@ -358,9 +767,11 @@ SafeWriter* DivEngine::saveCommand() {
     SafeReader* reader=oldStream->toReader();
     chanStream[i]=new SafeWriter;
     chanStream[i]->init();
+    std::vector<size_t> cmdStart;
 
     while (1) {
       try {
+        cmdStart.push_back(chanStream[i]->tell());
         unsigned char next=reader->readC();
         switch (next) {
           case 0xb8: // instrument
@@ -369,7 +780,7 @@ SafeWriter* DivEngine::saveCommand() {
           case 0xc4: // vibrato shape
           case 0xc5: // pitch
           case 0xc7: // volume
-          case 0xca: // legato
+          case 0xcb: // legato
             chanStream[i]->writeC(next);
             next=reader->readC();
             chanStream[i]->writeC(next);
@@ -378,13 +789,20 @@ SafeWriter* DivEngine::saveCommand() {
           case 0xc2: // vibrato
           case 0xc6: // arpeggio
           case 0xc8: // vol slide
-          case 0xc9: // porta
+          case 0xca: // porta
             chanStream[i]->writeC(next);
             next=reader->readC();
             chanStream[i]->writeC(next);
             next=reader->readC();
             chanStream[i]->writeC(next);
             break;
+          case 0xc9: // vol slide with target
+            chanStream[i]->writeC(next);
+            for (int j=0; j<4; j++) {
+              next=reader->readC();
+              chanStream[i]->writeC(next);
+            }
+            break;
           case 0xf0: { // full command (pre)
             unsigned char cmd=reader->readC();
             bool foundShort=false;
@@ -462,16 +880,40 @@ SafeWriter* DivEngine::saveCommand() {
 
     oldStream->finish();
     delete oldStream;
-  }
 
-  for (int i=0; i<chans; i++) {
-    chanStreamOff[i]=w->tell();
-    logI("- %d: off %x size %ld",i,chanStreamOff[i],chanStream[i]->size());
-    w->write(chanStream[i]->getFinalBuf(),chanStream[i]->size());
+    // split it into commands (leaving the stop command out)
+    size_t streamSize=chanStream[i]->size();
+    flatSize+=streamSize;
+    unsigned char* buf=chanStream[i]->getFinalBuf();
+    cmdStart.push_back(streamSize);
+    for (size_t j=0; j+1<cmdStart.size(); j++) {
+      if (cmdStart[j]>=streamSize-1) break;
+      String cmd((const char*)&buf[cmdStart[j]],cmdStart[j+1]-cmdStart[j]);
+      auto id=cmdIndex.find(cmd);
+      if (id==cmdIndex.end()) {
+        id=cmdIndex.emplace(cmd,(int)prog.cmds.size()).first;
+        prog.cmds.push_back(cmd);
+      }
+      prog.streams[i].push_back(id->second);
+    }
     chanStream[i]->finish();
     delete chanStream[i];
   }
 
+  // put repeated runs of commands in subroutines
+  for (int i=0; i<DIV_CS_MAX_ROUNDS; i++) {
+    prog.buildCallGraph();
+    if (!findCSSubroutines(prog)) break;
+  }
+  inlineCSSubroutines(prog);
+
+  std::vector<unsigned int> streamOff=writeCSProgram(prog,w);
+  for (int i=0; i<chans; i++) {
+    chanStreamOff[i]=streamOff[i];
+    logI("- %d: off %x size %d",i,chanStreamOff[i],(int)(((i+1<(int)streamOff.size())?streamOff[i+1]:w->size())-streamOff[i]));
+  }
+  logI("%d subroutines. size: %d (%d without subroutines)",(int)prog.streams.size()-chans,(int)w->size(),(int)(streamOff[0]+flatSize));
+
   w->seek(8,SEEK_SET);
   for (int i=0; i<chans; i++) {
     w->writeI(chanStreamOff[i]);
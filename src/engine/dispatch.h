@@ -404,8 +404,48 @@ struct DivDispatchOscBuffer {
     followNeedle(0) {
     memset(data,0,65536*sizeof(short));
   }
+
+  /**
+   * append a block of samples (for cores which render in blocks).
+   * @param src the samples.
+   * @param len how many (up to 65536).
+   */
+  void putBlock(const short* src, size_t len) {
+    size_t first=65536-(size_t)needle;
+    if (first>len) first=len;
+    memcpy(&data[needle],src,first*sizeof(short));
+    if (len>first) memcpy(data,&src[first],(len-first)*sizeof(short));
+    needle+=len;
+  }
+
+  /**
+   * append a block of a constant value (e.g. for muted channels).
+   * @param val the value.
+   * @param len how many (up to 65536).
+   */
+  void fillBlock(short val, size_t len) {
+    for (size_t i=0; i<len; i++) {
+      data[(unsigned short)(needle+i)]=val;
+    }
+    needle+=len;
+  }
 };
 
+// maximum length of a block for cores which render in blocks (see DivDispatch::acquire()).
+#define DIV_BLOCK_LEN 256
+
+/**
+ * for cores which render in blocks: get the number of samples before a
+ * software DAC/PCM step (period+=rate every sample, step once period>limit).
+ * @return how many samples can be rendered without checking, or max if there's no step ahead.
+ */
+static inline size_t divSamplesBeforeStep(int period, int rate, int limit, size_t max) {
+  if (period+rate>limit) return 0;
+  if (rate<=0) return max;
+  size_t ret=(size_t)((limit-period)/rate);
+  return (ret<max)?ret:max;
+}
+
 struct DivChannelPair {
   const char* label;
   // -1: none
@@ -547,6 +587,11 @@ class DivDispatch {
 
     /**
      * fill a buffer with sound data.
+     * register writes queued by tick() are due at the start of the buffer.
+     * cores may render in blocks (up to DIV_BLOCK_LEN samples): apply the
+     * pending writes, render the run until the next event (e.g. a DAC step)
+     * without per-sample checks, and copy oscilloscope data with
+     * DivDispatchOscBuffer::putBlock().
      * @param buf pointers to output buffers.
      * @param len the amount of samples to fill.
      */
@@ -649,18 +694,27 @@ class DivDispatch {
     virtual int getRegisterPoolDepth();
 
     /**
-     * get this dispatch's state. DO NOT IMPLEMENT YET.
-     * @return a pointer to the dispatch's state. must be deallocated manually!
+     * get this dispatch's playback state (channel state, macros and such).
+     * used by the engine to build seek keyframes.
+     * the state of the emulated chip itself is NOT included, since register writes are skipped while seeking.
+     * @return a pointer to the dispatch's state, or NULL if this dispatch does not support state saves.
+     * must be deallocated using freeState()!
      */
     virtual void* getState();
 
     /**
-     * set this dispatch's state. DO NOT IMPLEMENT YET.
-     * @param state a pointer to a state pertaining to this dispatch,
-     * or NULL if this dispatch does not support state saves.
+     * set this dispatch's state.
+     * the state shall only be restored on the same dispatch instance that produced it.
+     * @param state a pointer to a state pertaining to this dispatch.
      */
     virtual void setState(void* state);
 
+    /**
+     * deallocate a state returned by getState().
+     * @param state the state.
+     */
+    virtual void freeState(void* state);
+
     /**
      * mute a channel.
      * @param ch the channel to mute.
@@ -19,6 +19,7 @@
 
 #include "blip_buf.h"
 #include "engine.h"
+#include <chrono>
 #include "platform/genesis.h"
 #include "platform/genesisext.h"
 #include "platform/msm5232.h"
@@ -164,7 +165,9 @@ void DivDispatchContainer::acquire(size_t offset, size_t count) {
       }
     }
   }
+  std::chrono::steady_clock::time_point ts_begin=std::chrono::steady_clock::now();
   dispatch->acquire(bbInMapped,count);
+  acquireTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ts_begin).count();
 }
 
 void DivDispatchContainer::flush(size_t count) {
@@ -179,6 +182,8 @@ void DivDispatchContainer::flush(size_t count) {
 void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size) {
   CHECK_MISSING_BUFS;
 
+  std::chrono::steady_clock::time_point ts_begin=std::chrono::steady_clock::now();
+
   if (dcOffCompensation && runtotal>0) {
     dcOffCompensation=false;
     if (hiPass) {
@@ -188,27 +193,13 @@ void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size)
       }
     }
   }
-  if (lowQuality) {
-    for (int i=0; i<outs; i++) {
-      if (bbIn[i]==NULL) continue;
-      if (bb[i]==NULL) continue;
-      for (size_t j=0; j<runtotal; j++) {
-        if (bbIn[i][j]==temp[i]) continue;
-        temp[i]=bbIn[i][j];
-        blip_add_delta_fast(bb[i],j,temp[i]-prevSample[i]);
-        prevSample[i]=temp[i];
-      }
-    }
-  } else {
-    for (int i=0; i<outs; i++) {
-      if (bbIn[i]==NULL) continue;
-      if (bb[i]==NULL) continue;
-      for (size_t j=0; j<runtotal; j++) {
-        if (bbIn[i][j]==temp[i]) continue;
-        temp[i]=bbIn[i][j];
-        blip_add_delta(bb[i],j,temp[i]-prevSample[i]);
-        prevSample[i]=temp[i];
-      }
+  for (int i=0; i<outs; i++) {
+    if (bbIn[i]==NULL) continue;
+    if (bb[i]==NULL) continue;
+    if (lowQuality) {
+      blip_add_samples_fast(bb[i],bbIn[i],runtotal,&temp[i],&prevSample[i]);
+    } else {
+      blip_add_samples(bb[i],bbIn[i],runtotal,&temp[i],&prevSample[i]);
     }
   }
 
@@ -218,6 +209,7 @@ void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size)
     blip_end_frame(bb[i],runtotal);
     blip_read_samples(bb[i],bbOut[i]+offset,size,0);
   }
+  fillBufTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ts_begin).count();
   /*if (totalRead<(int)size && totalRead>0) {
     for (size_t i=totalRead; i<size; i++) {
       bbOut[0][i]=bbOut[0][totalRead-1];//bbOut[0][totalRead];
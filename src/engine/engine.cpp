@@ -24,6 +24,7 @@
 #include "instrument.h"
 #include "safeReader.h"
 #include "workPool.h"
+#include "filter.h"
 #include "../ta-log.h"
 #include "../fileutils.h"
 #ifdef HAVE_SDL2
@@ -211,6 +212,9 @@ void DivEngine::findSongLength(int loopOrder, int loopRow, double fadeoutLen, in
 
 #define EXPORT_BUFSIZE 2048
 
+// take a seek keyframe every this many orders
+#define DIV_SEEK_KEYFRAME_INTERVAL 4
+
 double DivEngine::benchmarkPlayback() {
   float* outBuf[2];
   outBuf[0]=new float[EXPORT_BUFSIZE];
@@ -238,18 +242,15 @@ double DivEngine::benchmarkPlayback() {
   return t;
 }
 
-double DivEngine::benchmarkSeek() {
+static double runSeekBenchmark(const std::function<void()>& what, const char* name) {
   double t[20];
-  curOrder=curSubSong->ordersLen-1;
-  prevOrder=curSubSong->ordersLen-1;
 
-  // benchmark
   for (int i=0; i<20; i++) {
     std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
-    playSub(false);     
+    what();
     std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
     t[i]=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
-    printf("[#%d] %fs\n",i+1,t[i]);
+    printf("[%s #%d] %fs\n",name,i+1,t[i]);
   }
 
   double tMin=DBL_MAX;
@@ -262,12 +263,114 @@ double DivEngine::benchmarkSeek() {
   }
   tAvg/=20.0;
 
-  printf("[RESULT] min %fs max %fs average %fs\n",tMin,tMax,tAvg);
+  printf("[RESULT] %s: min %fs max %fs average %fs\n",name,tMin,tMax,tAvg);
   return tAvg;
 }
 
+double DivEngine::benchmarkSeek() {
+  bool oldSeekIndexEnabled=seekIndexEnabled;
+  std::function<void()> seekToEnd=[this]() {
+    curOrder=curSubSong->ordersLen-1;
+    prevOrder=curSubSong->ordersLen-1;
+    playSub(false);
+  };
+
+  // benchmark without keyframes (replay from order 0)
+  clearSeekIndex();
+  seekIndexEnabled=false;
+  double tFull=runSeekBenchmark(seekToEnd,"full");
+
+  // build the seek index, then benchmark again
+  seekIndexEnabled=true;
+  seekToEnd();
+  double tIndex=runSeekBenchmark(seekToEnd,"keyframe");
+
+  int keyframeCount=0;
+  for (int i=0; i<DIV_MAX_PATTERNS; i++) {
+    if (seekKeyframes[i]!=NULL) keyframeCount++;
+  }
+  if (!seekIndexSupported) {
+    printf("[RESULT] a chip in this song does not support seek keyframes.\n");
+  }
+  printf("[RESULT] %d keyframes. speedup: %.2fx\n",keyframeCount,(tIndex>0.0)?(tFull/tIndex):0.0);
+
+  seekIndexEnabled=oldSeekIndexEnabled;
+  return tIndex;
+}
+
+double DivEngine::benchmarkWorkPool() {
+  std::atomic<int> counter(0);
+  unsigned int threadCounts[4]={0,2,4,std::thread::hardware_concurrency()};
+  double ret=0.0;
+
+  for (unsigned int threads: threadCounts) {
+    DivWorkPool* pool=new DivWorkPool(threads);
+
+    // single task (dispatch and wait latency)
+    // and a batch of tasks (typical multi-chip render)
+    for (int batch: {1,8}) {
+      std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
+      for (int i=0; i<10000; i++) {
+        for (int j=0; j<batch; j++) {
+          pool->push([](void* d) {
+            ((std::atomic<int>*)d)->fetch_add(1);
+          },&counter);
+        }
+        pool->wait();
+      }
+      std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+
+      double t=(double)(std::chrono::duration_cast<std::chrono::nanoseconds>(timeEnd-timeStart).count())/10000000.0;
+      printf("[RESULT] %d threads, %d tasks: %fµs per wait()\n",threads,batch,t);
+      ret+=t/1000000.0;
+    }
+
+    delete pool;
+  }
+
+  if (counter!=10000*9*4) {
+    printf("[RESULT] ERROR: %d tasks ran (expected %d)\n",counter.load(),10000*9*4);
+  }
+  return ret;
+}
+
+double DivEngine::benchmarkTiuna() {
+  DivROMExport* exporter=buildROM(DIV_ROM_TIUNA);
+  DivConfig conf;
+  exporter->setConf(conf);
+
+  std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
+  DivRegTimeline* tl=captureRegTimeline();
+  std::chrono::high_resolution_clock::time_point timeCapture=std::chrono::high_resolution_clock::now();
+  exporter->setTimeline(tl);
+  exporter->go(this);
+  exporter->wait();
+  std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+  double tCapture=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeCapture-timeStart).count())/1000000.0;
+  double t=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
+  delete tl;
+
+  if (exporter->hasFailed()) {
+    printf("[RESULT] export failed!\n");
+  }
+  for (String& i: exporter->exportLog) {
+    if (i.find("total size")==0) {
+      printf("[RESULT] %s\n",i.c_str());
+    }
+  }
+  printf("[RESULT] capture: %fs\n",tCapture);
+  printf("[RESULT] %fs\n",t);
+
+  for (DivROMExportOutput& i: exporter->getResult()) {
+    if (i.data!=NULL) delete i.data;
+  }
+  delete exporter;
+  return t;
+}
+
 void DivEngine::notifyInsChange(int ins) {
   BUSY_BEGIN;
+  invalidateSeekIndex();
   for (int i=0; i<song.systemLen; i++) {
     disCont[i].dispatch->notifyInsChange(ins);
   }
@@ -276,6 +379,7 @@ void DivEngine::notifyInsChange(int ins) {
 
 void DivEngine::notifyWaveChange(int wave) {
   BUSY_BEGIN;
+  invalidateSeekIndex();
   for (int i=0; i<song.systemLen; i++) {
     disCont[i].dispatch->notifyWaveChange(wave);
   }
@@ -378,7 +482,22 @@ void DivEngine::renderSamplesP(int whichSample) {
   BUSY_END;
 }
 
+#define DIV_SAMPLE_RENDER_MAX_THREADS 8
+
+struct DivSampleRenderTask {
+  DivSample* sample;
+  unsigned int formatMask;
+  DivSampleCache* cache;
+  int brrPaths;
+};
+
+static void renderSampleTask(void* arg) {
+  DivSampleRenderTask* t=(DivSampleRenderTask*)arg;
+  t->sample->render(t->formatMask,t->cache,t->brrPaths);
+}
+
 void DivEngine::renderSamples(int whichSample) {
+  invalidateSeekIndex();
   sPreview.sample=-1;
   sPreview.pos=0;
   sPreview.dir=false;
@@ -395,11 +514,26 @@ void DivEngine::renderSamples(int whichSample) {
 
   // step 1: render samples
   if (whichSample==-1) {
+    // samples are independent of each other, so render them in parallel
+    unsigned int threads=std::thread::hardware_concurrency();
+    if (threads>DIV_SAMPLE_RENDER_MAX_THREADS) threads=DIV_SAMPLE_RENDER_MAX_THREADS;
+    if (threads>(unsigned int)song.sampleLen) threads=song.sampleLen;
+    if (threads<2) threads=0;
+
+    DivSampleRenderTask* tasks=new DivSampleRenderTask[song.sampleLen];
+    DivWorkPool* pool=new DivWorkPool(threads);
     for (int i=0; i<song.sampleLen; i++) {
-      song.sample[i]->render(formatMask);
+      tasks[i].sample=song.sample[i];
+      tasks[i].formatMask=formatMask;
+      tasks[i].cache=&sampleCache;
+      tasks[i].brrPaths=brrEncoderPaths;
+      pool->push(renderSampleTask,&tasks[i]);
     }
+    pool->wait();
+    delete pool;
+    delete[] tasks;
   } else if (whichSample>=0 && whichSample<song.sampleLen) {
-    song.sample[whichSample]->render(formatMask);
+    song.sample[whichSample]->render(formatMask,&sampleCache,brrEncoderPaths);
   }
 
   // step 2: render samples to dispatch
@@ -1623,6 +1757,201 @@ void DivEngine::getCommandStream(std::vector<DivCommand>& where) {
   BUSY_END;
 }
 
+void DivEngine::storeSeekKeyframe(int maxOrder) {
+  if (curOrder<0 || curOrder>=DIV_MAX_PATTERNS) return;
+  if (seekKeyframes[curOrder]!=NULL) return;
+
+  DivSeekKeyframe* kf=new DivSeekKeyframe;
+
+  // all dispatches must be able to save their state
+  for (int i=0; i<song.systemLen; i++) {
+    kf->dispatch[i]=disCont[i].dispatch;
+    kf->dispatchState[i]=disCont[i].dispatch->getState();
+    if (kf->dispatchState[i]==NULL) {
+      for (int j=0; j<i; j++) {
+        kf->dispatch[j]->freeState(kf->dispatchState[j]);
+      }
+      delete kf;
+      // don't bother trying again until the chips change
+      seekIndexSupported=false;
+      logV("seek index: a chip does not support state saves");
+      return;
+    }
+  }
+
+  kf->order=curOrder;
+  kf->maxOrder=maxOrder;
+  kf->chans=chans;
+  kf->systemLen=song.systemLen;
+  kf->subticks=subticks;
+  kf->ticks=ticks;
+  kf->curRow=curRow;
+  kf->prevRow=prevRow;
+  kf->prevOrder=prevOrder;
+  kf->nextSpeed=nextSpeed;
+  kf->elapsedBars=elapsedBars;
+  kf->elapsedBeats=elapsedBeats;
+  kf->curSpeed=curSpeed;
+  kf->changeOrd=changeOrd;
+  kf->changePos=changePos;
+  kf->totalSeconds=totalSeconds;
+  kf->totalTicks=totalTicks;
+  kf->totalTicksR=totalTicksR;
+  kf->globalPitch=globalPitch;
+  kf->curMidiClock=curMidiClock;
+  kf->curMidiTime=curMidiTime;
+  kf->curMidiTimePiece=curMidiTimePiece;
+  kf->curMidiTimeCode=curMidiTimeCode;
+  kf->cycles=cycles;
+  kf->midiClockCycles=midiClockCycles;
+  kf->midiTimeCycles=midiTimeCycles;
+  kf->divider=divider;
+  kf->clockDrift=clockDrift;
+  kf->midiClockDrift=midiClockDrift;
+  kf->midiTimeDrift=midiTimeDrift;
+  kf->extValue=extValue;
+  kf->pendingMetroTick=pendingMetroTick;
+  kf->arpLen=curSubSong->arpLen;
+  kf->extValuePresent=extValuePresent;
+  kf->endOfSong=endOfSong;
+  kf->shallStopSched=shallStopSched;
+  kf->firstTick=firstTick;
+  kf->speeds=speeds;
+  kf->virtualTempoN=virtualTempoN;
+  kf->virtualTempoD=virtualTempoD;
+  kf->tempoAccum=tempoAccum;
+  memcpy(kf->walked,walked,8192);
+  kf->chan.assign(chan,chan+chans);
+
+  seekKeyframes[curOrder]=kf;
+}
+
+int DivEngine::restoreSeekKeyframe(int goal) {
+  DivSeekKeyframe* kf=NULL;
+  // find the closest keyframe which is reached before the goal
+  for (int i=MIN(goal,DIV_MAX_PATTERNS-1); i>0; i--) {
+    if (seekKeyframes[i]==NULL) continue;
+    if (seekKeyframes[i]->maxOrder>=goal) continue;
+    kf=seekKeyframes[i];
+    break;
+  }
+  if (kf==NULL) return 0;
+
+  if (kf->chans!=chans || kf->systemLen!=song.systemLen) {
+    clearSeekIndex();
+    return 0;
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    if (kf->dispatch[i]!=disCont[i].dispatch) {
+      clearSeekIndex();
+      return 0;
+    }
+  }
+
+  for (int i=0; i<song.systemLen; i++) {
+    disCont[i].dispatch->setState(kf->dispatchState[i]);
+  }
+
+  curOrder=kf->order;
+  subticks=kf->subticks;
+  ticks=kf->ticks;
+  curRow=kf->curRow;
+  prevRow=kf->prevRow;
+  prevOrder=kf->prevOrder;
+  nextSpeed=kf->nextSpeed;
+  elapsedBars=kf->elapsedBars;
+  elapsedBeats=kf->elapsedBeats;
+  curSpeed=kf->curSpeed;
+  changeOrd=kf->changeOrd;
+  changePos=kf->changePos;
+  totalSeconds=kf->totalSeconds;
+  totalTicks=kf->totalTicks;
+  totalTicksR=kf->totalTicksR;
+  globalPitch=kf->globalPitch;
+  curMidiClock=kf->curMidiClock;
+  curMidiTime=kf->curMidiTime;
+  curMidiTimePiece=kf->curMidiTimePiece;
+  curMidiTimeCode=kf->curMidiTimeCode;
+  cycles=kf->cycles;
+  midiClockCycles=kf->midiClockCycles;
+  midiTimeCycles=kf->midiTimeCycles;
+  divider=kf->divider;
+  clockDrift=kf->clockDrift;
+  midiClockDrift=kf->midiClockDrift;
+  midiTimeDrift=kf->midiTimeDrift;
+  extValue=kf->extValue;
+  pendingMetroTick=kf->pendingMetroTick;
+  curSubSong->arpLen=kf->arpLen;
+  extValuePresent=kf->extValuePresent;
+  endOfSong=kf->endOfSong;
+  shallStopSched=kf->shallStopSched;
+  firstTick=kf->firstTick;
+  speeds=kf->speeds;
+  virtualTempoN=kf->virtualTempoN;
+  virtualTempoD=kf->virtualTempoD;
+  tempoAccum=kf->tempoAccum;
+  memcpy(walked,kf->walked,8192);
+  for (int i=0; i<chans; i++) {
+    chan[i]=kf->chan[i];
+  }
+
+  logV("seek index: restored keyframe at order %d",kf->order);
+  return kf->maxOrder;
+}
+
+void DivEngine::validateSeekIndex() {
+  if (seekIndexSubSong!=curSubSongIndex || seekIndexRate!=(int)got.rate) {
+    clearSeekIndex();
+    seekIndexSubSong=curSubSongIndex;
+    seekIndexRate=got.rate;
+    return;
+  }
+
+  int dirtyFrom=seekIndexDirtyFrom.exchange(DIV_MAX_PATTERNS);
+  if (dirtyFrom>=DIV_MAX_PATTERNS) return;
+
+  // a keyframe depends on every order played before it, plus its own
+  for (int i=0; i<DIV_MAX_PATTERNS; i++) {
+    DivSeekKeyframe* kf=seekKeyframes[i];
+    if (kf==NULL) continue;
+    if (MAX(kf->order,kf->maxOrder)<dirtyFrom) continue;
+    for (int j=0; j<kf->systemLen; j++) {
+      kf->dispatch[j]->freeState(kf->dispatchState[j]);
+    }
+    delete kf;
+    seekKeyframes[i]=NULL;
+  }
+}
+
+void DivEngine::clearSeekIndex() {
+  for (int i=0; i<DIV_MAX_PATTERNS; i++) {
+    DivSeekKeyframe* kf=seekKeyframes[i];
+    if (kf==NULL) continue;
+    for (int j=0; j<kf->systemLen; j++) {
+      kf->dispatch[j]->freeState(kf->dispatchState[j]);
+    }
+    delete kf;
+    seekKeyframes[i]=NULL;
+  }
+  seekIndexDirtyFrom=DIV_MAX_PATTERNS;
+  seekIndexSupported=true;
+}
+
+void DivEngine::invalidateSeekIndex(int fromOrder) {
+  if (fromOrder<0) fromOrder=0;
+  int prev=seekIndexDirtyFrom.load();
+  while (fromOrder<prev) {
+    if (seekIndexDirtyFrom.compare_exchange_weak(prev,fromOrder)) break;
+  }
+}
+
+void DivEngine::setSeekIndexEnabled(bool enable) {
+  BUSY_BEGIN;
+  if (!enable) clearSeekIndex();
+  seekIndexEnabled=enable;
+  BUSY_END;
+}
+
 void DivEngine::playSub(bool preserveDrift, int goalRow) {
   logV("playSub() called");
   std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
@@ -1672,6 +2001,18 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
   memset(walked,0,8192);
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(true);
   logV("goal: %d goalRow: %d",goal,goalRow);
+  // keyframes are only taken (and used) when replaying from a clean state
+  bool useSeekIndex=(seekIndexEnabled && !preserveDrift);
+  int seekMaxOrder=0;
+  if (useSeekIndex) {
+    validateSeekIndex();
+    if (seekIndexSupported) {
+      seekMaxOrder=restoreSeekKeyframe(goal);
+    } else {
+      useSeekIndex=false;
+    }
+  }
+  int lastSeekOrder=curOrder;
   while (playing && curOrder<goal) {
     if (nextTick(preserveDrift)) {
       skipping=false;
@@ -1686,6 +2027,16 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
       runMidiClock(cycles);
       runMidiTime(cycles);
     }
+    if (useSeekIndex) {
+      if (prevOrder>seekMaxOrder) seekMaxOrder=prevOrder;
+      if (curOrder!=lastSeekOrder) {
+        lastSeekOrder=curOrder;
+        if ((curOrder%DIV_SEEK_KEYFRAME_INTERVAL)==0) {
+          storeSeekKeyframe(seekMaxOrder);
+          if (!seekIndexSupported) useSeekIndex=false;
+        }
+      }
+    }
   }
   int oldOrder=curOrder;
   while (playing && (curRow<goalRow || ticks>1)) {
@@ -2120,6 +2471,8 @@ void DivEngine::recalcChans() {
   checkAssetDir(song.waveDir,song.wave.size());
   checkAssetDir(song.sampleDir,song.sample.size());
 
+  invalidateSeekIndex();
+
   hasLoadedSomething=true;
 }
 
@@ -2641,6 +2994,7 @@ void DivEngine::loadTempIns(DivInstrument* which) {
 }
 
 void DivEngine::delInstrumentUnsafe(int index) {
+  invalidateSeekIndex();
   if (index>=0 && index<(int)song.ins.size()) {
     for (int i=0; i<song.systemLen; i++) {
       disCont[i].dispatch->notifyInsDeletion(song.ins[index]);
@@ -3014,7 +3368,7 @@ void DivEngine::deepCloneOrder(int pos, bool where) {
         order[i]=j;
         DivPattern* oldPat=curPat[i].getPattern(origOrd,false);
         DivPattern* pat=curPat[i].getPattern(j,true);
-        memcpy(pat->data,oldPat->data,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
+        pat->data=oldPat->data;
         logD("found at %d",j);
         didNotFind=false;
         break;
@@ -3481,6 +3835,7 @@ void DivEngine::setOrder(unsigned char order) {
 
 void DivEngine::updateSysFlags(int system, bool restart, bool render) {
   BUSY_BEGIN_SOFT;
+  invalidateSeekIndex();
   disCont[system].dispatch->setFlags(song.systemFlags[system]);
   disCont[system].setRates(got.rate);
   if (render) renderSamples();
@@ -3504,6 +3859,7 @@ void DivEngine::updateSysFlags(int system, bool restart, bool render) {
 
 void DivEngine::setSongRate(float hz) {
   BUSY_BEGIN;
+  invalidateSeekIndex();
   saveLock.lock();
   curSubSong->hz=hz;
   divider=curSubSong->hz;
@@ -3609,15 +3965,72 @@ bool DivEngine::sendMidiMessage(TAMidiMessage& msg) {
   return ret;
 }
 
+// every live engine (including export workers)
+struct DivLiveEngines {
+  std::mutex lock;
+  std::vector<DivEngine*> list;
+};
+
+static DivLiveEngines& getLiveEngines() {
+  // never freed, since an engine may be a global which outlives this file's statics
+  static DivLiveEngines* live=new DivLiveEngines;
+  return *live;
+}
+
+void DivEngine::registerEngine() {
+  DivLiveEngines& live=getLiveEngines();
+  std::lock_guard<std::mutex> lock(live.lock);
+  live.list.push_back(this);
+}
+
+DivEngine::~DivEngine() {
+  stopMapCopy();
+  DivLiveEngines& live=getLiveEngines();
+  std::lock_guard<std::mutex> lock(live.lock);
+  for (size_t i=0; i<live.list.size(); i++) {
+    if (live.list[i]==this) {
+      live.list.erase(live.list.begin()+i);
+      break;
+    }
+  }
+}
+
+// whether no engine other than self is reading its song right now.
+// whoever reads a song holds its engine's isBusy, so seeing every other isBusy
+// free means no reader can still hold a pointer it loaded before this call.
+// never blocks: the caller already holds its own isBusy.
+bool DivEngine::otherEnginesIdle(void* self) {
+  DivLiveEngines& live=getLiveEngines();
+  std::lock_guard<std::mutex> lock(live.lock);
+  for (DivEngine* i: live.list) {
+    if (i==self) continue;
+    if (!i->isBusy.try_lock()) return false;
+    i->isBusy.unlock();
+  }
+  return true;
+}
+
+// free pattern chunks and macro values which were replaced while an audio
+// thread may have been reading them. call with isBusy held.
+// the retire lists are shared by all engines, since storage doesn't know which
+// song it belongs to, so this waits until the other engines are idle too (if any
+// is busy, the storage is kept until the next call).
+void DivEngine::freeRetiredStorage() {
+  DivPatternData::freeRetired(otherEnginesIdle,this);
+  DivInstrumentMacroValues::freeRetired(otherEnginesIdle,this);
+}
+
 void DivEngine::synchronized(const std::function<void()>& what) {
   BUSY_BEGIN;
   what();
+  freeRetiredStorage();
   BUSY_END;
 }
 
 void DivEngine::synchronizedSoft(const std::function<void()>& what) {
   BUSY_BEGIN_SOFT;
   what();
+  freeRetiredStorage();
   BUSY_END;
 }
 
@@ -3632,6 +4045,7 @@ void DivEngine::lockEngine(const std::function<void()>& what) {
   saveLock.lock();
   what();
   saveLock.unlock();
+  freeRetiredStorage();
   BUSY_END;
 }
 
@@ -3693,12 +4107,14 @@ void DivEngine::initDispatch(bool isRender) {
     saveLock.unlock();
   }
   recalcChans();
+  resetRenderStats();
   BUSY_END;
 }
 
 void DivEngine::quitDispatch() {
   BUSY_BEGIN;
   logV("terminating dispatch...");
+  clearSeekIndex();
   for (int i=0; i<song.systemLen; i++) {
     disCont[i].quit();
   }
@@ -3779,6 +4195,27 @@ bool DivEngine::initAudioBackend() {
   if (previewVol<0.0f) previewVol=0.0f;
   if (previewVol>1.0f) previewVol=1.0f;
   renderPoolThreads=getConfInt("renderPoolThreads",0);
+  renderPoolPinThreads=getConfInt("renderPoolPinThreads",0);
+
+  // BRR encoder: 0 is greedy. otherwise a trellis search with 4 or 16 paths
+  switch (getConfInt("brrEncoder",0)) {
+    case 1:
+      brrEncoderPaths=4;
+      break;
+    case 2:
+      brrEncoderPaths=16;
+      break;
+    default:
+      brrEncoderPaths=0;
+      break;
+  }
+
+  sampleCache.setLimit((size_t)MAX(0,getConfInt("sampleCacheSize",64))<<20);
+  if (getConfInt("sampleCacheDisk",0)) {
+    sampleCache.setDiskPath(configPath+DIR_SEPARATOR_STR+"sampleCache",(size_t)MAX(0,getConfInt("sampleCacheDiskSize",256))<<20);
+  } else {
+    sampleCache.setDiskPath("",0);
+  }
 
   if (lowLatency) logI("using low latency mode.");
 
@@ -4004,9 +4441,48 @@ void DivEngine::everythingOK() {
   */
 }
 
+bool DivEngine::initRenderBuffers() {
+  logV("creating blip_buf");
+
+  samp_bb=blip_new(32768);
+  if (samp_bb==NULL) {
+    logE("not enough memory!");
+    return false;
+  }
+  blip_set_dc(samp_bb,0);
+
+  samp_bbOut=new short[32768];
+
+  samp_bbIn=new short[32768];
+  samp_bbInLen=32768;
+
+  metroBuf=new float[8192];
+  metroBufLen=8192;
+
+  logV("setting blip rate of samp_bb (%f)",got.rate);
+  
+  blip_set_rates(samp_bb,44100,got.rate);
+
+  for (int i=0; i<64; i++) {
+    vibTable[i]=127*sin(((double)i/64.0)*(2*M_PI));
+  }
+  for (int i=0; i<128; i++) {
+    tremTable[i]=255*0.5*(1.0-cos(((double)i/128.0)*(2*M_PI)));
+  }
+  for (int i=0; i<4096; i++) {
+    reversePitchTable[i]=round(1024.0*pow(2.0,(2048.0-(double)i)/(12.0*128.0)));
+    pitchTable[i]=round(1024.0*pow(2.0,((double)i-2048.0)/(12.0*128.0)));
+  }
+
+  return true;
+}
+
 bool DivEngine::init() {
   loadSampleROMs();
 
+  // build interpolation tables now rather than on first use
+  DivFilterTables::init();
+
   // set default system preset
   if (!hasLoadedSomething) {
     logD("setting default preset");
@@ -4039,37 +4515,7 @@ bool DivEngine::init() {
     haveAudio=true;
   }
 
-  logV("creating blip_buf");
-
-  samp_bb=blip_new(32768);
-  if (samp_bb==NULL) {
-    logE("not enough memory!");
-    return false;
-  }
-  blip_set_dc(samp_bb,0);
-
-  samp_bbOut=new short[32768];
-
-  samp_bbIn=new short[32768];
-  samp_bbInLen=32768;
-
-  metroBuf=new float[8192];
-  metroBufLen=8192;
-
-  logV("setting blip rate of samp_bb (%f)",got.rate);
-  
-  blip_set_rates(samp_bb,44100,got.rate);
-
-  for (int i=0; i<64; i++) {
-    vibTable[i]=127*sin(((double)i/64.0)*(2*M_PI));
-  }
-  for (int i=0; i<128; i++) {
-    tremTable[i]=255*0.5*(1.0-cos(((double)i/128.0)*(2*M_PI)));
-  }
-  for (int i=0; i<4096; i++) {
-    reversePitchTable[i]=round(1024.0*pow(2.0,(2048.0-(double)i)/(12.0*128.0)));
-    pitchTable[i]=round(1024.0*pow(2.0,((double)i-2048.0)/(12.0*128.0)));
-  }
+  if (!initRenderBuffers()) return false;
 
   for (int i=0; i<DIV_MAX_CHANS; i++) {
     isMuted[i]=0;
@@ -4097,6 +4543,7 @@ bool DivEngine::init() {
 }
 
 bool DivEngine::quit(bool saveConfig) {
+  stopMapCopy();
   deinitAudioBackend();
   quitDispatch();
   if (saveConfig) {
@@ -4116,5 +4563,6 @@ bool DivEngine::quit(bool saveConfig) {
   if (tg100ROM!=NULL) delete[] tg100ROM;
   if (mu5ROM!=NULL) delete[] mu5ROM;
   song.unload();
+  freeRetiredStorage();
   return true;
 }
@@ -28,6 +28,10 @@
 #include "dataErrors.h"
 #include "safeWriter.h"
 #include "cmdStream.h"
+#include "renderStats.h"
+#include "mappedFile.h"
+#include "regTimeline.h"
+#include "sampleCache.h"
 #include "../audio/taAudio.h"
 #include "blip_buf.h"
 #include <functional>
@@ -130,6 +134,25 @@ struct DivAudioExportOptions {
   }
 };
 
+enum DivBatchExportFormats {
+  DIV_BATCH_WAV=0,
+  DIV_BATCH_VGM,
+  DIV_BATCH_VGZ,
+  DIV_BATCH_CMD
+};
+
+struct DivBatchJob {
+  String inPath;
+  // empty to derive from inPath
+  String outPath;
+  // -1 for all sub-songs
+  int subSong;
+  DivBatchExportFormats format;
+  DivBatchJob():
+    subSong(-1),
+    format(DIV_BATCH_WAV) {}
+};
+
 struct DivChannelState {
   std::vector<DivDelayedCommand> delayed;
   int note, oldNote, lastIns, pitch, portaSpeed, portaNote;
@@ -243,6 +266,37 @@ struct DivNoteEvent {
     fromMIDI(false) {}
 };
 
+// a snapshot of playback state, taken while seeking.
+// playSub() restores the closest one instead of replaying the song from order 0.
+struct DivSeekKeyframe {
+  // the order this keyframe was taken at, and the highest order played before reaching it
+  int order, maxOrder;
+  int chans, systemLen;
+  int subticks, ticks, curRow, prevRow, prevOrder, nextSpeed, elapsedBars, elapsedBeats, curSpeed;
+  int changeOrd, changePos, totalSeconds, totalTicks, totalTicksR, globalPitch;
+  int curMidiClock, curMidiTime, curMidiTimePiece, curMidiTimeCode;
+  int cycles, midiClockCycles, midiTimeCycles;
+  double divider, clockDrift, midiClockDrift, midiTimeDrift;
+  unsigned char extValue, pendingMetroTick, arpLen;
+  bool extValuePresent, endOfSong, shallStopSched, firstTick;
+  DivGroovePattern speeds;
+  short virtualTempoN, virtualTempoD;
+  short tempoAccum;
+  unsigned char walked[8192];
+  std::vector<DivChannelState> chan;
+  DivDispatch* dispatch[DIV_MAX_CHIPS];
+  void* dispatchState[DIV_MAX_CHIPS];
+
+  DivSeekKeyframe():
+    order(0),
+    maxOrder(0),
+    chans(0),
+    systemLen(0) {
+    memset(dispatch,0,DIV_MAX_CHIPS*sizeof(void*));
+    memset(dispatchState,0,DIV_MAX_CHIPS*sizeof(void*));
+  }
+};
+
 struct DivDispatchContainer {
   DivDispatch* dispatch;
   blip_buffer_t* bb[DIV_MAX_OUTPUTS];
@@ -258,6 +312,9 @@ struct DivDispatchContainer {
   int cycles;
   unsigned int size;
 
+  // time spent in acquire() and fillBuf() during the current buffer (in nanoseconds)
+  unsigned int acquireTime, fillBufTime;
+
   void setRates(double gotRate);
   void setQuality(bool lowQual, bool dcHiPass);
   void grow(size_t size);
@@ -279,7 +336,9 @@ struct DivDispatchContainer {
     hiPass(true),
     rateMemory(0.0),
     cycles(0),
-    size(0) {
+    size(0),
+    acquireTime(0),
+    fillBufTime(0) {
     memset(bb,0,DIV_MAX_OUTPUTS*sizeof(blip_buffer_t*));
     memset(temp,0,DIV_MAX_OUTPUTS*sizeof(int));
     memset(prevSample,0,DIV_MAX_OUTPUTS*sizeof(int));
@@ -439,6 +498,12 @@ class DivEngine {
   TAAudioDesc want, got;
   String exportPath;
   std::thread* exportThread;
+  // copies mapped samples into memory after loading (see loadMapped())
+  std::thread* mapCopyThread;
+  std::atomic<bool> mapCopyCancel;
+  // mapped files which samples were copied out of. kept until the next load, since
+  // the GUI may still be drawing from the old data.
+  std::vector<DivMappedFile*> mapCopyHeld;
   int chans;
   bool configLoaded;
   bool active;
@@ -507,7 +572,17 @@ class DivEngine {
   // bitfield
   unsigned char walked[8192];
   bool isMuted[DIV_MAX_CHANS];
-  std::mutex isBusy, saveLock, playPosLock;
+  std::mutex isBusy, saveLock, playPosLock, renderStatsLock;
+
+  // retired pattern chunks and macro values are shared by all engines. see freeRetiredStorage().
+  void registerEngine();
+  static bool otherEnginesIdle(void* self);
+  void freeRetiredStorage();
+
+  void runMapCopy();
+  void startMapCopy();
+  void stopMapCopy();
+
   String configPath;
   String configFile;
   String lastError;
@@ -573,8 +648,26 @@ class DivEngine {
   size_t totalProcessed;
 
   unsigned int renderPoolThreads;
+  bool renderPoolPinThreads;
+  int brrEncoderPaths;
+  DivRenderCounter renderCounters[DIV_RENDER_STAGE_MAX];
+  DivRenderCounter acquireCounters[DIV_MAX_CHIPS];
+  DivRenderCounter fillBufCounters[DIV_MAX_CHIPS];
+  DivRenderStats renderStats;
+  String benchmarkJSON;
+  unsigned int renderStatsCycle;
   DivWorkPool* renderPool;
 
+  // cache of sample format conversions
+  DivSampleCache sampleCache;
+
+  // seek index
+  DivSeekKeyframe* seekKeyframes[DIV_MAX_PATTERNS];
+  size_t seekIndexSubSong;
+  int seekIndexRate;
+  bool seekIndexEnabled, seekIndexSupported;
+  std::atomic<int> seekIndexDirtyFrom;
+
   // MIDI stuff
   std::function<int(const TAMidiMessage&)> midiCallback=[](const TAMidiMessage&) -> int {return -2;};
 
@@ -582,7 +675,7 @@ class DivEngine {
   void processRow(int i, bool afterDelay);
   void nextOrder();
   void nextRow();
-  void performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, size_t bankOffset, bool directStream, bool* sampleStoppable);
+  void performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, unsigned short* sampleBlock8, size_t bankOffset, bool directStream, bool* sampleStoppable);
   // returns true if end of song.
   bool nextTick(bool noAccum=false, bool inhibitLowLat=false);
   bool perSystemEffect(int ch, unsigned char effect, unsigned char effectVal);
@@ -591,6 +684,11 @@ class DivEngine {
   void recalcChans();
   void reset();
   void playSub(bool preserveDrift, int goalRow=0);
+  // seek index management (UNSAFE)
+  void storeSeekKeyframe(int maxOrder);
+  int restoreSeekKeyframe(int goal);
+  void validateSeekIndex();
+  void clearSeekIndex();
   void runMidiClock(int totalCycles=1);
   void runMidiTime(int totalCycles=1);
   bool shallSwitchCores();
@@ -598,7 +696,7 @@ class DivEngine {
   void testFunction();
 
   bool loadDMF(unsigned char* file, size_t len);
-  bool loadFur(unsigned char* file, size_t len, int variantID=0);
+  bool loadFur(unsigned char* file, size_t len, int variantID=0, DivMappedFile* map=NULL);
   bool loadMod(unsigned char* file, size_t len);
   bool loadS3M(unsigned char* file, size_t len);
   bool loadXM(unsigned char* file, size_t len);
@@ -639,6 +737,32 @@ class DivEngine {
   bool initAudioBackend();
   bool deinitAudioBackend(bool dueToSwitchMaster=false);
 
+  // allocate blip/metronome buffers and lookup tables
+  bool initRenderBuffers();
+
+  // publish render statistics (called by nextBuf)
+  void updateRenderStats(unsigned int size);
+  void resetRenderStats();
+
+  // set up this engine as a headless copy of parent for exporting (no audio backend)
+  bool initExportWorker(DivEngine* parent, SafeWriter* songData);
+  // same as above, but loading a song of our own. takes ownership of data.
+  // rate is the output rate (0 to use the parent's).
+  bool initWorker(DivEngine* parent, unsigned char* data, size_t len, const char* nameHint, int subSong, int rate);
+
+  // run a single batch export job in a new engine. used by batchExport
+  bool runBatchJob(const DivBatchJob& job, bool split, const DivAudioExportOptions& options, bool vgmDirect, int& subSongCount, String& outPath);
+  void quitExportWorker();
+
+  // render a single channel (stem) of the song to file. used by per-channel export
+  // chan -1 renders the whole song to exportPath instead.
+  bool renderExportStem(int chan, DivEngine* parent, bool reportProgress);
+
+  // replace the song with a synthetic stress song for a single chip (used by benchmarkChips)
+  void createBenchmarkSong(DivSystem sys);
+  // render a few seconds of the current song using render cores and print/collect the result
+  String runChipBenchmark(DivSystem sys, const char* coreKey, int coreOption, double& timeOut);
+
   void registerSystems();
   void registerROMExports();
   void initSongWithDesc(const char* description, bool inBase64=true, bool oldVol=false);
@@ -705,6 +829,13 @@ class DivEngine {
     void createNewFromDefaults();
     // load a file.
     bool load(unsigned char* f, size_t length, const char* nameHint=NULL);
+    // load an uncompressed .fur by mapping it into memory. large samples are used in place.
+    // returns 1 on success, -1 on error, or 0 if the file can't be mapped (load() it instead).
+    // mapped samples are then copied into memory in the background, so that the song
+    // no longer depends on the file once that is done.
+    int loadMapped(const char* path);
+    // copy samples out of the specified mapped file (e.g. before overwriting it), or all of them if NULL.
+    void unmapSamples(const char* path=NULL);
     // play a binary command stream.
     bool playStream(unsigned char* f, size_t length);
     // get the playing stream.
@@ -724,11 +855,22 @@ class DivEngine {
     // - x to add x+1 ticks of trailing
     // - -1 to auto-determine trailing
     // - -2 to add a whole loop of trailing
-    SafeWriter* saveVGM(bool* sysToExport=NULL, bool loop=true, int version=0x171, bool patternHints=false, bool directStream=false, int trailingTicks=-1);
+    // set optimize to drop redundant register writes, merge waits and deduplicate samples.
+    // unless directStream is set, the song is played once through captureRegTimeline(). a timeline
+    // captured at 44100Hz with enough trailing may be passed to skip that (it is not deleted).
+    SafeWriter* saveVGM(bool* sysToExport=NULL, bool loop=true, int version=0x171, bool patternHints=false, bool directStream=false, int trailingTicks=-1, bool optimize=true, DivRegTimeline* timeline=NULL);
     // dump to TIunA.
     SafeWriter* saveTiuna(const bool* sysToExport, const char* baseLabel, int firstBankSize, int otherBankSize);
     // dump command stream.
     SafeWriter* saveCommand();
+    // play the current sub-song once and record all register writes (for exporters).
+    // trailingTicks sets how long to keep playing past the end, like in saveVGM():
+    // - 0 for none
+    // - x for x ticks
+    // - -1 until every channel which played a note has played another one
+    // - -2 for a whole loop
+    // the caller shall delete the result.
+    DivRegTimeline* captureRegTimeline(unsigned int rate=44100, int trailingTicks=0);
     // export to text
     SafeWriter* saveText(bool separatePatterns=true);
     // export to an audio file
@@ -737,6 +879,18 @@ class DivEngine {
     void waitAudioFile();
     // stop audio file export
     bool haltAudioFile();
+    /**
+     * export a list of songs without an audio backend.
+     * every job is run in its own engine, several at once. the system definitions are
+     * shared, so this engine must be initialized (preInit) first.
+     * jobs asking for all sub-songs are split into one job per sub-song.
+     * @param jobs the jobs.
+     * @param options audio export options (for DIV_BATCH_WAV). only DIV_EXPORT_MODE_ONE is supported.
+     * @param vgmDirect whether to use VGM direct stream mode.
+     * @param threads number of jobs to run at once. 0 picks a number automatically.
+     * @return the number of jobs which failed.
+     */
+    int batchExport(const std::vector<DivBatchJob>& jobs, DivAudioExportOptions options, bool vgmDirect, unsigned int threads=0);
     // return back to playback cores if necessary
     void finishAudioFile();
     // notify instrument parameter change
@@ -762,6 +916,30 @@ class DivEngine {
     // benchmark (returns time in seconds)
     double benchmarkPlayback();
     double benchmarkSeek();
+    double benchmarkWorkPool();
+    // compress the song with the TIunA exporter.
+    double benchmarkTiuna();
+    // render a stress song on every chip with every core option.
+    // machine-readable results are available through getBenchmarkJSON().
+    double benchmarkChips();
+    // resample a long sample with the scalar and SIMD/multi-threaded resamplers.
+    double benchmarkResample();
+
+    // get the results of the last benchmarkChips() run as JSON
+    String getBenchmarkJSON();
+
+    // get render statistics (per stage and per chip)
+    DivRenderStats getRenderStats();
+
+    // get render statistics as JSON
+    String getRenderStatsJSON();
+
+    // invalidate seek keyframes which depend on the specified order or any later one.
+    // call this after editing the song (thread-safe).
+    void invalidateSeekIndex(int fromOrder=0);
+
+    // enable or disable seek keyframes
+    void setSeekIndexEnabled(bool enable);
 
     // returns the minimum VGM version which may carry the specified system, or 0 if none.
     int minVGMVersion(DivSystem which);
@@ -1378,6 +1556,8 @@ class DivEngine {
     DivEngine():
       output(NULL),
       exportThread(NULL),
+      mapCopyThread(NULL),
+      mapCopyCancel(false),
       chans(0),
       configLoaded(false),
       active(false),
@@ -1487,7 +1667,15 @@ class DivEngine {
       previewVol(1.0f),
       totalProcessed(0),
       renderPoolThreads(0),
+      renderPoolPinThreads(false),
+      brrEncoderPaths(0),
+      renderStatsCycle(0),
       renderPool(NULL),
+      seekIndexSubSong(0),
+      seekIndexRate(0),
+      seekIndexEnabled(true),
+      seekIndexSupported(true),
+      seekIndexDirtyFrom(DIV_MAX_PATTERNS),
       curOrders(NULL),
       curPat(NULL),
       tempIns(NULL),
@@ -1513,18 +1701,17 @@ class DivEngine {
       memset(reversePitchTable,0,4096*sizeof(int));
       memset(pitchTable,0,4096*sizeof(int));
       memset(effectSlotMap,-1,4096*sizeof(short));
-      memset(sysDefs,0,DIV_MAX_CHIP_DEFS*sizeof(void*));
-      memset(romExportDefs,0,DIV_ROM_MAX*sizeof(void*));
       memset(walked,0,8192);
       memset(oscBuf,0,DIV_MAX_OUTPUTS*(sizeof(float*)));
+      memset(seekKeyframes,0,DIV_MAX_PATTERNS*sizeof(void*));
       memset(exportChannelMask,1,DIV_MAX_CHANS*sizeof(bool));
 
-      for (int i=0; i<DIV_MAX_CHIP_DEFS; i++) {
-        sysFileMapFur[i]=DIV_SYSTEM_NULL;
-        sysFileMapDMF[i]=DIV_SYSTEM_NULL;
-      }
+      // sysDefs, romExportDefs and the system file maps are static (zero-initialized)
+      // and shared with other engine instances (e.g. export workers), so don't clear them here.
 
       changeSong(0);
+      registerEngine();
     }
+    ~DivEngine();
 };
 #endif
@@ -25,6 +25,7 @@
 #include "../pch.h"
 
 class DivEngine;
+class DivRegTimeline;
 
 enum DivROMExportOptions {
   DIV_ROM_ABSTRACT=0,
@@ -56,12 +57,20 @@ class DivROMExport {
   protected:
     DivConfig conf;
     std::vector<DivROMExportOutput> output;
+    DivRegTimeline* timeline;
     void logAppend(String what);
   public:
     std::vector<String> exportLog;
     std::mutex logLock;
 
     void setConf(DivConfig& c);
+    /**
+     * use an existing register timeline instead of playing the song.
+     * it must be kept until the export finishes, and may be shared by
+     * several exports at once.
+     * not all exporters use it.
+     */
+    void setTimeline(DivRegTimeline* tl);
     virtual bool go(DivEngine* eng);
     virtual void abort();
     virtual void wait();
@@ -69,6 +78,8 @@ class DivROMExport {
     virtual bool hasFailed();
     virtual bool isRunning();
     virtual DivROMExportProgress getProgress(int index=0);
+    DivROMExport():
+      timeline(NULL) {}
     virtual ~DivROMExport() {}
 };
 
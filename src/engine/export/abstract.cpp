@@ -59,3 +59,7 @@ bool DivROMExport::isRunning() {
 void DivROMExport::setConf(DivConfig& c) {
   conf=c;
 }
+
+void DivROMExport::setTimeline(DivRegTimeline* tl) {
+  timeline=tl;
+}
@@ -19,10 +19,12 @@
 
 #include "tiuna.h"
 #include "../engine.h"
+#include "../suffixArray.h"
 #include "../ta-log.h"
 #include <fmt/printf.h>
 #include <algorithm>
 #include <map>
+#include <queue>
 #include <tuple>
 #include <vector>
 
@@ -113,17 +115,309 @@ struct TiunaMatch {
     id(0) {}
 };
 
-struct TiunaMatches {
+// command sequence prepared for match finding
+struct TiunaSequence {
+  // one token per distinct command. channels are separated by unique tokens so that
+  // matches can't cross them (a channel end command is inserted there later)
+  std::vector<int> tokens;
+  // index of every token in renderedCmds (-1 for separators)
+  std::vector<int> cmdIndex;
+  // running totals of size and ticks (sizeSum[i] is the size of tokens 0 to i-1)
+  std::vector<int> sizeSum;
+  std::vector<int> tickSum;
+  // suffix array, position of each suffix in it and LCP of each suffix with the previous one
+  std::vector<int> sa;
+  std::vector<int> rank;
+  std::vector<int> lcp;
+  // commands which have been put in a call already
+  std::vector<bool> taken;
+};
+
+struct TiunaCandidate {
+  // range in the suffix array
+  int lb, rb;
+  // range of lengths sharing these positions
+  int minLen, maxLen;
+  // what candidates are ranked by. an upper bound unless evaluated for the current call ID
+  double weight;
   int bytesSaved;
   int length;
-  int ticks;
-  std::vector<int> pos;
-  TiunaMatches():
-    bytesSaved(INT32_MIN),
-    length(0),
-    ticks(0) {}
+  // call ID weight was computed for, or -1
+  int evalId;
+  TiunaCandidate(int l, int r, int minL, int maxL, int saved):
+    lb(l),
+    rb(r),
+    minLen(minL),
+    maxLen(maxL),
+    weight(saved),
+    bytesSaved(saved),
+    length(maxL),
+    evalId(-1) {}
+};
+
+// calls found by a compression pass
+struct TiunaCalls {
+  // the candidate each call was made from (with the length picked) and its index
+  std::vector<TiunaCandidate> entries;
+  std::vector<int> candidate;
+  // positions of each call in the sequence, in order. the first one holds the commands
+  std::vector<std::vector<int>> pos;
+};
+
+#define TIUNA_LENGTH_BIAS_COUNT 3
+static const double tiunaLengthBias[TIUNA_LENGTH_BIAS_COUNT]={
+  0.0, 0.5, 1.0
 };
 
+// after the best weight is found, try leaving out one of the first calls picked
+// (which may prevent better ones from being picked later) this many times
+#define TIUNA_REFINE_PASSES 48
+#define TIUNA_REFINE_CALLS 16
+
+static void buildTiunaSequence(const std::vector<TiunaBytes>& cmds, TiunaSequence& seq) {
+  std::map<String,int> tokenIDs;
+  int lastCh=-1;
+  int sep=-1;
+  seq.sizeSum.push_back(0);
+  seq.tickSum.push_back(0);
+  for (int i=0; i<(int)cmds.size(); i++) {
+    const TiunaBytes& c=cmds[i];
+    if (lastCh>=0 && c.ch!=lastCh) {
+      seq.tokens.push_back(sep--);
+      seq.cmdIndex.push_back(-1);
+      seq.sizeSum.push_back(seq.sizeSum.back());
+      seq.tickSum.push_back(seq.tickSum.back());
+    }
+    lastCh=c.ch;
+    String key;
+    key+=(char)(c.ticks&0xff);
+    key+=(char)(c.ticks>>8);
+    key.append((const char*)c.buf,c.size);
+    auto id=tokenIDs.find(key);
+    if (id==tokenIDs.end()) {
+      id=tokenIDs.emplace(key,(int)tokenIDs.size()).first;
+    }
+    seq.tokens.push_back(id->second);
+    seq.cmdIndex.push_back(i);
+    seq.sizeSum.push_back(seq.sizeSum.back()+c.size);
+    seq.tickSum.push_back(seq.tickSum.back()+c.ticks);
+  }
+  seq.taken.assign(seq.tokens.size(),false);
+  divBuildSuffixArray(seq.tokens,seq.sa,seq.rank,seq.lcp);
+}
+
+// keep the LCP intervals which may save bytes
+static void findTiunaCandidates(const TiunaSequence& seq, std::vector<TiunaCandidate>& candidates) {
+  divWalkLCPIntervals(seq.lcp,[&seq,&candidates](int lb, int rb, int len, int parentLen) {
+    // a call can't last more than 256 ticks
+    int p=seq.sa[lb];
+    int maxLen=0;
+    while (maxLen<len && seq.tickSum[p+maxLen+1]-seq.tickSum[p]<=256) maxLen++;
+    if (maxLen>parentLen) {
+      int upperBound=(rb-lb)*(seq.sizeSum[p+maxLen]-seq.sizeSum[p]-2)-4;
+      if (upperBound>0) {
+        candidates.push_back(TiunaCandidate(lb,rb,parentLen+1,maxLen,upperBound));
+      }
+    }
+  });
+}
+
+// pick occurrences of the first len commands of a candidate from left to right,
+// skipping those which overlap a previous one or commands in a call already.
+static void pickTiunaOccurrences(const std::vector<int>& sorted, const std::vector<int>& freeLen, int len, std::vector<int>& pos) {
+  pos.clear();
+  int nextFree=0;
+  for (size_t i=0; i<sorted.size(); i++) {
+    if (sorted[i]<nextFree || freeLen[i]<len) continue;
+    pos.push_back(sorted[i]);
+    nextFree=sorted[i]+len;
+  }
+}
+
+static void getTiunaOccurrences(const TiunaSequence& seq, const TiunaCandidate& c, std::vector<int>& sorted, std::vector<int>& freeLen) {
+  sorted.assign(seq.sa.begin()+c.lb,seq.sa.begin()+c.rb+1);
+  std::sort(sorted.begin(),sorted.end());
+  freeLen.resize(sorted.size());
+  for (size_t i=0; i<sorted.size(); i++) {
+    int len=0;
+    while (len<c.maxLen && !seq.taken[sorted[i]+len]) len++;
+    freeLen[i]=len;
+  }
+}
+
+// compute the bytes saved by a candidate and the best length.
+// the weight may favor longer calls (which leave more room for other calls) over the most bytes saved right away.
+static void evalTiunaCandidate(const TiunaSequence& seq, TiunaCandidate& c, double lengthBias, std::vector<int>& pos) {
+  std::vector<int> sorted, freeLen;
+  getTiunaOccurrences(seq,c,sorted,freeLen);
+  int p=sorted[0];
+  c.weight=0;
+  c.bytesSaved=0;
+  for (int len=c.minLen; len<=c.maxLen; len++) {
+    pickTiunaOccurrences(sorted,freeLen,len,pos);
+    if (pos.size()<2) break;
+    int size=seq.sizeSum[p+len]-seq.sizeSum[p];
+    int bytesSaved=((int)pos.size()-1)*(size-2)-4;
+    if (bytesSaved<=0) continue;
+    double weight=bytesSaved*pow(size,lengthBias);
+    if (weight>c.weight) {
+      c.weight=weight;
+      c.bytesSaved=bytesSaved;
+      c.length=len;
+    }
+  }
+}
+
+// put the occurrences of a candidate in a call
+static void takeTiunaCandidate(TiunaSequence& seq, const TiunaCandidate& c, int len, std::vector<int>& pos) {
+  std::vector<int> sorted, freeLen;
+  getTiunaOccurrences(seq,c,sorted,freeLen);
+  pickTiunaOccurrences(sorted,freeLen,len,pos);
+  for (int i: pos) {
+    for (int j=0; j<len; j++) {
+      seq.taken[i+j]=true;
+    }
+  }
+}
+
+// pick calls greedily, highest weight first.
+// returns false if aborted.
+static bool findTiunaCalls(const TiunaSequence& origSeq, const std::vector<TiunaCandidate>& origCandidates, const std::vector<bool>& banned, double lengthBias, int maxCmId, const bool& mustAbort, float& progress, TiunaCalls& calls) {
+  TiunaSequence seq=origSeq;
+  std::vector<TiunaCandidate> candidates=origCandidates;
+  std::priority_queue<std::pair<double,int>> queue;
+  for (int i=0; i<(int)candidates.size(); i++) {
+    if (banned[i]) continue;
+    TiunaCandidate& c=candidates[i];
+    int p=seq.sa[c.lb];
+    c.weight=c.bytesSaved*pow(seq.sizeSum[p+c.maxLen]-seq.sizeSum[p],lengthBias);
+    queue.push(std::pair<double,int>(c.weight,i));
+  }
+
+  std::vector<int> pos;
+  int cmId=0;
+  while (cmId<maxCmId && !queue.empty()) {
+    if (mustAbort) return false;
+
+    int ci=queue.top().second;
+    queue.pop();
+    TiunaCandidate& c=candidates[ci];
+    if (c.evalId!=cmId) {
+      evalTiunaCandidate(seq,c,lengthBias,pos);
+      c.evalId=cmId;
+      if (c.weight>0) queue.push(std::pair<double,int>(c.weight,ci));
+      continue;
+    }
+
+    // this is the best candidate
+    takeTiunaCandidate(seq,c,c.length,pos);
+    calls.entries.push_back(c);
+    calls.candidate.push_back(ci);
+    calls.pos.push_back(pos);
+    cmId++;
+    progress=(float)cmId/(float)maxCmId;
+
+    // shorter runs may still be worth it
+    c.evalId=-1;
+    queue.push(std::pair<double,int>(c.weight,ci));
+  }
+  return true;
+}
+
+// call IDs past the last full page of the call table are not used, as they tend to
+// increase the final size due to page alignment
+static int getTiunaCallCount(int cmId) {
+  return cmId>256?(cmId&~255):cmId;
+}
+
+static int getTiunaCallBytesSaved(const TiunaSequence& seq, const TiunaCalls& calls, int index) {
+  int p=calls.pos[index][0];
+  int size=seq.sizeSum[p+calls.entries[index].length]-seq.sizeSum[p];
+  return ((int)calls.pos[index].size()-1)*(size-2)-4;
+}
+
+// bytes saved by a set of calls, including the call table
+static int getTiunaBytesSaved(const TiunaSequence& seq, const TiunaCalls& calls) {
+  int count=getTiunaCallCount(calls.entries.size());
+  int total=0;
+  for (int i=0; i<count; i++) {
+    total+=getTiunaCallBytesSaved(seq,calls,i);
+  }
+  // bytesSaved includes 4 bytes per call. the rest of each page is padding
+  for (int i=0; i<count; i+=256) {
+    total-=768-3*MIN(count-i,256);
+  }
+  return total;
+}
+
+// greedy picking only looks at one call at a time, which may leave occurrences which overlap
+// an earlier call unused. keeping the commands of every call where they are, find the best
+// places for calls again using dynamic programming.
+static void reparseTiunaCalls(const TiunaSequence& seq, TiunaCalls& calls) {
+  int n=seq.tokens.size();
+  int count=getTiunaCallCount(calls.entries.size());
+  calls.entries.erase(calls.entries.begin()+count,calls.entries.end());
+  calls.candidate.resize(count);
+  calls.pos.resize(count);
+
+  // commands of calls can't be replaced
+  std::vector<int> nextFixed(n+1,n);
+  std::vector<bool> fixed(n,false);
+  for (int i=0; i<count; i++) {
+    int p=calls.pos[i][0];
+    for (int j=0; j<calls.entries[i].length; j++) {
+      fixed[p+j]=true;
+    }
+  }
+  for (int i=n-1; i>=0; i--) {
+    nextFixed[i]=fixed[i]?i:nextFixed[i+1];
+  }
+
+  // best[i] is the most bytes saved from position i onwards
+  std::vector<int> best(n+1,0);
+  std::vector<int> choice(n+1,-1);
+  for (int i=n-1; i>=0; i--) {
+    best[i]=best[i+1];
+    if (fixed[i]) continue;
+    for (int j=0; j<count; j++) {
+      const TiunaCandidate& c=calls.entries[j];
+      if (seq.rank[i]<c.lb || seq.rank[i]>c.rb) continue;
+      if (i+c.length>nextFixed[i]) continue;
+      int saved=best[i+c.length]+seq.sizeSum[i+c.length]-seq.sizeSum[i]-2;
+      if (saved>best[i]) {
+        best[i]=saved;
+        choice[i]=j;
+      }
+    }
+  }
+
+  for (int i=0; i<count; i++) {
+    calls.pos[i].resize(1);
+  }
+  for (int i=0; i<n;) {
+    if (choice[i]<0) {
+      i++;
+      continue;
+    }
+    calls.pos[choice[i]].push_back(i);
+    i+=calls.entries[choice[i]].length;
+  }
+
+  // remove calls which are not used anymore
+  int next=0;
+  for (int i=0; i<count; i++) {
+    if (calls.pos[i].size()<2) continue;
+    std::sort(calls.pos[i].begin(),calls.pos[i].end());
+    calls.entries[next]=calls.entries[i];
+    calls.candidate[next]=calls.candidate[i];
+    calls.pos[next]=calls.pos[i];
+    next++;
+  }
+  calls.entries.erase(calls.entries.begin()+next,calls.entries.end());
+  calls.candidate.resize(next);
+  calls.pos.resize(next);
+}
+
 static void writeCmd(std::vector<TiunaBytes>& cmds, TiunaCmd& cmd, unsigned char ch, int& lastWait, int fromTick, int toTick) {
   while (fromTick<toTick) {
     int val=MIN(toTick-fromTick,256);
@@ -192,144 +486,127 @@ void DivExportTiuna::run() {
   int otherBankSize=conf.getInt("otherBankSize",4096-48);
   int tiaIdx=conf.getInt("sysToExport",-1);
 
-  e->stop();
-  e->repeatPattern=false;
-  e->shallStop=false;
-  e->setOrder(0);
-  e->synchronizedSoft([&]() {
-    // determine loop point
-    // bool stopped=false;
-    loopOrder=0;
-    loopOrderRow=0;
-    loopEnd=0;
-    e->walkSong(loopOrder,loopOrderRow,loopEnd);
-    logAppendf("loop point: %d %d",loopOrder,loopOrderRow);
-
-    w=new SafeWriter;
-    w->init();
-
-    if (tiaIdx<0 || tiaIdx>=e->song.systemLen) {
-      tiaIdx=-1;
-      for (int i=0; i<e->song.systemLen; i++) {
-        if (e->song.system[i]==DIV_SYSTEM_TIA) {
-          tiaIdx=i;
-          break;
-        }
-      }
-      if (tiaIdx<0) {
-        logAppend("ERROR: selected TIA system not found");
-        failed=true;
-        running=false;
-        return;
+  if (tiaIdx<0 || tiaIdx>=e->song.systemLen) {
+    tiaIdx=-1;
+    for (int i=0; i<e->song.systemLen; i++) {
+      if (e->song.system[i]==DIV_SYSTEM_TIA) {
+        tiaIdx=i;
+        break;
       }
-    } else if (e->song.system[tiaIdx]!=DIV_SYSTEM_TIA) {
-      logAppend("ERROR: selected chip is not a TIA!");
+    }
+    if (tiaIdx<0) {
+      logAppend("ERROR: selected TIA system not found");
       failed=true;
       running=false;
       return;
     }
+  } else if (e->song.system[tiaIdx]!=DIV_SYSTEM_TIA) {
+    logAppend("ERROR: selected chip is not a TIA!");
+    failed=true;
+    running=false;
+    return;
+  }
 
-    e->disCont[tiaIdx].dispatch->toggleRegisterDump(true);
-
-    // write patterns
-    // bool writeLoop=false;
-    logAppend("recording sequence...");
-    bool done=false;
-    e->playSub(false);
-    
-    // int loopTick=-1;
-    TiunaLast last[2];
-    TiunaNew news[2];
-    while (!done) {
-      // TODO implement loop
-      // if (loopTick<0 && loopOrder==curOrder && loopOrderRow==curRow
-      //   && (ticks-((tempoAccum+virtualTempoN)/virtualTempoD))<=0
-      // ) {
-      //   writeLoop=true;
-      //   loopTick=tick;
-      //   // invalidate last register state so it always force an absolute write after loop
-      //   for (int i=0; i<2; i++) {
-      //     last[i]=TiunaLast();
-      //     last[i].pitch=-1;
-      //     last[i].ins=-1;
-      //     last[i].vol=-1;
-      //   }
-      // }
-      if (e->nextTick(false,true) || !e->playing) {
-        // stopped=!playing;
-        done=true;
-        break;
-      }
-      for (int i=0; i<2; i++) {
-        news[i]=TiunaNew();
+  // write patterns
+  // bool writeLoop=false;
+  logAppend("recording sequence...");
+  DivRegTimeline* tl=timeline;
+  if (tl==NULL) tl=e->captureRegTimeline();
+
+  // determine loop point
+  tl->getLoop(loopOrder,loopOrderRow,loopEnd);
+  logAppendf("loop point: %d %d",loopOrder,loopOrderRow);
+
+  w=new SafeWriter;
+  w->init();
+
+  // int loopTick=-1;
+  TiunaLast last[2];
+  TiunaNew news[2];
+  // the last tick is where the song ends
+  size_t tickCount=tl->getSongTickCount();
+  if (tickCount>0) tickCount--;
+  for (size_t t=0; t<tickCount; t++) {
+    // TODO implement loop
+    // if (loopTick<0 && loopOrder==curOrder && loopOrderRow==curRow
+    //   && (ticks-((tempoAccum+virtualTempoN)/virtualTempoD))<=0
+    // ) {
+    //   writeLoop=true;
+    //   loopTick=tick;
+    //   // invalidate last register state so it always force an absolute write after loop
+    //   for (int i=0; i<2; i++) {
+    //     last[i]=TiunaLast();
+    //     last[i].pitch=-1;
+    //     last[i].ins=-1;
+    //     last[i].vol=-1;
+    //   }
+    // }
+    for (int i=0; i<2; i++) {
+      news[i]=TiunaNew();
+    }
+    // get register dumps (those made when starting playback go with the first tick)
+    size_t writeCount=0;
+    const DivRegTimelineWrite* writes=tl->getWrites(t,writeCount);
+    if (t==0) {
+      writes=tl->getInitWrites(writeCount);
+      writeCount+=tl->getTick(1).firstWrite-tl->getTick(0).firstWrite;
+    }
+    for (size_t j=0; j<writeCount; j++) {
+      const DivRegTimelineWrite& i=writes[j];
+      if (i.chip!=tiaIdx) continue;
+      switch (i.addr) {
+        case 0xfffe0000:
+        case 0xfffe0001:
+          news[i.addr&1].pitch=i.val;
+          break;
+        case 0xfffe0002:
+          news[0].sync=i.val;
+          break;
+        case 0x15:
+        case 0x16:
+          news[i.addr-0x15].ins=i.val;
+          break;
+        case 0x19:
+        case 0x1a:
+          news[i.addr-0x19].vol=i.val;
+          break;
+        default: break;
       }
-      // get register dumps
-      std::vector<DivRegWrite>& writes=e->disCont[tiaIdx].dispatch->getRegisterWrites();
-      for (const DivRegWrite& i: writes) {
-        switch (i.addr) {
-          case 0xfffe0000:
-          case 0xfffe0001:
-            news[i.addr&1].pitch=i.val;
-            break;
-          case 0xfffe0002:
-            news[0].sync=i.val;
-            break;
-          case 0x15:
-          case 0x16:
-            news[i.addr-0x15].ins=i.val;
-            break;
-          case 0x19:
-          case 0x1a:
-            news[i.addr-0x19].vol=i.val;
-            break;
-          default: break;
+    }
+    // collect changes
+    for (int i=0; i<2; i++) {
+      TiunaCmd cmds;
+      bool hasCmd=false;
+      if (news[i].pitch>=0 && (last[i].forcePitch || news[i].pitch!=last[i].pitch)) {
+        int dt=news[i].pitch-last[i].pitch;
+        if (!last[i].forcePitch && abs(dt)<=16) {
+          if (dt<0) cmds.pitchChange=15-dt;
+          else cmds.pitchChange=dt-1;
         }
+        else cmds.pitchSet=news[i].pitch;
+        last[i].pitch=news[i].pitch;
+        last[i].forcePitch=false;
+        hasCmd=true;
       }
-      writes.clear();
-      // collect changes
-      for (int i=0; i<2; i++) {
-        TiunaCmd cmds;
-        bool hasCmd=false;
-        if (news[i].pitch>=0 && (last[i].forcePitch || news[i].pitch!=last[i].pitch)) {
-          int dt=news[i].pitch-last[i].pitch;
-          if (!last[i].forcePitch && abs(dt)<=16) {
-            if (dt<0) cmds.pitchChange=15-dt;
-            else cmds.pitchChange=dt-1;
-          }
-          else cmds.pitchSet=news[i].pitch;
-          last[i].pitch=news[i].pitch;
-          last[i].forcePitch=false;
-          hasCmd=true;
-        }
-        if (news[i].ins>=0 && news[i].ins!=last[i].ins) {
-          cmds.ins=news[i].ins;
-          last[i].ins=news[i].ins;
-          hasCmd=true;
-        }
-        if (news[i].vol>=0 && news[i].vol!=last[i].vol) {
-          cmds.vol=(news[i].vol-last[i].vol)&0xf;
-          last[i].vol=news[i].vol;
-          hasCmd=true;
-        }
-        if (news[i].sync>=0) {
-          cmds.sync=news[i].sync;
-          hasCmd=true;
-        }
-        if (hasCmd) allCmds[i][tick]=cmds;
+      if (news[i].ins>=0 && news[i].ins!=last[i].ins) {
+        cmds.ins=news[i].ins;
+        last[i].ins=news[i].ins;
+        hasCmd=true;
       }
-      e->cmdStream.clear();
-      tick++;
-    }
-    for (int i=0; i<e->song.systemLen; i++) {
-      e->disCont[i].dispatch->getRegisterWrites().clear();
-      e->disCont[i].dispatch->toggleRegisterDump(false);
+      if (news[i].vol>=0 && news[i].vol!=last[i].vol) {
+        cmds.vol=(news[i].vol-last[i].vol)&0xf;
+        last[i].vol=news[i].vol;
+        hasCmd=true;
+      }
+      if (news[i].sync>=0) {
+        cmds.sync=news[i].sync;
+        hasCmd=true;
+      }
+      if (hasCmd) allCmds[i][tick]=cmds;
     }
-
-    e->remainingLoops=-1;
-    e->playing=false;
-    e->freelance=false;
-    e->extValuePresent=false;
-  });
+    tick++;
+  }
+  if (tl!=timeline) delete tl;
 
   if (failed) return;
 
@@ -364,137 +641,106 @@ void DivExportTiuna::run() {
     // if (stopped || loopTick<0) w->writeText(".loop\n    db 0\n");
   }
   // compress commands
+  // repeated runs of commands are moved into calls.
+  // the candidates are the LCP intervals of the suffix array of the command sequence: each one is a
+  // set of positions sharing a prefix, and every length between the LCP of the parent interval and
+  // its own has the same positions.
+  // calls are picked greedily. taking commands can only lower the bytes saved by a candidate, so a
+  // value computed earlier is an upper bound and candidates are only evaluated again when they reach
+  // the top of the queue.
+  // greedy picking is not optimal, so this is done a few times with different weights and the
+  // smallest result is kept.
   std::vector<TiunaMatch> confirmedMatches;
   std::vector<int> callTicks;
   int cmId=0;
   int cmdSize=renderedCmds.size();
-  bool* processed=new bool[cmdSize];
-  memset(processed,0,cmdSize*sizeof(bool));
-  logAppend("compressing! this may take a while.");
+  logAppend("compressing...");
   int maxCmId=(MAX(firstBankSize/1024,1))*256;
-  int lastMaxPMVal=100000;
   logAppendf("max cmId: %d",maxCmId);
   logAppendf("commands: %d",cmdSize);
-  while (firstBankSize>768 && cmId<maxCmId) {
-    if (mustAbort) {
-      logAppend("aborted!");
-      failed=true;
-      running=false;
-      delete[] processed;
-      return;
-    }
+  if (firstBankSize>768 && cmdSize>1) {
+    TiunaSequence seq;
+    buildTiunaSequence(renderedCmds,seq);
+    std::vector<TiunaCandidate> candidates;
+    findTiunaCandidates(seq,candidates);
+    logAppendf("candidates: %d",(int)candidates.size());
 
-    float theOtherSide=pow(1.0/float(MAX(1,lastMaxPMVal)),0.2)*0.98;
-    progress[0].amount=theOtherSide+(1.0-theOtherSide)*((float)cmId/(float)maxCmId);
-
-    logAppendf("start CM %04x...",cmId);
-    std::map<int,TiunaMatches> potentialMatches;
-    for (int i=0; i<cmdSize-1;) {
-      // continue and skip if it's part of previous confirmed matches
-      while (i<cmdSize-1 && processed[i]) i++;
-      if (i>=cmdSize-1) break;
-      progress[1].amount=(float)i/(float)(cmdSize-1);
-      std::vector<TiunaMatch> match;
-      int ch=renderedCmds[i].ch;
-      for (int j=i+1; j<cmdSize;) {
-        if (processed[i]) break;
-        //while (j<cmdSize && processed[i]) j++;
-        if (j>=cmdSize) break;
-        int k=0;
-        int ticks=0;
-        int size=0;
-        while (
-          (i+k)<j && (i+k)<cmdSize && (j+k)<cmdSize &&
-          (ticks+renderedCmds[i+k].ticks)<=256 &&
-          // match runs can't cross channels
-          // as channel end command would be insterted there later
-          renderedCmds[i+k].ch==ch &&
-          renderedCmds[j+k].ch==ch &&
-          renderedCmds[i+k]==renderedCmds[j+k] &&
-          !processed[i+k] && !processed[j+k]
-        ) {
-          ticks+=renderedCmds[i+k].ticks;
-          size+=renderedCmds[i+k].size;
-          k++;
-        }
-        if (size>2) match.push_back(TiunaMatch(j,j+k,size,0));
-        if (k==0) k++;
-        j+=k;
+    // runs a greedy pass and keeps it if it's the best so far
+    TiunaCalls best;
+    int bestSaved=INT32_MIN;
+    int passes=0;
+    const int totalPasses=TIUNA_LENGTH_BIAS_COUNT+TIUNA_REFINE_PASSES;
+    auto runPass=[&](const std::vector<bool>& banned, double lengthBias) -> int {
+      TiunaCalls calls;
+      if (!findTiunaCalls(seq,candidates,banned,lengthBias,maxCmId,mustAbort,progress[1].amount,calls)) {
+        return -1;
       }
-      if (match.empty()) {
-        i++;
-        continue;
+      reparseTiunaCalls(seq,calls);
+      int saved=getTiunaBytesSaved(seq,calls);
+      passes++;
+      progress[0].amount=(float)passes/(float)totalPasses;
+      logAppendf("pass %d: %d calls, %d bytes saved",passes,(int)calls.entries.size(),saved);
+      if (saved>bestSaved) {
+        bestSaved=saved;
+        best=calls;
+        return 1;
       }
-      // find a length that results in most bytes saved
-      TiunaMatches matches;
-      int curSize=0;
-      int curLength=1;
-      int curTicks=0;
-      while (true) {
-        int bytesSaved=-4;
-        bool found=false;
-        for (const TiunaMatch& j: match) {
-          if ((j.endPos-j.pos)>=curLength) {
-            if (!found) {
-              found=true;
-              curSize+=renderedCmds[i+curLength-1].size;
-              curTicks+=renderedCmds[i+curLength-1].ticks;
-            }
-            bytesSaved+=curSize-2;
-          }
-        }
-        if (!found) break;
-        if (bytesSaved>matches.bytesSaved) {
-          matches.length=curLength;
-          matches.bytesSaved=bytesSaved;
-          matches.ticks=curTicks;
-        }
-        curLength++;
+      return 0;
+    };
+
+    std::vector<bool> banned(candidates.size(),false);
+    double bestBias=0.0;
+    bool aborted=false;
+    for (int i=0; i<TIUNA_LENGTH_BIAS_COUNT; i++) {
+      int result=runPass(banned,tiunaLengthBias[i]);
+      if (result<0) {
+        aborted=true;
+        break;
       }
-      if (matches.bytesSaved>0) {
-        matches.pos.push_back(i);
-        for (const TiunaMatch& j: match) {
-          if ((j.endPos-j.pos)>=matches.length) {
-            matches.pos.push_back(j.pos);
-          }
-        }
-        potentialMatches[i]=matches;
+      if (result>0) bestBias=tiunaLengthBias[i];
+    }
+
+    // leave out early picks one at a time, keeping any improvement
+    int nextCall=0;
+    while (!aborted && passes<totalPasses && nextCall<MIN(TIUNA_REFINE_CALLS,(int)best.candidate.size())) {
+      int ci=best.candidate[nextCall];
+      banned[ci]=true;
+      int result=runPass(banned,bestBias);
+      if (result<0) {
+        aborted=true;
+      } else if (result>0) {
+        nextCall=0;
+      } else {
+        banned[ci]=false;
+        nextCall++;
       }
-      i++;
     }
-    if (potentialMatches.empty()) {
-      logAppend("potentialMatches is empty");
-      break;
+    if (aborted) {
+      logAppend("aborted!");
+      failed=true;
+      running=false;
+      return;
     }
-    int maxPMIdx=0;
-    int maxPMVal=0;
-    for (const auto& i: potentialMatches) {
-      if (i.second.bytesSaved>maxPMVal) {
-        maxPMVal=i.second.bytesSaved;
-        maxPMIdx=i.first;
+
+    cmId=best.entries.size();
+    for (int i=0; i<cmId; i++) {
+      int len=best.entries[i].length;
+      int p=best.pos[i][0];
+      for (int j: best.pos[i]) {
+        int cmdPos=seq.cmdIndex[j];
+        confirmedMatches.push_back(TiunaMatch(cmdPos,cmdPos+len,0,i));
       }
+      callTicks.push_back(seq.tickSum[p+len]-seq.tickSum[p]);
+      logAppendf("CM %04x added: pos=%d,len=%d,matches=%d,saved=%d",i,seq.cmdIndex[p],len,(int)best.pos[i].size(),getTiunaCallBytesSaved(seq,best,i));
     }
-    int maxPMLen=potentialMatches[maxPMIdx].length;
-    for (const int i: potentialMatches[maxPMIdx].pos) {
-      confirmedMatches.push_back({i,i+maxPMLen,0,cmId});
-      memset(processed+i,1,maxPMLen);
-      //std::fill(processed.begin()+i,processed.begin()+(i+maxPMLen),true);
-    }
-    callTicks.push_back(potentialMatches[maxPMIdx].ticks);
-    logAppendf("CM %04x added: pos=%d,len=%d,matches=%d,saved=%d",cmId,maxPMIdx,maxPMLen,potentialMatches[maxPMIdx].pos.size(),maxPMVal);
-    lastMaxPMVal=maxPMVal;
-    cmId++;
   }
   progress[0].amount=1.0f;
   progress[1].amount=1.0f;
   logAppend("generating data...");
-  delete[] processed;
   std::sort(confirmedMatches.begin(),confirmedMatches.end(),[](const TiunaMatch& l, const TiunaMatch& r){
     return l.pos<r.pos;
   });
-  // ignore last call IDs >256 that don't fill up a page
-  // as they tends to increase the final size due to page alignment
-  int cmIdLen=cmId>256?(cmId&~255):cmId;
+  int cmIdLen=getTiunaCallCount(cmId);
   // overlap check
   for (int i=1; i<(int)confirmedMatches.size(); i++) {
     if (confirmedMatches[i-1].endPos<=confirmedMatches[i].pos) continue;
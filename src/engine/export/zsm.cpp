@@ -518,9 +518,6 @@ void DivZSM::flushTicks() {
 
 /// ZSM export
 
-constexpr int MASTER_CLOCK_PREC=(sizeof(void*)==8)?8:0;
-constexpr int MASTER_CLOCK_MASK=(sizeof(void*)==8)?0xff:0;
-
 void DivExportZSM::run() {
   // settings
   unsigned int zsmrate=conf.getInt("zsmrate",60);
@@ -569,145 +566,123 @@ void DivExportZSM::run() {
 
   DivZSM zsm;
 
-  e->stop();
-  e->repeatPattern=false;
-  e->setOrder(0);
-  e->synchronizedSoft([&]() {
-    double origRate=e->got.rate;
-    e->got.rate=zsmrate&0xffff;
-
-    // determine loop point
-    int loopOrder=0;
-    int loopRow=0;
-    int loopEnd=0;
-    e->walkSong(loopOrder,loopRow,loopEnd);
-    logAppendf("loop point: %d %d",loopOrder,loopRow);
-
-    zsm.init(zsmrate);
-
-    // reset the playback state
-    e->curOrder=0;
-    e->freelance=false;
-    e->playing=false;
-    e->extValuePresent=false;
-    e->remainingLoops=-1;
-
-    // Prepare to write song data
-    e->playSub(false);
-    //size_t tickCount=0;
-    bool done=false;
-    bool loopNow=false;
-    int loopPos=-1;
-    int fracWait=0; // accumulates fractional ticks
-    if (VERA>=0) e->disCont[VERA].dispatch->toggleRegisterDump(true);
-    if (YM>=0) {
-      e->disCont[YM].dispatch->toggleRegisterDump(true);
-      // emit LFO initialization commands
-      zsm.writeYM(0x18,0);    // freq=0
-      zsm.writeYM(0x19,0x7F); // AMD =7F
-      zsm.writeYM(0x19,0xFF); // PMD =7F
-      // TODO: incorporate the Furnace meta-command for init data and filter
-      //       out writes to otherwise-unused channels.
-    }
-    // Indicate the song's tuning as a sync meta-event
-    // specified in terms of how many 1/256th semitones
-    // the song is offset from standard A-440 tuning.
-    // This is mainly to benefit visualizations in players
-    // for non-standard tunings so that they can avoid
-    // displaying the entire song held in pitch bend.
-    // Tunings offsets that exceed a half semitone
-    // will simply be represented in a different key
-    // by nature of overflowing the signed char value
-    signed char tuningoffset=(signed char)(round(3072*(log(e->song.tuning/440.0)/log(2))))&0xff;
-    zsm.writeSync(0x01,tuningoffset);
-    // Set optimize flag, which mainly buffers PSG writes
-    // whenever the channel is silent
-    zsm.setOptimize(optimize);
-
-    while (!done) {
-      if (loopPos==-1) {
-        if (loopOrder==e->curOrder && loopRow==e->curRow && loop)
-          loopNow=true;
-        if (loopNow) {
-          // If Virtual Tempo is in use, our exact loop point
-          // might be skipped due to quantization error.
-          // If this happens, the tick immediately following is our loop point.
-          if (e->ticks==1 || !(loopOrder==e->curOrder && loopRow==e->curRow)) {
-            loopPos=zsm.getoffset();
-            zsm.setLoopPoint();
-            loopNow=false;
-          }
+  DivRegTimeline* tl=timeline;
+  if (tl==NULL) {
+    // capture at the ZSM rate so that waits need no conversion
+    tl=e->captureRegTimeline(zsmrate&0xffff);
+  }
+
+  // determine loop point
+  int loopOrder=0;
+  int loopRow=0;
+  int loopEnd=0;
+  tl->getLoop(loopOrder,loopRow,loopEnd);
+  logAppendf("loop point: %d %d",loopOrder,loopRow);
+
+  zsm.init(zsmrate);
+
+  // Prepare to write song data
+  //size_t tickCount=0;
+  bool done=false;
+  bool loopNow=false;
+  int loopPos=-1;
+  int prec=tl->getPrec();
+  if (YM>=0) {
+    // emit LFO initialization commands
+    zsm.writeYM(0x18,0);    // freq=0
+    zsm.writeYM(0x19,0x7F); // AMD =7F
+    zsm.writeYM(0x19,0xFF); // PMD =7F
+    // TODO: incorporate the Furnace meta-command for init data and filter
+    //       out writes to otherwise-unused channels.
+  }
+  // Indicate the song's tuning as a sync meta-event
+  // specified in terms of how many 1/256th semitones
+  // the song is offset from standard A-440 tuning.
+  // This is mainly to benefit visualizations in players
+  // for non-standard tunings so that they can avoid
+  // displaying the entire song held in pitch bend.
+  // Tunings offsets that exceed a half semitone
+  // will simply be represented in a different key
+  // by nature of overflowing the signed char value
+  signed char tuningoffset=(signed char)(round(3072*(log(e->song.tuning/440.0)/log(2))))&0xff;
+  zsm.writeSync(0x01,tuningoffset);
+  // Set optimize flag, which mainly buffers PSG writes
+  // whenever the channel is silent
+  zsm.setOptimize(optimize);
+
+  for (size_t t=0; t<tl->getSongTickCount() && !done; t++) {
+    const DivRegTimelineTick& tick=tl->getTick(t);
+    if (loopPos==-1) {
+      if (loopOrder==tick.order && loopRow==tick.row && loop)
+        loopNow=true;
+      if (loopNow) {
+        // If Virtual Tempo is in use, our exact loop point
+        // might be skipped due to quantization error.
+        // If this happens, the tick immediately following is our loop point.
+        if ((tick.flags&DIV_REGTL_ROW_LAST) || !(loopOrder==tick.order && loopRow==tick.row)) {
+          loopPos=zsm.getoffset();
+          zsm.setLoopPoint();
+          loopNow=false;
         }
       }
-      if (e->nextTick() || !e->playing) {
-        done=true;
-        if (!loop) {
-          for (int i=0; i<e->song.systemLen; i++) {
-            e->disCont[i].dispatch->getRegisterWrites().clear();
-          }
-          break;
-        }
-        if (!e->playing) {
-          loopPos=-1;
+    }
+    if (tick.flags&(DIV_REGTL_END|DIV_REGTL_STOPPED)) {
+      done=true;
+      if (!loop) break;
+      if (tick.flags&DIV_REGTL_STOPPED) {
+        loopPos=-1;
+      }
+    }
+    // get register dumps
+    size_t writeCount=0;
+    const DivRegTimelineWrite* writes=tl->getWrites(t,writeCount);
+    for (int j=0; j<2; j++) {
+      int i=0;
+      // dump YM writes first
+      if (j==0) {
+        if (YM<0) {
+          continue;
+        } else {
+          i=YM;
         }
       }
-      // get register dumps
-      for (int j=0; j<2; j++) {
-        int i=0;
-        // dump YM writes first
-        if (j==0) {
-          if (YM<0) {
-            continue;
-          } else {
-            i=YM;
-          }
+      // dump VERA writes second
+      if (j==1) {
+        if (VERA<0) {
+          continue;
+        } else {
+          i=VERA;
         }
-        // dump VERA writes second
-        if (j==1) {
-          if (VERA<0) {
-            continue;
-          } else {
-            i=VERA;
-          }
+      }
+      int chipWrites=0;
+      for (size_t k=0; k<writeCount; k++) {
+        const DivRegTimelineWrite& write=writes[k];
+        if (write.chip!=i) continue;
+        chipWrites++;
+        if (i==YM) {
+          if (done && write.addr==0x08 && (write.val&0x78)>0) continue; // don't process keydown on lookahead
+          zsm.writeYM(write.addr&0xff,write.val);
         }
-        std::vector<DivRegWrite>& writes=e->disCont[i].dispatch->getRegisterWrites();
-        if (writes.size()>0)
-          logD("zsmOps: Writing %d messages to chip %d",writes.size(),i);
-        for (DivRegWrite& write: writes) {
-          if (i==YM) {
-            if (done && write.addr==0x08 && (write.val&0x78)>0) continue; // don't process keydown on lookahead
-            zsm.writeYM(write.addr&0xff,write.val);
-          }
-          if (i==VERA) {
-            if (done && write.addr>=64) continue; // don't process any PCM or sync events on the loop lookahead
-            zsm.writePSG(write.addr&0xff,write.val);
-          }
+        if (i==VERA) {
+          if (done && write.addr>=64) continue; // don't process any PCM or sync events on the loop lookahead
+          zsm.writePSG(write.addr&0xff,write.val);
         }
-        writes.clear();
       }
+      if (chipWrites>0)
+        logD("zsmOps: Writing %d messages to chip %d",chipWrites,i);
+    }
 
-      // write wait
-      int totalWait=e->cycles>>MASTER_CLOCK_PREC;
-      fracWait+=e->cycles&MASTER_CLOCK_MASK;
-      totalWait+=fracWait>>MASTER_CLOCK_PREC;
-      fracWait&=MASTER_CLOCK_MASK;
-      if (totalWait>0 && !done) {
-        zsm.tick(totalWait);
-        //tickCount+=totalWait;
-      }
+    // write wait
+    int totalWait=(tl->getTime(t+1,zsmrate&0xffff)>>prec)-(tl->getTime(t,zsmrate&0xffff)>>prec);
+    if (totalWait>0 && !done) {
+      zsm.tick(totalWait);
+      //tickCount+=totalWait;
     }
-    // end of song
-
-    // done - close out.
-    e->got.rate=origRate;
-    if (VERA>=0) e->disCont[VERA].dispatch->toggleRegisterDump(false);
-    if (YM>=0) e->disCont[YM].dispatch->toggleRegisterDump(false);
-
-    e->remainingLoops=-1;
-    e->playing=false;
-    e->freelance=false;
-    e->extValuePresent=false;
-  });
+  }
+  // end of song
+
+  // done - close out.
+  if (tl!=timeline) delete tl;
 
   progress[0].amount=1.0f;
 
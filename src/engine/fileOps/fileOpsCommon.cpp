@@ -48,92 +48,9 @@ bool DivEngine::load(unsigned char* f, size_t slen, const char* nameHint) {
 
   // step 1: try loading as a zlib-compressed file
   logD("trying zlib...");
-  try {
-    z_stream zl;
-    memset(&zl,0,sizeof(z_stream));
-
-    zl.avail_in=slen;
-    zl.next_in=(Bytef*)f;
-    zl.zalloc=NULL;
-    zl.zfree=NULL;
-    zl.opaque=NULL;
-
-    int nextErr;
-    nextErr=inflateInit(&zl);
-    if (nextErr!=Z_OK) {
-      if (zl.msg==NULL) {
-        logD("zlib error: unknown! %d",nextErr);
-      } else {
-        logD("zlib error: %s",zl.msg);
-      }
-      inflateEnd(&zl);
-      lastError="not a .dmf/.fur song";
-      throw NotZlibException(0);
-    }
-
-    std::vector<InflateBlock*> blocks;
-    while (true) {
-      InflateBlock* ib=new InflateBlock(DIV_READ_SIZE);
-      zl.next_out=ib->buf;
-      zl.avail_out=ib->len;
-
-      nextErr=inflate(&zl,Z_SYNC_FLUSH);
-      if (nextErr!=Z_OK && nextErr!=Z_STREAM_END) {
-        if (zl.msg==NULL) {
-          logD("zlib error: unknown error! %d",nextErr);
-          lastError="unknown decompression error";
-        } else {
-          logD("zlib inflate: %s",zl.msg);
-          lastError=fmt::sprintf("decompression error: %s",zl.msg);
-        }
-        for (InflateBlock* i: blocks) delete i;
-        blocks.clear();
-        delete ib;
-        inflateEnd(&zl);
-        throw NotZlibException(0);
-      }
-      ib->blockSize=ib->len-zl.avail_out;
-      blocks.push_back(ib);
-      if (nextErr==Z_STREAM_END) {
-        break;
-      }
-    }
-    nextErr=inflateEnd(&zl);
-    if (nextErr!=Z_OK) {
-      if (zl.msg==NULL) {
-        logD("zlib end error: unknown error! %d",nextErr);
-        lastError="unknown decompression finish error";
-      } else {
-        logD("zlib end: %s",zl.msg);
-        lastError=fmt::sprintf("decompression finish error: %s",zl.msg);
-      }
-      for (InflateBlock* i: blocks) delete i;
-      blocks.clear();
-      throw NotZlibException(0);
-    }
-
-    size_t finalSize=0;
-    size_t curSeek=0;
-    for (InflateBlock* i: blocks) {
-      finalSize+=i->blockSize;
-    }
-    if (finalSize<1) {
-      logD("compressed too small!");
-      lastError="file too small";
-      for (InflateBlock* i: blocks) delete i;
-      blocks.clear();
-      throw NotZlibException(0);
-    }
-    file=new unsigned char[finalSize];
-    for (InflateBlock* i: blocks) {
-      memcpy(&file[curSeek],i->buf,i->blockSize);
-      curSeek+=i->blockSize;
-      delete i;
-    }
-    blocks.clear();
-    len=finalSize;
+  if (divInflate(f,slen,file,len,lastError)) {
     delete[] f;
-  } catch (NotZlibException& e) {
+  } else {
     logD("not zlib. loading as raw...");
     file=f;
     len=slen;
@@ -178,3 +95,123 @@ bool DivEngine::load(unsigned char* f, size_t slen, const char* nameHint) {
   delete[] file;
   return false;
 }
+
+int DivEngine::loadMapped(const char* path) {
+  // the song is about to be replaced
+  stopMapCopy();
+
+  DivMappedFile* map=DivMappedFile::open(path);
+  if (map==NULL) return 0;
+
+  // only uncompressed .fur files may contain mappable samples
+  int variantID=-1;
+  if (map->size()>=DIV_SAMPLE_MAP_MIN) {
+    if (memcmp(map->getData(),DIV_FUR_MAGIC,16)==0) {
+      variantID=DIV_FUR_VARIANT_VANILLA;
+    } else if (memcmp(map->getData(),DIV_FUR_MAGIC_DS0,16)==0) {
+      variantID=DIV_FUR_VARIANT_B;
+    }
+  }
+  if (variantID<0) {
+    map->unref();
+    return 0;
+  }
+
+  if (!systemsRegistered) registerSystems();
+
+  logD("loading mapped file...");
+  bool ret=loadFur(map->getData(),map->size(),variantID,map);
+  // mapped samples hold their own references
+  map->unref();
+  // another program may truncate or rewrite the file while it is open, so
+  // don't keep using it
+  if (ret) startMapCopy();
+  return ret?1:-1;
+}
+
+void DivEngine::unmapSamples(const char* path) {
+  stopMapCopy();
+  BUSY_BEGIN;
+  saveLock.lock();
+  bool stillMapped=false;
+  for (DivSample* i: song.sample) {
+    if (i->mappedFile==NULL) continue;
+    if (path!=NULL && !i->mappedFile->isFile(path)) {
+      stillMapped=true;
+      continue;
+    }
+    i->unmap();
+  }
+  saveLock.unlock();
+  BUSY_END;
+  if (stillMapped) startMapCopy();
+}
+
+struct DivMapCopyJob {
+  DivMappedFile* file;
+  const void* mapped;
+  DivSampleDepth depth;
+  unsigned int samples;
+};
+
+void DivEngine::runMapCopy() {
+  std::vector<DivMapCopyJob> jobs;
+  lockEngine([this,&jobs]() {
+    for (DivSample* i: song.sample) {
+      if (i->mappedFile==NULL) continue;
+      DivMapCopyJob job;
+      job.file=i->mappedFile;
+      job.mapped=i->mappedBuf;
+      job.depth=i->depth;
+      job.samples=i->samples;
+      // keep the mapping alive even if the sample goes away
+      job.file->ref();
+      jobs.push_back(job);
+    }
+  });
+  if (jobs.empty()) return;
+
+  logD("copying %d mapped samples...",(int)jobs.size());
+  int copied=0;
+  for (DivMapCopyJob& i: jobs) {
+    if (!mapCopyCancel) {
+      // reading the mapping may take a while (it may not be in memory yet), so do it unlocked
+      void* copy=DivSample::copyMapped(i.mapped,i.depth,i.samples);
+      bool taken=false;
+      lockEngine([this,&i,copy,&taken]() {
+        for (DivSample* j: song.sample) {
+          if (j->replaceMapped(i.mapped,copy,i.depth,i.samples)) {
+            taken=true;
+            break;
+          }
+        }
+      });
+      if (taken) {
+        copied++;
+      } else {
+        DivSample::freeMappedCopy(copy,i.depth);
+      }
+    }
+    mapCopyHeld.push_back(i.file);
+  }
+  logD("copied %d mapped samples",copied);
+}
+
+void DivEngine::startMapCopy() {
+  stopMapCopy();
+  mapCopyThread=new std::thread(&DivEngine::runMapCopy,this);
+}
+
+void DivEngine::stopMapCopy() {
+  if (mapCopyThread!=NULL) {
+    mapCopyCancel=true;
+    mapCopyThread->join();
+    delete mapCopyThread;
+    mapCopyThread=NULL;
+    mapCopyCancel=false;
+  }
+  for (DivMappedFile* i: mapCopyHeld) {
+    i->unref();
+  }
+  mapCopyHeld.clear();
+}
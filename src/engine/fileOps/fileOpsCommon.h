@@ -20,32 +20,9 @@
 #include "../dataErrors.h"
 #include "../engine.h"
 #include "../../ta-log.h"
-#include <zlib.h>
+#include "../zlibOps.h"
 #include <fmt/printf.h>
 
-#define DIV_READ_SIZE 131072
-
-struct InflateBlock {
-  unsigned char* buf;
-  size_t len;
-  size_t blockSize;
-  InflateBlock(size_t s) {
-    buf=new unsigned char[s];
-    len=s;
-    blockSize=0;
-  }
-  ~InflateBlock() {
-    delete[] buf;
-    len=0;
-  }
-};
-
-struct NotZlibException {
-  int what;
-  NotZlibException(int w):
-    what(w) {}
-};
-
 #define DIV_DMF_MAGIC ".DelekDefleMask."
 #define DIV_FUR_MAGIC "-Furnace module-"
 #define DIV_FTM_MAGIC "FamiTracker Module"
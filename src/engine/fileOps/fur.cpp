@@ -18,6 +18,10 @@
  */
 
 #include "fileOpsCommon.h"
+#include "../workPool.h"
+
+// maximum number of threads used to read blocks while loading
+#define DIV_LOAD_MAX_THREADS 8
 
 short newFormatNotes[180]={
   12, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, // -5
@@ -691,7 +695,176 @@ void DivEngine::convertOldFlags(unsigned int oldFlags, DivConfig& newFlags, DivS
   }
 }
 
-bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
+enum FurBlockType {
+  FUR_BLOCK_INS=0,
+  FUR_BLOCK_WAVE,
+  FUR_BLOCK_SAMPLE,
+  FUR_BLOCK_PATTERN
+};
+
+// a block of the file (instrument, wavetable, sample or pattern) to be read
+// independently of the others.
+// each block is read with its own SafeReader over the file buffer.
+struct FurBlockReadTask {
+  const unsigned char* file;
+  size_t len;
+  FurBlockType type;
+  unsigned int ptr;
+  short version;
+  // samples: the file this one is mapped from, if any
+  DivMappedFile* map;
+
+  // patterns: the header is read beforehand
+  DivPattern* pat;
+  int patLen, effectCols, chan;
+  bool newFormat;
+
+  // result
+  void* result;
+  DivDataErrors error;
+  bool seekFailed;
+  bool eof;
+  size_t end;
+
+  FurBlockReadTask(const unsigned char* f, size_t l, FurBlockType t, unsigned int p, short v):
+    file(f),
+    len(l),
+    type(t),
+    ptr(p),
+    version(v),
+    map(NULL),
+    pat(NULL),
+    patLen(0),
+    effectCols(0),
+    chan(0),
+    newFormat(false),
+    result(NULL),
+    error(DIV_DATA_SUCCESS),
+    seekFailed(false),
+    eof(false),
+    end(0) {}
+};
+
+static void readFurPatternData(SafeReader& reader, DivPattern* pat, int patLen, int effectCols, bool newFormat, short version, int chan, unsigned int where) {
+  if (newFormat) {
+    pat->name=reader.readString();
+
+    // read new pattern
+    for (int j=0; j<patLen; j++) {
+      unsigned char mask=reader.readC();
+      unsigned short effectMask=0;
+
+      if (mask==0xff) break;
+      if (mask&128) {
+        j+=(mask&127)+1;
+        continue;
+      }
+
+      if (mask&32) {
+        effectMask|=(unsigned char)reader.readC();
+      }
+      if (mask&64) {
+        effectMask|=((unsigned short)reader.readC()&0xff)<<8;
+      }
+      if (mask&8) effectMask|=1;
+      if (mask&16) effectMask|=2;
+
+      if (mask&1) { // note
+        unsigned char note=reader.readC();
+        if (note==180) {
+          pat->data[j][0]=100;
+          pat->data[j][1]=0;
+        } else if (note==181) {
+          pat->data[j][0]=101;
+          pat->data[j][1]=0;
+        } else if (note==182) {
+          pat->data[j][0]=102;
+          pat->data[j][1]=0;
+        } else if (note<180) {
+          pat->data[j][0]=newFormatNotes[note];
+          pat->data[j][1]=newFormatOctaves[note];
+        } else {
+          pat->data[j][0]=0;
+          pat->data[j][1]=0;
+        }
+      }
+      if (mask&2) { // instrument
+        pat->data[j][2]=(unsigned char)reader.readC();
+      }
+      if (mask&4) { // volume
+        pat->data[j][3]=(unsigned char)reader.readC();
+      }
+      for (unsigned char k=0; k<16; k++) {
+        if (effectMask&(1<<k)) {
+          pat->data[j][4+k]=(unsigned char)reader.readC();
+        }
+      }
+    }
+  } else {
+    for (int j=0; j<patLen; j++) {
+      pat->data[j][0]=reader.readS();
+      pat->data[j][1]=reader.readS();
+      pat->data[j][2]=reader.readS();
+      pat->data[j][3]=reader.readS();
+      for (int k=0; k<effectCols; k++) {
+        pat->data[j][4+(k<<1)]=reader.readS();
+        pat->data[j][5+(k<<1)]=reader.readS();
+      }
+      if (pat->data[j][0]==0 && pat->data[j][1]!=0) {
+        logD("what? %d:%d:%d note %d octave %d",chan,where,j,pat->data[j][0],pat->data[j][1]);
+        pat->data[j][0]=12;
+        pat->data[j][1]--;
+      }
+    }
+
+    if (version>=51) {
+      pat->name=reader.readString();
+    }
+  }
+}
+
+static void readFurBlock(void* arg) {
+  FurBlockReadTask* t=(FurBlockReadTask*)arg;
+  SafeReader reader(t->file,t->len);
+
+  if (!reader.seek(t->ptr,SEEK_SET)) {
+    t->seekFailed=true;
+    return;
+  }
+
+  try {
+    switch (t->type) {
+      case FUR_BLOCK_INS: {
+        DivInstrument* ins=new DivInstrument;
+        logD("reading instrument at %x...",t->ptr);
+        t->error=ins->readInsData(reader,t->version);
+        t->result=ins;
+        break;
+      }
+      case FUR_BLOCK_WAVE: {
+        DivWavetable* wave=new DivWavetable;
+        logD("reading wavetable at %x...",t->ptr);
+        t->error=wave->readWaveData(reader,t->version);
+        t->result=wave;
+        break;
+      }
+      case FUR_BLOCK_SAMPLE: {
+        DivSample* sample=new DivSample;
+        t->error=sample->readSampleData(reader,t->version,t->map);
+        t->result=sample;
+        break;
+      }
+      case FUR_BLOCK_PATTERN:
+        readFurPatternData(reader,t->pat,t->patLen,t->effectCols,t->newFormat,t->version,t->chan,t->ptr);
+        break;
+    }
+  } catch (EndOfFileException& e) {
+    t->eof=true;
+  }
+  t->end=reader.tell();
+}
+
+bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID, DivMappedFile* map) {
   unsigned int insPtr[256];
   unsigned int wavePtr[256];
   unsigned int samplePtr[256];
@@ -714,7 +887,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     if (!reader.seek(16,SEEK_SET)) {
       logE("premature end of file!");
       lastError="incomplete file";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     ds.version=reader.readS();
@@ -872,7 +1045,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     if (!reader.seek(infoSeek,SEEK_SET)) {
       logE("couldn't seek to info header at %d!",infoSeek);
       lastError="couldn't seek to info header!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
 
@@ -881,7 +1054,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     if (strcmp(magic,"INFO")!=0) {
       logE("invalid info header!");
       lastError="invalid info header!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     reader.readI();
@@ -907,49 +1080,49 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     if (subSong->patLen<0) {
       logE("pattern length is negative!");
       lastError="pattern lengrh is negative!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (subSong->patLen>DIV_MAX_ROWS) {
       logE("pattern length is too large!");
       lastError="pattern length is too large!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (subSong->ordersLen<0) {
       logE("song length is negative!");
       lastError="song length is negative!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (subSong->ordersLen>DIV_MAX_PATTERNS) {
       logE("song is too long!");
       lastError="song is too long!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (ds.insLen<0 || ds.insLen>256) {
       logE("invalid instrument count!");
       lastError="invalid instrument count!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (ds.waveLen<0 || ds.waveLen>256) {
       logE("invalid wavetable count!");
       lastError="invalid wavetable count!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (ds.sampleLen<0 || ds.sampleLen>256) {
       logE("invalid sample count!");
       lastError="invalid sample count!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
     if (numberOfPats<0) {
       logE("invalid pattern count!");
       lastError="invalid pattern count!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
 
@@ -962,7 +1135,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
       if (sysID!=0 && systemToFileFur(ds.system[i])==0) {
         logE("unrecognized system ID %.2x",sysID);
         lastError=fmt::sprintf("unrecognized system ID %.2x!",sysID);
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
       if (ds.system[i]!=DIV_SYSTEM_NULL) ds.systemLen=i+1;
@@ -979,7 +1152,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     if (ds.systemLen<1) {
       logE("zero chips!");
       lastError="zero chips!";
-      delete[] file;
+      if (map==NULL) delete[] file;
       return false;
     }
 
@@ -1166,7 +1339,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
       if (subSong->pat[i].effectCols<1 || subSong->pat[i].effectCols>DIV_MAX_EFFECTS) {
         logE("channel %d has zero or too many effect columns! (%d)",i,subSong->pat[i].effectCols);
         lastError=fmt::sprintf("channel %d has too many effect columns! (%d)",i,subSong->pat[i].effectCols);
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
     }
@@ -1460,7 +1633,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
           logE("couldn't seek to chip %d flags!",i+1);
           lastError=fmt::sprintf("couldn't seek to chip %d flags!",i+1);
           ds.unload();
-          delete[] file;
+          if (map==NULL) delete[] file;
           return false;
         }
 
@@ -1469,7 +1642,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
           logE("%d: invalid flag header!",i);
           lastError="invalid flag header!";
           ds.unload();
-          delete[] file;
+          if (map==NULL) delete[] file;
           return false;
         }
         reader.readI();
@@ -1492,13 +1665,13 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
         logE("couldn't seek to ins dir!");
         lastError=fmt::sprintf("couldn't read instrument directory");
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
       if (readAssetDirData(reader,ds.insDir)!=DIV_DATA_SUCCESS) {
         lastError="invalid instrument directory data!";
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
 
@@ -1506,13 +1679,13 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
         logE("couldn't seek to wave dir!");
         lastError=fmt::sprintf("couldn't read wavetable directory");
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
       if (readAssetDirData(reader,ds.waveDir)!=DIV_DATA_SUCCESS) {
         lastError="invalid wavetable directory data!";
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
 
@@ -1520,13 +1693,13 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
         logE("couldn't seek to sample dir!");
         lastError=fmt::sprintf("couldn't read sample directory");
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
       if (readAssetDirData(reader,ds.sampleDir)!=DIV_DATA_SUCCESS) {
         lastError="invalid sample directory data!";
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
     }
@@ -1540,7 +1713,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
           logE("couldn't seek to subsong %d!",i+1);
           lastError=fmt::sprintf("couldn't seek to subsong %d!",i+1);
           ds.unload();
-          delete[] file;
+          if (map==NULL) delete[] file;
           return false;
         }
 
@@ -1549,7 +1722,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
           logE("%d: invalid subsong header!",i);
           lastError="invalid subsong header!";
           ds.unload();
-          delete[] file;
+          if (map==NULL) delete[] file;
           return false;
         }
         reader.readI();
@@ -1621,89 +1794,29 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
       }
     }
 
-    // read instruments
-    ds.ins.reserve(ds.insLen);
+    // read pattern headers
+    // patterns are created here, and their data is read later along with the other blocks.
+    std::vector<FurBlockReadTask> blocks;
+    std::vector<FurBlockReadTask> dupPatBlocks;
+    std::vector<DivPattern*> seenPats;
+    blocks.reserve(ds.insLen+ds.waveLen+ds.sampleLen+patPtr.size());
     for (int i=0; i<ds.insLen; i++) {
-      DivInstrument* ins=new DivInstrument;
-      logD("reading instrument %d at %x...",i,insPtr[i]);
-      if (!reader.seek(insPtr[i],SEEK_SET)) {
-        logE("couldn't seek to instrument %d!",i);
-        lastError=fmt::sprintf("couldn't seek to instrument %d!",i);
-        ds.unload();
-        delete ins;
-        delete[] file;
-        return false;
-      }
-      
-      if (ins->readInsData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid instrument header/data!";
-        ds.unload();
-        delete ins;
-        delete[] file;
-        return false;
-      }
-
-      ds.ins.push_back(ins);
+      blocks.push_back(FurBlockReadTask(file,len,FUR_BLOCK_INS,insPtr[i],ds.version));
     }
-
-    // read wavetables
-    ds.wave.reserve(ds.waveLen);
     for (int i=0; i<ds.waveLen; i++) {
-      DivWavetable* wave=new DivWavetable;
-      logD("reading wavetable %d at %x...",i,wavePtr[i]);
-      if (!reader.seek(wavePtr[i],SEEK_SET)) {
-        logE("couldn't seek to wavetable %d!",i);
-        lastError=fmt::sprintf("couldn't seek to wavetable %d!",i);
-        ds.unload();
-        delete wave;
-        delete[] file;
-        return false;
-      }
-
-      if (wave->readWaveData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid wavetable header/data!";
-        ds.unload();
-        delete wave;
-        delete[] file;
-        return false;
-      }
-
-      ds.wave.push_back(wave);
+      blocks.push_back(FurBlockReadTask(file,len,FUR_BLOCK_WAVE,wavePtr[i],ds.version));
     }
-
-    // read samples
-    ds.sample.reserve(ds.sampleLen);
     for (int i=0; i<ds.sampleLen; i++) {
-      DivSample* sample=new DivSample;
-
-      if (!reader.seek(samplePtr[i],SEEK_SET)) {
-        logE("couldn't seek to sample %d!",i);
-        lastError=fmt::sprintf("couldn't seek to sample %d!",i);
-        ds.unload();
-        delete sample;
-        delete[] file;
-        return false;
-      }
-
-      if (sample->readSampleData(reader,ds.version)!=DIV_DATA_SUCCESS) {
-        lastError="invalid sample header/data!";
-        ds.unload();
-        delete sample;
-        delete[] file;
-        return false;
-      }
-
-      ds.sample.push_back(sample);
+      blocks.push_back(FurBlockReadTask(file,len,FUR_BLOCK_SAMPLE,samplePtr[i],ds.version));
+      blocks.back().map=map;
     }
-
-    // read patterns
     for (unsigned int i: patPtr) {
       bool isNewFormat=false;
       if (!reader.seek(i,SEEK_SET)) {
         logE("couldn't seek to pattern in %x!",i);
         lastError=fmt::sprintf("couldn't seek to pattern in %x!",i);
         ds.unload();
-        delete[] file;
+        if (map==NULL) delete[] file;
         return false;
       }
       reader.read(magic,4);
@@ -1713,7 +1826,7 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
           logE("%x: invalid pattern header!",i);
           lastError="invalid pattern header!";
           ds.unload();
-          delete[] file;
+          if (map==NULL) delete[] file;
           return false;
         } else {
           isNewFormat=true;
@@ -1721,93 +1834,18 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
       }
       reader.readI();
 
+      int subs=0;
+      int chan=0;
+      int index=0;
       if (isNewFormat) {
-        int subs=(unsigned char)reader.readC();
-        int chan=(unsigned char)reader.readC();
-        int index=reader.readS();
+        subs=(unsigned char)reader.readC();
+        chan=(unsigned char)reader.readC();
+        index=reader.readS();
 
         logD("- %d, %d, %d (new)",subs,chan,index);
-
-        if (chan<0 || chan>=tchans) {
-          logE("pattern channel out of range!",i);
-          lastError="pattern channel out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
-        }
-        if (index<0 || index>(DIV_MAX_PATTERNS-1)) {
-          logE("pattern index out of range!",i);
-          lastError="pattern index out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
-        }
-        if (subs<0 || subs>=(int)ds.subsong.size()) {
-          logE("pattern subsong out of range!",i);
-          lastError="pattern subsong out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
-        }
-
-        DivPattern* pat=ds.subsong[subs]->pat[chan].getPattern(index,true);
-        pat->name=reader.readString();
-
-        // read new pattern
-        for (int j=0; j<ds.subsong[subs]->patLen; j++) {
-          unsigned char mask=reader.readC();
-          unsigned short effectMask=0;
-
-          if (mask==0xff) break;
-          if (mask&128) {
-            j+=(mask&127)+1;
-            continue;
-          }
-
-          if (mask&32) {
-            effectMask|=(unsigned char)reader.readC();
-          }
-          if (mask&64) {
-            effectMask|=((unsigned short)reader.readC()&0xff)<<8;
-          }
-          if (mask&8) effectMask|=1;
-          if (mask&16) effectMask|=2;
-
-          if (mask&1) { // note
-            unsigned char note=reader.readC();
-            if (note==180) {
-              pat->data[j][0]=100;
-              pat->data[j][1]=0;
-            } else if (note==181) {
-              pat->data[j][0]=101;
-              pat->data[j][1]=0;
-            } else if (note==182) {
-              pat->data[j][0]=102;
-              pat->data[j][1]=0;
-            } else if (note<180) {
-              pat->data[j][0]=newFormatNotes[note];
-              pat->data[j][1]=newFormatOctaves[note];
-            } else {
-              pat->data[j][0]=0;
-              pat->data[j][1]=0;
-            }
-          }
-          if (mask&2) { // instrument
-            pat->data[j][2]=(unsigned char)reader.readC();
-          }
-          if (mask&4) { // volume
-            pat->data[j][3]=(unsigned char)reader.readC();
-          }
-          for (unsigned char k=0; k<16; k++) {
-            if (effectMask&(1<<k)) {
-              pat->data[j][4+k]=(unsigned char)reader.readC();
-            }
-          }
-        }
       } else {
-        int chan=reader.readS();
-        int index=reader.readS();
-        int subs=0;
+        chan=reader.readS();
+        index=reader.readS();
         if (ds.version>=95) {
           subs=reader.readS();
         } else {
@@ -1816,50 +1854,160 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
         reader.readS();
 
         logD("- %d, %d, %d (old)",subs,chan,index);
+      }
 
-        if (chan<0 || chan>=tchans) {
-          logE("pattern channel out of range!",i);
-          lastError="pattern channel out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
-        }
-        if (index<0 || index>(DIV_MAX_PATTERNS-1)) {
-          logE("pattern index out of range!",i);
-          lastError="pattern index out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
-        }
-        if (subs<0 || subs>=(int)ds.subsong.size()) {
-          logE("pattern subsong out of range!",i);
-          lastError="pattern subsong out of range!";
-          ds.unload();
-          delete[] file;
-          return false;
+      if (chan<0 || chan>=tchans) {
+        logE("pattern channel out of range!",i);
+        lastError="pattern channel out of range!";
+        ds.unload();
+        if (map==NULL) delete[] file;
+        return false;
+      }
+      if (index<0 || index>(DIV_MAX_PATTERNS-1)) {
+        logE("pattern index out of range!",i);
+        lastError="pattern index out of range!";
+        ds.unload();
+        if (map==NULL) delete[] file;
+        return false;
+      }
+      if (subs<0 || subs>=(int)ds.subsong.size()) {
+        logE("pattern subsong out of range!",i);
+        lastError="pattern subsong out of range!";
+        ds.unload();
+        if (map==NULL) delete[] file;
+        return false;
+      }
+
+      FurBlockReadTask block(file,len,FUR_BLOCK_PATTERN,reader.tell(),ds.version);
+      block.pat=ds.subsong[subs]->pat[chan].getPattern(index,true);
+      block.patLen=ds.subsong[subs]->patLen;
+      block.effectCols=ds.subsong[subs]->pat[chan].effectCols;
+      block.chan=chan;
+      block.newFormat=isNewFormat;
+
+      // the same pattern stored twice (shouldn't happen).
+      // read these afterwards and in order, so the result is the same.
+      bool isDup=false;
+      for (DivPattern* j: seenPats) {
+        if (j==block.pat) {
+          isDup=true;
+          break;
         }
+      }
+      if (isDup) {
+        dupPatBlocks.push_back(block);
+      } else {
+        seenPats.push_back(block.pat);
+        blocks.push_back(block);
+      }
+    }
 
-        DivPattern* pat=ds.subsong[subs]->pat[chan].getPattern(index,true);
-        for (int j=0; j<ds.subsong[subs]->patLen; j++) {
-          pat->data[j][0]=reader.readS();
-          pat->data[j][1]=reader.readS();
-          pat->data[j][2]=reader.readS();
-          pat->data[j][3]=reader.readS();
-          for (int k=0; k<ds.subsong[subs]->pat[chan].effectCols; k++) {
-            pat->data[j][4+(k<<1)]=reader.readS();
-            pat->data[j][5+(k<<1)]=reader.readS();
+    // read instruments, wavetables, samples and patterns
+    unsigned int loadThreads=std::thread::hardware_concurrency();
+    if (loadThreads>DIV_LOAD_MAX_THREADS) loadThreads=DIV_LOAD_MAX_THREADS;
+    if (loadThreads<2 || blocks.size()<2) loadThreads=0;
+    DivWorkPool* loadPool=new DivWorkPool(loadThreads);
+    for (FurBlockReadTask& i: blocks) {
+      loadPool->push(readFurBlock,&i);
+    }
+    loadPool->wait();
+    delete loadPool;
+    for (FurBlockReadTask& i: dupPatBlocks) {
+      readFurBlock(&i);
+      blocks.push_back(i);
+    }
+
+    // collect results in file order
+    ds.ins.reserve(ds.insLen);
+    ds.wave.reserve(ds.waveLen);
+    ds.sample.reserve(ds.sampleLen);
+    bool loadFailed=false;
+    bool loadEOF=false;
+    size_t blockIndex=0;
+    for (FurBlockReadTask& i: blocks) {
+      if (!loadFailed && !loadEOF) {
+        if (i.seekFailed) {
+          switch (i.type) {
+            case FUR_BLOCK_INS:
+              logE("couldn't seek to instrument %d!",(int)blockIndex);
+              lastError=fmt::sprintf("couldn't seek to instrument %d!",(int)blockIndex);
+              break;
+            case FUR_BLOCK_WAVE:
+              logE("couldn't seek to wavetable %d!",(int)(blockIndex-ds.insLen));
+              lastError=fmt::sprintf("couldn't seek to wavetable %d!",(int)(blockIndex-ds.insLen));
+              break;
+            case FUR_BLOCK_SAMPLE:
+              logE("couldn't seek to sample %d!",(int)(blockIndex-ds.insLen-ds.waveLen));
+              lastError=fmt::sprintf("couldn't seek to sample %d!",(int)(blockIndex-ds.insLen-ds.waveLen));
+              break;
+            case FUR_BLOCK_PATTERN:
+              logE("couldn't seek to pattern in %x!",i.ptr);
+              lastError=fmt::sprintf("couldn't seek to pattern in %x!",i.ptr);
+              break;
           }
-          if (pat->data[j][0]==0 && pat->data[j][1]!=0) {
-            logD("what? %d:%d:%d note %d octave %d",chan,i,j,pat->data[j][0],pat->data[j][1]);
-            pat->data[j][0]=12;
-            pat->data[j][1]--;
+          loadFailed=true;
+        } else if (i.eof) {
+          loadEOF=true;
+        } else if (i.error!=DIV_DATA_SUCCESS) {
+          switch (i.type) {
+            case FUR_BLOCK_INS:
+              lastError="invalid instrument header/data!";
+              break;
+            case FUR_BLOCK_WAVE:
+              lastError="invalid wavetable header/data!";
+              break;
+            case FUR_BLOCK_SAMPLE:
+              lastError="invalid sample header/data!";
+              break;
+            default:
+              break;
           }
+          loadFailed=true;
         }
+      }
 
-        if (ds.version>=51) {
-          pat->name=reader.readString();
+      if (loadFailed || loadEOF) {
+        // discard the rest
+        switch (i.type) {
+          case FUR_BLOCK_INS:
+            delete (DivInstrument*)i.result;
+            break;
+          case FUR_BLOCK_WAVE:
+            delete (DivWavetable*)i.result;
+            break;
+          case FUR_BLOCK_SAMPLE:
+            delete (DivSample*)i.result;
+            break;
+          default:
+            break;
         }
+      } else {
+        switch (i.type) {
+          case FUR_BLOCK_INS:
+            ds.ins.push_back((DivInstrument*)i.result);
+            break;
+          case FUR_BLOCK_WAVE:
+            ds.wave.push_back((DivWavetable*)i.result);
+            break;
+          case FUR_BLOCK_SAMPLE:
+            ds.sample.push_back((DivSample*)i.result);
+            break;
+          default:
+            break;
+        }
+        reader.seek(i.end,SEEK_SET);
       }
+      blockIndex++;
+    }
+
+    if (loadFailed) {
+      ds.unload();
+      if (map==NULL) delete[] file;
+      return false;
+    }
+    if (loadEOF) {
+      ds.unload();
+      throw EndOfFileException(&reader,reader.size());
     }
 
     if (reader.tell()<reader.size()) {
@@ -2112,6 +2260,8 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
     }
 
 
+    ds.sharePatterns();
+
     if (active) quitDispatch();
     BUSY_BEGIN_SOFT;
     saveLock.lock();
@@ -2131,10 +2281,10 @@ bool DivEngine::loadFur(unsigned char* file, size_t len, int variantID) {
   } catch (EndOfFileException& e) {
     logE("premature end of file!");
     lastError="incomplete file";
-    delete[] file;
+    if (map==NULL) delete[] file;
     return false;
   }
-  delete[] file;
+  if (map==NULL) delete[] file;
   return true;
 }
 
@@ -2579,14 +2729,19 @@ SafeWriter* DivEngine::saveFur(bool notPrimary, bool newPatternFormat) {
   samplePtr.reserve(song.sampleLen);
   for (int i=0; i<song.sampleLen; i++) {
     DivSample* sample=song.sample[i];
+    // large samples are placed on a page boundary, so that they can be mapped
+    size_t padding=sample->getMapPadding(w->tell());
+    for (size_t j=0; j<padding; j++) {
+      w->writeC(0);
+    }
     samplePtr.push_back(w->tell());
-    sample->putSampleData(w);
+    sample->putSampleData(w,true);
   }
 
   /// PATTERN
   patPtr.reserve(patsToWrite.size());
   for (PatToWrite& i: patsToWrite) {
-    DivPattern* pat=song.subsong[i.subsong]->pat[i.chan].getPattern(i.pat,false);
+    const DivPattern* pat=song.subsong[i.subsong]->pat[i.chan].getPattern(i.pat,false);
     patPtr.push_back(w->tell());
 
     if (newPatternFormat) {
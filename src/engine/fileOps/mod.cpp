@@ -256,7 +256,7 @@ bool DivEngine::loadMod(unsigned char* file, size_t len) {
     for (int ch=0; ch<=chCount; ch++) {
       unsigned char fxCols=1;
       for (int pat=0; pat<=patMax; pat++) {
-        auto* data=ds.subsong[0]->pat[ch].getPattern(pat,true)->data;
+        DivPatternData& data=ds.subsong[0]->pat[ch].getPattern(pat,true)->data;
         short lastPitchEffect=-1;
         short lastEffectState[5]={-1,-1,-1,-1,-1};
         short setEffectState[5]={-1,-1,-1,-1,-1};
@@ -266,7 +266,7 @@ bool DivEngine::loadMod(unsigned char* file, size_t len) {
           unsigned char curFxCol=0;
           short fxTyp=data[row][4];
           short fxVal=data[row][5];
-          auto writeFxCol=[data,row,&curFxCol](short typ, short val) {
+          auto writeFxCol=[&data,row,&curFxCol](short typ, short val) {
             data[row][4+curFxCol*2]=typ;
             data[row][5+curFxCol*2]=val;
             curFxCol++;
@@ -394,7 +394,7 @@ void DivEngine::loadDMP(SafeReader& reader, std::vector<DivInstrument*>& ret, St
             ins->std.algMacro.val[j]=-(ins->std.volMacro.val[j]-18);
           }
           ins->std.volMacro.len=0;
-          memset(ins->std.volMacro.val,0,256*sizeof(int));
+          ins->std.volMacro.val.clear();
         }
         for (int j=0; j<ins->std.dutyMacro.len; j++) {
           ins->std.dutyMacro.val[j]-=12;
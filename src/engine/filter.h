@@ -17,13 +17,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+// all tables are interleaved by phase: the taps for one phase are
+// contiguous, so a SIMD kernel can load them with a single aligned read.
 class DivFilterTables {
   public:
-    static float* cubicTable;
-    static float* sincTable;
-    static float* sincTable8;
-    static float* sincIntegralTable;
-    static float* sincIntegralSmallTable;
+    /**
+     * build all filter tables.
+     * this is thread-safe and only does work on the first call.
+     * the engine calls it during init so that playback and sample previews
+     * do not pay for table generation.
+     */
+    static void init();
 
     /**
      * get a 1024x4 cubic spline table.
@@ -54,4 +58,4 @@ class DivFilterTables {
      * @return the table.
      */
     static float* getSincIntegralSmallTable();
-};
\ No newline at end of file
+};
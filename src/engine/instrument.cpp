@@ -22,6 +22,7 @@
 #include "instrument.h"
 #include "../ta-log.h"
 #include "../fileutils.h"
+#include <mutex>
 
 const DivInstrument defaultIns;
 
@@ -306,6 +307,177 @@ DivInstrumentMacro* DivInstrumentSTD::macroByType(DivMacroType type) {
 
 #undef CONSIDER
 
+static DivInstrumentMacro DivInstrumentSTD::* const stdMacros[20]={
+  &DivInstrumentSTD::volMacro,
+  &DivInstrumentSTD::arpMacro,
+  &DivInstrumentSTD::dutyMacro,
+  &DivInstrumentSTD::waveMacro,
+  &DivInstrumentSTD::pitchMacro,
+  &DivInstrumentSTD::ex1Macro,
+  &DivInstrumentSTD::ex2Macro,
+  &DivInstrumentSTD::ex3Macro,
+  &DivInstrumentSTD::algMacro,
+  &DivInstrumentSTD::fbMacro,
+  &DivInstrumentSTD::fmsMacro,
+  &DivInstrumentSTD::amsMacro,
+  &DivInstrumentSTD::panLMacro,
+  &DivInstrumentSTD::panRMacro,
+  &DivInstrumentSTD::phaseResetMacro,
+  &DivInstrumentSTD::ex4Macro,
+  &DivInstrumentSTD::ex5Macro,
+  &DivInstrumentSTD::ex6Macro,
+  &DivInstrumentSTD::ex7Macro,
+  &DivInstrumentSTD::ex8Macro
+};
+
+static DivInstrumentMacro DivInstrumentSTD::OpMacro::* const opMacroList[20]={
+  &DivInstrumentSTD::OpMacro::amMacro,
+  &DivInstrumentSTD::OpMacro::arMacro,
+  &DivInstrumentSTD::OpMacro::drMacro,
+  &DivInstrumentSTD::OpMacro::multMacro,
+  &DivInstrumentSTD::OpMacro::rrMacro,
+  &DivInstrumentSTD::OpMacro::slMacro,
+  &DivInstrumentSTD::OpMacro::tlMacro,
+  &DivInstrumentSTD::OpMacro::dt2Macro,
+  &DivInstrumentSTD::OpMacro::rsMacro,
+  &DivInstrumentSTD::OpMacro::dtMacro,
+  &DivInstrumentSTD::OpMacro::d2rMacro,
+  &DivInstrumentSTD::OpMacro::ssgMacro,
+  &DivInstrumentSTD::OpMacro::damMacro,
+  &DivInstrumentSTD::OpMacro::dvbMacro,
+  &DivInstrumentSTD::OpMacro::egtMacro,
+  &DivInstrumentSTD::OpMacro::kslMacro,
+  &DivInstrumentSTD::OpMacro::susMacro,
+  &DivInstrumentSTD::OpMacro::vibMacro,
+  &DivInstrumentSTD::OpMacro::wsMacro,
+  &DivInstrumentSTD::OpMacro::ksrMacro
+};
+
+DivInstrumentMacro* DivInstrumentSTD::macroByIndex(int index) {
+  if (index<0 || index>=DIV_INS_MACRO_COUNT) return NULL;
+  if (index<20) return &(this->*stdMacros[index]);
+  index-=20;
+  return &(opMacros[index/20].*opMacroList[index%20]);
+}
+
+const DivInstrumentMacro* DivInstrumentSTD::macroByIndex(int index) const {
+  if (index<0 || index>=DIV_INS_MACRO_COUNT) return NULL;
+  if (index<20) return &(this->*stdMacros[index]);
+  index-=20;
+  return &(opMacros[index/20].*opMacroList[index%20]);
+}
+
+// blocks which were replaced. the audio thread may still be reading one of
+// them, so they are only freed by freeRetired().
+static std::mutex retiredMacroLock;
+static std::vector<int*> retiredMacroBlocks;
+
+static void retireMacroBlock(int* b) {
+  if (b==NULL) return;
+  std::lock_guard<std::mutex> lock(retiredMacroLock);
+  retiredMacroBlocks.push_back(b);
+}
+
+void DivInstrumentMacroValues::freeRetired(bool (*canFree)(void*), void* data) {
+  std::vector<int*> toFree;
+  retiredMacroLock.lock();
+  toFree.swap(retiredMacroBlocks);
+  retiredMacroLock.unlock();
+  if (toFree.empty()) return;
+  // only ask after taking the list, so that everything in it was retired before
+  if (canFree!=NULL && !canFree(data)) {
+    std::lock_guard<std::mutex> lock(retiredMacroLock);
+    retiredMacroBlocks.insert(retiredMacroBlocks.end(),toFree.begin(),toFree.end());
+    return;
+  }
+  for (int* i: toFree) {
+    delete[] i;
+  }
+}
+
+int* DivInstrumentMacroValues::grow(int size) {
+  int* old=block.load(std::memory_order_acquire);
+  int cap=(old==NULL)?0:old[0];
+  if (size>256) size=256;
+  if (size<=cap) return old;
+  int newCap=(size+15)&(~15);
+  if (newCap<cap*2) newCap=cap*2;
+  if (newCap>256) newCap=256;
+
+  int* newBlock=new int[1+newCap];
+  newBlock[0]=newCap;
+  if (cap>0) memcpy(&newBlock[1],&old[1],cap*sizeof(int));
+  memset(&newBlock[1+cap],0,(newCap-cap)*sizeof(int));
+
+  block.store(newBlock,std::memory_order_release);
+  retireMacroBlock(old);
+  return newBlock;
+}
+
+int* DivInstrumentMacroValues::expand() {
+  return &grow(256)[1];
+}
+
+void DivInstrumentMacroValues::copyTo(int* dest, int count) const {
+  const int* b=block.load(std::memory_order_acquire);
+  int cap=(b==NULL)?0:MIN(b[0],count);
+  if (cap>0) memcpy(dest,&b[1],cap*sizeof(int));
+  if (count>cap) memset(&dest[cap],0,(count-cap)*sizeof(int));
+}
+
+bool DivInstrumentMacroValues::equals(const DivInstrumentMacroValues& other) const {
+  const int* a=block.load(std::memory_order_acquire);
+  const int* b=other.block.load(std::memory_order_acquire);
+  int capA=(a==NULL)?0:a[0];
+  int capB=(b==NULL)?0:b[0];
+  int common=MIN(capA,capB);
+  if (common>0) {
+    if (memcmp(&a[1],&b[1],common*sizeof(int))!=0) return false;
+  }
+  for (int i=common; i<capA; i++) {
+    if (a[1+i]!=0) return false;
+  }
+  for (int i=common; i<capB; i++) {
+    if (b[1+i]!=0) return false;
+  }
+  return true;
+}
+
+void DivInstrumentMacroValues::swap(DivInstrumentMacroValues& other) {
+  int* temp=block.load(std::memory_order_acquire);
+  block.store(other.block.exchange(temp,std::memory_order_acq_rel),std::memory_order_release);
+}
+
+void DivInstrumentMacroValues::clear() {
+  retireMacroBlock(block.exchange(NULL,std::memory_order_acq_rel));
+}
+
+DivInstrumentMacroValues& DivInstrumentMacroValues::operator=(const DivInstrumentMacroValues& other) {
+  if (this==&other) return *this;
+  const int* src=other.block.load(std::memory_order_acquire);
+  int srcCap=(src==NULL)?0:src[0];
+  // reuse storage if possible
+  int* dest=grow(srcCap);
+  if (dest==NULL) return *this;
+  if (srcCap>0) memcpy(&dest[1],&src[1],srcCap*sizeof(int));
+  if (dest[0]>srcCap) memset(&dest[1+srcCap],0,(dest[0]-srcCap)*sizeof(int));
+  return *this;
+}
+
+DivInstrumentMacroValues::DivInstrumentMacroValues(const DivInstrumentMacroValues& other):
+  block(NULL) {
+  const int* src=other.block.load(std::memory_order_acquire);
+  if (src!=NULL && src[0]>0) {
+    int* newBlock=new int[1+src[0]];
+    memcpy(newBlock,src,(1+src[0])*sizeof(int));
+    block.store(newBlock,std::memory_order_relaxed);
+  }
+}
+
+DivInstrumentMacroValues::~DivInstrumentMacroValues() {
+  clear();
+}
+
 #define FEATURE_BEGIN(x) \
   w->write(x,2); \
   size_t featStartSeek=w->tell(); \
@@ -367,7 +539,7 @@ void DivInstrument::writeFeatureFM(SafeWriter* w, bool fui) {
   FEATURE_END;
 }
 
-bool MemPatch::calcDiff(const void* pre, const void* post, size_t inputSize) {
+bool MemPatch::calcDiff(const void* pre, const void* post, size_t inputSize, const unsigned char* ignore) {
   bool diffValid=false;
   size_t firstDiff=0;
   size_t lastDiff=0;
@@ -378,6 +550,7 @@ bool MemPatch::calcDiff(const void* pre, const void* post, size_t inputSize) {
   // for the common case, which is no change
   for (size_t ii=0; ii<inputSize; ++ii) {
     if (preBytes[ii] != postBytes[ii]) {
+      if (ignore!=NULL && ignore[ii]) continue;
       lastDiff=ii;
       firstDiff=diffValid ? firstDiff : ii;
       diffValid=true;
@@ -397,7 +570,7 @@ bool MemPatch::calcDiff(const void* pre, const void* post, size_t inputSize) {
   return diffValid;
 }
 
-void MemPatch::applyAndReverse(void* target, size_t targetSize) {
+void MemPatch::applyAndReverse(void* target, size_t targetSize, const unsigned char* ignore) {
   if (size==0) return;
   if (offset+size>targetSize) {
     logW("MemPatch (offset %d, size %d) exceeds target size (%d), can't apply!",offset,size,targetSize);
@@ -408,30 +581,56 @@ void MemPatch::applyAndReverse(void* target, size_t targetSize) {
 
   // swap this->data and its segment on target
   for (size_t ii=0; ii<size; ++ii) {
+    if (ignore!=NULL && ignore[offset+ii]) continue;
     unsigned char tmp=targetBytes[offset+ii];
     targetBytes[offset+ii] = data[ii];
     data[ii] = tmp;
   }
 }
 
+// the storage of macro values (pointers) must not be diffed/patched
+static const unsigned char* getPODIgnoreMask() {
+  static std::vector<unsigned char> mask;
+  static std::once_flag maskInit;
+  std::call_once(maskInit,[]() {
+    DivInstrumentPOD* pod=new DivInstrumentPOD;
+    mask.resize(sizeof(DivInstrumentPOD),0);
+    for (int i=0; i<DIV_INS_MACRO_COUNT; i++) {
+      size_t off=(const unsigned char*)&pod->std.macroByIndex(i)->val-(const unsigned char*)pod;
+      memset(&mask[off],1,sizeof(DivInstrumentMacroValues));
+    }
+    delete pod;
+  });
+  return mask.data();
+}
+
 void DivInstrumentUndoStep::applyAndReverse(DivInstrument* target) {
   if (nameValid) {
     name.swap(target->name);
   }
-  podPatch.applyAndReverse((DivInstrumentPOD*)target, sizeof(DivInstrumentPOD));
+  podPatch.applyAndReverse((DivInstrumentPOD*)target, sizeof(DivInstrumentPOD), getPODIgnoreMask());
+  for (std::pair<int,DivInstrumentMacroValues>& i: macroPatch) {
+    target->std.macroByIndex(i.first)->val.swap(i.second);
+  }
 }
 
 bool DivInstrumentUndoStep::makeUndoPatch(size_t processTime_, const DivInstrument* pre, const DivInstrument* post) {
   processTime=processTime_;
 
   // create the patch that will make post into pre
-  podPatch.calcDiff((const DivInstrumentPOD*)post, (const DivInstrumentPOD*)pre, sizeof(DivInstrumentPOD));
+  podPatch.calcDiff((const DivInstrumentPOD*)post, (const DivInstrumentPOD*)pre, sizeof(DivInstrumentPOD), getPODIgnoreMask());
   if (pre->name!=post->name) {
     nameValid=true;
     name=pre->name;
   }
+  for (int i=0; i<DIV_INS_MACRO_COUNT; i++) {
+    const DivInstrumentMacroValues& preVal=pre->std.macroByIndex(i)->val;
+    if (!preVal.equals(post->std.macroByIndex(i)->val)) {
+      macroPatch.push_back(std::pair<int,DivInstrumentMacroValues>(i,preVal));
+    }
+  }
 
-  return nameValid || podPatch.isValid();
+  return nameValid || podPatch.isValid() || !macroPatch.empty();
 }
 
 bool DivInstrument::recordUndoStepIfChanged(size_t processTime, const DivInstrument* old) {
@@ -2433,7 +2632,7 @@ DivDataErrors DivInstrument::readInsDataNew(SafeReader& reader, short version, b
 
   // <187 C64 cutoff macro compatibility
   if (type==DIV_INS_C64 && volIsCutoff && version<187) {
-    memcpy(&std.algMacro,&std.volMacro,sizeof(DivInstrumentMacro));
+    std.algMacro=std.volMacro;
     std.algMacro.macroType=DIV_MACRO_ALG;
     std.volMacro=DivInstrumentMacro(DIV_MACRO_VOL,true);
 
@@ -3192,7 +3391,7 @@ DivDataErrors DivInstrument::readInsDataOld(SafeReader &reader, short version) {
 
   // <187 C64 cutoff macro compatibility
   if (type==DIV_INS_C64 && volIsCutoff && version<187) {
-    memcpy(&std.algMacro,&std.volMacro,sizeof(DivInstrumentMacro));
+    std.algMacro=std.volMacro;
     std.algMacro.macroType=DIV_MACRO_ALG;
     std.volMacro=DivInstrumentMacro(DIV_MACRO_VOL,true);
 
@@ -24,6 +24,7 @@
 #include "../ta-utils.h"
 #include "../pch.h"
 #include "../fixedQueue.h"
+#include <atomic>
 
 struct DivSong;
 struct DivInstrument;
@@ -255,19 +256,94 @@ struct DivInstrumentFM {
   }
 };
 
+// storage for macro values.
+// only the entries which have been written to are allocated, and reading past
+// them returns 0. reading through a const reference never allocates.
+// the size and the values live in one block (block[0] is the number of
+// entries) which is swapped atomically, so the audio thread always sees a
+// consistent pair. replaced blocks are freed by freeRetired() once no engine
+// is reading a song.
+class DivInstrumentMacroValues {
+  std::atomic<int*> block;
+
+  int* grow(int size);
+
+  public:
+    inline int operator[](int i) const {
+      const int* b=block.load(std::memory_order_acquire);
+      if (b==NULL || (unsigned int)i>=(unsigned int)b[0]) return 0;
+      return b[1+i];
+    }
+
+    inline int& operator[](int i) {
+      int* b=block.load(std::memory_order_acquire);
+      if (b==NULL || (unsigned int)i>=(unsigned int)b[0]) b=grow(i+1);
+      return b[1+i];
+    }
+
+    /**
+     * allocate all 256 entries.
+     * @return a pointer to them, for editors.
+     */
+    int* expand();
+
+    /**
+     * copy values without allocating anything.
+     * @param dest the destination.
+     * @param count number of entries to copy.
+     */
+    void copyTo(int* dest, int count) const;
+
+    /**
+     * compare with other values (unallocated entries count as 0).
+     */
+    bool equals(const DivInstrumentMacroValues& other) const;
+
+    /**
+     * exchange storage with other values.
+     */
+    void swap(DivInstrumentMacroValues& other);
+
+    /**
+     * set all entries to 0 and release memory.
+     */
+    void clear();
+
+    /**
+     * get the number of allocated entries.
+     */
+    int size() const {
+      const int* b=block.load(std::memory_order_acquire);
+      return (b==NULL)?0:b[0];
+    }
+
+    /**
+     * free storage which was replaced or released.
+     * the list is shared by all engines, so the caller must make sure none of them is reading a song.
+     * @param canFree called after taking the list. if it returns false, the storage is kept for later.
+     * @param data passed to canFree.
+     * @warning only call this while the audio thread is not running (e.g. with isBusy held).
+     */
+    static void freeRetired(bool (*canFree)(void*)=NULL, void* data=NULL);
+
+    DivInstrumentMacroValues& operator=(const DivInstrumentMacroValues& other);
+    DivInstrumentMacroValues(const DivInstrumentMacroValues& other);
+    DivInstrumentMacroValues():
+      block(NULL) {}
+    ~DivInstrumentMacroValues();
+};
+
 // this is getting out of hand
 struct DivInstrumentMacro {
-  int val[256];
+  DivInstrumentMacroValues val;
   unsigned int mode;
   unsigned char open;
   unsigned char len, delay, speed, loop, rel;
   // 0-31: normal
   // 32+: operator (top 3 bits select operator, starting from 1)
   unsigned char macroType;
-  
-  // the following variables are used by the GUI and not saved in the file
-  int vScroll, vZoom;
-  int typeMemory[16];
+
+  // length of the sequence while in ADSR/LFO mode (and vice versa)
   unsigned char lenMemory;
 
   explicit DivInstrumentMacro(unsigned char initType, bool initOpen=false):
@@ -279,14 +355,13 @@ struct DivInstrumentMacro {
     loop(255),
     rel(255),
     macroType(initType),
-    vScroll(0),
-    vZoom(-1),
     lenMemory(0) {
-    memset(val,0,256*sizeof(int));
-    memset(typeMemory,0,16*sizeof(int));
   }
 };
 
+// 20 macros plus 20 per operator
+#define DIV_INS_MACRO_COUNT 100
+
 struct DivInstrumentSTD {
   DivInstrumentMacro volMacro;
   DivInstrumentMacro arpMacro;
@@ -341,6 +416,12 @@ struct DivInstrumentSTD {
 
   DivInstrumentMacro* macroByType(DivMacroType type);
 
+  /**
+   * get a macro by index (0 to DIV_INS_MACRO_COUNT-1), including operator macros.
+   */
+  DivInstrumentMacro* macroByIndex(int index);
+  const DivInstrumentMacro* macroByIndex(int index) const;
+
   DivInstrumentSTD():
     volMacro(DIV_MACRO_VOL,true),
     arpMacro(DIV_MACRO_ARP),
@@ -907,8 +988,9 @@ struct MemPatch {
     }
   }
 
-  bool calcDiff(const void* pre, const void* post, size_t size);
-  void applyAndReverse(void* target, size_t inputSize);
+  // ignore (optional): bytes which are non-zero in it are not compared or patched
+  bool calcDiff(const void* pre, const void* post, size_t size, const unsigned char* ignore=NULL);
+  void applyAndReverse(void* target, size_t inputSize, const unsigned char* ignore=NULL);
   bool isValid() const { return size>0; }
 
   unsigned char* data;
@@ -924,6 +1006,8 @@ struct DivInstrumentUndoStep {
   }
 
   MemPatch podPatch;
+  // macro values live outside of the POD, so they're saved separately
+  std::vector<std::pair<int,DivInstrumentMacroValues>> macroPatch;
   String name;
   bool nameValid;
   size_t processTime;
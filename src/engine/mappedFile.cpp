@@ -0,0 +1,153 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "mappedFile.h"
+#include "../ta-log.h"
+#ifdef _WIN32
+#include "../utfutils.h"
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+DivMappedFile::DivMappedFile():
+  refs(1),
+  data(NULL),
+  len(0)
+#ifdef _WIN32
+  ,fileHandle(NULL),
+  mapHandle(NULL)
+#endif
+  {}
+
+DivMappedFile::~DivMappedFile() {
+#ifdef _WIN32
+  if (data!=NULL) UnmapViewOfFile(data);
+  if (mapHandle!=NULL) CloseHandle((HANDLE)mapHandle);
+  if (fileHandle!=NULL) CloseHandle((HANDLE)fileHandle);
+#else
+  if (data!=NULL) munmap(data,len);
+#endif
+  data=NULL;
+}
+
+DivMappedFile* DivMappedFile::open(const char* path) {
+  DivMappedFile* ret=new DivMappedFile;
+  ret->path=path;
+#ifdef _WIN32
+  WString widePath=utf8To16(path);
+  HANDLE f=CreateFileW(widePath.c_str(),GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+  if (f==INVALID_HANDLE_VALUE) {
+    logW("could not open %s for mapping!",path);
+    delete ret;
+    return NULL;
+  }
+  ret->fileHandle=f;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(f,&fileSize) || fileSize.QuadPart<1) {
+    delete ret;
+    return NULL;
+  }
+  ret->len=fileSize.QuadPart;
+  HANDLE m=CreateFileMappingW(f,NULL,PAGE_WRITECOPY,0,0,NULL);
+  if (m==NULL) {
+    logW("could not create mapping of %s!",path);
+    delete ret;
+    return NULL;
+  }
+  ret->mapHandle=m;
+  ret->data=(unsigned char*)MapViewOfFile(m,FILE_MAP_COPY,0,0,0);
+  if (ret->data==NULL) {
+    logW("could not map %s!",path);
+    delete ret;
+    return NULL;
+  }
+#else
+  int fd=::open(path,O_RDONLY);
+  if (fd<0) {
+    logW("could not open %s for mapping! (%s)",path,strerror(errno));
+    delete ret;
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd,&st)!=0 || st.st_size<1) {
+    close(fd);
+    delete ret;
+    return NULL;
+  }
+  ret->len=st.st_size;
+  void* addr=mmap(NULL,ret->len,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (addr==MAP_FAILED) {
+    logW("could not map %s! (%s)",path,strerror(errno));
+    delete ret;
+    return NULL;
+  }
+  ret->data=(unsigned char*)addr;
+#endif
+  return ret;
+}
+
+unsigned char* DivMappedFile::getData() {
+  return data;
+}
+
+size_t DivMappedFile::size() {
+  return len;
+}
+
+bool DivMappedFile::isFile(const char* p) {
+  if (path==p) return true;
+#ifndef _WIN32
+  struct stat st0, st1;
+  if (stat(path.c_str(),&st0)!=0) return false;
+  if (stat(p,&st1)!=0) return false;
+  return (st0.st_dev==st1.st_dev && st0.st_ino==st1.st_ino);
+#else
+  // compare volume serial number and file index (the Windows equivalent of device and inode)
+  if (fileHandle==NULL) return false;
+  BY_HANDLE_FILE_INFORMATION info0, info1;
+  if (!GetFileInformationByHandle((HANDLE)fileHandle,&info0)) return false;
+  WString widePath=utf8To16(p);
+  HANDLE f=CreateFileW(widePath.c_str(),FILE_READ_ATTRIBUTES,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+  if (f==INVALID_HANDLE_VALUE) return false;
+  bool ok=GetFileInformationByHandle(f,&info1);
+  CloseHandle(f);
+  if (!ok) return false;
+  return (info0.dwVolumeSerialNumber==info1.dwVolumeSerialNumber &&
+          info0.nFileIndexHigh==info1.nFileIndexHigh &&
+          info0.nFileIndexLow==info1.nFileIndexLow);
+#endif
+}
+
+void DivMappedFile::ref() {
+  refs++;
+}
+
+void DivMappedFile::unref() {
+  if (--refs==0) {
+    delete this;
+  }
+}
@@ -0,0 +1,67 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _MAPPEDFILE_H
+#define _MAPPEDFILE_H
+
+#include "../ta-utils.h"
+#include <atomic>
+
+/**
+ * a file mapped into memory (privately - writes do not reach the file).
+ * reference counted, since several samples may point into the same file.
+ */
+class DivMappedFile {
+  std::atomic<int> refs;
+  unsigned char* data;
+  size_t len;
+  String path;
+#ifdef _WIN32
+  void* fileHandle;
+  void* mapHandle;
+#endif
+
+  DivMappedFile();
+  ~DivMappedFile();
+  public:
+    /**
+     * map a file.
+     * @param path the file path.
+     * @return a DivMappedFile with one reference, or NULL on error.
+     */
+    static DivMappedFile* open(const char* path);
+
+    unsigned char* getData();
+    size_t size();
+
+    /**
+     * check whether this is the file at the specified path.
+     */
+    bool isFile(const char* p);
+
+    void ref();
+
+    /**
+     * drop a reference. the file is unmapped when the last one is gone.
+     */
+    void unref();
+};
+
+#endif
@@ -19,9 +19,150 @@
 
 #include "engine.h"
 #include "../ta-log.h"
+#include <mutex>
+
+// chunks which are no longer referenced. the audio thread may still be
+// reading one of them, so they are only freed by freeRetired().
+static std::mutex retiredLock;
+static std::vector<DivPatternChunk*> retiredChunks;
 
 static DivPattern emptyPat;
 
+const short DivPatternData::emptyRow[DIV_MAX_COLS]={
+  0, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static void releaseChunk(DivPatternChunk* c) {
+  if (c==NULL) return;
+  if (c->refs.fetch_sub(1,std::memory_order_acq_rel)==1) {
+    std::lock_guard<std::mutex> lock(retiredLock);
+    retiredChunks.push_back(c);
+  }
+}
+
+void DivPatternData::freeRetired(bool (*canFree)(void*), void* data) {
+  std::vector<DivPatternChunk*> toFree;
+  retiredLock.lock();
+  toFree.swap(retiredChunks);
+  retiredLock.unlock();
+  if (toFree.empty()) return;
+  // only ask after taking the list, so that everything in it was retired before
+  if (canFree!=NULL && !canFree(data)) {
+    std::lock_guard<std::mutex> lock(retiredLock);
+    retiredChunks.insert(retiredChunks.end(),toFree.begin(),toFree.end());
+    return;
+  }
+  for (DivPatternChunk* i: toFree) {
+    delete i;
+  }
+}
+
+static bool isChunkEmpty(const DivPatternChunk* c) {
+  for (int i=0; i<DIV_PATTERN_CHUNK_ROWS; i++) {
+    if (memcmp(c->data[i],DivPatternData::emptyRow,sizeof(DivPatternData::emptyRow))!=0) return false;
+  }
+  return true;
+}
+
+DivPatternChunk* DivPatternData::makeWritable(int index) {
+  while (true) {
+    DivPatternChunk* old=chunks[index].load(std::memory_order_acquire);
+    if (old!=NULL && old->refs.load(std::memory_order_acquire)==1) return old;
+
+    DivPatternChunk* c=new DivPatternChunk;
+    if (old==NULL) {
+      for (int i=0; i<DIV_PATTERN_CHUNK_ROWS; i++) {
+        memcpy(c->data[i],emptyRow,sizeof(emptyRow));
+      }
+    } else {
+      memcpy(c->data,old->data,sizeof(c->data));
+    }
+
+    // another thread may have done this already
+    if (chunks[index].compare_exchange_strong(old,c,std::memory_order_acq_rel)) {
+      releaseChunk(old);
+      return c;
+    }
+    delete c;
+  }
+}
+
+DivPatternChunk* DivPatternData::getChunk(int index) const {
+  return chunks[index].load(std::memory_order_acquire);
+}
+
+void DivPatternData::setChunk(int index, DivPatternChunk* c) {
+  if (c!=NULL) c->refs.fetch_add(1,std::memory_order_relaxed);
+  releaseChunk(chunks[index].exchange(c,std::memory_order_acq_rel));
+}
+
+void DivPatternData::clear() {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    setChunk(i,NULL);
+  }
+}
+
+void DivPatternData::compact() {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    DivPatternChunk* c=getChunk(i);
+    if (c==NULL) continue;
+    if (isChunkEmpty(c)) setChunk(i,NULL);
+  }
+}
+
+bool DivPatternData::equals(const DivPatternData& other) const {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    const DivPatternChunk* a=getChunk(i);
+    const DivPatternChunk* b=other.getChunk(i);
+    if (a==b) continue;
+    if (a==NULL) {
+      if (!isChunkEmpty(b)) return false;
+    } else if (b==NULL) {
+      if (!isChunkEmpty(a)) return false;
+    } else if (memcmp(a->data,b->data,sizeof(a->data))!=0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t DivPatternData::getMemoryUsage() const {
+  size_t ret=0;
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    if (getChunk(i)!=NULL) ret+=sizeof(DivPatternChunk);
+  }
+  return ret;
+}
+
+DivPatternData& DivPatternData::operator=(const DivPatternData& other) {
+  if (this==&other) return *this;
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    setChunk(i,other.getChunk(i));
+  }
+  return *this;
+}
+
+DivPatternData::DivPatternData(const DivPatternData& other) {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    DivPatternChunk* c=other.getChunk(i);
+    if (c!=NULL) c->refs.fetch_add(1,std::memory_order_relaxed);
+    chunks[i].store(c,std::memory_order_relaxed);
+  }
+}
+
+DivPatternData::DivPatternData() {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    chunks[i].store(NULL,std::memory_order_relaxed);
+  }
+}
+
+DivPatternData::~DivPatternData() {
+  for (int i=0; i<DIV_PATTERN_CHUNKS; i++) {
+    releaseChunk(chunks[i].load(std::memory_order_relaxed));
+  }
+}
+
 DivPattern::DivPattern() {
   clear();
 }
@@ -45,7 +186,7 @@ std::vector<std::pair<int,int>> DivChannelData::optimize() {
       for (int j=0; j<DIV_MAX_PATTERNS; j++) {
         if (j==i) continue;
         if (data[j]==NULL) continue;
-        if (memcmp(data[i]->data,data[j]->data,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short))==0) {
+        if (data[i]->data.equals(data[j]->data)) {
           delete data[j];
           data[j]=NULL;
           logV("%d == %d",i,j);
@@ -86,15 +227,11 @@ void DivChannelData::wipePatterns() {
 
 void DivPattern::copyOn(DivPattern* dest) {
   dest->name=name;
-  memcpy(dest->data,data,sizeof(data));
+  dest->data=data;
 }
 
 void DivPattern::clear() {
-  memset(data,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
-  for (int i=0; i<DIV_MAX_ROWS; i++) {
-    data[i][0]=0;
-    data[i][1]=0;
-  }
+  data.clear();
 }
 
 DivChannelData::DivChannelData():
@@ -19,10 +19,99 @@
 
 #include "safeReader.h"
 #include "../pch.h"
+#include <atomic>
+
+#define DIV_PATTERN_CHUNK_ROWS 64
+#define DIV_PATTERN_CHUNKS (DIV_MAX_ROWS/DIV_PATTERN_CHUNK_ROWS)
+
+// a block of rows which may be shared between several patterns.
+struct DivPatternChunk {
+  std::atomic<int> refs;
+  short data[DIV_PATTERN_CHUNK_ROWS][DIV_MAX_COLS];
+  DivPatternChunk():
+    refs(1) {}
+};
+
+// pattern storage, accessed as data[ROW][TYPE].
+// rows are stored in chunks which are only allocated once written to. a chunk which
+// is not allocated reads as empty rows.
+// chunks are copy-on-write: copying pattern data only shares them, and writing
+// to a shared chunk makes a private copy first.
+// reading through a const reference never allocates, so use that if you're not
+// going to modify the pattern.
+// released chunks are not freed right away (an audio thread may be reading
+// them). they are freed by freeRetired() once no engine is reading a song.
+class DivPatternData {
+  std::atomic<DivPatternChunk*> chunks[DIV_PATTERN_CHUNKS];
+
+  DivPatternChunk* makeWritable(int index);
+
+  public:
+    static const short emptyRow[DIV_MAX_COLS];
+
+    inline const short* operator[](int row) const {
+      DivPatternChunk* c=chunks[row/DIV_PATTERN_CHUNK_ROWS].load(std::memory_order_acquire);
+      if (c==NULL) return emptyRow;
+      return c->data[row%DIV_PATTERN_CHUNK_ROWS];
+    }
+
+    inline short* operator[](int row) {
+      DivPatternChunk* c=chunks[row/DIV_PATTERN_CHUNK_ROWS].load(std::memory_order_acquire);
+      if (c==NULL || c->refs.load(std::memory_order_relaxed)>1) c=makeWritable(row/DIV_PATTERN_CHUNK_ROWS);
+      return c->data[row%DIV_PATTERN_CHUNK_ROWS];
+    }
+
+    /**
+     * get a chunk (may be NULL).
+     */
+    DivPatternChunk* getChunk(int index) const;
+
+    /**
+     * replace a chunk with another one, sharing it.
+     * @param index the chunk index.
+     * @param c the chunk, or NULL to make it empty.
+     */
+    void setChunk(int index, DivPatternChunk* c);
+
+    /**
+     * clear all rows and release memory.
+     */
+    void clear();
+
+    /**
+     * release chunks which only contain empty rows.
+     */
+    void compact();
+
+    /**
+     * compare with other pattern data.
+     * @return whether the data is identical.
+     */
+    bool equals(const DivPatternData& other) const;
+
+    /**
+     * get the amount of memory used by this pattern's chunks, including shared ones.
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * free chunks which are no longer used by any pattern.
+     * the list is shared by all engines, so the caller must make sure none of them is reading a song.
+     * @param canFree called after taking the list. if it returns false, the chunks are kept for later.
+     * @param data passed to canFree.
+     * @warning only call this while the audio thread is not running (e.g. with isBusy held).
+     */
+    static void freeRetired(bool (*canFree)(void*)=NULL, void* data=NULL);
+
+    DivPatternData& operator=(const DivPatternData& other);
+    DivPatternData(const DivPatternData& other);
+    DivPatternData();
+    ~DivPatternData();
+};
 
 struct DivPattern {
   String name;
-  short data[DIV_MAX_ROWS][DIV_MAX_COLS];
+  DivPatternData data;
 
   /**
    * clear the pattern.
@@ -76,6 +76,9 @@ void* DivDispatch::getState() {
 void DivDispatch::setState(void* state) {
 }
 
+void DivDispatch::freeState(void* state) {
+}
+
 void DivDispatch::muteChannel(int ch, bool mute) {
 }
 
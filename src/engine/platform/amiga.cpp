@@ -81,119 +81,142 @@ const char** DivPlatformAmiga::getRegisterSheet() {
 
 void DivPlatformAmiga::acquire(short** buf, size_t len) {
   thread_local int outL, outR, output;
-
-  for (size_t h=0; h<len; h++) {
-    if (--delay<0) delay=0;
-    if (!writes.empty() && delay<=0) {
-      QueuedWrite w=writes.front();
-
-      if (w.addr==0x96 && !(w.val&0x8000)) delay=4096/AMIGA_DIVIDER;
-
-      amiga.write(w.addr,w.val);
-      writes.pop();
-    }
-
-    bool hsync=bypassLimits;
-    outL=0;
-    outR=0;
-
-    // TODO:
-    // - improve DMA overrun behavior
-    // - does V/P mod really work like that?
-    amiga.volPos=(amiga.volPos+1)&AMIGA_VPMASK;
-    if (!bypassLimits) {
-      amiga.hPos+=AMIGA_DIVIDER;
-      if (amiga.hPos>=228) {
-        amiga.hPos-=228;
-        hsync=true;
+  short oscOut[4][DIV_BLOCK_LEN];
+
+  for (size_t h=0; h<len;) {
+    size_t runLen=MIN(len-h,DIV_BLOCK_LEN);
+    bool noWrites=writes.empty();
+    if (!noWrites) {
+      // writes happen one per sample
+      runLen=1;
+      if (--delay<0) delay=0;
+      if (delay<=0) {
+        QueuedWrite w=writes.front();
+
+        if (w.addr==0x96 && !(w.val&0x8000)) delay=4096/AMIGA_DIVIDER;
+
+        amiga.write(w.addr,w.val);
+        writes.pop();
       }
     }
-    for (int i=0; i<4; i++) {
-      // run DMA
-      if (amiga.audEn[i]) amiga.mustDMA[i]=true;
-      if (amiga.dmaEn && amiga.mustDMA[i] && !amiga.audIr[i]) {
-        amiga.audTick[i]-=AMIGA_DIVIDER;
-        if (amiga.audTick[i]<0) {
-          amiga.audTick[i]+=MAX(AMIGA_DIVIDER,amiga.audPer[i]);
-          if (amiga.audByte[i]) {
-            // read next samples
-            if (!amiga.incLoc[i]) {
-              amiga.audDat[0][i]=sampleMem[(amiga.dmaLoc[i])&chipMask];
-              amiga.audDat[1][i]=sampleMem[(amiga.dmaLoc[i]+1)&chipMask];
-              amiga.incLoc[i]=true;
-            }
 
-            amiga.audWord[i]=!amiga.audWord[i];
-          }
+    // render until the end of the run, or until an interrupt queues writes
+    size_t j=0;
+    while (j<runLen) {
+      bool hsync=bypassLimits;
+      outL=0;
+      outR=0;
+
+      // TODO:
+      // - improve DMA overrun behavior
+      // - does V/P mod really work like that?
+      amiga.volPos=(amiga.volPos+1)&AMIGA_VPMASK;
+      if (!bypassLimits) {
+        amiga.hPos+=AMIGA_DIVIDER;
+        if (amiga.hPos>=228) {
+          amiga.hPos-=228;
+          hsync=true;
+        }
+      }
+      for (int i=0; i<4; i++) {
+        // run DMA
+        if (amiga.audEn[i]) amiga.mustDMA[i]=true;
+        if (amiga.dmaEn && amiga.mustDMA[i] && !amiga.audIr[i]) {
+          amiga.audTick[i]-=AMIGA_DIVIDER;
+          if (amiga.audTick[i]<0) {
+            amiga.audTick[i]+=MAX(AMIGA_DIVIDER,amiga.audPer[i]);
+            if (amiga.audByte[i]) {
+              // read next samples
+              if (!amiga.incLoc[i]) {
+                amiga.audDat[0][i]=sampleMem[(amiga.dmaLoc[i])&chipMask];
+                amiga.audDat[1][i]=sampleMem[(amiga.dmaLoc[i]+1)&chipMask];
+                amiga.incLoc[i]=true;
+              }
 
-          amiga.mustDMA[i]=amiga.audEn[i];
+              amiga.audWord[i]=!amiga.audWord[i];
+            }
 
-          amiga.audByte[i]=!amiga.audByte[i];
-          if (!amiga.audByte[i] && (amiga.useV[i] || amiga.useP[i])) {
-            amiga.nextOut2[i]=((unsigned char)amiga.audDat[0][i])<<8|((unsigned char)amiga.audDat[1][i]);
-            if (i<3) {
-              if (amiga.useV[i] && amiga.useP[i]) {
-                if (amiga.audWord[i]) {
-                  amiga.audPer[i+1]=amiga.nextOut2[i];
-                } else {
+            amiga.mustDMA[i]=amiga.audEn[i];
+
+            amiga.audByte[i]=!amiga.audByte[i];
+            if (!amiga.audByte[i] && (amiga.useV[i] || amiga.useP[i])) {
+              amiga.nextOut2[i]=((unsigned char)amiga.audDat[0][i])<<8|((unsigned char)amiga.audDat[1][i]);
+              if (i<3) {
+                if (amiga.useV[i] && amiga.useP[i]) {
+                  if (amiga.audWord[i]) {
+                    amiga.audPer[i+1]=amiga.nextOut2[i];
+                  } else {
+                    amiga.audVol[i+1]=amiga.nextOut2[i];
+                  }
+                } else if (amiga.useV[i]) {
                   amiga.audVol[i+1]=amiga.nextOut2[i];
+                } else {
+                  amiga.audPer[i+1]=amiga.nextOut2[i];
                 }
-              } else if (amiga.useV[i]) {
-                amiga.audVol[i+1]=amiga.nextOut2[i];
-              } else {
-                amiga.audPer[i+1]=amiga.nextOut2[i];
               }
+            } else if (!amiga.useV[i] && !amiga.useP[i]) {
+              amiga.nextOut[i]=amiga.audDat[amiga.audByte[i]][i];
             }
-          } else if (!amiga.useV[i] && !amiga.useP[i]) {
-            amiga.nextOut[i]=amiga.audDat[amiga.audByte[i]][i];
           }
-        }
 
-        if (hsync) {
-          if (amiga.incLoc[i]) {
-            amiga.incLoc[i]=false;
-            amiga.dmaLoc[i]+=2;
-            // check for length
-            if ((--amiga.dmaLen[i])==0) {
-              if (amiga.audInt[i]) {
-                amiga.audIr[i]=true;
-                irq(i);
+          if (hsync) {
+            if (amiga.incLoc[i]) {
+              amiga.incLoc[i]=false;
+              amiga.dmaLoc[i]+=2;
+              // check for length
+              if ((--amiga.dmaLen[i])==0) {
+                if (amiga.audInt[i]) {
+                  amiga.audIr[i]=true;
+                  irq(i);
+                }
+                amiga.dmaLoc[i]=amiga.audLoc[i];
+                amiga.dmaLen[i]=amiga.audLen[i];
               }
-              amiga.dmaLoc[i]=amiga.audLoc[i];
-              amiga.dmaLen[i]=amiga.audLen[i];
             }
           }
         }
-      }
 
-      // output
-      if (!isMuted[i]) {
-        if ((amiga.audVol[i]&127)>=64) {
-          output=amiga.nextOut[i]<<6;
-        } else if ((amiga.audVol[i]&127)==0) {
-          output=0;
-        } else {
-          output=amiga.nextOut[i]*volTable[amiga.audVol[i]&63][amiga.volPos];
-        }
-        if (i==0 || i==3) {
-          outL+=(output*sep1)>>7;
-          outR+=(output*sep2)>>7;
+        // output
+        if (!isMuted[i]) {
+          if ((amiga.audVol[i]&127)>=64) {
+            output=amiga.nextOut[i]<<6;
+          } else if ((amiga.audVol[i]&127)==0) {
+            output=0;
+          } else {
+            output=amiga.nextOut[i]*volTable[amiga.audVol[i]&63][amiga.volPos];
+          }
+          if (i==0 || i==3) {
+            outL+=(output*sep1)>>7;
+            outR+=(output*sep2)>>7;
+          } else {
+            outL+=(output*sep2)>>7;
+            outR+=(output*sep1)>>7;
+          }
+          oscOut[i][j]=(amiga.nextOut[i]*MIN(64,amiga.audVol[i]&127))<<1;
         } else {
-          outL+=(output*sep2)>>7;
-          outR+=(output*sep1)>>7;
+          oscOut[i][j]=0;
         }
-        oscBuf[i]->data[oscBuf[i]->needle++]=(amiga.nextOut[i]*MIN(64,amiga.audVol[i]&127))<<1;
-      } else {
-        oscBuf[i]->data[oscBuf[i]->needle++]=0;
       }
+
+      filter[0][0]+=(filtConst*(outL-filter[0][0]))>>12;
+      filter[0][1]+=(filtConst*(filter[0][0]-filter[0][1]))>>12;
+      filter[1][0]+=(filtConst*(outR-filter[1][0]))>>12;
+      filter[1][1]+=(filtConst*(filter[1][0]-filter[1][1]))>>12;
+      buf[0][h+j]=filter[0][1];
+      buf[1][h+j]=filter[1][1];
+      j++;
+      if (!writes.empty()) break;
+    }
+    runLen=j;
+    if (noWrites) {
+      delay-=(int)runLen;
+      if (delay<0) delay=0;
     }
 
-    filter[0][0]+=(filtConst*(outL-filter[0][0]))>>12;
-    filter[0][1]+=(filtConst*(filter[0][0]-filter[0][1]))>>12;
-    filter[1][0]+=(filtConst*(outR-filter[1][0]))>>12;
-    filter[1][1]+=(filtConst*(filter[1][0]-filter[1][1]))>>12;
-    buf[0][h]=filter[0][1];
-    buf[1][h]=filter[1][1];
+    for (int i=0; i<4; i++) {
+      oscBuf[i]->putBlock(oscOut[i],runLen);
+    }
+    h+=runLen;
   }
 }
 
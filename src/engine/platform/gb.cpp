@@ -631,6 +631,37 @@ int DivPlatformGB::getRegisterPoolSize() {
   return 64;
 }
 
+void* DivPlatformGB::getState() {
+  SaveState* s=new SaveState;
+  for (int i=0; i<4; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->ws=ws;
+  s->lastPan=lastPan;
+  s->antiClickPeriodCount=antiClickPeriodCount;
+  s->antiClickWavePos=antiClickWavePos;
+  s->doubleWave=doubleWave;
+  s->lastDoubleWave=lastDoubleWave;
+  return s;
+}
+
+void DivPlatformGB::setState(void* state) {
+  SaveState* s=(SaveState*)state;
+  for (int i=0; i<4; i++) {
+    chan[i]=s->chan[i];
+  }
+  ws=s->ws;
+  lastPan=s->lastPan;
+  antiClickPeriodCount=s->antiClickPeriodCount;
+  antiClickWavePos=s->antiClickWavePos;
+  doubleWave=s->doubleWave;
+  lastDoubleWave=s->lastDoubleWave;
+}
+
+void DivPlatformGB::freeState(void* state) {
+  delete (SaveState*)state;
+}
+
 void DivPlatformGB::reset() {
   for (int i=0; i<4; i++) {
     chan[i]=DivPlatformGB::Channel();
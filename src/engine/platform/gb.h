@@ -77,6 +77,13 @@ class DivPlatformGB: public DivDispatch {
   GB_gameboy_t* gb;
   GB_model_t model;
   unsigned char regPool[128];
+  struct SaveState {
+    Channel chan[4];
+    DivWaveSynth ws;
+    unsigned char lastPan;
+    int antiClickPeriodCount, antiClickWavePos;
+    bool doubleWave, lastDoubleWave;
+  };
   
   unsigned char procMute();
   void updateWave();  
@@ -91,6 +98,9 @@ class DivPlatformGB: public DivDispatch {
     DivDispatchOscBuffer* getOscBuffer(int chan);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
@@ -55,7 +55,11 @@ const char** DivPlatformPCE::getRegisterSheet() {
 }
 
 void DivPlatformPCE::acquire(short** buf, size_t len) {
-  for (size_t h=0; h<len; h++) {
+  short oscOut[6][DIV_BLOCK_LEN];
+
+  for (size_t h=0; h<len;) {
+    size_t runLen=MIN(len-h,DIV_BLOCK_LEN);
+
     // PCM part
     for (int i=0; i<6; i++) {
       if (chan[i].pcm && chan[i].dacSample!=-1) {
@@ -86,7 +90,19 @@ void DivPlatformPCE::acquire(short** buf, size_t len) {
         }
       }
     }
-  
+
+    // the run ends before the next DAC step
+    for (int i=0; i<6; i++) {
+      if (chan[i].pcm && chan[i].dacSample!=-1) {
+        runLen=1+divSamplesBeforeStep(chan[i].dacPeriod,chan[i].dacRate,rate,runLen-1);
+      }
+    }
+    for (int i=0; i<6; i++) {
+      if (chan[i].pcm && chan[i].dacSample!=-1) {
+        chan[i].dacPeriod+=chan[i].dacRate*(int)(runLen-1);
+      }
+    }
+
     // PCE part
     while (!writes.empty()) {
       QueuedWrite w=writes.front();
@@ -94,26 +110,33 @@ void DivPlatformPCE::acquire(short** buf, size_t len) {
       regPool[w.addr&0x0f]=w.val;
       writes.pop();
     }
-    tempL[0]=0;
-    tempR[0]=0;
-    pce->Update(coreQuality);
-    pce->ResetTS(0);
 
-    for (int i=0; i<6; i++) {
-      oscBuf[i]->data[oscBuf[i]->needle++]=CLAMP(pce->channel[i].blip_prev_samp[0]+pce->channel[i].blip_prev_samp[1],-32768,32767);
+    for (size_t j=0; j<runLen; j++) {
+      tempL[0]=0;
+      tempR[0]=0;
+      pce->Update(coreQuality);
+      pce->ResetTS(0);
+
+      for (int i=0; i<6; i++) {
+        oscOut[i][j]=CLAMP(pce->channel[i].blip_prev_samp[0]+pce->channel[i].blip_prev_samp[1],-32768,32767);
+      }
+
+      tempL[0]=(tempL[0]>>1)+(tempL[0]>>2);
+      tempR[0]=(tempR[0]>>1)+(tempR[0]>>2);
+
+      if (tempL[0]<-32768) tempL[0]=-32768;
+      if (tempL[0]>32767) tempL[0]=32767;
+      if (tempR[0]<-32768) tempR[0]=-32768;
+      if (tempR[0]>32767) tempR[0]=32767;
+
+      buf[0][h+j]=tempL[0];
+      buf[1][h+j]=tempR[0];
     }
 
-    tempL[0]=(tempL[0]>>1)+(tempL[0]>>2);
-    tempR[0]=(tempR[0]>>1)+(tempR[0]>>2);
-
-    if (tempL[0]<-32768) tempL[0]=-32768;
-    if (tempL[0]>32767) tempL[0]=32767;
-    if (tempR[0]<-32768) tempR[0]=-32768;
-    if (tempR[0]>32767) tempR[0]=32767;
-    
-    //printf("tempL: %d tempR: %d\n",tempL,tempR);
-    buf[0][h]=tempL[0];
-    buf[1][h]=tempR[0];
+    for (int i=0; i<6; i++) {
+      oscBuf[i]->putBlock(oscOut[i],runLen);
+    }
+    h+=runLen;
   }
 }
 
@@ -588,6 +611,35 @@ int DivPlatformPCE::getRegisterPoolSize() {
   return 112;
 }
 
+void* DivPlatformPCE::getState() {
+  SaveState* s=new SaveState;
+  for (int i=0; i<6; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->lastPan=lastPan;
+  s->sampleBank=sampleBank;
+  s->lfoMode=lfoMode;
+  s->lfoSpeed=lfoSpeed;
+  s->updateLFO=updateLFO;
+  return s;
+}
+
+void DivPlatformPCE::setState(void* state) {
+  SaveState* s=(SaveState*)state;
+  for (int i=0; i<6; i++) {
+    chan[i]=s->chan[i];
+  }
+  lastPan=s->lastPan;
+  sampleBank=s->sampleBank;
+  lfoMode=s->lfoMode;
+  lfoSpeed=s->lfoSpeed;
+  updateLFO=s->updateLFO;
+}
+
+void DivPlatformPCE::freeState(void* state) {
+  delete (SaveState*)state;
+}
+
 void DivPlatformPCE::reset() {
   writes.clear();
   memset(regPool,0,128);
@@ -76,6 +76,11 @@ class DivPlatformPCE: public DivDispatch {
   int coreQuality;
   PCE_PSG* pce;
   unsigned char regPool[128];
+  struct SaveState {
+    Channel chan[6];
+    unsigned char lastPan, sampleBank, lfoMode, lfoSpeed;
+    bool updateLFO;
+  };
   void updateWave(int ch);
   friend void putDispatchChip(void*,int);
   friend void putDispatchChan(void*,int,int);
@@ -93,6 +98,9 @@ class DivPlatformPCE: public DivDispatch {
     float getGain(int ch, int vol);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
@@ -122,19 +122,27 @@ void DivPlatformSMS::acquire_mame(short** buf, size_t len) {
 
     writes.pop();
   }
-  for (size_t h=0; h<len; h++) {
+  short oscOut[4][DIV_BLOCK_LEN];
+  short* oscOutPtrs[4]={oscOut[0],oscOut[1],oscOut[2],oscOut[3]};
+
+  for (size_t h=0; h<len;) {
+    size_t runLen=MIN(len-h,DIV_BLOCK_LEN);
     short* outs[2]={
       &buf[0][h],
       stereo?(&buf[1][h]):NULL
     };
-    sn->sound_stream_update(outs,1);
+    sn->sound_stream_update(outs,runLen,oscOutPtrs);
     for (int i=0; i<4; i++) {
       if (isMuted[i]) {
-        oscBuf[i]->data[oscBuf[i]->needle++]=0;
+        oscBuf[i]->fillBlock(0,runLen);
       } else {
-        oscBuf[i]->data[oscBuf[i]->needle++]=sn->get_channel_output(i)*3;
+        for (size_t j=0; j<runLen; j++) {
+          oscOut[i][j]*=3;
+        }
+        oscBuf[i]->putBlock(oscOut[i],runLen);
       }
     }
+    h+=runLen;
   }
 }
 
@@ -483,6 +491,33 @@ int DivPlatformSMS::getRegisterPoolSize() {
   return stereo?9:8;
 }
 
+void* DivPlatformSMS::getState() {
+  SaveState* s=new SaveState;
+  for (int i=0; i<4; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->lastPan=lastPan;
+  s->oldValue=oldValue;
+  s->snNoiseMode=snNoiseMode;
+  s->updateSNMode=updateSNMode;
+  return s;
+}
+
+void DivPlatformSMS::setState(void* state) {
+  SaveState* s=(SaveState*)state;
+  for (int i=0; i<4; i++) {
+    chan[i]=s->chan[i];
+  }
+  lastPan=s->lastPan;
+  oldValue=s->oldValue;
+  snNoiseMode=s->snNoiseMode;
+  updateSNMode=s->updateSNMode;
+}
+
+void DivPlatformSMS::freeState(void* state) {
+  delete (SaveState*)state;
+}
+
 void DivPlatformSMS::reset() {
   memset(regPool,0,16);
   chanLatch=0;
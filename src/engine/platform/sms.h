@@ -63,6 +63,11 @@ class DivPlatformSMS: public DivDispatch {
     QueuedWrite(unsigned short a, unsigned char v): addr(a), val(v), addrOrVal(false) {}
   };
   FixedQueue<QueuedWrite,128> writes;
+  struct SaveState {
+    Channel chan[4];
+    unsigned char lastPan, oldValue, snNoiseMode;
+    bool updateSNMode;
+  };
   friend void putDispatchChip(void*,int);
   friend void putDispatchChan(void*,int,int);
 
@@ -83,6 +88,9 @@ class DivPlatformSMS: public DivDispatch {
     float getGain(int ch, int vol);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
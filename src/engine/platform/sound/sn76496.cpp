@@ -337,7 +337,7 @@ inline bool sn76496_base_device::in_noise_mode()
 	return ((m_register[6] & 4)!=0);
 }
 
-void sn76496_base_device::sound_stream_update(short** outputs, int outLen)
+void sn76496_base_device::sound_stream_update(short** outputs, int outLen, short** chanOuts)
 {
 	int i;
 
@@ -413,5 +413,11 @@ void sn76496_base_device::sound_stream_update(short** outputs, int outLen)
 		outputs[0][sampindex]=out;
 		if (m_stereo && (outputs[1] != nullptr))
 			outputs[1][sampindex]=out2;
+
+		if (chanOuts != nullptr)
+		{
+			for (i = 0; i < 4; i++)
+				chanOuts[i][sampindex]=get_channel_output(i);
+		}
 	}
 }
@@ -15,7 +15,8 @@ public:
 	void stereo_w(u8 data);
 	void write(u8 data);
 	void device_start();
-	void sound_stream_update(short** outputs, int outLen);
+	// chanOuts (optional): per-channel output for the oscilloscope
+	void sound_stream_update(short** outputs, int outLen, short** chanOuts=nullptr);
 	inline int32_t get_channel_output(int ch) {
 		return ((m_output[ch]!=0)?m_volume[ch]:0);
 	}
@@ -470,7 +470,7 @@ bool DivEngine::perSystemPreEffect(int ch, unsigned char effect, unsigned char e
 void DivEngine::processRowPre(int i) {
   int whatOrder=curOrder;
   int whatRow=curRow;
-  DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
   for (int j=0; j<curPat[i].effectCols; j++) {
     short effect=pat->data[whatRow][4+(j<<1)];
     short effectVal=pat->data[whatRow][5+(j<<1)];
@@ -484,7 +484,7 @@ void DivEngine::processRowPre(int i) {
 void DivEngine::processRow(int i, bool afterDelay) {
   int whatOrder=afterDelay?chan[i].delayOrder:curOrder;
   int whatRow=afterDelay?chan[i].delayRow:curRow;
-  DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
   // pre effects
   if (!afterDelay) {
     bool returnAfterPre=false;
@@ -1309,7 +1309,7 @@ void DivEngine::nextRow() {
       snprintf(pb,4095," %.2x",curOrders->ord[i][curOrder]);
       strcat(pb1,pb);
       
-      DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
+      const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
       snprintf(pb2,4095,"\x1b[37m %s",
               formatNote(pat->data[curRow][0],pat->data[curRow][1]));
       strcat(pb3,pb2);
@@ -1438,7 +1438,7 @@ void DivEngine::nextRow() {
 
   // post row details
   for (int i=0; i<chans; i++) {
-    DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
+    const DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][curOrder],false);
     if (!(pat->data[curRow][0]==0 && pat->data[curRow][1]==0)) {
       if (pat->data[curRow][0]!=100 && pat->data[curRow][0]!=101 && pat->data[curRow][0]!=102) {
         if (!chan[i].legato) {
@@ -2150,6 +2150,62 @@ void _runDispatch2(void* d) {
 
 }
 
+#define RENDER_STAGE_END(x) \
+  { \
+    std::chrono::steady_clock::time_point ts_stageEnd=std::chrono::steady_clock::now(); \
+    stageTime[x]+=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_stageEnd-ts_stageBegin).count(); \
+    ts_stageBegin=ts_stageEnd; \
+  }
+
+void DivEngine::updateRenderStats(unsigned int size) {
+  DivRenderStats stats;
+  for (int i=0; i<DIV_RENDER_STAGE_MAX; i++) {
+    stats.stage[i]=renderCounters[i].get();
+  }
+  stats.chips=song.systemLen;
+  for (int i=0; i<song.systemLen; i++) {
+    stats.acquire[i]=acquireCounters[i].get();
+    stats.fillBuf[i]=fillBufCounters[i].get();
+  }
+  if (got.rate>0) stats.budget=1000000000.0*(double)size/got.rate;
+
+  // don't block the audio thread
+  if (renderStatsLock.try_lock()) {
+    renderStats=stats;
+    renderStatsLock.unlock();
+  }
+}
+
+void DivEngine::resetRenderStats() {
+  for (int i=0; i<DIV_RENDER_STAGE_MAX; i++) {
+    renderCounters[i].clear();
+  }
+  for (int i=0; i<DIV_MAX_CHIPS; i++) {
+    acquireCounters[i].clear();
+    fillBufCounters[i].clear();
+  }
+  renderStatsCycle=0;
+  renderStatsLock.lock();
+  renderStats=DivRenderStats();
+  renderStatsLock.unlock();
+}
+
+DivRenderStats DivEngine::getRenderStats() {
+  renderStatsLock.lock();
+  DivRenderStats ret=renderStats;
+  renderStatsLock.unlock();
+  return ret;
+}
+
+String DivEngine::getRenderStatsJSON() {
+  DivRenderStats stats=getRenderStats();
+  const char* chipNames[DIV_MAX_CHIPS];
+  for (int i=0; i<stats.chips; i++) {
+    chipNames[i]=(i<song.systemLen)?getSystemName(song.system[i]):"???";
+  }
+  return stats.toJSON(chipNames);
+}
+
 void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsigned int size) {
   lastNBIns=inChans;
   lastNBOuts=outChans;
@@ -2178,12 +2234,15 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
   got.bufsize=size;
 
   std::chrono::steady_clock::time_point ts_processBegin=std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point ts_stageBegin=ts_processBegin;
+  unsigned int stageTime[DIV_RENDER_STAGE_MAX];
+  memset(stageTime,0,DIV_RENDER_STAGE_MAX*sizeof(unsigned int));
 
   if (renderPool==NULL) {
     unsigned int howManyThreads=song.systemLen;
     if (howManyThreads<2) howManyThreads=0;
     if (howManyThreads>renderPoolThreads) howManyThreads=renderPoolThreads;
-    renderPool=new DivWorkPool(howManyThreads);
+    renderPool=new DivWorkPool(howManyThreads,renderPoolPinThreads);
   }
 
   // process MIDI events (TODO: everything)
@@ -2245,6 +2304,7 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     //logD("%.2x",msg.type);
     output->midiIn->queue.pop();
   }
+  RENDER_STAGE_END(DIV_RENDER_STAGE_MIDI);
   
   // process sample/wave preview
   if ((sPreview.sample>=0 && sPreview.sample<(int)song.sample.size()) || (sPreview.wave>=0 && sPreview.wave<(int)song.wave.size())) {
@@ -2392,6 +2452,7 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
   } else {
     memset(samp_bbOut,0,size*sizeof(short));
   }
+  RENDER_STAGE_END(DIV_RENDER_STAGE_PREVIEW);
 
   // process audio
   bool mustPlay=playing && !halted;
@@ -2426,6 +2487,7 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
 
     int attempts=0;
     int runLeftG=size<<MASTER_CLOCK_PREC;
+    bool bufsFilled=false;
     while (++attempts<(int)size) {
       // -1. set bufferPos
       bufferPos=(size<<MASTER_CLOCK_PREC)-runLeftG;
@@ -2435,6 +2497,8 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       // 1. check whether we are done with all buffers
       if (runLeftG<=0) break;
 
+      RENDER_STAGE_END(DIV_RENDER_STAGE_CHIPS);
+
       // 2. check whether we gonna tick
       if (cycles<=0) {
         // we have to tick
@@ -2462,6 +2526,7 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
           metroTick[realPos]=pendingMetroTick;
           pendingMetroTick=0;
         }
+        RENDER_STAGE_END(DIV_RENDER_STAGE_TICK);
       } else {
         // 3. run MIDI clock
         int midiTotal=MIN(cycles,runLeftG);
@@ -2469,6 +2534,7 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
 
         // 4. run MIDI timecode
         runMidiTime(midiTotal);
+        RENDER_STAGE_END(DIV_RENDER_STAGE_TICK);
 
         // 5. tick the clock and fill buffers as needed
         if (cycles<runLeftG) {
@@ -2489,14 +2555,24 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
         } else {
           cycles-=runLeftG;
           runLeftG=0;
+          // this is the last segment of the buffer, so fill the output buffers
+          // in the same task (saves one wait)
           for (int i=0; i<song.systemLen; i++) {
+            if (size<disCont[i].lastAvail) {
+              logW("%d: size<lastAvail! %d<%d",i,size,disCont[i].lastAvail);
+            }
+            disCont[i].size=size;
             renderPool->push([](void* d) {
               DivDispatchContainer* dc=(DivDispatchContainer*)d;
               dc->acquire(dc->runPos,dc->runLeft);
               dc->runLeft=0;
+              if (dc->size>=dc->lastAvail) {
+                dc->fillBuf(dc->runtotal,dc->lastAvail,dc->size-dc->lastAvail);
+              }
             },&disCont[i]);
           }
           renderPool->wait();
+          bufsFilled=true;
         }
       }
     }
@@ -2510,19 +2586,23 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
     totalProcessed=size-(runLeftG>>MASTER_CLOCK_PREC);
 
-    for (int i=0; i<song.systemLen; i++) {
-      if (size<disCont[i].lastAvail) {
-        logW("%d: size<lastAvail! %d<%d",i,size,disCont[i].lastAvail);
-        continue;
+    // playback stopped before the end of the buffer
+    if (!bufsFilled) {
+      for (int i=0; i<song.systemLen; i++) {
+        if (size<disCont[i].lastAvail) {
+          logW("%d: size<lastAvail! %d<%d",i,size,disCont[i].lastAvail);
+          continue;
+        }
+        disCont[i].size=size;
+        renderPool->push([](void* d) {
+          DivDispatchContainer* dc=(DivDispatchContainer*)d;
+          dc->fillBuf(dc->runtotal,dc->lastAvail,dc->size-dc->lastAvail);
+        },&disCont[i]);
       }
-      disCont[i].size=size;
-      renderPool->push([](void* d) {
-        DivDispatchContainer* dc=(DivDispatchContainer*)d;
-        dc->fillBuf(dc->runtotal,dc->lastAvail,dc->size-dc->lastAvail);
-      },&disCont[i]);
+      renderPool->wait();
     }
-    renderPool->wait();
   }
+  RENDER_STAGE_END(DIV_RENDER_STAGE_CHIPS);
 
   // process metronome
   if (metroBufLen<size || metroBuf==NULL) {
@@ -2556,6 +2636,8 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
   }
 
+  RENDER_STAGE_END(DIV_RENDER_STAGE_METRONOME);
+
   // resolve patchbay
   for (unsigned int i: song.patchbay) {
     const unsigned short srcPort=i>>16;
@@ -2615,6 +2697,8 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     // nothing/invalid
   }
 
+  RENDER_STAGE_END(DIV_RENDER_STAGE_PATCHBAY);
+
   // dump to oscillator buffer
   for (unsigned int i=0; i<size; i++) {
     for (int j=0; j<outChans; j++) {
@@ -2648,6 +2732,25 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       }
     }
   }
+  RENDER_STAGE_END(DIV_RENDER_STAGE_OUTPUT);
+
+  // collect statistics
+  stageTime[DIV_RENDER_STAGE_TOTAL]=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_stageBegin-ts_processBegin).count();
+  for (int i=0; i<DIV_RENDER_STAGE_MAX; i++) {
+    renderCounters[i].add(stageTime[i]);
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    if (mustPlay) {
+      acquireCounters[i].add(disCont[i].acquireTime);
+      fillBufCounters[i].add(disCont[i].fillBufTime);
+    }
+    disCont[i].acquireTime=0;
+    disCont[i].fillBufTime=0;
+  }
+  if (++renderStatsCycle>=DIV_RENDER_STATS_INTERVAL) {
+    renderStatsCycle=0;
+    updateRenderStats(size);
+  }
   isBusy.unlock();
 
   std::chrono::steady_clock::time_point ts_processEnd=std::chrono::steady_clock::now();
@@ -0,0 +1,309 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "regTimeline.h"
+#include "mappedFile.h"
+#include "engine.h"
+#include "../ta-log.h"
+#include "../fileutils.h"
+#include <string.h>
+
+constexpr int MASTER_CLOCK_PREC=(sizeof(void*)==8)?8:0;
+
+static const char regTimelineMagic[8]={'F','u','r','R','e','g','T','L'};
+
+// the tick table starts at an 8-byte boundary
+#define DIV_REGTL_TICKS_OFFSET ((sizeof(DivRegTimelineHeader)+7)&(~(size_t)7))
+
+size_t DivRegTimeline::getTickCount() const {
+  return header.tickCount;
+}
+
+size_t DivRegTimeline::getSongTickCount() const {
+  return header.songTickCount;
+}
+
+int DivRegTimeline::getTrailingTicks() const {
+  return header.trailingTicks;
+}
+
+int DivRegTimeline::getTrailNote(int chan) const {
+  if (chan<0 || chan>=(int)header.chanCount) return -2;
+  return header.trailNote[chan];
+}
+
+const DivRegTimelineTick& DivRegTimeline::getTick(size_t tick) const {
+  return ticks[tick];
+}
+
+const DivRegTimelineWrite* DivRegTimeline::getWrites(size_t tick, size_t& count) const {
+  count=ticks[tick+1].firstWrite-ticks[tick].firstWrite;
+  return &writes[ticks[tick].firstWrite];
+}
+
+const DivRegTimelineWrite* DivRegTimeline::getInitWrites(size_t& count) const {
+  count=ticks[0].firstWrite;
+  return writes;
+}
+
+uint64_t DivRegTimeline::getTime(size_t tick, unsigned int rate) const {
+  if (rate==header.rate) return ticks[tick].time;
+  // this won't overflow unless the song is several years long
+  return (ticks[tick].time*rate)/header.rate;
+}
+
+int DivRegTimeline::getPrec() const {
+  return header.prec;
+}
+
+unsigned int DivRegTimeline::getRate() const {
+  return header.rate;
+}
+
+void DivRegTimeline::getLoop(int& loopOrder, int& loopRow, int& loopEnd) const {
+  loopOrder=header.loopOrder;
+  loopRow=header.loopRow;
+  loopEnd=header.loopEnd;
+}
+
+DivSystem DivRegTimeline::getChip(int chip) const {
+  if (chip<0 || chip>=(int)header.chipCount) return DIV_SYSTEM_NULL;
+  return (DivSystem)header.chips[chip];
+}
+
+bool DivRegTimeline::save(const char* path) const {
+  FILE* f=ps_fopen(path,"wb");
+  if (f==NULL) {
+    logE("could not open %s for writing! (%s)",path,strerror(errno));
+    return false;
+  }
+  static const unsigned char padding[8]={0,0,0,0,0,0,0,0};
+  bool ok=true;
+  ok&=(fwrite(&header,1,sizeof(DivRegTimelineHeader),f)==sizeof(DivRegTimelineHeader));
+  ok&=(fwrite(padding,1,DIV_REGTL_TICKS_OFFSET-sizeof(DivRegTimelineHeader),f)==DIV_REGTL_TICKS_OFFSET-sizeof(DivRegTimelineHeader));
+  ok&=(fwrite(ticks,sizeof(DivRegTimelineTick),header.tickCount+1,f)==header.tickCount+1);
+  if (header.writeCount>0) {
+    ok&=(fwrite(writes,sizeof(DivRegTimelineWrite),header.writeCount,f)==header.writeCount);
+  }
+  if (fclose(f)!=0) ok=false;
+  if (!ok) {
+    logE("could not write %s! (%s)",path,strerror(errno));
+  }
+  return ok;
+}
+
+DivRegTimeline* DivRegTimeline::open(const char* path) {
+  DivMappedFile* m=DivMappedFile::open(path);
+  if (m==NULL) return NULL;
+
+  const unsigned char* data=m->getData();
+  size_t len=m->size();
+  DivRegTimelineHeader h;
+  if (len<DIV_REGTL_TICKS_OFFSET) {
+    logE("%s: not a register timeline!",path);
+    m->unref();
+    return NULL;
+  }
+  memcpy(&h,data,sizeof(DivRegTimelineHeader));
+  if (memcmp(h.magic,regTimelineMagic,8)!=0 || h.version!=DIV_REGTL_VERSION || h.rate==0 || h.chipCount>DIV_MAX_CHIPS || h.chanCount>DIV_MAX_CHANS || h.songTickCount>h.tickCount) {
+    logE("%s: not a register timeline or made by another version!",path);
+    m->unref();
+    return NULL;
+  }
+  size_t ticksLen=((size_t)h.tickCount+1)*sizeof(DivRegTimelineTick);
+  size_t writesLen=(size_t)h.writeCount*sizeof(DivRegTimelineWrite);
+  if (len!=DIV_REGTL_TICKS_OFFSET+ticksLen+writesLen) {
+    logE("%s: register timeline has wrong size!",path);
+    m->unref();
+    return NULL;
+  }
+
+  DivRegTimeline* ret=new DivRegTimeline;
+  ret->header=h;
+  ret->ticks=(const DivRegTimelineTick*)(data+DIV_REGTL_TICKS_OFFSET);
+  ret->writes=(const DivRegTimelineWrite*)(data+DIV_REGTL_TICKS_OFFSET+ticksLen);
+  ret->mapping=m;
+
+  // check the write indices so that readers can trust them
+  unsigned int prevWrite=0;
+  for (size_t i=0; i<=h.tickCount; i++) {
+    if (ret->ticks[i].firstWrite<prevWrite || ret->ticks[i].firstWrite>h.writeCount) {
+      logE("%s: register timeline is corrupt!",path);
+      delete ret;
+      return NULL;
+    }
+    prevWrite=ret->ticks[i].firstWrite;
+  }
+  if (prevWrite!=h.writeCount) {
+    logE("%s: register timeline is corrupt!",path);
+    delete ret;
+    return NULL;
+  }
+  return ret;
+}
+
+DivRegTimeline::DivRegTimeline():
+  ticks(NULL),
+  writes(NULL),
+  mapping(NULL) {
+  memset(&header,0,sizeof(DivRegTimelineHeader));
+}
+
+DivRegTimeline::~DivRegTimeline() {
+  if (mapping!=NULL) {
+    mapping->unref();
+    mapping=NULL;
+  }
+}
+
+DivRegTimeline* DivEngine::captureRegTimeline(unsigned int rate, int trailingTicks) {
+  DivRegTimeline* tl=new DivRegTimeline;
+  DivRegTimelineHeader& h=tl->header;
+  memcpy(h.magic,regTimelineMagic,8);
+  h.version=DIV_REGTL_VERSION;
+  h.rate=rate;
+  h.prec=MASTER_CLOCK_PREC;
+  h.trailingTicks=trailingTicks;
+
+  stop();
+  repeatPattern=false;
+  shallStop=false;
+  setOrder(0);
+  synchronizedSoft([&]() {
+    double origRate=got.rate;
+    got.rate=rate;
+
+    walkSong(h.loopOrder,h.loopRow,h.loopEnd);
+
+    h.chipCount=song.systemLen;
+    for (int i=0; i<song.systemLen; i++) {
+      h.chips[i]=song.system[i];
+      disCont[i].dispatch->getRegisterWrites().clear();
+      disCont[i].dispatch->toggleRegisterDump(true);
+    }
+
+    // reset the playback state
+    curOrder=0;
+    freelance=false;
+    playing=false;
+    extValuePresent=false;
+    remainingLoops=-1;
+
+    std::vector<DivRegTimelineTick>& tickList=tl->tickStorage;
+    std::vector<DivRegTimelineWrite>& writeList=tl->writeStorage;
+    auto collectWrites=[&]() {
+      for (int i=0; i<song.systemLen; i++) {
+        std::vector<DivRegWrite>& chipWrites=disCont[i].dispatch->getRegisterWrites();
+        for (DivRegWrite& j: chipWrites) {
+          DivRegTimelineWrite w;
+          w.addr=j.addr;
+          w.val=j.val;
+          w.chip=i;
+          memset(w.reserved,0,sizeof(w.reserved));
+          writeList.push_back(w);
+        }
+        chipWrites.clear();
+      }
+    };
+
+    playSub(false);
+    collectWrites();
+
+    h.chanCount=chans;
+    for (int i=0; i<chans; i++) {
+      h.trailNote[i]=-2;
+    }
+    // whether a channel which played a note has yet to play another one after the end
+    auto stillHaveTo=[&]() -> bool {
+      for (int i=0; i<chans; i++) {
+        if (h.trailNote[i]==-1) return true;
+      }
+      return false;
+    };
+
+    uint64_t time=0;
+    bool ended=false;
+    int trailed=0;
+    DivRegTimelineTick t;
+    memset(&t,0,sizeof(DivRegTimelineTick));
+    while (true) {
+      t.time=time;
+      t.firstWrite=writeList.size();
+      t.order=curOrder;
+      t.row=curRow;
+      t.flags=(ticks==1)?DIV_REGTL_ROW_LAST:0;
+      if ((ticks-((tempoAccum+virtualTempoN)/virtualTempoD))<=0) t.flags|=DIV_REGTL_ROW_NEXT;
+      if (ended) t.flags|=DIV_REGTL_TRAILING;
+      for (int i=0; i<chans; i++) {
+        chan[i].wentThroughNote=false;
+      }
+      if (nextTick(false,true)) t.flags|=DIV_REGTL_END;
+      if (!playing) t.flags|=DIV_REGTL_STOPPED;
+      t.prevOrder=prevOrder;
+      t.prevRow=prevRow;
+      collectWrites();
+      time+=cycles;
+      tickList.push_back(t);
+
+      if (!ended) {
+        for (int i=0; i<chans; i++) {
+          if (chan[i].wentThroughNote) h.trailNote[i]=-1;
+        }
+        if (t.flags&(DIV_REGTL_END|DIV_REGTL_STOPPED)) {
+          h.songTickCount=tickList.size();
+          if (t.flags&DIV_REGTL_STOPPED) break;
+          ended=true;
+          if (trailingTicks==0) break;
+          if (trailingTicks==-1 && !stillHaveTo()) break;
+        }
+      } else {
+        for (int i=0; i<chans; i++) {
+          if (h.trailNote[i]==-1 && chan[i].wentThroughNote) h.trailNote[i]=trailed;
+        }
+        trailed++;
+        // stop on the next end as well
+        if (t.flags&(DIV_REGTL_END|DIV_REGTL_STOPPED)) break;
+        if (trailingTicks>0 && trailed>=trailingTicks) break;
+        if (trailingTicks==-1 && !stillHaveTo()) break;
+      }
+    }
+    // end entry
+    t.time=time;
+    t.firstWrite=writeList.size();
+    t.flags=0;
+    tickList.push_back(t);
+
+    for (int i=0; i<song.systemLen; i++) {
+      disCont[i].dispatch->toggleRegisterDump(false);
+    }
+
+    got.rate=origRate;
+    remainingLoops=-1;
+    playing=false;
+    freelance=false;
+    extValuePresent=false;
+  });
+
+  h.tickCount=tl->tickStorage.size()-1;
+  h.writeCount=tl->writeStorage.size();
+  tl->ticks=tl->tickStorage.data();
+  tl->writes=tl->writeStorage.data();
+  logD("register timeline: %d ticks (%d trailing), %d writes",(int)h.tickCount,(int)(h.tickCount-h.songTickCount),(int)h.writeCount);
+  return tl;
+}
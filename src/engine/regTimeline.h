@@ -0,0 +1,194 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _REGTIMELINE_H
+#define _REGTIMELINE_H
+
+#include "../ta-utils.h"
+#include "song.h"
+#include <stdint.h>
+#include <vector>
+
+#define DIV_REGTL_VERSION 3
+
+// the row advances after this tick
+#define DIV_REGTL_ROW_LAST 1
+// the song ended during this tick. its writes belong to the next loop.
+#define DIV_REGTL_END 2
+// playback stopped during this tick (e.g. by effect FFxx).
+#define DIV_REGTL_STOPPED 4
+// the row advances after this tick, counting virtual tempo (the loop point check of VGM export)
+#define DIV_REGTL_ROW_NEXT 8
+// this tick comes after the end of the song (see DivEngine::captureRegTimeline()).
+#define DIV_REGTL_TRAILING 16
+
+class DivMappedFile;
+
+struct DivRegTimelineTick {
+  // start of the tick, in 1/(rate<<prec) seconds
+  uint64_t time;
+  // index of the first write of this tick
+  unsigned int firstWrite;
+  // position before the tick
+  unsigned short order, row;
+  // position of the last processed row after the tick
+  unsigned short prevOrder, prevRow;
+  unsigned char flags;
+  unsigned char reserved[3];
+};
+
+struct DivRegTimelineWrite {
+  unsigned int addr;
+  // full width, since some chips (and the 0xffffxxxx commands) use values above 16 bits
+  unsigned int val;
+  unsigned char chip;
+  unsigned char reserved[3];
+};
+
+struct DivRegTimelineHeader {
+  char magic[8];
+  unsigned int version;
+  unsigned int rate;
+  unsigned int prec;
+  unsigned int chipCount;
+  int loopOrder, loopRow, loopEnd;
+  // not counting the end entry
+  unsigned int tickCount;
+  unsigned int writeCount;
+  // the trailing mode passed to DivEngine::captureRegTimeline()
+  int trailingTicks;
+  // ticks up to and including the one where the song ends or stops
+  unsigned int songTickCount;
+  unsigned int chanCount;
+  // per channel: -2 if no note was played until the end, -1 if no note was
+  // played after the end, or else the first trailing tick with a note.
+  int trailNote[DIV_MAX_CHANS];
+  unsigned short chips[DIV_MAX_CHIPS];
+};
+
+/**
+ * a log of all register writes which happen while playing a song once.
+ * it is captured in one pass (see DivEngine::captureRegTimeline()) and then read
+ * by exporters, so that exporting to several formats only plays the song once.
+ * it may be read by several threads at once.
+ *
+ * ticks are stored in order, followed by an entry which marks the end of the
+ * last one. the writes of a tick are grouped by chip, in chip order.
+ * writes made while starting playback come before the first tick.
+ * the song may be followed by trailing ticks, which play past the end.
+ */
+class DivRegTimeline {
+  DivRegTimelineHeader header;
+  std::vector<DivRegTimelineTick> tickStorage;
+  std::vector<DivRegTimelineWrite> writeStorage;
+  const DivRegTimelineTick* ticks;
+  const DivRegTimelineWrite* writes;
+  DivMappedFile* mapping;
+
+  friend class DivEngine;
+
+  public:
+    /**
+     * get the number of ticks, including trailing ones.
+     */
+    size_t getTickCount() const;
+
+    /**
+     * get the number of ticks until the song ends or stops (that tick included).
+     */
+    size_t getSongTickCount() const;
+
+    /**
+     * get the trailing mode which the timeline was captured with.
+     */
+    int getTrailingTicks() const;
+
+    /**
+     * get when a channel played a note after the song ended.
+     * @param chan the channel.
+     * @return -2 if it played no note before the end, -1 if it played none after it,
+     * or the index of the first trailing tick (counting from getSongTickCount()) with a note.
+     */
+    int getTrailNote(int chan) const;
+
+    /**
+     * get a tick.
+     * @param tick the tick. getTickCount() is the end entry.
+     */
+    const DivRegTimelineTick& getTick(size_t tick) const;
+
+    /**
+     * get the writes of a tick.
+     * @param tick the tick.
+     * @param count set to the number of writes.
+     * @return a pointer to the first write.
+     */
+    const DivRegTimelineWrite* getWrites(size_t tick, size_t& count) const;
+
+    /**
+     * get the writes made while starting playback (before the first tick).
+     */
+    const DivRegTimelineWrite* getInitWrites(size_t& count) const;
+
+    /**
+     * get the time at which a tick starts.
+     * @param tick the tick. getTickCount() returns the end of the last one.
+     * @param rate the sample rate to express the time in.
+     * @return the time in samples at that rate, with getPrec() fractional bits.
+     */
+    uint64_t getTime(size_t tick, unsigned int rate) const;
+
+    /**
+     * get the number of fractional bits of times.
+     */
+    int getPrec() const;
+
+    /**
+     * get the rate at which the timeline was captured.
+     */
+    unsigned int getRate() const;
+
+    /**
+     * get the loop point, as returned by DivEngine::walkSong().
+     */
+    void getLoop(int& loopOrder, int& loopRow, int& loopEnd) const;
+
+    /**
+     * get the system of a chip.
+     */
+    DivSystem getChip(int chip) const;
+
+    /**
+     * write the timeline to a file, which may be mapped back with open().
+     * the file uses native byte order.
+     * @return whether it was successful.
+     */
+    bool save(const char* path) const;
+
+    /**
+     * map a timeline file written by save().
+     * @return the timeline, or NULL on error.
+     */
+    static DivRegTimeline* open(const char* path);
+
+    DivRegTimeline();
+    ~DivRegTimeline();
+};
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "renderStats.h"
+#include <algorithm>
+#include <fmt/printf.h>
+
+static const char* stageNames[DIV_RENDER_STAGE_MAX]={
+  "total",
+  "midi",
+  "preview",
+  "tick",
+  "chips",
+  "metronome",
+  "patchbay",
+  "output"
+};
+
+void DivRenderCounter::add(unsigned int ns) {
+  window[pos]=ns;
+  if (++pos>=DIV_RENDER_STATS_WINDOW) pos=0;
+  if (len<DIV_RENDER_STATS_WINDOW) len++;
+}
+
+void DivRenderCounter::clear() {
+  pos=0;
+  len=0;
+}
+
+DivRenderStat DivRenderCounter::get() {
+  DivRenderStat ret;
+  unsigned int sorted[DIV_RENDER_STATS_WINDOW];
+  unsigned long long sum=0;
+
+  if (len==0) return ret;
+
+  ret.min=window[0];
+  for (unsigned int i=0; i<len; i++) {
+    sorted[i]=window[i];
+    sum+=window[i];
+    if (window[i]<ret.min) ret.min=window[i];
+  }
+  ret.avg=sum/len;
+
+  unsigned int p99Pos=(len*99)/100;
+  std::nth_element(sorted,sorted+p99Pos,sorted+len);
+  ret.p99=sorted[p99Pos];
+  return ret;
+}
+
+const char* DivRenderStats::stageName(int stage) {
+  if (stage<0 || stage>=DIV_RENDER_STAGE_MAX) return "???";
+  return stageNames[stage];
+}
+
+static String statToJSON(const DivRenderStat& s) {
+  return fmt::sprintf("{\"min\": %u, \"avg\": %u, \"p99\": %u}",s.min,s.avg,s.p99);
+}
+
+String DivRenderStats::toJSON(const char** chipNames) {
+  String ret="{\n  \"unit\": \"ns\",\n";
+  ret+=fmt::sprintf("  \"budget\": %u,\n",budget);
+  ret+="  \"stages\": {\n";
+  for (int i=0; i<DIV_RENDER_STAGE_MAX; i++) {
+    ret+=fmt::sprintf("    \"%s\": %s%s\n",stageNames[i],statToJSON(stage[i]),(i<DIV_RENDER_STAGE_MAX-1)?",":"");
+  }
+  ret+="  },\n  \"chips\": [\n";
+  for (int i=0; i<chips; i++) {
+    String name;
+    // escape the name
+    for (const char* j=chipNames[i]; *j; j++) {
+      if (*j=='"' || *j=='\\') name+='\\';
+      name+=*j;
+    }
+    ret+=fmt::sprintf("    {\"index\": %d, \"name\": \"%s\", \"acquire\": %s, \"fillBuf\": %s}%s\n",i,name,statToJSON(acquire[i]),statToJSON(fillBuf[i]),(i<chips-1)?",":"");
+  }
+  ret+="  ]\n}\n";
+  return ret;
+}
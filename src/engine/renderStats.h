@@ -0,0 +1,99 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RENDERSTATS_H
+#define _RENDERSTATS_H
+
+#include "defines.h"
+#include "../ta-utils.h"
+
+// number of buffers to keep statistics of
+#define DIV_RENDER_STATS_WINDOW 512
+
+// recalculate the statistics every this many buffers
+#define DIV_RENDER_STATS_INTERVAL 16
+
+enum DivRenderStage {
+  DIV_RENDER_STAGE_TOTAL=0,
+  DIV_RENDER_STAGE_MIDI,
+  DIV_RENDER_STAGE_PREVIEW,
+  // nextTick(), MIDI clock and timecode
+  DIV_RENDER_STAGE_TICK,
+  // chip emulation and resampling, including waiting for render threads
+  DIV_RENDER_STAGE_CHIPS,
+  DIV_RENDER_STAGE_METRONOME,
+  DIV_RENDER_STAGE_PATCHBAY,
+  // oscilloscope copy, mono and clamping
+  DIV_RENDER_STAGE_OUTPUT,
+
+  DIV_RENDER_STAGE_MAX
+};
+
+struct DivRenderStat {
+  // in nanoseconds
+  unsigned int min, avg, p99;
+  DivRenderStat():
+    min(0),
+    avg(0),
+    p99(0) {}
+};
+
+/**
+ * a rolling window of durations.
+ */
+struct DivRenderCounter {
+  unsigned int window[DIV_RENDER_STATS_WINDOW];
+  unsigned int pos, len;
+
+  void add(unsigned int ns);
+  void clear();
+  DivRenderStat get();
+  DivRenderCounter():
+    pos(0),
+    len(0) {}
+};
+
+/**
+ * a snapshot of render statistics.
+ */
+struct DivRenderStats {
+  DivRenderStat stage[DIV_RENDER_STAGE_MAX];
+  // per chip
+  DivRenderStat acquire[DIV_MAX_CHIPS];
+  DivRenderStat fillBuf[DIV_MAX_CHIPS];
+  int chips;
+  // buffer length in nanoseconds
+  unsigned int budget;
+
+  /**
+   * get the name of a stage.
+   */
+  static const char* stageName(int stage);
+
+  /**
+   * write these statistics as JSON.
+   * @param chipNames name of each chip.
+   */
+  String toJSON(const char** chipNames);
+  DivRenderStats():
+    chips(0),
+    budget(0) {}
+};
+
+#endif
@@ -0,0 +1,341 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "resampleKernels.h"
+#include "blip_buf.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RESAMPLE_SIMD_X86 1
+#define RESAMPLE_TARGET(x) __attribute__((target(x)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define RESAMPLE_SIMD_X86 1
+#define RESAMPLE_TARGET(x)
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define RESAMPLE_SIMD_NEON 1
+#endif
+
+// scalar
+
+static void sincScalar(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  for (int k=0; k<count; k++) {
+    const float* s=src+pos[k]-15;
+    const float* t1=&table[(8191-phase[k])<<3];
+    const float* t2=&table[phase[k]<<3];
+    float result=0;
+    for (int j=0; j<8; j++) {
+      result+=s[j]*t2[7-j];
+      result+=s[8+j]*t1[j];
+    }
+    out[k]=result;
+  }
+}
+
+static void cubicScalar(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  for (int k=0; k<count; k++) {
+    const float* s=src+pos[k]-1;
+    const float* t=&table[phase[k]<<2];
+    out[k]=s[0]*t[0]+s[1]*t[1]+s[2]*t[2]+s[3]*t[3];
+  }
+}
+
+static void stepScalar(float* out, const float* t1, const float* t2, float delta) {
+  for (int j=0; j<8; j++) {
+    out[-j]+=t1[j]*-delta;
+    out[1+j]+=t2[j]*delta;
+  }
+}
+
+#ifdef RESAMPLE_SIMD_X86
+
+// AVX2: one output per lane, reading inputs and coefficients with gathers
+
+RESAMPLE_TARGET("avx2")
+static void sincAVX2(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  for (; k+8<=count; k+=8) {
+    __m256i p=_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)&pos[k]),_mm256_set1_epi32(15));
+    __m256i ph=_mm256_loadu_si256((const __m256i*)&phase[k]);
+    __m256i i1=_mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(8191),ph),3);
+    __m256i i2=_mm256_add_epi32(_mm256_slli_epi32(ph,3),_mm256_set1_epi32(7));
+    __m256 result=_mm256_setzero_ps();
+    for (int j=0; j<8; j++) {
+      __m256i jv=_mm256_set1_epi32(j);
+      __m256 s=_mm256_i32gather_ps(src,_mm256_add_epi32(p,jv),4);
+      __m256 t=_mm256_i32gather_ps(table,_mm256_sub_epi32(i2,jv),4);
+      result=_mm256_add_ps(result,_mm256_mul_ps(s,t));
+      s=_mm256_i32gather_ps(src+8,_mm256_add_epi32(p,jv),4);
+      t=_mm256_i32gather_ps(table,_mm256_add_epi32(i1,jv),4);
+      result=_mm256_add_ps(result,_mm256_mul_ps(s,t));
+    }
+    _mm256_storeu_ps(&out[k],result);
+  }
+  sincScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+RESAMPLE_TARGET("avx2")
+static void cubicAVX2(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  for (; k+8<=count; k+=8) {
+    __m256i p=_mm256_loadu_si256((const __m256i*)&pos[k]);
+    __m256i t=_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)&phase[k]),2);
+    __m256 result=_mm256_mul_ps(_mm256_i32gather_ps(src-1,p,4),_mm256_i32gather_ps(table,t,4));
+    result=_mm256_add_ps(result,_mm256_mul_ps(_mm256_i32gather_ps(src,p,4),_mm256_i32gather_ps(table+1,t,4)));
+    result=_mm256_add_ps(result,_mm256_mul_ps(_mm256_i32gather_ps(src+1,p,4),_mm256_i32gather_ps(table+2,t,4)));
+    result=_mm256_add_ps(result,_mm256_mul_ps(_mm256_i32gather_ps(src+2,p,4),_mm256_i32gather_ps(table+3,t,4)));
+    _mm256_storeu_ps(&out[k],result);
+  }
+  cubicScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+RESAMPLE_TARGET("avx2")
+static void stepAVX2(float* out, const float* t1, const float* t2, float delta) {
+  __m256 t1r=_mm256_permutevar8x32_ps(_mm256_loadu_ps(t1),_mm256_setr_epi32(7,6,5,4,3,2,1,0));
+  _mm256_storeu_ps(out-7,_mm256_add_ps(_mm256_loadu_ps(out-7),_mm256_mul_ps(t1r,_mm256_set1_ps(-delta))));
+  _mm256_storeu_ps(out+1,_mm256_add_ps(_mm256_loadu_ps(out+1),_mm256_mul_ps(_mm256_loadu_ps(t2),_mm256_set1_ps(delta))));
+}
+
+// SSE2: four outputs at a time. rows of inputs and coefficients are loaded
+// per output and transposed, so that each lane holds one output.
+
+#define TRANSPOSE_SSE(r0,r1,r2,r3) _MM_TRANSPOSE4_PS(r0,r1,r2,r3)
+
+RESAMPLE_TARGET("sse2")
+static void sincSSE2(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  __m128 s[16];
+  __m128 t1[8];
+  __m128 t2[8];
+  for (; k+4<=count; k+=4) {
+    for (int b=0; b<16; b+=4) {
+      s[b]=_mm_loadu_ps(src+pos[k]-15+b);
+      s[b+1]=_mm_loadu_ps(src+pos[k+1]-15+b);
+      s[b+2]=_mm_loadu_ps(src+pos[k+2]-15+b);
+      s[b+3]=_mm_loadu_ps(src+pos[k+3]-15+b);
+      TRANSPOSE_SSE(s[b],s[b+1],s[b+2],s[b+3]);
+    }
+    for (int b=0; b<8; b+=4) {
+      t1[b]=_mm_loadu_ps(&table[((8191-phase[k])<<3)+b]);
+      t1[b+1]=_mm_loadu_ps(&table[((8191-phase[k+1])<<3)+b]);
+      t1[b+2]=_mm_loadu_ps(&table[((8191-phase[k+2])<<3)+b]);
+      t1[b+3]=_mm_loadu_ps(&table[((8191-phase[k+3])<<3)+b]);
+      TRANSPOSE_SSE(t1[b],t1[b+1],t1[b+2],t1[b+3]);
+      t2[b]=_mm_loadu_ps(&table[(phase[k]<<3)+b]);
+      t2[b+1]=_mm_loadu_ps(&table[(phase[k+1]<<3)+b]);
+      t2[b+2]=_mm_loadu_ps(&table[(phase[k+2]<<3)+b]);
+      t2[b+3]=_mm_loadu_ps(&table[(phase[k+3]<<3)+b]);
+      TRANSPOSE_SSE(t2[b],t2[b+1],t2[b+2],t2[b+3]);
+    }
+    __m128 result=_mm_setzero_ps();
+    for (int j=0; j<8; j++) {
+      result=_mm_add_ps(result,_mm_mul_ps(s[j],t2[7-j]));
+      result=_mm_add_ps(result,_mm_mul_ps(s[8+j],t1[j]));
+    }
+    _mm_storeu_ps(&out[k],result);
+  }
+  sincScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+RESAMPLE_TARGET("sse2")
+static void cubicSSE2(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  for (; k+4<=count; k+=4) {
+    __m128 s0=_mm_loadu_ps(src+pos[k]-1);
+    __m128 s1=_mm_loadu_ps(src+pos[k+1]-1);
+    __m128 s2=_mm_loadu_ps(src+pos[k+2]-1);
+    __m128 s3=_mm_loadu_ps(src+pos[k+3]-1);
+    __m128 t0=_mm_loadu_ps(&table[phase[k]<<2]);
+    __m128 t1=_mm_loadu_ps(&table[phase[k+1]<<2]);
+    __m128 t2=_mm_loadu_ps(&table[phase[k+2]<<2]);
+    __m128 t3=_mm_loadu_ps(&table[phase[k+3]<<2]);
+    TRANSPOSE_SSE(s0,s1,s2,s3);
+    TRANSPOSE_SSE(t0,t1,t2,t3);
+    __m128 result=_mm_mul_ps(s0,t0);
+    result=_mm_add_ps(result,_mm_mul_ps(s1,t1));
+    result=_mm_add_ps(result,_mm_mul_ps(s2,t2));
+    result=_mm_add_ps(result,_mm_mul_ps(s3,t3));
+    _mm_storeu_ps(&out[k],result);
+  }
+  cubicScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+RESAMPLE_TARGET("sse2")
+static void stepSSE2(float* out, const float* t1, const float* t2, float delta) {
+  __m128 nd=_mm_set1_ps(-delta);
+  __m128 d=_mm_set1_ps(delta);
+  __m128 lo=_mm_loadu_ps(t1);
+  __m128 hi=_mm_loadu_ps(t1+4);
+  lo=_mm_shuffle_ps(lo,lo,_MM_SHUFFLE(0,1,2,3));
+  hi=_mm_shuffle_ps(hi,hi,_MM_SHUFFLE(0,1,2,3));
+  _mm_storeu_ps(out-7,_mm_add_ps(_mm_loadu_ps(out-7),_mm_mul_ps(hi,nd)));
+  _mm_storeu_ps(out-3,_mm_add_ps(_mm_loadu_ps(out-3),_mm_mul_ps(lo,nd)));
+  _mm_storeu_ps(out+1,_mm_add_ps(_mm_loadu_ps(out+1),_mm_mul_ps(_mm_loadu_ps(t2),d)));
+  _mm_storeu_ps(out+5,_mm_add_ps(_mm_loadu_ps(out+5),_mm_mul_ps(_mm_loadu_ps(t2+4),d)));
+}
+
+#endif
+
+#ifdef RESAMPLE_SIMD_NEON
+
+// NEON: same as SSE2
+
+#define TRANSPOSE_NEON(r0,r1,r2,r3) { \
+  float32x4x2_t t01=vtrnq_f32(r0,r1); \
+  float32x4x2_t t23=vtrnq_f32(r2,r3); \
+  r0=vcombine_f32(vget_low_f32(t01.val[0]),vget_low_f32(t23.val[0])); \
+  r1=vcombine_f32(vget_low_f32(t01.val[1]),vget_low_f32(t23.val[1])); \
+  r2=vcombine_f32(vget_high_f32(t01.val[0]),vget_high_f32(t23.val[0])); \
+  r3=vcombine_f32(vget_high_f32(t01.val[1]),vget_high_f32(t23.val[1])); \
+}
+
+static inline float32x4_t reverseNEON(float32x4_t x) {
+  x=vrev64q_f32(x);
+  return vcombine_f32(vget_high_f32(x),vget_low_f32(x));
+}
+
+static void sincNEON(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  float32x4_t s[16];
+  float32x4_t t1[8];
+  float32x4_t t2[8];
+  for (; k+4<=count; k+=4) {
+    for (int b=0; b<16; b+=4) {
+      s[b]=vld1q_f32(src+pos[k]-15+b);
+      s[b+1]=vld1q_f32(src+pos[k+1]-15+b);
+      s[b+2]=vld1q_f32(src+pos[k+2]-15+b);
+      s[b+3]=vld1q_f32(src+pos[k+3]-15+b);
+      TRANSPOSE_NEON(s[b],s[b+1],s[b+2],s[b+3]);
+    }
+    for (int b=0; b<8; b+=4) {
+      t1[b]=vld1q_f32(&table[((8191-phase[k])<<3)+b]);
+      t1[b+1]=vld1q_f32(&table[((8191-phase[k+1])<<3)+b]);
+      t1[b+2]=vld1q_f32(&table[((8191-phase[k+2])<<3)+b]);
+      t1[b+3]=vld1q_f32(&table[((8191-phase[k+3])<<3)+b]);
+      TRANSPOSE_NEON(t1[b],t1[b+1],t1[b+2],t1[b+3]);
+      t2[b]=vld1q_f32(&table[(phase[k]<<3)+b]);
+      t2[b+1]=vld1q_f32(&table[(phase[k+1]<<3)+b]);
+      t2[b+2]=vld1q_f32(&table[(phase[k+2]<<3)+b]);
+      t2[b+3]=vld1q_f32(&table[(phase[k+3]<<3)+b]);
+      TRANSPOSE_NEON(t2[b],t2[b+1],t2[b+2],t2[b+3]);
+    }
+    float32x4_t result=vdupq_n_f32(0.0f);
+    for (int j=0; j<8; j++) {
+      result=vaddq_f32(result,vmulq_f32(s[j],t2[7-j]));
+      result=vaddq_f32(result,vmulq_f32(s[8+j],t1[j]));
+    }
+    vst1q_f32(&out[k],result);
+  }
+  sincScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+static void cubicNEON(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  int k=0;
+  for (; k+4<=count; k+=4) {
+    float32x4_t s0=vld1q_f32(src+pos[k]-1);
+    float32x4_t s1=vld1q_f32(src+pos[k+1]-1);
+    float32x4_t s2=vld1q_f32(src+pos[k+2]-1);
+    float32x4_t s3=vld1q_f32(src+pos[k+3]-1);
+    float32x4_t t0=vld1q_f32(&table[phase[k]<<2]);
+    float32x4_t t1=vld1q_f32(&table[phase[k+1]<<2]);
+    float32x4_t t2=vld1q_f32(&table[phase[k+2]<<2]);
+    float32x4_t t3=vld1q_f32(&table[phase[k+3]<<2]);
+    TRANSPOSE_NEON(s0,s1,s2,s3);
+    TRANSPOSE_NEON(t0,t1,t2,t3);
+    float32x4_t result=vmulq_f32(s0,t0);
+    result=vaddq_f32(result,vmulq_f32(s1,t1));
+    result=vaddq_f32(result,vmulq_f32(s2,t2));
+    result=vaddq_f32(result,vmulq_f32(s3,t3));
+    vst1q_f32(&out[k],result);
+  }
+  cubicScalar(src,pos+k,phase+k,table,out+k,count-k);
+}
+
+static void stepNEON(float* out, const float* t1, const float* t2, float delta) {
+  float32x4_t nd=vdupq_n_f32(-delta);
+  float32x4_t d=vdupq_n_f32(delta);
+  float32x4_t lo=reverseNEON(vld1q_f32(t1));
+  float32x4_t hi=reverseNEON(vld1q_f32(t1+4));
+  vst1q_f32(out-7,vaddq_f32(vld1q_f32(out-7),vmulq_f32(hi,nd)));
+  vst1q_f32(out-3,vaddq_f32(vld1q_f32(out-3),vmulq_f32(lo,nd)));
+  vst1q_f32(out+1,vaddq_f32(vld1q_f32(out+1),vmulq_f32(vld1q_f32(t2),d)));
+  vst1q_f32(out+5,vaddq_f32(vld1q_f32(out+5),vmulq_f32(vld1q_f32(t2+4),d)));
+}
+
+#endif
+
+void divResampleSinc(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  switch (blip_simd_level()) {
+#ifdef RESAMPLE_SIMD_X86
+    case blip_simd_avx2:
+      sincAVX2(src,pos,phase,table,out,count);
+      return;
+    case blip_simd_sse41:
+      sincSSE2(src,pos,phase,table,out,count);
+      return;
+#endif
+#ifdef RESAMPLE_SIMD_NEON
+    case blip_simd_neon:
+      sincNEON(src,pos,phase,table,out,count);
+      return;
+#endif
+    default:
+      sincScalar(src,pos,phase,table,out,count);
+      return;
+  }
+}
+
+void divResampleCubic(const float* src, const int* pos, const int* phase, const float* table, float* out, int count) {
+  switch (blip_simd_level()) {
+#ifdef RESAMPLE_SIMD_X86
+    case blip_simd_avx2:
+      cubicAVX2(src,pos,phase,table,out,count);
+      return;
+    case blip_simd_sse41:
+      cubicSSE2(src,pos,phase,table,out,count);
+      return;
+#endif
+#ifdef RESAMPLE_SIMD_NEON
+    case blip_simd_neon:
+      cubicNEON(src,pos,phase,table,out,count);
+      return;
+#endif
+    default:
+      cubicScalar(src,pos,phase,table,out,count);
+      return;
+  }
+}
+
+DivResampleStepFunc divResampleGetStepFunc() {
+  switch (blip_simd_level()) {
+#ifdef RESAMPLE_SIMD_X86
+    case blip_simd_avx2:
+      return stepAVX2;
+    case blip_simd_sse41:
+      return stepSSE2;
+#endif
+#ifdef RESAMPLE_SIMD_NEON
+    case blip_simd_neon:
+      return stepNEON;
+#endif
+    default:
+      return stepScalar;
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _RESAMPLE_KERNELS_H
+#define _RESAMPLE_KERNELS_H
+
+// inner loops of DivSample::resample(), with SIMD versions picked at run time
+// (see blip_simd_level()).
+// every version does the same float operations in the same order as the scalar
+// loops, so they all produce the same output.
+
+/**
+ * compute windowed sinc interpolation for several output samples.
+ * output k is sum(src[pos[k]-15+j]*table[(phase[k]<<3)+7-j]+src[pos[k]-7+j]*table[((8191-phase[k])<<3)+j]),
+ * adding the terms in that order for j from 0 to 7.
+ * @param src input samples.
+ * @param pos position of the last input sample of each window, in src.
+ * @param phase phase of each output sample (0 to 8191).
+ * @param table the sinc table (see DivFilterTables::getSincTable()).
+ * @param out the output.
+ * @param count the number of output samples.
+ */
+void divResampleSinc(const float* src, const int* pos, const int* phase, const float* table, float* out, int count);
+
+/**
+ * compute cubic interpolation for several output samples.
+ * output k is src[pos[k]-1]*t[0]+src[pos[k]]*t[1]+src[pos[k]+1]*t[2]+src[pos[k]+2]*t[3],
+ * where t is table+(phase[k]<<2).
+ * @param src input samples.
+ * @param pos position of each output sample in src.
+ * @param phase phase of each output sample (0 to 1023).
+ * @param table the cubic table (see DivFilterTables::getCubicTable()).
+ * @param out the output.
+ * @param count the number of output samples.
+ */
+void divResampleCubic(const float* src, const int* pos, const int* phase, const float* table, float* out, int count);
+
+/**
+ * adds a band-limited step to a buffer.
+ * out[-j] gets t1[j]*-delta and out[1+j] gets t2[j]*delta added, for j from 0 to 7.
+ */
+typedef void (*DivResampleStepFunc)(float* out, const float* t1, const float* t2, float delta);
+
+/**
+ * get the best step function for this CPU.
+ */
+DivResampleStepFunc divResampleGetStepFunc();
+
+#endif
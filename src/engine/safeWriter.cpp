@@ -29,6 +29,8 @@ unsigned char* SafeWriter::getFinalBuf() {
 void SafeWriter::checkSize(size_t amount) {
   while ((curSeek+amount)>=bufLen) {
     size_t newSize=WRITER_BUF_SIZE*(1+((curSeek+amount)/WRITER_BUF_SIZE));
+    // grow geometrically, otherwise writing large songs takes quadratic time
+    if (newSize<(bufLen+(bufLen>>1))) newSize=WRITER_BUF_SIZE*(1+((bufLen+(bufLen>>1))/WRITER_BUF_SIZE));
     if (newSize<(bufLen+WRITER_BUF_SIZE)) {
       logE("REPORT NOW: newSize is too small! case 1... %d<%d",(int)newSize,(int)(bufLen+WRITER_BUF_SIZE));
     }
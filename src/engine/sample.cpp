@@ -18,6 +18,8 @@
  */
 
 #include "sample.h"
+#include "mappedFile.h"
+#include "zlibOps.h"
 #include "../ta-log.h"
 #include "../fileutils.h"
 #include <math.h>
@@ -37,12 +39,146 @@ extern "C" {
 }
 #include "../../extern/adpcm-xq-s/adpcm-lib.h"
 #include "brrUtils.h"
+#include "sampleCache.h"
+#include "resampleKernels.h"
+#include "workPool.h"
+
+// 16-bit data is stored as differences between samples while compressed,
+// which deflate handles much better than the samples themselves.
+static void deltaEncode16(short* buf, size_t len) {
+  short prev=0;
+  for (size_t i=0; i<len; i++) {
+    short next=buf[i];
+    buf[i]=(short)(next-prev);
+    prev=next;
+  }
+}
+
+static void deltaDecode16(short* buf, size_t len) {
+  short prev=0;
+  for (size_t i=0; i<len; i++) {
+    prev=(short)(prev+buf[i]);
+    buf[i]=prev;
+  }
+}
+
+static void packHistory(DivSampleHistory* h) {
+  bool delta=(h->depth==DIV_SAMPLE_DEPTH_16BIT && (h->length&1)==0);
+  if (delta) deltaEncode16((short*)h->data,h->length>>1);
+  SafeWriter* w=divDeflate(h->data,h->length,1,false,1);
+  // only keep the compressed data if it is worth it
+  if (w!=NULL && w->size()<h->length-(h->length>>3)) {
+    unsigned char* packedData=new unsigned char[w->size()];
+    memcpy(packedData,w->getFinalBuf(),w->size());
+    delete[] h->data;
+    h->data=packedData;
+    h->packedLen=w->size();
+    h->packed=true;
+  } else if (delta) {
+    deltaDecode16((short*)h->data,h->length>>1);
+  }
+  if (w!=NULL) {
+    w->finish();
+    delete w;
+  }
+  h->packDone=true;
+}
+
+void DivSampleHistory::pack() {
+  if (data==NULL || packed || packThread!=NULL || length<DIV_SAMPLE_UNDO_PACK_MIN) return;
+  packDone=false;
+  packThread=new std::thread(packHistory,this);
+}
+
+void DivSampleHistory::finishPack(bool onlyIfDone) {
+  if (packThread==NULL) return;
+  if (onlyIfDone && !packDone) return;
+  packThread->join();
+  delete packThread;
+  packThread=NULL;
+}
+
+unsigned char* DivSampleHistory::getData() {
+  finishPack();
+  if (!packed) return data;
+
+  unsigned char* out=NULL;
+  size_t outLen=0;
+  String err;
+  if (!divInflate(data,packedLen,out,outLen,err) || outLen!=length) {
+    logE("could not decompress undo step!");
+    if (out!=NULL) delete[] out;
+    return NULL;
+  }
+  if (depth==DIV_SAMPLE_DEPTH_16BIT && (length&1)==0) {
+    deltaDecode16((short*)out,length>>1);
+  }
+  delete[] data;
+  data=out;
+  packed=false;
+  packedLen=0;
+  return data;
+}
 
 DivSampleHistory::~DivSampleHistory() {
+  finishPack();
   if (data!=NULL) delete[] data;
 }
 
-void DivSample::putSampleData(SafeWriter* w) {
+// size of an SMP2 block up to the sample data
+#define SAMPLE_HEADER_SIZE(nameLen) (4+4+(nameLen)+1+4+4+4+4+4+4+4*DIV_MAX_SAMPLE_TYPE)
+
+bool DivSample::isMappable() {
+#ifdef TA_BIG_ENDIAN
+  // 16-bit samples are stored as little-endian
+  if (depth!=DIV_SAMPLE_DEPTH_8BIT) return false;
+#else
+  if (depth!=DIV_SAMPLE_DEPTH_8BIT && depth!=DIV_SAMPLE_DEPTH_16BIT) return false;
+#endif
+  return getCurBufLen()>=DIV_SAMPLE_MAP_MIN;
+}
+
+// the length of the buffer allocated by initInternal(), which may be accessed past the end
+static size_t getPaddedLen(DivSampleDepth depth, unsigned int count) {
+  switch (depth) {
+    case DIV_SAMPLE_DEPTH_1BIT:
+      return (count+7)/8;
+    case DIV_SAMPLE_DEPTH_1BIT_DPCM:
+      return 1+((((count-1)/8)+15)&(~15));
+    case DIV_SAMPLE_DEPTH_YMZ_ADPCM:
+      return (((count+1)/2)+3)&(~0x03);
+    case DIV_SAMPLE_DEPTH_QSOUND_ADPCM:
+    case DIV_SAMPLE_DEPTH_VOX:
+      return (count+1)/2;
+    case DIV_SAMPLE_DEPTH_ADPCM_A:
+    case DIV_SAMPLE_DEPTH_ADPCM_B:
+    case DIV_SAMPLE_DEPTH_ADPCM_K:
+      return (((count+1)/2)+255)&(~0xff);
+    case DIV_SAMPLE_DEPTH_8BIT:
+    case DIV_SAMPLE_DEPTH_MULAW:
+    case DIV_SAMPLE_DEPTH_C219:
+      return (count+4095)&(~0xfff);
+    case DIV_SAMPLE_DEPTH_BRR:
+      return 9*((count+15)/16)+9;
+    case DIV_SAMPLE_DEPTH_IMA_ADPCM:
+      return 4+((count+1)/2);
+    case DIV_SAMPLE_DEPTH_12BIT:
+      return ((count*3)+1)/2;
+    case DIV_SAMPLE_DEPTH_16BIT:
+      return ((count+511)&(~0x1ff))*sizeof(short);
+    default:
+      return 0;
+  }
+  return 0;
+}
+
+size_t DivSample::getMapPadding(size_t pos) {
+  if (!isMappable()) return 0;
+  size_t dataPos=pos+SAMPLE_HEADER_SIZE(name.size());
+  return (DIV_SAMPLE_MAP_ALIGN-(dataPos%DIV_SAMPLE_MAP_ALIGN))%DIV_SAMPLE_MAP_ALIGN;
+}
+
+void DivSample::putSampleData(SafeWriter* w, bool mappable) {
   size_t blockStartSeek, blockEndSeek;
 
   w->write("SMP2",4);
@@ -84,6 +220,14 @@ void DivSample::putSampleData(SafeWriter* w) {
   w->write(getCurBuf(),getCurBufLen());
 #endif
 
+  // zero out the rest of what would be allocated, so that a mapped sample can be read past the end
+  if (mappable && isMappable()) {
+    size_t paddedLen=getPaddedLen(depth,samples);
+    for (size_t i=getCurBufLen(); i<paddedLen; i++) {
+      w->writeC(0);
+    }
+  }
+
   blockEndSeek=w->tell();
   w->seek(blockStartSeek,SEEK_SET);
   w->writeI(blockEndSeek-blockStartSeek-4);
@@ -97,7 +241,7 @@ static double samplePitchesSD[11]={
   2, 3, 4, 5, 6
 };
 
-DivDataErrors DivSample::readSampleData(SafeReader& reader, short version) {
+DivDataErrors DivSample::readSampleData(SafeReader& reader, short version, DivMappedFile* map) {
   int vol=0;
   int pitch=0;
   char magic[4];
@@ -179,6 +323,44 @@ DivDataErrors DivSample::readSampleData(SafeReader& reader, short version) {
   }
 
   if (version>=58) { // modern sample
+    if (map!=NULL) {
+      // use the sample in place if it was stored page-aligned along with its padding
+      size_t pos=reader.tell();
+      size_t dataLen=(depth==DIV_SAMPLE_DEPTH_8BIT)?samples:(samples*sizeof(short));
+      size_t paddedLen=getPaddedLen(depth,samples);
+      bool canMap=((depth==DIV_SAMPLE_DEPTH_8BIT || depth==DIV_SAMPLE_DEPTH_16BIT) && dataLen>=DIV_SAMPLE_MAP_MIN && (pos%DIV_SAMPLE_MAP_ALIGN)==0 && pos+paddedLen<=map->size());
+#ifdef TA_BIG_ENDIAN
+      if (depth!=DIV_SAMPLE_DEPTH_8BIT) canMap=false;
+#endif
+      if (canMap) {
+        unsigned char* mapData=map->getData();
+        for (size_t i=pos+dataLen; i<pos+paddedLen; i++) {
+          if (mapData[i]!=0) {
+            canMap=false;
+            break;
+          }
+        }
+      }
+      if (canMap) {
+        logV("mapping sample (%d bytes)",(int)dataLen);
+        if (depth==DIV_SAMPLE_DEPTH_8BIT) {
+          freeBuf(data8);
+          data8=(signed char*)&map->getData()[pos];
+          length8=samples;
+          mappedBuf=data8;
+        } else {
+          freeBuf(data16);
+          data16=(short*)&map->getData()[pos];
+          length16=samples*2;
+          mappedBuf=data16;
+        }
+        map->ref();
+        mappedFile=map;
+        setSampleCount(samples);
+        reader.seek(dataLen,SEEK_CUR);
+        return DIV_DATA_SUCCESS;
+      }
+    }
     init(samples);
     reader.read(getCurBuf(),getCurBufLen());
 #ifdef TA_BIG_ENDIAN
@@ -535,6 +717,7 @@ bool DivSample::saveRaw(const char* path) {
 // 16-bit memory is padded to 512, to make things easier for ADPCM-A/B.
 bool DivSample::initInternal(DivSampleDepth d, int count) {
   logV("initInternal(%d,%d)",(int)d,count);
+  invalidatePeaks();
   switch (d) {
     case DIV_SAMPLE_DEPTH_1BIT: // 1-bit
       if (data1!=NULL) delete[] data1;
@@ -580,7 +763,7 @@ bool DivSample::initInternal(DivSampleDepth d, int count) {
       memset(dataK,0,(lengthK+255)&(~0xff));
       break;
     case DIV_SAMPLE_DEPTH_8BIT: // 8-bit
-      if (data8!=NULL) delete[] data8;
+      freeBuf(data8);
       length8=count;
       // for padding X1-010 sample
       data8=new signed char[(count+4095)&(~0xfff)];
@@ -623,7 +806,7 @@ bool DivSample::initInternal(DivSampleDepth d, int count) {
       memset(data12,0,length12);
       break;
     case DIV_SAMPLE_DEPTH_16BIT: // 16-bit
-      if (data16!=NULL) delete[] data16;
+      freeBuf(data16);
       length16=count*2;
       data16=new short[(count+511)&(~0x1ff)];
       memset(data16,0,((count+511)&(~0x1ff))*sizeof(short));
@@ -634,6 +817,86 @@ bool DivSample::initInternal(DivSampleDepth d, int count) {
   return true;
 }
 
+void DivSample::freeBuf(signed char* buf) {
+  if (buf==NULL) return;
+  if (buf==mappedBuf) {
+    mappedBuf=NULL;
+    mappedFile->unref();
+    mappedFile=NULL;
+    return;
+  }
+  delete[] buf;
+}
+
+void DivSample::freeBuf(short* buf) {
+  if (buf==NULL) return;
+  if (buf==mappedBuf) {
+    mappedBuf=NULL;
+    mappedFile->unref();
+    mappedFile=NULL;
+    return;
+  }
+  delete[] buf;
+}
+
+void DivSample::unmap() {
+  if (mappedFile==NULL) return;
+  if (mappedBuf==data8) {
+    signed char* oldData8=data8;
+    data8=NULL;
+    initInternal(DIV_SAMPLE_DEPTH_8BIT,samples);
+    memcpy(data8,oldData8,length8);
+    freeBuf(oldData8);
+  } else if (mappedBuf==data16) {
+    short* oldData16=data16;
+    data16=NULL;
+    initInternal(DIV_SAMPLE_DEPTH_16BIT,samples);
+    memcpy(data16,oldData16,length16);
+    freeBuf(oldData16);
+  }
+}
+
+void* DivSample::copyMapped(const void* mapped, DivSampleDepth d, unsigned int count) {
+  size_t len=getPaddedLen(d,count);
+  void* ret=NULL;
+  if (d==DIV_SAMPLE_DEPTH_8BIT) {
+    ret=new signed char[len];
+  } else {
+    ret=new short[len/2];
+  }
+  // the padding was mapped as well (see readSampleData())
+  memcpy(ret,mapped,len);
+  return ret;
+}
+
+bool DivSample::replaceMapped(const void* mapped, void* copy, DivSampleDepth d, unsigned int count) {
+  if (mappedFile==NULL || mappedBuf!=mapped || depth!=d || samples!=count) return false;
+  // the sample may have been edited in place since the copy was made
+  size_t len=getPaddedLen(d,count);
+  if (memcmp(copy,mapped,len)!=0) memcpy(copy,mapped,len);
+  if (mappedBuf==data8) {
+    signed char* oldData8=data8;
+    data8=(signed char*)copy;
+    freeBuf(oldData8);
+  } else if (mappedBuf==data16) {
+    short* oldData16=data16;
+    data16=(short*)copy;
+    freeBuf(oldData16);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void DivSample::freeMappedCopy(void* copy, DivSampleDepth d) {
+  if (copy==NULL) return;
+  if (d==DIV_SAMPLE_DEPTH_8BIT) {
+    delete[] (signed char*)copy;
+  } else {
+    delete[] (short*)copy;
+  }
+}
+
 bool DivSample::init(unsigned int count) {
   if (!initInternal(depth,count)) return false;
   setSampleCount(count);
@@ -647,7 +910,7 @@ bool DivSample::resize(unsigned int count) {
       data8=NULL;
       initInternal(DIV_SAMPLE_DEPTH_8BIT,count);
       memcpy(data8,oldData8,MIN(count,samples));
-      delete[] oldData8;
+      freeBuf(oldData8);
     } else {
       initInternal(DIV_SAMPLE_DEPTH_8BIT,count);
     }
@@ -659,7 +922,7 @@ bool DivSample::resize(unsigned int count) {
       data16=NULL;
       initInternal(DIV_SAMPLE_DEPTH_16BIT,count);
       memcpy(data16,oldData16,sizeof(short)*MIN(count,samples));
-      delete[] oldData16;
+      freeBuf(oldData16);
     } else {
       initInternal(DIV_SAMPLE_DEPTH_16BIT,count);
     }
@@ -712,7 +975,7 @@ bool DivSample::strip(unsigned int begin, unsigned int end) {
       if (samples-end>0) {
         memcpy(data8+begin,oldData8+end,samples-end);
       }
-      delete[] oldData8;
+      freeBuf(oldData8);
     } else {
       // do nothing
       return true;
@@ -730,7 +993,7 @@ bool DivSample::strip(unsigned int begin, unsigned int end) {
       if (samples-end>0) {
         memcpy(&(data16[begin]),&(oldData16[end]),sizeof(short)*(samples-end));
       }
-      delete[] oldData16;
+      freeBuf(oldData16);
     } else {
       // do nothing
       return true;
@@ -761,7 +1024,7 @@ bool DivSample::trim(unsigned int begin, unsigned int end) {
       data8=NULL;
       initInternal(DIV_SAMPLE_DEPTH_8BIT,count);
       memcpy(data8,oldData8+begin,count);
-      delete[] oldData8;
+      freeBuf(oldData8);
     } else {
       // do nothing
       return true;
@@ -774,7 +1037,7 @@ bool DivSample::trim(unsigned int begin, unsigned int end) {
       data16=NULL;
       initInternal(DIV_SAMPLE_DEPTH_16BIT,count);
       memcpy(data16,&(oldData16[begin]),sizeof(short)*count);
-      delete[] oldData16;
+      freeBuf(oldData16);
     } else {
       // do nothing
       return true;
@@ -798,7 +1061,7 @@ bool DivSample::insert(unsigned int pos, unsigned int length) {
       if (count-pos-length>0) {
         memcpy(data8+pos+length,oldData8+pos,count-pos-length);
       }
-      delete[] oldData8;
+      freeBuf(oldData8);
     } else {
       initInternal(DIV_SAMPLE_DEPTH_8BIT,count);
     }
@@ -815,7 +1078,7 @@ bool DivSample::insert(unsigned int pos, unsigned int length) {
       if (count-pos-length>0) {
         memcpy(&(data16[pos+length]),&(oldData16[pos]),sizeof(short)*(count-pos-length));
       }
-      delete[] oldData16;
+      freeBuf(oldData16);
     } else {
       initInternal(DIV_SAMPLE_DEPTH_16BIT,count);
     }
@@ -892,9 +1155,9 @@ void DivSample::convert(DivSampleDepth newDepth, unsigned int formatMask) {
   rate=(int)((double)rate*(tRate/sRate)); \
   samples=finalCount; \
   if (depth==DIV_SAMPLE_DEPTH_16BIT) { \
-    delete[] oldData16; \
+    freeBuf(oldData16); \
   } else if (depth==DIV_SAMPLE_DEPTH_8BIT) { \
-    delete[] oldData8; \
+    freeBuf(oldData8); \
   }
 
 bool DivSample::resampleNone(double sRate, double tRate) {
@@ -963,212 +1226,348 @@ bool DivSample::resampleLinear(double sRate, double tRate) {
   return true;
 }
 
-bool DivSample::resampleCubic(double sRate, double tRate) {
-  RESAMPLE_BEGIN;
+// resampling is split into chunks of output samples, which run in parallel.
+// the position of each chunk is found by stepping through the sample first (which is cheap),
+// so that the result is the same as that of a single pass.
+#define DIV_RESAMPLE_CHUNK 32768
+// output samples given to a kernel at once
+#define DIV_RESAMPLE_BLOCK 1024
+#define DIV_RESAMPLE_MAX_THREADS 8
+
+struct DivResampleChunk {
+  const void* in;
+  void* out;
+  unsigned int samples;
+  int loopStart;
+  int finalCount;
+  // output samples to write
+  int first, last;
+  // position at the start of the chunk
+  double posFrac;
+  unsigned int posInt;
+  double factor;
+  const float* table;
+  DivResampleChunk():
+    in(NULL),
+    out(NULL),
+    samples(0),
+    loopStart(-1),
+    finalCount(0),
+    first(0),
+    last(0),
+    posFrac(0.0),
+    posInt(0),
+    factor(1.0),
+    table(NULL) {}
+};
 
-  double posFrac=0;
-  unsigned int posInt=0;
-  double factor=sRate/tRate;
-  float* cubicTable=DivFilterTables::getCubicTable();
+static void runResampleChunks(std::vector<DivResampleChunk>& chunks, void (*func)(void*), unsigned int threads) {
+  if (threads==0) threads=std::thread::hardware_concurrency();
+  if (threads>DIV_RESAMPLE_MAX_THREADS) threads=DIV_RESAMPLE_MAX_THREADS;
+  if (threads>chunks.size()) threads=chunks.size();
+  if (threads<2) {
+    for (DivResampleChunk& i: chunks) {
+      func(&i);
+    }
+    return;
+  }
+  DivWorkPool* pool=new DivWorkPool(threads);
+  for (DivResampleChunk& i: chunks) {
+    pool->push(func,&i);
+  }
+  pool->wait();
+  delete pool;
+}
 
-  if (depth==DIV_SAMPLE_DEPTH_16BIT) {
-    for (int i=0; i<finalCount; i++) {
-      unsigned int n=((unsigned int)(posFrac*1024.0))&1023;
-      float* t=&cubicTable[n<<2];
-      float s0=(posInt<1)?0:oldData16[posInt-1];
-      float s1=(posInt>=samples)?0:oldData16[posInt];
-      float s2=(posInt+1>=samples)?((loopStart>=0 && loopStart<(int)samples)?oldData16[loopStart]:0):oldData16[posInt+1];
-      float s3=(posInt+2>=samples)?((loopStart>=0 && loopStart<(int)samples)?oldData16[loopStart]:0):oldData16[posInt+2];
-
-      float result=s0*t[0]+s1*t[1]+s2*t[2]+s3*t[3];
-      if (result<-32768) result=-32768;
-      if (result>32767) result=32767;
-      data16[i]=result;
+// splits [0,finalCount) into chunks. the caller fills in the start positions.
+static void makeResampleChunks(std::vector<DivResampleChunk>& chunks, DivResampleChunk& base) {
+  for (int i=0; i<base.finalCount; i+=DIV_RESAMPLE_CHUNK) {
+    DivResampleChunk c=base;
+    c.first=i;
+    c.last=MIN(i+DIV_RESAMPLE_CHUNK,base.finalCount);
+    chunks.push_back(c);
+  }
+}
 
-      posFrac+=factor;
+template<typename T, int minVal, int maxVal> static void resampleCubicChunk(void* arg) {
+  DivResampleChunk* c=(DivResampleChunk*)arg;
+  const T* in=(const T*)c->in;
+  T* out=(T*)c->out;
+  const unsigned int samples=c->samples;
+  const int loopStart=c->loopStart;
+  double posFrac=c->posFrac;
+  unsigned int posInt=c->posInt;
+  int pos[DIV_RESAMPLE_BLOCK];
+  int phase[DIV_RESAMPLE_BLOCK];
+  float result[DIV_RESAMPLE_BLOCK];
+  std::vector<float> src;
+
+  for (int i=c->first; i<c->last; i+=DIV_RESAMPLE_BLOCK) {
+    int blockLen=MIN(DIV_RESAMPLE_BLOCK,c->last-i);
+    bool inside=true;
+    for (int k=0; k<blockLen; k++) {
+      pos[k]=posInt;
+      phase[k]=((unsigned int)(posFrac*1024.0))&1023;
+      if (posInt<1 || posInt+2>=samples) inside=false;
+
+      posFrac+=c->factor;
       while (posFrac>=1.0) {
         posFrac-=1.0;
         posInt++;
       }
     }
-  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
-    for (int i=0; i<finalCount; i++) {
-      unsigned int n=((unsigned int)(posFrac*1024.0))&1023;
-      float* t=&cubicTable[n<<2];
-      float s0=(posInt<1)?0:oldData8[posInt-1];
-      float s1=(posInt>=samples)?0:oldData8[posInt];
-      float s2=(posInt+1>=samples)?((loopStart>=0 && loopStart<(int)samples)?oldData8[loopStart]:0):oldData8[posInt+1];
-      float s3=(posInt+2>=samples)?((loopStart>=0 && loopStart<(int)samples)?oldData8[loopStart]:0):oldData8[posInt+2];
-
-      float result=s0*t[0]+s1*t[1]+s2*t[2]+s3*t[3];
-      if (result<-128) result=-128;
-      if (result>127) result=127;
-      data8[i]=result;
 
-      posFrac+=factor;
-      while (posFrac>=1.0) {
-        posFrac-=1.0;
-        posInt++;
+    if (inside) {
+      // every point is within the sample, so use the kernel
+      int base=pos[0]-1;
+      src.resize(pos[blockLen-1]+3-base);
+      for (size_t k=0; k<src.size(); k++) {
+        src[k]=in[base+k];
+      }
+      for (int k=0; k<blockLen; k++) {
+        pos[k]-=base;
+      }
+      divResampleCubic(src.data(),pos,phase,c->table,result,blockLen);
+    } else {
+      for (int k=0; k<blockLen; k++) {
+        unsigned int p=pos[k];
+        const float* t=&c->table[phase[k]<<2];
+        float s0=(p<1)?0:in[p-1];
+        float s1=(p>=samples)?0:in[p];
+        float s2=(p+1>=samples)?((loopStart>=0 && loopStart<(int)samples)?in[loopStart]:0):in[p+1];
+        float s3=(p+2>=samples)?((loopStart>=0 && loopStart<(int)samples)?in[loopStart]:0):in[p+2];
+        result[k]=s0*t[0]+s1*t[1]+s2*t[2]+s3*t[3];
       }
     }
-  }
 
-  RESAMPLE_END;
-  return true;
+    for (int k=0; k<blockLen; k++) {
+      float r=result[k];
+      if (r<minVal) r=minVal;
+      if (r>maxVal) r=maxVal;
+      out[i+k]=r;
+    }
+  }
 }
 
-bool DivSample::resampleBlep(double sRate, double tRate) {
+bool DivSample::resampleCubic(double sRate, double tRate, unsigned int threads) {
   RESAMPLE_BEGIN;
 
+  DivResampleChunk base;
+  base.in=(depth==DIV_SAMPLE_DEPTH_16BIT)?(const void*)oldData16:(const void*)oldData8;
+  base.out=(depth==DIV_SAMPLE_DEPTH_16BIT)?(void*)data16:(void*)data8;
+  base.samples=samples;
+  base.loopStart=loopStart;
+  base.finalCount=finalCount;
+  base.factor=sRate/tRate;
+  base.table=DivFilterTables::getCubicTable();
+
+  std::vector<DivResampleChunk> chunks;
+  makeResampleChunks(chunks,base);
+
   double posFrac=0;
   unsigned int posInt=0;
-  double factor=tRate/sRate;
-  float* sincITable=DivFilterTables::getSincIntegralTable();
-
-  float* floatData=new float[finalCount];
-  memset(floatData,0,finalCount*sizeof(float));
+  size_t nextChunk=0;
+  for (int i=0; i<finalCount && nextChunk<chunks.size(); i++) {
+    if (i==chunks[nextChunk].first) {
+      chunks[nextChunk].posFrac=posFrac;
+      chunks[nextChunk].posInt=posInt;
+      nextChunk++;
+    }
+    posFrac+=base.factor;
+    while (posFrac>=1.0) {
+      posFrac-=1.0;
+      posInt++;
+    }
+  }
 
   if (depth==DIV_SAMPLE_DEPTH_16BIT) {
-    memset(data16,0,finalCount*sizeof(short));
-    for (int i=0; i<finalCount; i++) {
-      if (posInt<samples) {
-        data16[i]=oldData16[posInt];
-      }
-      
-      posFrac+=1.0;
-      while (posFrac>=1.0) {
-        unsigned int n=((unsigned int)(posFrac*8192.0))&8191;
-        posFrac-=factor;
-        posInt++;
+    runResampleChunks(chunks,resampleCubicChunk<short,-32768,32767>,threads);
+  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
+    runResampleChunks(chunks,resampleCubicChunk<signed char,-128,127>,threads);
+  }
 
-        float* t1=&sincITable[(8191-n)<<3];
-        float* t2=&sincITable[n<<3];
-        float delta=oldData16[posInt]-oldData16[posInt-1];
+  RESAMPLE_END;
+  return true;
+}
 
-        for (int j=0; j<8; j++) {
-          if (i-j>0) {
-            floatData[i-j]+=t1[j]*-delta;
-          }
-          if (i+j+1<finalCount) {
-            floatData[i+j+1]+=t2[j]*delta;
-          }
-        }
-      }
-    }
-    for (int i=0; i<finalCount; i++) {
-      float result=floatData[i]+data16[i];
-      if (result<-32768) result=-32768;
-      if (result>32767) result=32767;
-      data16[i]=round(result);
+// a step at output i changes outputs i-7 to i+8, so a chunk also runs the steps
+// of the 8 outputs on either side of it and keeps what falls within it.
+template<typename T, int minVal, int maxVal> static void resampleBlepChunk(void* arg) {
+  DivResampleChunk* c=(DivResampleChunk*)arg;
+  const T* in=(const T*)c->in;
+  T* out=(T*)c->out;
+  const unsigned int samples=c->samples;
+  const int start=MAX(0,c->first-8);
+  const int end=MIN(c->finalCount,c->last+8);
+  const int base=start-8;
+  double posFrac=c->posFrac;
+  unsigned int posInt=c->posInt;
+  DivResampleStepFunc step=divResampleGetStepFunc();
+
+  std::vector<float> floatData(end-start+17,0.0f);
+  std::vector<T> stepBase(c->last-c->first,0);
+
+  for (int i=start; i<end; i++) {
+    if (i>=c->first && i<c->last && posInt<samples) {
+      stepBase[i-c->first]=in[posInt];
     }
-  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
-    memset(data8,0,finalCount);
-    for (int i=0; i<finalCount; i++) {
-      if (posInt<samples) {
-        data8[i]=oldData8[posInt];
-      }
-      
-      posFrac+=1.0;
-      while (posFrac>=1.0) {
-        unsigned int n=((unsigned int)(posFrac*8192.0))&8191;
-        posFrac-=factor;
-        posInt++;
 
-        float* t1=&sincITable[(8191-n)<<3];
-        float* t2=&sincITable[n<<3];
-        float delta=oldData8[posInt]-oldData8[posInt-1];
+    posFrac+=1.0;
+    while (posFrac>=1.0) {
+      unsigned int n=((unsigned int)(posFrac*8192.0))&8191;
+      posFrac-=c->factor;
+      posInt++;
 
-        for (int j=0; j<8; j++) {
-          if (i-j>0) {
-            floatData[i-j]+=t1[j]*-delta;
-          }
-          if (i+j+1<finalCount) {
-            floatData[i+j+1]+=t2[j]*delta;
-          }
-        }
-      }
-    }
-    for (int i=0; i<finalCount; i++) {
-      float result=floatData[i]+data8[i];
-      if (result<-128) result=-128;
-      if (result>127) result=127;
-      data8[i]=round(result);
+      float delta=in[posInt]-in[posInt-1];
+      step(&floatData[i-base],&c->table[(8191-n)<<3],&c->table[n<<3],delta);
     }
   }
-  delete[] floatData;
 
-  RESAMPLE_END;
-  return true;
+  for (int i=c->first; i<c->last; i++) {
+    // nothing is added to the first output
+    float result=((i==0)?0.0f:floatData[i-base])+stepBase[i-c->first];
+    if (result<minVal) result=minVal;
+    if (result>maxVal) result=maxVal;
+    out[i]=round(result);
+  }
 }
 
-bool DivSample::resampleSinc(double sRate, double tRate) {
+bool DivSample::resampleBlep(double sRate, double tRate, unsigned int threads) {
   RESAMPLE_BEGIN;
 
+  DivResampleChunk base;
+  base.in=(depth==DIV_SAMPLE_DEPTH_16BIT)?(const void*)oldData16:(const void*)oldData8;
+  base.out=(depth==DIV_SAMPLE_DEPTH_16BIT)?(void*)data16:(void*)data8;
+  base.samples=samples;
+  base.loopStart=loopStart;
+  base.finalCount=finalCount;
+  base.factor=tRate/sRate;
+  base.table=DivFilterTables::getSincIntegralTable();
+
+  std::vector<DivResampleChunk> chunks;
+  makeResampleChunks(chunks,base);
+
   double posFrac=0;
   unsigned int posInt=0;
-  double factor=sRate/tRate;
-  float* sincTable=DivFilterTables::getSincTable();
-  float s[16];
-
-  memset(s,0,16*sizeof(float));
+  size_t nextChunk=0;
+  for (int i=0; i<finalCount && nextChunk<chunks.size(); i++) {
+    if (i==MAX(0,chunks[nextChunk].first-8)) {
+      chunks[nextChunk].posFrac=posFrac;
+      chunks[nextChunk].posInt=posInt;
+      nextChunk++;
+    }
+    posFrac+=1.0;
+    while (posFrac>=1.0) {
+      posFrac-=base.factor;
+      posInt++;
+    }
+  }
 
   if (depth==DIV_SAMPLE_DEPTH_16BIT) {
-    for (int i=0; i<finalCount+8; i++) {
-      unsigned int n=((unsigned int)(posFrac*8192.0))&8191;
-      float result=0;
-      float* t1=&sincTable[(8191-n)<<3];
-      float* t2=&sincTable[n<<3];
-      for (int j=0; j<8; j++) {
-        result+=s[j]*t2[7-j];
-        result+=s[8+j]*t1[j];
-      }
-      if (result<-32768) result=-32768;
-      if (result>32767) result=32767;
-      if (i>=8) {
-        data16[i-8]=result;
-      }
-      
-      posFrac+=factor;
+    runResampleChunks(chunks,resampleBlepChunk<short,-32768,32767>,threads);
+  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
+    runResampleChunks(chunks,resampleBlepChunk<signed char,-128,127>,threads);
+  }
+
+  RESAMPLE_END;
+  return true;
+}
+
+template<typename T, int minVal, int maxVal> static void resampleSincChunk(void* arg) {
+  DivResampleChunk* c=(DivResampleChunk*)arg;
+  const T* in=(const T*)c->in;
+  T* out=(T*)c->out;
+  const unsigned int samples=c->samples;
+  double posFrac=c->posFrac;
+  unsigned int posInt=c->posInt;
+  int pos[DIV_RESAMPLE_BLOCK];
+  int phase[DIV_RESAMPLE_BLOCK];
+  float result[DIV_RESAMPLE_BLOCK];
+  std::vector<float> src;
+
+  // fewer outputs at a time when downsampling, so that the input range stays small
+  int blockMax=DIV_RESAMPLE_BLOCK/MAX(1,(int)ceil(c->factor));
+  if (blockMax<16) blockMax=16;
+
+  for (int i=c->first; i<c->last; i+=blockMax) {
+    int blockLen=MIN(blockMax,c->last-i);
+    for (int k=0; k<blockLen; k++) {
+      // past this point the window is silent
+      pos[k]=MIN(posInt,samples+15);
+      phase[k]=((unsigned int)(posFrac*8192.0))&8191;
+
+      posFrac+=c->factor;
       while (posFrac>=1.0) {
         posFrac-=1.0;
         posInt++;
-
-        for (int j=0; j<15; j++) s[j]=s[j+1];
-        s[15]=(posInt>=samples)?0:oldData16[posInt];
       }
     }
-  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
-    for (int i=0; i<finalCount+8; i++) {
-      unsigned int n=((unsigned int)(posFrac*8192.0))&8191;
-      float result=0;
-      float* t1=&sincTable[(8191-n)<<3];
-      float* t2=&sincTable[n<<3];
-      for (int j=0; j<8; j++) {
-        result+=s[j]*t2[7-j];
-        result+=s[8+j]*t1[j];
-      }
-      if (result<-128) result=-128;
-      if (result>127) result=127;
-      if (i>=8) {
-        data8[i-8]=result;
-      }
-      
-      posFrac+=factor;
-      while (posFrac>=1.0) {
-        posFrac-=1.0;
-        posInt++;
 
-        for (int j=0; j<15; j++) s[j]=s[j+1];
-        s[15]=(posInt>=samples)?0:oldData8[posInt];
-      }
+    // the window of an output holds the 16 input samples up to the position.
+    // the first one is never read.
+    int base=pos[0]-15;
+    src.resize(pos[blockLen-1]+1-base);
+    for (size_t k=0; k<src.size(); k++) {
+      int p=base+(int)k;
+      src[k]=(p<1 || p>=(int)samples)?0:in[p];
+    }
+    for (int k=0; k<blockLen; k++) {
+      pos[k]-=base;
+    }
+    divResampleSinc(src.data(),pos,phase,c->table,result,blockLen);
+
+    for (int k=0; k<blockLen; k++) {
+      float r=result[k];
+      if (r<minVal) r=minVal;
+      if (r>maxVal) r=maxVal;
+      out[i+k]=r;
+    }
+  }
+}
+
+bool DivSample::resampleSinc(double sRate, double tRate, unsigned int threads) {
+  RESAMPLE_BEGIN;
+
+  DivResampleChunk base;
+  base.in=(depth==DIV_SAMPLE_DEPTH_16BIT)?(const void*)oldData16:(const void*)oldData8;
+  base.out=(depth==DIV_SAMPLE_DEPTH_16BIT)?(void*)data16:(void*)data8;
+  base.samples=samples;
+  base.loopStart=loopStart;
+  base.finalCount=finalCount;
+  base.factor=sRate/tRate;
+  base.table=DivFilterTables::getSincTable();
+
+  std::vector<DivResampleChunk> chunks;
+  makeResampleChunks(chunks,base);
+
+  // output i is computed at step i+8
+  double posFrac=0;
+  unsigned int posInt=0;
+  size_t nextChunk=0;
+  for (int i=0; i<finalCount+8 && nextChunk<chunks.size(); i++) {
+    if (i==chunks[nextChunk].first+8) {
+      chunks[nextChunk].posFrac=posFrac;
+      chunks[nextChunk].posInt=posInt;
+      nextChunk++;
+    }
+    posFrac+=base.factor;
+    while (posFrac>=1.0) {
+      posFrac-=1.0;
+      posInt++;
     }
   }
 
+  if (depth==DIV_SAMPLE_DEPTH_16BIT) {
+    runResampleChunks(chunks,resampleSincChunk<short,-32768,32767>,threads);
+  } else if (depth==DIV_SAMPLE_DEPTH_8BIT) {
+    runResampleChunks(chunks,resampleSincChunk<signed char,-128,127>,threads);
+  }
+
   RESAMPLE_END;
   return true;
 }
 
-bool DivSample::resample(double sRate, double tRate, int filter) {
+bool DivSample::resample(double sRate, double tRate, int filter, unsigned int threads) {
   if (depth!=DIV_SAMPLE_DEPTH_8BIT && depth!=DIV_SAMPLE_DEPTH_16BIT) return false;
   switch (filter) {
     case DIV_RESAMPLE_NONE:
@@ -1178,19 +1577,19 @@ bool DivSample::resample(double sRate, double tRate, int filter) {
       return resampleLinear(sRate,tRate);
       break;
     case DIV_RESAMPLE_CUBIC:
-      return resampleCubic(sRate,tRate);
+      return resampleCubic(sRate,tRate,threads);
       break;
     case DIV_RESAMPLE_BLEP:
-      return resampleBlep(sRate,tRate);
+      return resampleBlep(sRate,tRate,threads);
       break;
     case DIV_RESAMPLE_SINC:
-      return resampleSinc(sRate,tRate);
+      return resampleSinc(sRate,tRate,threads);
       break;
     case DIV_RESAMPLE_BEST:
       if (tRate>sRate) {
-        return resampleSinc(sRate,tRate);
+        return resampleSinc(sRate,tRate,threads);
       } else {
-        return resampleBlep(sRate,tRate);
+        return resampleBlep(sRate,tRate,threads);
       }
       break;
   }
@@ -1235,7 +1634,35 @@ signed char adpcmKTable[16]={
   0, 1, 2, 4, 8, 16, 32, 64, -128, -64, -32, -16, -8, -4, -2, -1
 };
 
-void DivSample::render(unsigned int formatMask) {
+// formats which are worth caching (those with a non-trivial encoder)
+#define DIV_SAMPLE_CACHED_FORMATS ( \
+  (1U<<DIV_SAMPLE_DEPTH_YMZ_ADPCM)| \
+  (1U<<DIV_SAMPLE_DEPTH_QSOUND_ADPCM)| \
+  (1U<<DIV_SAMPLE_DEPTH_ADPCM_A)| \
+  (1U<<DIV_SAMPLE_DEPTH_ADPCM_B)| \
+  (1U<<DIV_SAMPLE_DEPTH_BRR)| \
+  (1U<<DIV_SAMPLE_DEPTH_VOX)| \
+  (1U<<DIV_SAMPLE_DEPTH_IMA_ADPCM) \
+)
+
+bool DivSample::renderFromCache(DivSampleCache* cache, const DivSampleCacheKey& base, DivSampleCacheKey& key, DivSampleDepth d, int count, const int* params, int paramCount) {
+  if (cache==NULL) return false;
+  int keyParams[8];
+  keyParams[0]=d;
+  keyParams[1]=count;
+  for (int i=0; i<paramCount && i<6; i++) {
+    keyParams[2+i]=params[i];
+  }
+  key=DivSampleCache::makeKey(base,keyParams,2+MIN(paramCount,6));
+  return cache->get(key,(unsigned char*)getBuf(d),getPaddedLen(d,count));
+}
+
+void DivSample::renderToCache(DivSampleCache* cache, const DivSampleCacheKey& key, DivSampleDepth d, int count) {
+  if (cache==NULL) return;
+  cache->put(key,(const unsigned char*)getBuf(d),getPaddedLen(d,count));
+}
+
+void DivSample::render(unsigned int formatMask, DivSampleCache* cache, int brrPaths) {
   // step 1: convert to 16-bit if needed
   if (depth!=DIV_SAMPLE_DEPTH_16BIT) {
     if (!initInternal(DIV_SAMPLE_DEPTH_16BIT,samples)) return;
@@ -1322,6 +1749,16 @@ void DivSample::render(unsigned int formatMask) {
     }
   }
 
+  // the encoders below only look at the 16-bit data (including its padding)
+  DivSampleCacheKey baseKey, key;
+  if (cache!=NULL) {
+    if (formatMask&DIV_SAMPLE_CACHED_FORMATS&(~(1U<<depth))) {
+      baseKey=DivSampleCache::makeKey(data16,getPaddedLen(DIV_SAMPLE_DEPTH_16BIT,samples),NULL,0);
+    } else {
+      cache=NULL;
+    }
+  }
+
   // step 2: render to other formats
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_1BIT)) { // 1-bit
     if (!initInternal(DIV_SAMPLE_DEPTH_1BIT,samples)) return;
@@ -1351,20 +1788,32 @@ void DivSample::render(unsigned int formatMask) {
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_YMZ_ADPCM)) { // YMZ ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples)) return;
-    ymz_encode(data16,dataZ,(samples+7)&(~0x7));
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples)) {
+      ymz_encode(data16,dataZ,(samples+7)&(~0x7));
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples);
+    }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_QSOUND_ADPCM)) { // QSound ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples)) return;
-    bs_encode(data16,dataQSoundA,samples);
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples)) {
+      bs_encode(data16,dataQSoundA,samples);
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples);
+    }
   }
   // TODO: pad to 256.
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_A)) { // ADPCM-A
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_A,samples)) return;
-    yma_encode(data16,dataA,(samples+511)&(~0x1ff));
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_ADPCM_A,samples)) {
+      yma_encode(data16,dataA,(samples+511)&(~0x1ff));
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_ADPCM_A,samples);
+    }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_B)) { // ADPCM-B
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_B,samples)) return;
-    ymb_encode(data16,dataB,(samples+511)&(~0x1ff));
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_ADPCM_B,samples)) {
+      ymb_encode(data16,dataB,(samples+511)&(~0x1ff));
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_ADPCM_B,samples);
+    }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_K)) { // K05 ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_K,samples)) return;
@@ -1448,12 +1897,27 @@ void DivSample::render(unsigned int formatMask) {
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_BRR)) { // BRR
     int sampleCount=loop?loopEnd:samples;
+    int brrParams[4];
+    brrParams[0]=loop?loopStart:-1;
+    brrParams[1]=brrEmphasis;
+    brrParams[2]=brrNoFilter;
+    brrParams[3]=brrPaths;
     if (!initInternal(DIV_SAMPLE_DEPTH_BRR,sampleCount)) return;
-    brrEncode(data16,dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis,brrNoFilter);
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_BRR,sampleCount,brrParams,4)) {
+      if (brrPaths>0) {
+        brrEncodeTrellis(data16,dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis,brrNoFilter,brrPaths);
+      } else {
+        brrEncode(data16,dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis,brrNoFilter);
+      }
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_BRR,sampleCount);
+    }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_VOX)) { // VOX
     if (!initInternal(DIV_SAMPLE_DEPTH_VOX,samples)) return;
-    oki_encode(data16,dataVOX,samples);
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_VOX,samples)) {
+      oki_encode(data16,dataVOX,samples);
+      renderToCache(cache,key,DIV_SAMPLE_DEPTH_VOX,samples);
+    }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_MULAW)) { // µ-law
     if (!initInternal(DIV_SAMPLE_DEPTH_MULAW,samples)) return;
@@ -1491,19 +1955,22 @@ void DivSample::render(unsigned int formatMask) {
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_IMA_ADPCM)) { // IMA ADPCM
     if (!initInternal(DIV_SAMPLE_DEPTH_IMA_ADPCM,samples)) return;
-    int delta[2];
-    delta[0]=0;
-    delta[1]=0;
-
-    void* codec=adpcm_create_context(1,1,NOISE_SHAPING_OFF,delta);
-    if (codec==NULL) {
-      logE("oh no IMA encoder could not be created!");
-    } else {
-      size_t whyPointer=0;
-      adpcm_encode_block(codec,dataIMA,&whyPointer,data16,samples);
-      if (whyPointer!=lengthIMA) logW("IMA length mismatch! %d -> %d!=%d",(int)samples,(int)whyPointer,(int)lengthIMA);
+    if (!renderFromCache(cache,baseKey,key,DIV_SAMPLE_DEPTH_IMA_ADPCM,samples)) {
+      int delta[2];
+      delta[0]=0;
+      delta[1]=0;
+
+      void* codec=adpcm_create_context(1,1,NOISE_SHAPING_OFF,delta);
+      if (codec==NULL) {
+        logE("oh no IMA encoder could not be created!");
+      } else {
+        size_t whyPointer=0;
+        adpcm_encode_block(codec,dataIMA,&whyPointer,data16,samples);
+        if (whyPointer!=lengthIMA) logW("IMA length mismatch! %d -> %d!=%d",(int)samples,(int)whyPointer,(int)lengthIMA);
 
-      adpcm_free_context(codec);
+        adpcm_free_context(codec);
+        renderToCache(cache,key,DIV_SAMPLE_DEPTH_IMA_ADPCM,samples);
+      }
     }
   }
   if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_12BIT)) { // 12-bit PCM (MultiPCM)
@@ -1519,7 +1986,11 @@ void DivSample::render(unsigned int formatMask) {
 }
 
 void* DivSample::getCurBuf() {
-  switch (depth) {
+  return getBuf(depth);
+}
+
+void* DivSample::getBuf(DivSampleDepth d) {
+  switch (d) {
     case DIV_SAMPLE_DEPTH_1BIT:
       return data1;
     case DIV_SAMPLE_DEPTH_1BIT_DPCM:
@@ -1597,6 +2068,8 @@ unsigned int DivSample::getCurBufLen() {
 DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
   DivSampleHistory* h;
   if (data) {
+    // the data is about to change
+    invalidatePeaks();
     unsigned char* duplicate;
     if (getCurBuf()==NULL) {
       duplicate=NULL;
@@ -1605,24 +2078,199 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
       memcpy(duplicate,getCurBuf(),getCurBufLen());
     }
     h=new DivSampleHistory(duplicate,getCurBufLen(),samples,depth,rate,centerRate,loopStart,loopEnd,loop,brrEmphasis,brrNoFilter,dither,loopMode);
+    h->pack();
   } else {
     h=new DivSampleHistory(depth,rate,centerRate,loopStart,loopEnd,loop,brrEmphasis,brrNoFilter,dither,loopMode);
   }
-  if (!doNotPush) {
-    while (!redoHist.empty()) {
-      DivSampleHistory* h=redoHist.back();
-      delete h;
-      redoHist.pop_back();
-    }
-    if (undoHist.size()>100) undoHist.pop_front();
-    undoHist.push_back(h);
+  if (!doNotPush) pushUndo(h);
+  return h;
+}
+
+DivSampleHistory* DivSample::prepareUndoRange(unsigned int start, unsigned int end, unsigned int newLen, bool doNotPush) {
+  if (depth!=DIV_SAMPLE_DEPTH_8BIT && depth!=DIV_SAMPLE_DEPTH_16BIT) {
+    return prepareUndo(true,doNotPush);
   }
+  if (end>samples) end=samples;
+  if (start>end) start=end;
+
+  unsigned int sampleSize=(depth==DIV_SAMPLE_DEPTH_16BIT)?2:1;
+  unsigned int len=(end-start)*sampleSize;
+  unsigned char* duplicate=NULL;
+  if (len>0 && getCurBuf()!=NULL) {
+    duplicate=new unsigned char[len];
+    memcpy(duplicate,(unsigned char*)getCurBuf()+start*sampleSize,len);
+  }
+  if (newLen==end-start) {
+    invalidatePeaks(start,end);
+  } else {
+    invalidatePeaks();
+  }
+
+  DivSampleHistory* h=new DivSampleHistory(duplicate,len,end-start,depth,rate,centerRate,loopStart,loopEnd,loop,brrEmphasis,brrNoFilter,dither,loopMode);
+  h->isRange=true;
+  h->rangeStart=start;
+  h->rangeNewLen=newLen;
+  h->pack();
+  if (!doNotPush) pushUndo(h);
   return h;
 }
 
+void DivSample::pushUndo(DivSampleHistory* h) {
+  while (!redoHist.empty()) {
+    delete redoHist.back();
+    redoHist.pop_back();
+  }
+  if (undoHist.size()>100) {
+    delete undoHist.front();
+    undoHist.pop_front();
+  }
+  // reap finished compression threads
+  for (size_t i=0; i<undoHist.size(); i++) {
+    undoHist[i]->finishPack(true);
+  }
+  undoHist.push_back(h);
+}
+
+void DivSample::invalidatePeaks(unsigned int start, unsigned int end) {
+  if (start>=end) return;
+  if (peaks.dirtyStart>=peaks.dirtyEnd) {
+    peaks.dirtyStart=start;
+    peaks.dirtyEnd=end;
+    return;
+  }
+  if (start<peaks.dirtyStart) peaks.dirtyStart=start;
+  if (end>peaks.dirtyEnd) peaks.dirtyEnd=end;
+}
+
+template<typename T> static void makePeakBlocks(const T* data, unsigned int samples, unsigned int from, unsigned int to, short* out) {
+  for (unsigned int i=from; i<to; i++) {
+    unsigned int start=i*DIV_SAMPLE_PEAK_BLOCK;
+    unsigned int end=MIN(start+DIV_SAMPLE_PEAK_BLOCK,samples);
+    short min=data[start];
+    short max=data[start];
+    for (unsigned int j=start+1; j<end; j++) {
+      if (data[j]<min) min=data[j];
+      if (data[j]>max) max=data[j];
+    }
+    out[i<<1]=min;
+    out[(i<<1)|1]=max;
+  }
+}
+
+void DivSample::updatePeaks() {
+  const void* data=(depth==DIV_SAMPLE_DEPTH_8BIT)?(const void*)data8:(const void*)data16;
+  if (data==NULL || samples==0) {
+    peaks.levels.clear();
+    peaks.data=data;
+    peaks.samples=samples;
+    peaks.depth=depth;
+    peaks.dirtyStart=0;
+    peaks.dirtyEnd=0;
+    return;
+  }
+
+  if (peaks.data!=data || peaks.samples!=samples || peaks.depth!=depth) {
+    // start over
+    peaks.levels.clear();
+    unsigned int blocks=samples;
+    unsigned int blockSize=DIV_SAMPLE_PEAK_BLOCK;
+    do {
+      blocks=(samples+blockSize-1)/blockSize;
+      peaks.levels.push_back(std::vector<short>(blocks*2));
+      blockSize<<=DIV_SAMPLE_PEAK_SHIFT;
+    } while (blocks>1);
+    peaks.data=data;
+    peaks.samples=samples;
+    peaks.depth=depth;
+    peaks.dirtyStart=0;
+    peaks.dirtyEnd=samples;
+  }
+
+  if (peaks.dirtyEnd>samples) peaks.dirtyEnd=samples;
+  if (peaks.dirtyStart>=peaks.dirtyEnd) return;
+
+  // update the blocks of the finest level which changed, and then those above them
+  unsigned int from=peaks.dirtyStart/DIV_SAMPLE_PEAK_BLOCK;
+  unsigned int to=(peaks.dirtyEnd+DIV_SAMPLE_PEAK_BLOCK-1)/DIV_SAMPLE_PEAK_BLOCK;
+  if (depth==DIV_SAMPLE_DEPTH_8BIT) {
+    makePeakBlocks(data8,samples,from,to,peaks.levels[0].data());
+  } else {
+    makePeakBlocks(data16,samples,from,to,peaks.levels[0].data());
+  }
+  for (size_t i=1; i<peaks.levels.size(); i++) {
+    const std::vector<short>& prev=peaks.levels[i-1];
+    std::vector<short>& cur=peaks.levels[i];
+    unsigned int prevBlocks=prev.size()>>1;
+    from>>=DIV_SAMPLE_PEAK_SHIFT;
+    to=((to-1)>>DIV_SAMPLE_PEAK_SHIFT)+1;
+    for (unsigned int j=from; j<to; j++) {
+      unsigned int start=j<<DIV_SAMPLE_PEAK_SHIFT;
+      unsigned int end=MIN(start+(1<<DIV_SAMPLE_PEAK_SHIFT),prevBlocks);
+      short min=prev[start<<1];
+      short max=prev[(start<<1)|1];
+      for (unsigned int k=start+1; k<end; k++) {
+        if (prev[k<<1]<min) min=prev[k<<1];
+        if (prev[(k<<1)|1]>max) max=prev[(k<<1)|1];
+      }
+      cur[j<<1]=min;
+      cur[(j<<1)|1]=max;
+    }
+  }
+  peaks.dirtyStart=0;
+  peaks.dirtyEnd=0;
+}
+
+void DivSample::getPeak(unsigned int start, unsigned int end, int& min, int& max) {
+  min=INT_MAX;
+  max=INT_MIN;
+  updatePeaks();
+  if (peaks.levels.empty()) return;
+  if (end>samples) end=samples;
+  if (start>=end) return;
+
+  // read whole blocks of the coarsest level which fits, and smaller ones at the edges
+  unsigned int blockSize=1;
+  int level=-1;
+  auto take=[&](unsigned int pos) {
+    int lo, hi;
+    if (level<0) {
+      lo=hi=(depth==DIV_SAMPLE_DEPTH_8BIT)?data8[pos]:data16[pos];
+    } else {
+      const short* block=&peaks.levels[level][(pos/blockSize)<<1];
+      lo=block[0];
+      hi=block[1];
+    }
+    if (lo<min) min=lo;
+    if (hi>max) max=hi;
+  };
+  while (level+1<(int)peaks.levels.size()) {
+    unsigned int nextSize=DIV_SAMPLE_PEAK_BLOCK<<((level+1)*DIV_SAMPLE_PEAK_SHIFT);
+    while (start<end && (start%nextSize)!=0) {
+      take(start);
+      start+=blockSize;
+    }
+    while (start<end && (end%nextSize)!=0) {
+      end-=blockSize;
+      take(end);
+    }
+    if (start>=end) return;
+    level++;
+    blockSize=nextSize;
+  }
+  while (start<end) {
+    take(start);
+    start+=blockSize;
+  }
+}
+
 #define applyHistory \
-  depth=h->depth; \
-  if (h->hasSample) { \
+  if (h->isRange) { \
+    applyRange(h); \
+  } else { \
+    depth=h->depth; \
+  } \
+  if (h->hasSample && !h->isRange) { \
+    unsigned char* hData=h->getData(); \
     initInternal(h->depth,h->samples); \
     samples=h->samples; \
 \
@@ -1630,8 +2278,8 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
 \
     void* buf=getCurBuf(); \
 \
-    if (buf!=NULL && h->data!=NULL) { \
-      memcpy(buf,h->data,h->length); \
+    if (buf!=NULL && hData!=NULL) { \
+      memcpy(buf,hData,h->length); \
     } \
   } \
   rate=h->rate; \
@@ -1644,11 +2292,38 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
   dither=h->dither; \
   loopMode=h->loopMode;
 
+// put back the samples of a range step
+void DivSample::applyRange(DivSampleHistory* h) {
+  if (h->depth!=depth) {
+    logW("range undo step has a different depth! %d != %d",(int)h->depth,(int)depth);
+    return;
+  }
+  unsigned char* hData=h->getData();
+  if (h->length>0 && hData==NULL) return;
+  if (h->rangeStart+h->rangeNewLen>samples) {
+    logW("range undo step goes past the end of the sample!");
+    return;
+  }
+  if (h->samples>h->rangeNewLen) {
+    insert(h->rangeStart+h->rangeNewLen,h->samples-h->rangeNewLen);
+  } else if (h->samples<h->rangeNewLen) {
+    strip(h->rangeStart+h->samples,h->rangeStart+h->rangeNewLen);
+  }
+  void* buf=getCurBuf();
+  if (buf!=NULL && h->length>0) {
+    memcpy((unsigned char*)buf+h->rangeStart*((depth==DIV_SAMPLE_DEPTH_16BIT)?2:1),hData,h->length);
+  }
+  invalidatePeaks(h->rangeStart,h->rangeStart+h->samples);
+}
+
+// the opposite of an undo step, made before applying it
+#define prepareInverse(h) \
+  (h->isRange?prepareUndoRange(h->rangeStart,h->rangeStart+h->rangeNewLen,h->samples,true):prepareUndo(h->hasSample,true))
 
 int DivSample::undo() {
   if (undoHist.empty()) return 0;
   DivSampleHistory* h=undoHist.back();
-  DivSampleHistory* redo=prepareUndo(h->hasSample,true);
+  DivSampleHistory* redo=prepareInverse(h);
 
   int ret=h->hasSample?2:1;
 
@@ -1663,7 +2338,7 @@ int DivSample::undo() {
 int DivSample::redo() {
   if (redoHist.empty()) return 0;
   DivSampleHistory* h=redoHist.back();
-  DivSampleHistory* undo=prepareUndo(h->hasSample,true);
+  DivSampleHistory* undo=prepareInverse(h);
 
   int ret=h->hasSample?2:1;
 
@@ -1686,8 +2361,8 @@ DivSample::~DivSample() {
     delete h;
     redoHist.pop_back();
   }
-  if (data8) delete[] data8;
-  if (data16) delete[] data16;
+  freeBuf(data8);
+  freeBuf(data16);
   if (data1) delete[] data1;
   if (dataDPCM) delete[] dataDPCM;
   if (dataZ) delete[] dataZ;
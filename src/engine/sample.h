@@ -25,6 +25,22 @@
 #include "safeWriter.h"
 #include "dataErrors.h"
 #include "../fixedQueue.h"
+#include <limits.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// 8/16-bit samples at least this large are stored page-aligned in .fur files,
+// so that they can be used straight out of a mapped file
+#define DIV_SAMPLE_MAP_MIN 65536
+#define DIV_SAMPLE_MAP_ALIGN 4096
+
+// undo steps with at least this much sample data are compressed in the background
+#define DIV_SAMPLE_UNDO_PACK_MIN 262144
+
+class DivMappedFile;
+class DivSampleCache;
+struct DivSampleCacheKey;
 
 enum DivSampleLoopMode: unsigned char {
   DIV_SAMPLE_LOOP_FORWARD=0,
@@ -52,6 +68,32 @@ enum DivSampleDepth: unsigned char {
   DIV_SAMPLE_DEPTH_MAX // boundary for sample depth
 };
 
+// samples per block in the finest level of the peak pyramid
+#define DIV_SAMPLE_PEAK_BLOCK 16
+// every level has blocks 1<<DIV_SAMPLE_PEAK_SHIFT times larger than the previous one
+#define DIV_SAMPLE_PEAK_SHIFT 2
+
+/**
+ * the lowest and highest values of a sample in blocks of growing size, so that
+ * its waveform can be drawn at any zoom level without reading every sample.
+ */
+struct DivSamplePeaks {
+  // min/max pairs of every block, for each level
+  std::vector<std::vector<short>> levels;
+  // what they were made from
+  const void* data;
+  unsigned int samples;
+  DivSampleDepth depth;
+  // range which has to be updated
+  unsigned int dirtyStart, dirtyEnd;
+  DivSamplePeaks():
+    data(NULL),
+    samples(0),
+    depth(DIV_SAMPLE_DEPTH_MAX),
+    dirtyStart(0),
+    dirtyEnd(0) {}
+};
+
 enum DivResampleFilters {
   DIV_RESAMPLE_NONE=0,
   DIV_RESAMPLE_LINEAR,
@@ -69,6 +111,33 @@ struct DivSampleHistory {
   bool loop, brrEmphasis, brrNoFilter, dither;
   DivSampleLoopMode loopMode;
   bool hasSample;
+  // if true, data only holds the samples starting at rangeStart, which replace
+  // the rangeNewLen samples there.
+  bool isRange;
+  unsigned int rangeStart, rangeNewLen;
+  // data is compressed by this thread. do not touch it until finishPack().
+  std::thread* packThread;
+  std::atomic<bool> packDone;
+  bool packed;
+  size_t packedLen;
+
+  /**
+   * compress the data in a background thread if it is large enough.
+   */
+  void pack();
+
+  /**
+   * wait for background compression to finish.
+   * @param onlyIfDone if true, don't wait if it is still running.
+   */
+  void finishPack(bool onlyIfDone=false);
+
+  /**
+   * get the uncompressed data, decompressing it if needed.
+   * @return the data, or NULL on error.
+   */
+  unsigned char* getData();
+
   DivSampleHistory(void* d, unsigned int l, unsigned int s, DivSampleDepth de, int r, int cr, int ls, int le, bool lp, bool be, bool bf, bool di, DivSampleLoopMode lm):
     data((unsigned char*)d),
     length(l),
@@ -83,7 +152,14 @@ struct DivSampleHistory {
     brrNoFilter(bf),
     dither(di),
     loopMode(lm),
-    hasSample(true) {}
+    hasSample(true),
+    isRange(false),
+    rangeStart(0),
+    rangeNewLen(0),
+    packThread(NULL),
+    packDone(false),
+    packed(false),
+    packedLen(0) {}
   DivSampleHistory(DivSampleDepth de, int r, int cr, int ls, int le, bool lp, bool be, bool bf, bool di, DivSampleLoopMode lm):
     data(NULL),
     length(0),
@@ -98,7 +174,14 @@ struct DivSampleHistory {
     brrNoFilter(bf),
     dither(di),
     loopMode(lm),
-    hasSample(false) {}
+    hasSample(false),
+    isRange(false),
+    rangeStart(0),
+    rangeNewLen(0),
+    packThread(NULL),
+    packDone(false),
+    packed(false),
+    packedLen(0) {}
   ~DivSampleHistory();
 };
 
@@ -152,22 +235,72 @@ struct DivSample {
 
   unsigned int samples;
 
+  // if not NULL, the data of the current depth lives in this mapped file
+  DivMappedFile* mappedFile;
+  void* mappedBuf;
+
   FixedQueue<DivSampleHistory*,128> undoHist;
   FixedQueue<DivSampleHistory*,128> redoHist;
 
+  DivSamplePeaks peaks;
+
   /**
    * put sample data.
    * @param w a SafeWriter.
+   * @param mappable whether to pad large samples so that they can be mapped. see getMapPadding().
+   */
+  void putSampleData(SafeWriter* w, bool mappable=false);
+
+  /**
+   * get the amount of padding to write before the sample data block, so that the
+   * sample lands on a page boundary.
+   * @param pos where the block would be written.
+   * @return the number of bytes to pad, or 0 if the sample is not large enough to be mapped.
    */
-  void putSampleData(SafeWriter* w);
+  size_t getMapPadding(size_t pos);
 
   /**
    * read sample data.
    * @param reader the reader.
    * @param version the format version.
+   * @param map if not NULL, the mapped file the reader is reading (from offset 0).
+   * aligned samples will point to it rather than being copied.
    * @return a DivDataErrors.
    */
-  DivDataErrors readSampleData(SafeReader& reader, short version);
+  DivDataErrors readSampleData(SafeReader& reader, short version, DivMappedFile* map=NULL);
+
+  /**
+   * copy the sample data out of the mapped file, if it is in one.
+   * @warning do not attempt to do this outside of a synchronized block!
+   */
+  void unmap();
+
+  /**
+   * make a copy of mapped sample data, to be put in place by replaceMapped().
+   * this only reads the mapping, so it may run outside of a synchronized block
+   * as long as the mapped file is referenced.
+   * @param mapped the mapped data (mappedBuf).
+   * @param d the depth of the data.
+   * @param count the number of samples.
+   * @return the copy.
+   */
+  static void* copyMapped(const void* mapped, DivSampleDepth d, unsigned int count);
+
+  /**
+   * replace mapped sample data with a copy made by copyMapped().
+   * @param mapped the data which was copied.
+   * @param copy the copy. it is taken only if this sample still uses mapped with the same depth and length.
+   * @param d the depth passed to copyMapped().
+   * @param count the sample count passed to copyMapped().
+   * @return whether the copy was taken. if not, it shall be freed with freeMappedCopy().
+   * @warning do not attempt to do this outside of a synchronized block!
+   */
+  bool replaceMapped(const void* mapped, void* copy, DivSampleDepth d, unsigned int count);
+
+  /**
+   * free a copy made by copyMapped() which was not taken.
+   */
+  static void freeMappedCopy(void* copy, DivSampleDepth d);
 
   /**
    * check if sample is loopable.
@@ -203,15 +336,20 @@ struct DivSample {
    * @warning DO NOT USE - internal functions
    */
   void setSampleCount(unsigned int count);
+  void freeBuf(signed char* buf);
+  void freeBuf(short* buf);
+  bool isMappable();
+  bool renderFromCache(DivSampleCache* cache, const DivSampleCacheKey& base, DivSampleCacheKey& key, DivSampleDepth d, int count, const int* params=NULL, int paramCount=0);
+  void renderToCache(DivSampleCache* cache, const DivSampleCacheKey& key, DivSampleDepth d, int count);
 
   /**
    * @warning DO NOT USE - internal functions
    */
   bool resampleNone(double sRate, double tRate);
   bool resampleLinear(double sRate, double tRate);
-  bool resampleCubic(double sRate, double tRate);
-  bool resampleBlep(double sRate, double tRate);
-  bool resampleSinc(double sRate, double tRate);
+  bool resampleCubic(double sRate, double tRate, unsigned int threads);
+  bool resampleBlep(double sRate, double tRate, unsigned int threads);
+  bool resampleSinc(double sRate, double tRate, unsigned int threads);
 
   /**
    * save this sample to a file.
@@ -284,9 +422,11 @@ struct DivSample {
    * @param sRate source rate.
    * @param tRate target rate.
    * @param filter the interpolation filter.
+   * @param threads number of threads to use for cubic, band-limited and sinc resampling.
+   * 0 picks a number automatically.
    * @return whether it was successful.
    */
-  bool resample(double sRate, double tRate, int filter);
+  bool resample(double sRate, double tRate, int filter, unsigned int threads=0);
 
   /**
    * convert sample depth.
@@ -297,8 +437,11 @@ struct DivSample {
 
   /**
    * initialize the rest of sample formats for this sample.
+   * @param formatMask the formats to render.
+   * @param cache if not NULL, a cache to look up and store conversions in.
+   * @param brrPaths if not 0, encode BRR using a trellis search with this many paths (see brrEncodeTrellis()).
    */
-  void render(unsigned int formatMask=0xffffffff);
+  void render(unsigned int formatMask=0xffffffff, DivSampleCache* cache=NULL, int brrPaths=0);
 
   /**
    * get the sample data for the current depth.
@@ -306,6 +449,13 @@ struct DivSample {
    */
   void* getCurBuf();
 
+  /**
+   * get the sample data for the specified depth.
+   * @param d the depth.
+   * @return the sample data, or NULL if not created.
+   */
+  void* getBuf(DivSampleDepth d);
+
   /**
    * get the sample data length for the current depth.
    * @return the sample data length.
@@ -320,6 +470,53 @@ struct DivSample {
    */
   DivSampleHistory* prepareUndo(bool data, bool doNotPush=false);
 
+  /**
+   * prepare an undo step for an edit which only changes part of the sample data.
+   * only the affected samples are stored. this is the same as prepareUndo(true)
+   * if the sample is not 8 or 16-bit.
+   * @param start the first sample which will change.
+   * @param end the sample after the last one which will change.
+   * @param newLen how many samples will be in place of those after the edit.
+   * use end-start if the length does not change.
+   * @param doNotPush if this is true, don't push the DivSampleHistory to the undo history.
+   * @return the undo step.
+   */
+  DivSampleHistory* prepareUndoRange(unsigned int start, unsigned int end, unsigned int newLen, bool doNotPush=false);
+
+  /**
+   * @warning DO NOT USE - internal function
+   */
+  void pushUndo(DivSampleHistory* h);
+
+  /**
+   * @warning DO NOT USE - internal function
+   */
+  void applyRange(DivSampleHistory* h);
+
+  /**
+   * mark part of the sample data as changed, so that its peaks are updated.
+   * prepareUndo() and reallocating or rendering the sample do this already.
+   * @param start the first changed sample.
+   * @param end the sample after the last changed one.
+   */
+  void invalidatePeaks(unsigned int start=0, unsigned int end=UINT_MAX);
+
+  /**
+   * get the lowest and highest values in a range of the sample data (data8 if
+   * the sample is 8-bit, data16 otherwise), using the peak pyramid.
+   * this takes about the same time regardless of the length of the range.
+   * @param start the first sample.
+   * @param end the sample after the last one.
+   * @param min set to the lowest value, or INT_MAX if the range is empty.
+   * @param max set to the highest value, or INT_MIN if the range is empty.
+   */
+  void getPeak(unsigned int start, unsigned int end, int& min, int& max);
+
+  /**
+   * @warning DO NOT USE - internal function
+   */
+  void updatePeaks();
+
   /**
    * undo. you may need to call DivEngine::renderSamples afterwards.
    * @warning do not attempt to undo outside of a synchronized block!
@@ -375,7 +572,9 @@ struct DivSample {
     lengthC219(0),
     lengthIMA(0),
     length12(0),
-    samples(0) {
+    samples(0),
+    mappedFile(NULL),
+    mappedBuf(NULL) {
     for (int i=0; i<DIV_MAX_CHIPS; i++) {
       for (int j=0; j<DIV_MAX_SAMPLE_TYPE; j++) {
         renderOn[j][i]=true;
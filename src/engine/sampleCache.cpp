@@ -0,0 +1,352 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "sampleCache.h"
+#include "../ta-log.h"
+#include "../fileutils.h"
+#include <string.h>
+#include <errno.h>
+#include <vector>
+#include <algorithm>
+#include <fmt/printf.h>
+#ifdef _WIN32
+#include <windows.h>
+#include "../utfutils.h"
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#define DIV_SAMPLE_CACHE_MAGIC "FSCE"
+// magic + version + length
+#define DIV_SAMPLE_CACHE_HEADER_SIZE 12
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+  return (x<<r)|(x>>(64-r));
+}
+
+static inline uint64_t mix64(uint64_t x) {
+  x^=x>>33;
+  x*=0xff51afd7ed558ccdULL;
+  x^=x>>33;
+  x*=0xc4ceb9fe1a85ec53ULL;
+  x^=x>>33;
+  return x;
+}
+
+// two independent 64-bit lanes, so that a collision is practically impossible
+DivSampleCacheKey DivSampleCache::makeKey(const void* data, size_t len, const int* params, int paramCount) {
+  const unsigned char* d=(const unsigned char*)data;
+  uint64_t h1=0x9e3779b97f4a7c15ULL^len;
+  uint64_t h2=0x6a09e667f3bcc909ULL+DIV_SAMPLE_CACHE_VERSION;
+  size_t i=0;
+  for (; i+8<=len; i+=8) {
+    uint64_t w;
+    memcpy(&w,&d[i],8);
+    h1=rotl64(h1^(w*0x87c37b91114253d5ULL),31)*0x4cf5ad432745937fULL;
+    h2=rotl64(h2+(w^0x52dce729da3ed7b5ULL),27)*0x9e3779b97f4a7c15ULL+h1;
+  }
+  if (i<len) {
+    uint64_t w=0;
+    memcpy(&w,&d[i],len-i);
+    h1=rotl64(h1^(w*0x87c37b91114253d5ULL),31)*0x4cf5ad432745937fULL;
+    h2=rotl64(h2+(w^0x52dce729da3ed7b5ULL),27)*0x9e3779b97f4a7c15ULL+h1;
+  }
+  for (int j=0; j<paramCount; j++) {
+    h1=rotl64(h1^((uint64_t)(unsigned int)params[j]*0x87c37b91114253d5ULL),31)*0x4cf5ad432745937fULL;
+    h2=rotl64(h2+(uint64_t)(unsigned int)params[j],27)*0x9e3779b97f4a7c15ULL+h1;
+  }
+
+  DivSampleCacheKey ret;
+  ret.a=mix64(h1);
+  ret.b=mix64(h2^ret.a);
+  return ret;
+}
+
+DivSampleCacheKey DivSampleCache::makeKey(const DivSampleCacheKey& base, const int* params, int paramCount) {
+  uint64_t baseData[2];
+  baseData[0]=base.a;
+  baseData[1]=base.b;
+  return makeKey(baseData,sizeof(baseData),params,paramCount);
+}
+
+String DivSampleCache::getDiskFileName(const DivSampleCacheKey& key) {
+  return diskPath+DIR_SEPARATOR_STR+fmt::sprintf("%.16llx%.16llx.bin",(unsigned long long)key.a,(unsigned long long)key.b);
+}
+
+void DivSampleCache::trimMem() {
+  while (memUsed>memLimit && !lru.empty()) {
+    auto i=entries.find(lru.back());
+    if (i!=entries.end()) {
+      memUsed-=i->second.len;
+      delete[] i->second.data;
+      entries.erase(i);
+    }
+    lru.pop_back();
+  }
+}
+
+void DivSampleCache::storeMem(const DivSampleCacheKey& key, const unsigned char* data, size_t len) {
+  if (len>memLimit) return;
+  if (entries.find(key)!=entries.end()) return;
+
+  Entry e;
+  e.data=new unsigned char[len];
+  e.len=len;
+  memcpy(e.data,data,len);
+  lru.push_front(key);
+  e.lruPos=lru.begin();
+  entries[key]=e;
+  memUsed+=len;
+  trimMem();
+}
+
+void DivSampleCache::trimDisk() {
+  while (diskUsed>diskLimit && !diskEntries.empty()) {
+    DiskEntry& e=diskEntries.front();
+    deleteFile(getDiskFileName(e.key).c_str());
+    diskUsed-=e.len;
+    diskIndex.erase(e.key);
+    diskEntries.pop_front();
+  }
+}
+
+bool DivSampleCache::loadDisk(const DivSampleCacheKey& key, unsigned char* out, size_t len) {
+  auto i=diskIndex.find(key);
+  if (i==diskIndex.end()) return false;
+  if (i->second->len!=len+DIV_SAMPLE_CACHE_HEADER_SIZE) return false;
+
+  FILE* f=ps_fopen(getDiskFileName(key).c_str(),"rb");
+  if (f==NULL) {
+    diskUsed-=i->second->len;
+    diskEntries.erase(i->second);
+    diskIndex.erase(i);
+    return false;
+  }
+  unsigned char header[DIV_SAMPLE_CACHE_HEADER_SIZE];
+  bool ok=(fread(header,1,DIV_SAMPLE_CACHE_HEADER_SIZE,f)==DIV_SAMPLE_CACHE_HEADER_SIZE);
+  if (ok) {
+    unsigned int version=header[4]|(header[5]<<8)|(header[6]<<16)|(header[7]<<24);
+    unsigned int dataLen=header[8]|(header[9]<<8)|(header[10]<<16)|(header[11]<<24);
+    ok=(memcmp(header,DIV_SAMPLE_CACHE_MAGIC,4)==0 && version==DIV_SAMPLE_CACHE_VERSION && dataLen==len);
+  }
+  if (ok) {
+    ok=(fread(out,1,len,f)==len);
+  }
+  fclose(f);
+
+  if (!ok) {
+    logW("invalid sample cache entry %s!",getDiskFileName(key));
+    return false;
+  }
+
+  // keep recently used entries around for longer
+  diskEntries.splice(diskEntries.end(),diskEntries,i->second);
+  return true;
+}
+
+void DivSampleCache::storeDisk(const DivSampleCacheKey& key, const unsigned char* data, size_t len) {
+  if (len+DIV_SAMPLE_CACHE_HEADER_SIZE>diskLimit) return;
+  if (diskIndex.find(key)!=diskIndex.end()) return;
+
+  String path=getDiskFileName(key);
+  FILE* f=ps_fopen(path.c_str(),"wb");
+  if (f==NULL) {
+    logW("could not write sample cache entry %s! (%s)",path,strerror(errno));
+    return;
+  }
+  unsigned char header[DIV_SAMPLE_CACHE_HEADER_SIZE];
+  memcpy(header,DIV_SAMPLE_CACHE_MAGIC,4);
+  for (int i=0; i<4; i++) {
+    header[4+i]=(DIV_SAMPLE_CACHE_VERSION>>(i*8))&0xff;
+    header[8+i]=(len>>(i*8))&0xff;
+  }
+  bool ok=(fwrite(header,1,DIV_SAMPLE_CACHE_HEADER_SIZE,f)==DIV_SAMPLE_CACHE_HEADER_SIZE);
+  if (ok) ok=(fwrite(data,1,len,f)==len);
+  if (fclose(f)!=0) ok=false;
+  if (!ok) {
+    logW("could not write sample cache entry %s!",path);
+    deleteFile(path.c_str());
+    return;
+  }
+
+  DiskEntry e;
+  e.key=key;
+  e.len=len+DIV_SAMPLE_CACHE_HEADER_SIZE;
+  diskEntries.push_back(e);
+  diskIndex[key]=std::prev(diskEntries.end());
+  diskUsed+=e.len;
+  trimDisk();
+}
+
+static bool parseHex64(const char* s, uint64_t& out) {
+  out=0;
+  for (int i=0; i<16; i++) {
+    out<<=4;
+    if (s[i]>='0' && s[i]<='9') {
+      out|=s[i]-'0';
+    } else if (s[i]>='a' && s[i]<='f') {
+      out|=s[i]-'a'+10;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct DivSampleCacheDiskFile {
+  DivSampleCacheKey key;
+  size_t len;
+  uint64_t time;
+};
+
+static void addDiskFile(std::vector<DivSampleCacheDiskFile>& files, const char* name, size_t len, uint64_t time) {
+  // 32 hex digits and ".bin"
+  if (strlen(name)!=36) return;
+  if (strcmp(&name[32],".bin")!=0) return;
+  DivSampleCacheDiskFile f;
+  if (!parseHex64(name,f.key.a)) return;
+  if (!parseHex64(&name[16],f.key.b)) return;
+  f.len=len;
+  f.time=time;
+  files.push_back(f);
+}
+
+void DivSampleCache::scanDisk() {
+  std::vector<DivSampleCacheDiskFile> files;
+#ifdef _WIN32
+  String findPath=diskPath+String(DIR_SEPARATOR_STR)+String("*.bin");
+  WString findPathW=utf8To16(findPath.c_str());
+  WIN32_FIND_DATAW next;
+  HANDLE dir=FindFirstFileW(findPathW.c_str(),&next);
+  if (dir!=INVALID_HANDLE_VALUE) {
+    do {
+      String nameU=utf16To8(next.cFileName);
+      uint64_t time=((uint64_t)next.ftLastWriteTime.dwHighDateTime<<32)|next.ftLastWriteTime.dwLowDateTime;
+      addDiskFile(files,nameU.c_str(),next.nFileSizeLow,time);
+    } while (FindNextFileW(dir,&next)!=0);
+    FindClose(dir);
+  }
+#else
+  DIR* dir=opendir(diskPath.c_str());
+  if (dir==NULL) {
+    logW("could not open sample cache dir!");
+    return;
+  }
+  while (true) {
+    struct dirent* next=readdir(dir);
+    if (next==NULL) break;
+    if (next->d_name[0]=='.') continue;
+    String path=diskPath+DIR_SEPARATOR_STR+next->d_name;
+    struct stat st;
+    if (stat(path.c_str(),&st)!=0) continue;
+    if (!S_ISREG(st.st_mode)) continue;
+    addDiskFile(files,next->d_name,st.st_size,st.st_mtime);
+  }
+  closedir(dir);
+#endif
+
+  std::sort(files.begin(),files.end(),[](const DivSampleCacheDiskFile& a, const DivSampleCacheDiskFile& b) {
+    return a.time<b.time;
+  });
+  for (DivSampleCacheDiskFile& i: files) {
+    DiskEntry e;
+    e.key=i.key;
+    e.len=i.len;
+    diskEntries.push_back(e);
+    diskIndex[i.key]=std::prev(diskEntries.end());
+    diskUsed+=i.len;
+  }
+  logD("sample cache: %d entries on disk (%d bytes)",(int)diskEntries.size(),(int)diskUsed);
+  trimDisk();
+}
+
+bool DivSampleCache::get(const DivSampleCacheKey& key, unsigned char* out, size_t len) {
+  std::lock_guard<std::mutex> guard(lock);
+  auto i=entries.find(key);
+  if (i!=entries.end()) {
+    if (i->second.len!=len) return false;
+    memcpy(out,i->second.data,len);
+    lru.splice(lru.begin(),lru,i->second.lruPos);
+    return true;
+  }
+  if (!diskPath.empty()) {
+    if (loadDisk(key,out,len)) {
+      if (memLimit>0) storeMem(key,out,len);
+      return true;
+    }
+  }
+  return false;
+}
+
+void DivSampleCache::put(const DivSampleCacheKey& key, const unsigned char* data, size_t len) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (memLimit>0) storeMem(key,data,len);
+  if (!diskPath.empty()) storeDisk(key,data,len);
+}
+
+void DivSampleCache::setLimit(size_t limit) {
+  std::lock_guard<std::mutex> guard(lock);
+  memLimit=limit;
+  trimMem();
+}
+
+void DivSampleCache::setDiskPath(const String& path, size_t limit) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (path==diskPath) {
+    diskLimit=limit;
+    trimDisk();
+    return;
+  }
+  diskEntries.clear();
+  diskIndex.clear();
+  diskUsed=0;
+  diskLimit=limit;
+  diskPath=path;
+  if (diskPath.empty()) return;
+
+  if (!dirExists(diskPath.c_str())) {
+    if (!makeDir(diskPath.c_str())) {
+      logW("could not create sample cache dir! disabling disk cache.");
+      diskPath="";
+      return;
+    }
+  }
+  scanDisk();
+}
+
+void DivSampleCache::clear() {
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto& i: entries) {
+    delete[] i.second.data;
+  }
+  entries.clear();
+  lru.clear();
+  memUsed=0;
+}
+
+DivSampleCache::DivSampleCache():
+  memUsed(0),
+  memLimit(0),
+  diskUsed(0),
+  diskLimit(0) {}
+
+DivSampleCache::~DivSampleCache() {
+  clear();
+}
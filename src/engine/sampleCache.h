@@ -0,0 +1,139 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SAMPLECACHE_H
+#define _SAMPLECACHE_H
+
+#include "../ta-utils.h"
+#include <stdint.h>
+#include <list>
+#include <map>
+#include <mutex>
+
+// bump this whenever the output of a sample encoder changes, so that stale
+// entries (in particular those on disk) are not used anymore.
+#define DIV_SAMPLE_CACHE_VERSION 1
+
+struct DivSampleCacheKey {
+  uint64_t a, b;
+  bool operator<(const DivSampleCacheKey& other) const {
+    if (a!=other.a) return a<other.a;
+    return b<other.b;
+  }
+  bool operator==(const DivSampleCacheKey& other) const {
+    return a==other.a && b==other.b;
+  }
+  DivSampleCacheKey():
+    a(0),
+    b(0) {}
+};
+
+/**
+ * a cache of sample format conversions, indexed by the contents of the source
+ * data and the parameters of the conversion.
+ * entries are kept in memory (least recently used ones are evicted first) and
+ * optionally on disk.
+ * all methods are thread-safe.
+ */
+class DivSampleCache {
+  struct Entry {
+    unsigned char* data;
+    size_t len;
+    std::list<DivSampleCacheKey>::iterator lruPos;
+    Entry():
+      data(NULL),
+      len(0) {}
+  };
+  struct DiskEntry {
+    DivSampleCacheKey key;
+    size_t len;
+  };
+
+  std::mutex lock;
+  std::map<DivSampleCacheKey,Entry> entries;
+  // most recently used first
+  std::list<DivSampleCacheKey> lru;
+  size_t memUsed, memLimit;
+
+  String diskPath;
+  // oldest first
+  std::list<DiskEntry> diskEntries;
+  std::map<DivSampleCacheKey,std::list<DiskEntry>::iterator> diskIndex;
+  size_t diskUsed, diskLimit;
+
+  String getDiskFileName(const DivSampleCacheKey& key);
+  void storeMem(const DivSampleCacheKey& key, const unsigned char* data, size_t len);
+  bool loadDisk(const DivSampleCacheKey& key, unsigned char* out, size_t len);
+  void storeDisk(const DivSampleCacheKey& key, const unsigned char* data, size_t len);
+  void trimMem();
+  void trimDisk();
+  void scanDisk();
+
+  public:
+    /**
+     * compute a cache key.
+     * @param data the source data.
+     * @param len its length in bytes.
+     * @param params parameters of the conversion (e.g. target format and encoder options).
+     * @param paramCount number of parameters.
+     */
+    static DivSampleCacheKey makeKey(const void* data, size_t len, const int* params, int paramCount);
+
+    /**
+     * derive a cache key from another one (e.g. to avoid hashing the same data again).
+     */
+    static DivSampleCacheKey makeKey(const DivSampleCacheKey& base, const int* params, int paramCount);
+
+    /**
+     * look up an entry.
+     * @param key the key.
+     * @param out where to copy the data to.
+     * @param len the expected length. entries with a different length are not used.
+     * @return whether the entry was found.
+     */
+    bool get(const DivSampleCacheKey& key, unsigned char* out, size_t len);
+
+    /**
+     * add an entry.
+     */
+    void put(const DivSampleCacheKey& key, const unsigned char* data, size_t len);
+
+    /**
+     * set the size limit of the in-memory cache.
+     * @param limit the limit in bytes. 0 disables the cache.
+     */
+    void setLimit(size_t limit);
+
+    /**
+     * set the directory for the on-disk cache.
+     * @param path the directory. an empty path disables the disk cache.
+     * @param limit the size limit in bytes.
+     */
+    void setDiskPath(const String& path, size_t limit);
+
+    /**
+     * remove all entries from memory.
+     */
+    void clear();
+
+    DivSampleCache();
+    ~DivSampleCache();
+};
+
+#endif
@@ -29,7 +29,7 @@ bool DivSubSong::walk(int& loopOrder, int& loopRow, int& loopEnd, int chans, int
   int nextRow=0;
   int effectVal=0;
   int lastSuspectedLoopEnd=-1;
-  DivPattern* subPat[DIV_MAX_CHANS];
+  const DivPattern* subPat[DIV_MAX_CHANS];
   unsigned char wsWalked[8192];
   memset(wsWalked,0,8192);
   if (firstPat>0) {
@@ -136,7 +136,7 @@ void DivSubSong::findLength(int loopOrder, int loopRow, double fadeoutLen, int&
   int nextRow=0;
   int effectVal=0;
   int lastSuspectedLoopEnd=-1;
-  DivPattern* subPat[DIV_MAX_CHANS];
+  const DivPattern* subPat[DIV_MAX_CHANS];
   unsigned char wsWalked[8192];
   memset(wsWalked,0,8192);
   if (firstPat>0) {
@@ -505,6 +505,48 @@ void DivSong::clearSongData() {
   subsong.push_back(new DivSubSong);
 }
 
+void DivSong::sharePatterns() {
+  std::unordered_map<unsigned int,std::vector<DivPatternChunk*>> chunkMap;
+  size_t shared=0;
+  for (DivSubSong* i: subsong) {
+    for (int j=0; j<DIV_MAX_CHANS; j++) {
+      for (int k=0; k<DIV_MAX_PATTERNS; k++) {
+        DivPattern* p=i->pat[j].data[k];
+        if (p==NULL) continue;
+        p->data.compact();
+        for (int l=0; l<DIV_PATTERN_CHUNKS; l++) {
+          DivPatternChunk* c=p->data.getChunk(l);
+          if (c==NULL) continue;
+
+          // FNV-1a
+          unsigned int hash=2166136261u;
+          const unsigned char* bytes=(const unsigned char*)c->data;
+          for (size_t m=0; m<sizeof(c->data); m++) {
+            hash=(hash^bytes[m])*16777619u;
+          }
+
+          std::vector<DivPatternChunk*>& candidates=chunkMap[hash];
+          bool found=false;
+          for (DivPatternChunk* m: candidates) {
+            if (m==c) {
+              found=true;
+              break;
+            }
+            if (memcmp(m->data,c->data,sizeof(c->data))==0) {
+              p->data.setChunk(l,m);
+              shared++;
+              found=true;
+              break;
+            }
+          }
+          if (!found) candidates.push_back(c);
+        }
+      }
+    }
+  }
+  logV("sharePatterns: %d chunks shared",(int)shared);
+}
+
 void DivSong::clearInstruments() {
   for (DivInstrument* i: ins) {
     delete i;
@@ -377,6 +377,12 @@ struct DivSong {
    */
   void clearSongData();
 
+  /**
+   * release empty pattern chunks and share identical ones between patterns.
+   * use after loading a song.
+   */
+  void sharePatterns();
+
   /**
    * clear instruments.
    */
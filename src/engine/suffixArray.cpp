@@ -0,0 +1,89 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "suffixArray.h"
+#include <algorithm>
+
+void divBuildSuffixArray(const std::vector<int>& s, std::vector<int>& sa, std::vector<int>& rank, std::vector<int>& lcp) {
+  int n=s.size();
+  std::vector<int> newRank(n);
+  rank.resize(n);
+  sa.resize(n);
+  lcp.assign(n,0);
+  if (n<1) return;
+
+  // compact values into ranks
+  std::vector<int> sorted=s;
+  std::sort(sorted.begin(),sorted.end());
+  sorted.erase(std::unique(sorted.begin(),sorted.end()),sorted.end());
+  for (int i=0; i<n; i++) {
+    rank[i]=std::lower_bound(sorted.begin(),sorted.end(),s[i])-sorted.begin();
+    sa[i]=i;
+  }
+
+  // prefix doubling
+  for (int k=1; ; k<<=1) {
+    auto cmp=[&rank,n,k](int a, int b) {
+      if (rank[a]!=rank[b]) return rank[a]<rank[b];
+      int ra=(a+k<n)?rank[a+k]:-1;
+      int rb=(b+k<n)?rank[b+k]:-1;
+      return ra<rb;
+    };
+    std::sort(sa.begin(),sa.end(),cmp);
+    newRank[sa[0]]=0;
+    for (int i=1; i<n; i++) {
+      newRank[sa[i]]=newRank[sa[i-1]]+(cmp(sa[i-1],sa[i])?1:0);
+    }
+    rank.swap(newRank);
+    if (rank[sa[n-1]]==n-1) break;
+  }
+
+  // Kasai's algorithm
+  int h=0;
+  for (int i=0; i<n; i++) {
+    if (rank[i]==0) {
+      h=0;
+      continue;
+    }
+    int j=sa[rank[i]-1];
+    while (i+h<n && j+h<n && s[i+h]==s[j+h]) h++;
+    lcp[rank[i]]=h;
+    if (h>0) h--;
+  }
+}
+
+void divWalkLCPIntervals(const std::vector<int>& lcp, const std::function<void(int,int,int,int)>& callback) {
+  int n=lcp.size();
+  // LCP and left bound of open intervals
+  std::vector<std::pair<int,int>> stack;
+  stack.push_back(std::pair<int,int>(0,0));
+  for (int i=1; i<=n; i++) {
+    int cur=(i<n)?lcp[i]:0;
+    int lb=i-1;
+    while (cur<stack.back().first) {
+      std::pair<int,int> top=stack.back();
+      stack.pop_back();
+      lb=top.second;
+      callback(lb,i-1,top.first,std::max(cur,stack.back().first));
+    }
+    if (cur>stack.back().first) {
+      stack.push_back(std::pair<int,int>(cur,lb));
+    }
+  }
+}
@@ -0,0 +1,45 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _SUFFIXARRAY_H
+#define _SUFFIXARRAY_H
+
+#include <functional>
+#include <vector>
+
+/**
+ * build the suffix array of a sequence.
+ * @param s the sequence.
+ * @param sa set to the start of every suffix, in sorted order.
+ * @param rank set to the position of every suffix in sa.
+ * @param lcp set to the length of the common prefix of every suffix in sa and the previous one.
+ */
+void divBuildSuffixArray(const std::vector<int>& s, std::vector<int>& sa, std::vector<int>& rank, std::vector<int>& lcp);
+
+/**
+ * walk the LCP intervals of a suffix array bottom-up.
+ * every interval is a range of suffixes in sa sharing a prefix longer than the one they share
+ * with the rest of the array, which means the prefix repeats at these positions.
+ * @param lcp the LCP array.
+ * @param callback called for every interval with its range in sa (inclusive), the length of the
+ * shared prefix and the length of the prefix shared with the parent interval.
+ */
+void divWalkLCPIntervals(const std::vector<int>& lcp, const std::function<void(int,int,int,int)>& callback);
+
+#endif
@@ -24,9 +24,210 @@
 
 constexpr int MASTER_CLOCK_PREC=(sizeof(void*)==8)?8:0;
 
+// returns whether writing a register of a chip again with the same value has no effect.
+// cmd is the VGM command (second chip commands included).
+// registers with side effects (key on, timers, latches, envelope restart, memory access)
+// and chips which are not listed are never considered.
+static bool vgmWriteIsIdempotent(unsigned char cmd, unsigned char addr) {
+  if (cmd==0xa0) { // AY-3-8910 (bit 7 of address selects the chip)
+    addr&=0x7f;
+    return addr<0x0d || addr==0x0e || addr==0x0f;
+  }
+  if (cmd>=0xa1 && cmd<=0xaf) cmd-=0x50;
+  switch (cmd) {
+    case 0x51: // YM2413
+      return addr!=0x0f;
+    case 0x52: // YM2612 port 0
+      return !(addr>=0x20 && addr<0x30) && !(addr>=0xa0 && addr<0xb0);
+    case 0x53: // YM2612 port 1
+      return addr>=0x30 && !(addr>=0xa0 && addr<0xb0);
+    case 0x54: // YM2151
+      return addr!=0x01 && addr!=0x08 && !(addr>=0x10 && addr<=0x14) && addr!=0x19;
+    case 0x55: // YM2203
+      return addr!=0x0d && !(addr>=0x20 && addr<0x30) && !(addr>=0xa0 && addr<0xb0);
+    case 0x56: // YM2608 port 0
+    case 0x58: // YM2610 port 0
+      return addr!=0x0d && !(addr>=0x10 && addr<0x30) && !(addr>=0xa0 && addr<0xb0);
+    case 0x57: // YM2608 port 1
+    case 0x59: // YM2610 port 1
+      return addr>=0x30 && !(addr>=0xa0 && addr<0xb0);
+    case 0x5a: // YM3812
+    case 0x5b: // YM3526
+    case 0x5e: // YMF262 port 0
+    case 0x5f: // YMF262 port 1
+      return addr>0x08;
+    case 0x5c: // Y8950
+      return addr>0x1a;
+  }
+  return false;
+}
+
+// returns the length of a VGM command (including the command byte), or 0 if unknown.
+static size_t vgmCommandLen(const unsigned char* buf, size_t pos, size_t len) {
+  unsigned char cmd=buf[pos];
+  if (cmd>=0x30 && cmd<=0x3f) return 2;
+  if (cmd>=0x40 && cmd<=0x4e) return 3;
+  if (cmd==0x4f || cmd==0x50) return 2;
+  if (cmd>=0x51 && cmd<=0x5f) return 3;
+  if (cmd==0x61) return 3;
+  if (cmd==0x62 || cmd==0x63 || cmd==0x66) return 1;
+  if (cmd==0x67) {
+    if (pos+7>len) return 0;
+    unsigned int blockLen=buf[pos+3]|(buf[pos+4]<<8)|(buf[pos+5]<<16)|((buf[pos+6]&0x7f)<<24);
+    return 7+blockLen;
+  }
+  if (cmd==0x68) return 12;
+  if (cmd>=0x70 && cmd<=0x8f) return 1;
+  switch (cmd) {
+    case 0x90: case 0x91: case 0x95:
+      return 5;
+    case 0x92:
+      return 6;
+    case 0x93:
+      return 11;
+    case 0x94:
+      return 2;
+  }
+  if (cmd>=0xa0 && cmd<=0xbf) return 3;
+  if (cmd>=0xc0 && cmd<=0xdf) return 4;
+  if (cmd>=0xe0) return 5;
+  return 0;
+}
+
+static int vgmWaitLen(const unsigned char* buf, size_t pos) {
+  unsigned char cmd=buf[pos];
+  if (cmd==0x61) return buf[pos+1]|(buf[pos+2]<<8);
+  if (cmd==0x62) return 735;
+  if (cmd==0x63) return 882;
+  if (cmd>=0x70 && cmd<=0x7f) return (cmd&15)+1;
+  return -1;
+}
+
+static bool vgmIsShortWait(int len) {
+  return len==735 || len==882 || (len>=1 && len<=16);
+}
+
+static void vgmWriteShortWait(SafeWriter* w, int len) {
+  if (len==735) {
+    w->writeC(0x62);
+  } else if (len==882) {
+    w->writeC(0x63);
+  } else {
+    w->writeC(0x70+len-1);
+  }
+}
+
+// write a wait using as few bytes as possible
+static void vgmWriteWait(SafeWriter* w, size_t len) {
+  while (len>0) {
+    if (vgmIsShortWait(len)) {
+      vgmWriteShortWait(w,len);
+      return;
+    }
+    // two one-byte waits are shorter than a 0x61
+    static const int shortWaits[]={735,882,16,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1};
+    for (int i: shortWaits) {
+      if (len>(size_t)i && vgmIsShortWait(len-i)) {
+        vgmWriteShortWait(w,i);
+        vgmWriteShortWait(w,len-i);
+        return;
+      }
+    }
+    size_t step=MIN(len,65535);
+    w->writeC(0x61);
+    w->writeS(step);
+    len-=step;
+  }
+}
+
+// rewrite the command stream of a VGM file (starting at start), dropping register writes
+// which don't change anything and merging consecutive waits.
+// the loop point is a barrier: waits are not merged across it and all registers are
+// assumed to be unknown after it.
+// tickPos is updated to point into the new stream.
+// returns NULL if the stream could not be parsed.
+static SafeWriter* optimizeVGMStream(SafeWriter* w, size_t start, size_t loopOff, std::vector<size_t>& tickPos, int& dropped) {
+  const unsigned char* buf=w->getFinalBuf();
+  size_t len=w->size();
+  SafeWriter* out=new SafeWriter;
+  out->init();
+  out->write(buf,start);
+
+  // last value written to each register, indexed by (cmd<<8)|addr. -1 means unknown.
+  short* shadow=new short[65536];
+  memset(shadow,-1,65536*sizeof(short));
+  size_t pendingWait=0;
+  size_t nextTick=0;
+  size_t pos=start;
+  bool ok=true;
+  dropped=0;
+
+  while (pos<len) {
+    if (pos==loopOff) {
+      vgmWriteWait(out,pendingWait);
+      pendingWait=0;
+      memset(shadow,-1,65536*sizeof(short));
+    }
+    while (nextTick<tickPos.size() && tickPos[nextTick]<=pos) {
+      tickPos[nextTick++]=out->tell();
+    }
+
+    size_t cmdLen=vgmCommandLen(buf,pos,len);
+    if (cmdLen==0 || pos+cmdLen>len) {
+      logW("VGM optimization: unknown command %.2x at %x",buf[pos],(int)pos);
+      ok=false;
+      break;
+    }
+    unsigned char cmd=buf[pos];
+
+    int waitLen=vgmWaitLen(buf,pos);
+    if (waitLen>=0) {
+      pendingWait+=waitLen;
+      pos+=cmdLen;
+      continue;
+    }
+
+    if (cmdLen==3 && ((cmd>=0x51 && cmd<=0x5f) || (cmd>=0xa0 && cmd<=0xaf))) {
+      unsigned char addr=buf[pos+1];
+      unsigned char val=buf[pos+2];
+      int slot=(cmd<<8)|addr;
+      if (vgmWriteIsIdempotent(cmd,addr)) {
+        if (shadow[slot]==val) {
+          dropped++;
+          pos+=cmdLen;
+          continue;
+        }
+        shadow[slot]=val;
+      } else if (cmd==0xa0 && (addr&0x7f)==0x0d) {
+        // AY8930 bank switch. forget about the other registers
+        for (int i=0; i<0x80; i++) {
+          shadow[(cmd<<8)|(addr&0x80)|i]=-1;
+        }
+      }
+    }
+
+    vgmWriteWait(out,pendingWait);
+    pendingWait=0;
+    out->write(&buf[pos],cmdLen);
+    pos+=cmdLen;
+  }
+  vgmWriteWait(out,pendingWait);
+  while (nextTick<tickPos.size()) {
+    tickPos[nextTick++]=out->tell();
+  }
+
+  delete[] shadow;
+  if (!ok) {
+    out->finish();
+    delete out;
+    return NULL;
+  }
+  return out;
+}
+
 // this function is so long
 // may as well make it something else
-void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, size_t bankOffset, bool directStream, bool* sampleStoppable) {
+void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write, int streamOff, double* loopTimer, double* loopFreq, int* loopSample, bool* sampleDir, bool isSecond, int* pendingFreq, int* playingSample, int* setPos, unsigned int* sampleOff8, unsigned int* sampleLen8, unsigned short* sampleBlock8, size_t bankOffset, bool directStream, bool* sampleStoppable) {
   unsigned char baseAddr1=isSecond?0xa0:0x50;
   unsigned char baseAddr2=isSecond?0x80:0;
   unsigned short baseAddr2S=isSecond?0x8000:0;
@@ -764,7 +965,7 @@ void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write
               } else {
                 w->writeC(0x95);
                 w->writeC(streamID);
-                w->writeS(write.val); // sample number
+                w->writeS(sampleBlock8[write.val&0xff]); // sample number
                 w->writeC((sample->getLoopStartPosition(DIV_SAMPLE_DEPTH_8BIT)==0 && sample->isLoopable())|(sampleDir[streamID]?0x10:0)); // flags
               }
 
@@ -807,7 +1008,7 @@ void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write
             } else {
               w->writeC(0x95);
               w->writeC(streamID);
-              w->writeS(pendingFreq[streamID]); // sample number
+              w->writeS(sampleBlock8[pendingFreq[streamID]&0xff]); // sample number
               w->writeC((sample->getLoopStartPosition(DIV_SAMPLE_DEPTH_8BIT)==0 && sample->isLoopable())|(sampleDir[streamID]?0x10:0)); // flags
             }
 
@@ -859,7 +1060,7 @@ void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write
             } else {
               w->writeC(0x95);
               w->writeC(streamID);
-              w->writeS(playingSample[streamID]); // sample number
+              w->writeS(sampleBlock8[playingSample[streamID]&0xff]); // sample number
               w->writeC((sample->getLoopStartPosition(DIV_SAMPLE_DEPTH_8BIT)==0 && sample->isLoopable())|(sampleDir[streamID]?0x10:0)); // flags
             }
 
@@ -1217,11 +1418,31 @@ void DivEngine::performVGMWrite(SafeWriter* w, DivSystem sys, DivRegWrite& write
   chipVol.push_back((_id)|(0x80000100)|(((unsigned int)_vol)<<16)); \
 }
 
-SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool patternHints, bool directStream, int trailingTicks) {
+// whether a timeline captured with the given trailing mode plays far enough past the end
+static bool timelineHasTrailing(int captured, int needed) {
+  if (needed==0 || captured==needed) return true;
+  // one loop is as far as any mode goes
+  if (captured==-2) return true;
+  return (captured>0 && needed>0 && captured>=needed);
+}
+
+SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool patternHints, bool directStream, int trailingTicks, bool optimize, DivRegTimeline* timeline) {
   if (version<0x150) {
     lastError="VGM version is too low";
     return NULL;
   }
+  // a direct stream needs the chips to render each tick, so only play the song here in that case.
+  // otherwise work from a register timeline.
+  DivRegTimeline* tl=NULL;
+  if (!directStream) {
+    int trailingNeeded=(loop && song.loopModality==2)?trailingTicks:0;
+    tl=timeline;
+    if (tl!=NULL && (tl->getRate()!=44100 || !timelineHasTrailing(tl->getTrailingTicks(),trailingNeeded))) {
+      logD("VGM: register timeline doesn't fit. capturing another one.");
+      tl=NULL;
+    }
+    if (tl==NULL) tl=captureRegTimeline(44100,trailingNeeded);
+  }
   stop();
   repeatPattern=false;
   setOrder(0);
@@ -1232,7 +1453,11 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   int loopOrder=0;
   int loopRow=0;
   int loopEnd=0;
-  walkSong(loopOrder,loopRow,loopEnd);
+  if (tl!=NULL) {
+    tl->getLoop(loopOrder,loopRow,loopEnd);
+  } else {
+    walkSong(loopOrder,loopRow,loopEnd);
+  }
   logI("loop point: %d %d",loopOrder,loopRow);
   warnings="";
 
@@ -1308,6 +1533,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
 
   unsigned int sampleOff8[256];
   unsigned int sampleLen8[256];
+  unsigned short sampleBlock8[256];
   unsigned int sampleOffSegaPCM[256];
 
   SafeWriter* w=new SafeWriter;
@@ -1332,7 +1558,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   int setPos[DIV_MAX_CHANS];
   std::vector<unsigned int> chipVol;
   std::vector<DivDelayedWrite> delayedWrites[DIV_MAX_CHIPS];
-  std::vector<std::pair<int,DivDelayedWrite>> sortedWrites;
+  size_t delayedPos[DIV_MAX_CHIPS];
   std::vector<size_t> tickPos;
   std::vector<int> tickSample;
 
@@ -1991,7 +2217,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
       default:
         break;
     }
-    if (willExport[i]) {
+    if (willExport[i] && tl==NULL) {
       disCont[i].dispatch->toggleRegisterDump(true);
     }
   }
@@ -2174,20 +2400,44 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   // initialize sample offsets
   memset(sampleOff8,0,256*sizeof(unsigned int));
   memset(sampleLen8,0,256*sizeof(unsigned int));
+  memset(sampleBlock8,0,256*sizeof(unsigned short));
   memset(sampleOffSegaPCM,0,256*sizeof(unsigned int));
 
   // write samples
+  // when optimizing, identical samples are stored once and share the same data block.
+  // VOX data is laid out differently, so it is left alone.
   unsigned int sampleSeek=0;
+  unsigned short sampleBlocks=0;
+  bool sampleIsCopy[256];
+  bool dedupSamples=optimize && !writeVOXSamples;
   for (int i=0; i<song.sampleLen; i++) {
     DivSample* sample=song.sample[i];
+    sampleIsCopy[i]=false;
+    if (dedupSamples) {
+      for (int j=0; j<i; j++) {
+        if (sampleIsCopy[j]) continue;
+        DivSample* other=song.sample[j];
+        if (other->length8!=sample->length8) continue;
+        if (sample->length8>0 && memcmp(other->data8,sample->data8,sample->length8)!=0) continue;
+        logD("sample %d is a copy of %d",i,j);
+        sampleIsCopy[i]=true;
+        sampleOff8[i]=sampleOff8[j];
+        sampleLen8[i]=sampleLen8[j];
+        sampleBlock8[i]=sampleBlock8[j];
+        break;
+      }
+      if (sampleIsCopy[i]) continue;
+    }
     logI("setting seek to %d",sampleSeek);
     sampleOff8[i]=sampleSeek;
     sampleLen8[i]=sample->length8;
+    sampleBlock8[i]=sampleBlocks++;
     sampleSeek+=sample->length8;
   }
 
   if (writeDACSamples && !directStream) for (int i=0; i<song.sampleLen; i++) {
     DivSample* sample=song.sample[i];
+    if (sampleIsCopy[i]) continue;
     w->writeC(0x67);
     w->writeC(0x66);
     w->writeC(0);
@@ -2199,6 +2449,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
 
   if (writeNESSamples && !directStream) for (int i=0; i<song.sampleLen; i++) {
     DivSample* sample=song.sample[i];
+    if (sampleIsCopy[i]) continue;
     w->writeC(0x67);
     w->writeC(0x66);
     w->writeC(7);
@@ -2211,6 +2462,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
 
   if (writePCESamples && !directStream) for (int i=0; i<song.sampleLen; i++) {
     DivSample* sample=song.sample[i];
+    if (sampleIsCopy[i]) continue;
     w->writeC(0x67);
     w->writeC(0x66);
     w->writeC(5);
@@ -2542,7 +2794,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   }
 
   // write song data
-  playSub(false);
+  if (tl==NULL) playSub(false);
   size_t tickCount=0;
   bool writeLoop=false;
   bool alreadyWroteLoop=false;
@@ -2554,9 +2806,30 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
     chan[i].wentThroughNote=false;
     chan[i].goneThroughNote=false;
   }
+  auto writeTimeline=[&](const DivRegTimelineWrite* writes, size_t count, int chip) {
+    for (size_t j=0; j<count; j++) {
+      if (writes[j].chip!=chip) continue;
+      DivRegWrite write(writes[j].addr,writes[j].val);
+      performVGMWrite(w,song.system[chip],write,streamIDs[chip],loopTimer,loopFreq,loopSample,sampleDir,isSecond[chip],pendingFreq,playingSample,setPos,sampleOff8,sampleLen8,sampleBlock8,bankOffset[chip],directStream,sampleStoppable);
+      writeCount++;
+    }
+  };
+  size_t tlTick=0;
   while (!done) {
+    const DivRegTimelineTick* tick=NULL;
+    if (tl!=NULL) {
+      if (tlTick>=tl->getTickCount()) {
+        logW("VGM: register timeline ended early!");
+        break;
+      }
+      tick=&tl->getTick(tlTick);
+    }
     if (loopPos==-1) {
-      if (loopOrder==curOrder && loopRow==curRow) {
+      if (tick!=NULL) {
+        if (loopOrder==tick->order && loopRow==tick->row && (tick->flags&DIV_REGTL_ROW_NEXT)) {
+          writeLoop=true;
+        }
+      } else if (loopOrder==curOrder && loopRow==curRow) {
         if ((ticks-((tempoAccum+virtualTempoN)/virtualTempoD))<=0) {
           writeLoop=true;
         }
@@ -2565,7 +2838,9 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
     songTick++;
     tickPos.push_back(w->tell());
     tickSample.push_back(tickCount);
-    if (nextTick(false,true)) {
+    bool songEnded=(tick!=NULL)?((tick->flags&DIV_REGTL_END)!=0):nextTick(false,true);
+    bool stopped=(tick!=NULL)?((tick->flags&DIV_REGTL_STOPPED)!=0):!playing;
+    if (songEnded) {
       if (trailing) beenOneLoopAlready=true;
       trailing=true;
       if (!loop) countDown=0;
@@ -2578,8 +2853,22 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
       switch (trailingTicks) {
         case -1: { // automatic
           bool stillHaveTo=false;
+          // ticks past the end (-1 on the tick where the song ends)
+          int trailPos=-1;
+          if (tick!=NULL && (tick->flags&DIV_REGTL_TRAILING)) {
+            trailPos=tlTick-tl->getSongTickCount();
+          }
           for (int i=0; i<chans; i++) {
             if (!willExport[dispatchOfChan[i]]) continue;
+            if (tick!=NULL) {
+              int trailNote=tl->getTrailNote(i);
+              if (trailNote==-2) continue;
+              if (trailNote==-1 || trailNote>trailPos) {
+                stillHaveTo=true;
+                break;
+              }
+              continue;
+            }
             if (!chan[i].goneThroughNote) continue;
             if (!chan[i].wentThroughNote) {
               stillHaveTo=true;
@@ -2601,7 +2890,7 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
         loopTickSong++;
       }
     }
-    if (countDown<=0 || !playing || beenOneLoopAlready) {
+    if (countDown<=0 || stopped || beenOneLoopAlready) {
       done=true;
       if (!loop) {
         for (int i=0; i<song.systemLen; i++) {
@@ -2618,15 +2907,17 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
         }
       }
 
-      if (!playing) {
+      if (stopped) {
         writeLoop=false;
         loopPos=-1;
       }
     } else {
       // check for pattern change
-      if (prevOrder!=ord) {
-        logI("registering order change %d on %d",prevOrder, prevRow);
-        ord=prevOrder;
+      int hintOrder=(tick!=NULL)?tick->prevOrder:prevOrder;
+      int hintRow=(tick!=NULL)?tick->prevRow:prevRow;
+      if (hintOrder!=ord) {
+        logI("registering order change %d on %d",hintOrder,hintRow);
+        ord=hintOrder;
 
         if (patternHints) {
           w->writeC(0x67);
@@ -2634,68 +2925,83 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
           w->writeC(0xfe);
           w->writeI(3+exportChans);
           w->writeC(0x01);
-          w->writeC(prevOrder);
-          w->writeC(prevRow);
+          w->writeC(hintOrder);
+          w->writeC(hintRow);
           for (int i=0; i<chans; i++) {
             if (!willExport[dispatchOfChan[i]]) continue;
-            w->writeC(curSubSong->orders.ord[i][prevOrder]);
+            w->writeC(curSubSong->orders.ord[i][hintOrder]);
           }
         }
       }
     }
     // get register dumps
-    for (int i=0; i<song.systemLen; i++) {
-      std::vector<DivRegWrite>& writes=disCont[i].dispatch->getRegisterWrites();
-      for (DivRegWrite& j: writes) {
-        performVGMWrite(w,song.system[i],j,streamIDs[i],loopTimer,loopFreq,loopSample,sampleDir,isSecond[i],pendingFreq,playingSample,setPos,sampleOff8,sampleLen8,bankOffset[i],directStream,sampleStoppable);
-        writeCount++;
+    if (tick!=NULL) {
+      size_t initCount=0;
+      size_t tickWriteCount=0;
+      const DivRegTimelineWrite* initWrites=tl->getInitWrites(initCount);
+      const DivRegTimelineWrite* tickWrites=tl->getWrites(tlTick,tickWriteCount);
+      for (int i=0; i<song.systemLen; i++) {
+        if (!willExport[i]) continue;
+        // writes made while starting playback go with the first tick
+        if (tlTick==0) writeTimeline(initWrites,initCount,i);
+        writeTimeline(tickWrites,tickWriteCount,i);
+      }
+    } else {
+      for (int i=0; i<song.systemLen; i++) {
+        std::vector<DivRegWrite>& writes=disCont[i].dispatch->getRegisterWrites();
+        for (DivRegWrite& j: writes) {
+          performVGMWrite(w,song.system[i],j,streamIDs[i],loopTimer,loopFreq,loopSample,sampleDir,isSecond[i],pendingFreq,playingSample,setPos,sampleOff8,sampleLen8,sampleBlock8,bankOffset[i],directStream,sampleStoppable);
+          writeCount++;
+        }
+        writes.clear();
       }
-      writes.clear();
     }
     // check whether we need to loop
-    int totalWait=cycles>>MASTER_CLOCK_PREC;
+    int totalWait=(tick!=NULL)?(int)((tl->getTick(tlTick+1).time-tick->time)>>tl->getPrec()):(cycles>>MASTER_CLOCK_PREC);
     if (directStream) {
       // render stream of all chips
       for (int i=0; i<song.systemLen; i++) {
-        disCont[i].dispatch->fillStream(delayedWrites[i],44100,totalWait);
-        for (DivDelayedWrite& j: delayedWrites[i]) {
-          sortedWrites.push_back(std::pair<int,DivDelayedWrite>(i,j));
-        }
         delayedWrites[i].clear();
+        disCont[i].dispatch->fillStream(delayedWrites[i],44100,totalWait);
+        delayedPos[i]=0;
       }
 
-      if (!sortedWrites.empty()) {
-        // sort if more than one chip
-        if (song.systemLen>1) {
-          std::sort(sortedWrites.begin(),sortedWrites.end(),[](const std::pair<int,DivDelayedWrite>& a, const std::pair<int,DivDelayedWrite>& b) -> bool {
-            return a.second.time<b.second.time;
-          });
-        }
-
-        // write it out
-        int lastOne=0;
-        for (std::pair<int,DivDelayedWrite>& i: sortedWrites) {
-          if (i.second.time>lastOne) {
-            // write delay
-            int delay=i.second.time-lastOne;
-            if (delay>16) {
-              w->writeC(0x61);
-              w->writeS(delay);
-            } else if (delay>0) {
-              w->writeC(0x70+delay-1);
-            }
-            lastOne=i.second.time;
+      // the stream of each chip is in order already, so merge them.
+      // on ties the first chip goes first.
+      int lastOne=0;
+      while (true) {
+        int next=-1;
+        int nextTime=0;
+        for (int i=0; i<song.systemLen; i++) {
+          if (delayedPos[i]>=delayedWrites[i].size()) continue;
+          int time=delayedWrites[i][delayedPos[i]].time;
+          if (next<0 || time<nextTime) {
+            next=i;
+            nextTime=time;
           }
-          // write write
-          performVGMWrite(w,song.system[i.first],i.second.write,streamIDs[i.first],loopTimer,loopFreq,loopSample,sampleDir,isSecond[i.first],pendingFreq,playingSample,setPos,sampleOff8,sampleLen8,bankOffset[i.first],directStream,sampleStoppable);
-          // handle global Furnace commands
+        }
+        if (next<0) break;
+        DivDelayedWrite& i=delayedWrites[next][delayedPos[next]++];
 
-          writeCount++;
+        if (i.time>lastOne) {
+          // write delay
+          int delay=i.time-lastOne;
+          if (delay>16) {
+            w->writeC(0x61);
+            w->writeS(delay);
+          } else if (delay>0) {
+            w->writeC(0x70+delay-1);
+          }
+          lastOne=i.time;
         }
-        sortedWrites.clear();
-        totalWait-=lastOne;
-        tickCount+=lastOne;
+        // write write
+        performVGMWrite(w,song.system[next],i.write,streamIDs[next],loopTimer,loopFreq,loopSample,sampleDir,isSecond[next],pendingFreq,playingSample,setPos,sampleOff8,sampleLen8,sampleBlock8,bankOffset[next],directStream,sampleStoppable);
+        // handle global Furnace commands
+
+        writeCount++;
       }
+      totalWait-=lastOne;
+      tickCount+=lastOne;
     } else {
       for (int i=0; i<streamID; i++) {
         if (loopSample[i]>=0) {
@@ -2768,10 +3074,28 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
       loopPos=w->tell();
       loopTickSong=songTick;
     }
+    tlTick++;
   }
   // end of song
   w->writeC(0x66);
 
+  if (optimize) {
+    size_t loopOff=SIZE_MAX;
+    if (loop && loopPos!=-1 && loopTickSong>=0 && loopTickSong<(int)tickPos.size()) {
+      loopOff=tickPos[loopTickSong];
+    }
+    std::vector<size_t> newTickPos=tickPos;
+    int dropped=0;
+    SafeWriter* optimized=optimizeVGMStream(w,songOff,loopOff,newTickPos,dropped);
+    if (optimized!=NULL) {
+      logI("VGM optimization: %d redundant writes dropped, %d -> %d bytes.",dropped,(int)w->size(),(int)optimized->size());
+      w->finish();
+      delete w;
+      w=optimized;
+      tickPos=newTickPos;
+    }
+  }
+
   got.rate=origRate;
 
   for (int i=0; i<song.systemLen; i++) {
@@ -2855,5 +3179,6 @@ SafeWriter* DivEngine::saveVGM(bool* sysToExport, bool loop, int version, bool p
   logI("%d register writes total.",writeCount);
 
   BUSY_END;
+  if (tl!=timeline) delete tl;
   return w;
 }
@@ -18,6 +18,7 @@
  */
 
 #include "engine.h"
+#include "workPool.h"
 #include "../ta-log.h"
 #ifdef HAVE_SNDFILE
 #include "sfWrapper.h"
@@ -25,6 +26,23 @@
 
 #define EXPORT_BUFSIZE 2048
 
+// shared state of a parallel per-channel export
+struct DivStemExportState {
+  DivEngine* parent;
+  SafeWriter* songData;
+  const std::vector<int>& stems;
+  std::atomic<size_t> nextStem;
+  std::atomic<int> workerCount;
+  std::mutex progressLock;
+
+  DivStemExportState(DivEngine* p, SafeWriter* data, const std::vector<int>& s):
+    parent(p),
+    songData(data),
+    stems(s),
+    nextStem(0),
+    workerCount(0) {}
+};
+
 void _runExportThread(DivEngine* caller) {
   caller->runExportThread();
 }
@@ -101,6 +119,117 @@ bool DivEngine::getIsFadingOut() {
 }
 
 #ifdef HAVE_SNDFILE
+bool DivEngine::renderExportStem(int chan, DivEngine* parent, bool reportProgress) {
+  size_t fadeOutSamples=got.rate*exportFadeOut;
+  size_t curFadeOutSample=0;
+
+  float* outBuf[DIV_MAX_OUTPUTS];
+  float* outBufFinal;
+
+  SNDFILE* sf;
+  SF_INFO si;
+  SFWrapper sfWrap;
+  String fname=(chan<0)?exportPath:fmt::sprintf("%s_c%02d.wav",exportPath,chan+1);
+  logI("- %s",fname.c_str());
+  si.samplerate=got.rate;
+  si.channels=exportOutputs;
+  if (exportFormat==DIV_EXPORT_FORMAT_S16) {
+    si.format=SF_FORMAT_WAV|SF_FORMAT_PCM_16;
+  } else {
+    si.format=SF_FORMAT_WAV|SF_FORMAT_FLOAT;
+  }
+
+  sf=sfWrap.doOpen(fname.c_str(),SFM_WRITE,&si);
+  if (sf==NULL) {
+    logE("could not open file for writing! (%s)",sf_strerror(NULL));
+    return false;
+  }
+
+  for (int i=0; i<exportOutputs; i++) {
+    outBuf[i]=new float[EXPORT_BUFSIZE];
+  }
+  outBufFinal=new float[EXPORT_BUFSIZE*exportOutputs];
+
+  for (int j=0; j<chans; j++) {
+    bool mute=(chan>=0 && j!=chan);
+    isMuted[j]=mute;
+  }
+  if (chan>=0 && getChannelType(chan)==5) {
+    for (int j=chan; j<chans; j++) {
+      if (getChannelType(j)!=5) break;
+      isMuted[j]=false;
+    }
+  }
+  for (int j=0; j<chans; j++) {
+    if (disCont[dispatchOfChan[j]].dispatch!=NULL) {
+      disCont[dispatchOfChan[j]].dispatch->muteChannel(dispatchChanOfChan[j],isMuted[j]);
+    }
+  }
+
+  curOrder=0;
+  prevOrder=0;
+  lastLoopPos=-1;
+  totalLoops=0;
+  isFadingOut=false;
+  remainingLoops=-1;
+  playSub(false);
+
+  while (playing) {
+    size_t total=0;
+    nextBuf(NULL,outBuf,0,exportOutputs,EXPORT_BUFSIZE);
+    if (totalProcessed>EXPORT_BUFSIZE) {
+      logE("error: total processed is bigger than export bufsize! %d>%d",totalProcessed,EXPORT_BUFSIZE);
+      totalProcessed=EXPORT_BUFSIZE;
+    }
+    int fi=0;
+    for (int j=0; j<(int)totalProcessed; j++) {
+      total++;
+      if (isFadingOut) {
+        double mul=(1.0-((double)curFadeOutSample/(double)fadeOutSamples));
+        for (int k=0; k<exportOutputs; k++) {
+          outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]))*mul;
+        }
+        if (++curFadeOutSample>=fadeOutSamples) {
+          playing=false;
+          break;
+        }
+      } else {
+        for (int k=0; k<exportOutputs; k++) {
+          outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]));
+        }
+        if (lastLoopPos>-1 && j>=lastLoopPos && totalLoops>=exportLoopCount) {
+          logD("start fading out...");
+          isFadingOut=true;
+          if (fadeOutSamples==0) break;
+        }
+      }
+    }
+    if (sf_writef_float(sf,outBufFinal,total)!=(int)total) {
+      logE("error: failed to write entire buffer!");
+      break;
+    }
+    if (parent!=this) {
+      if (parent->stopExport) break;
+      if (reportProgress) {
+        parent->curRow=curRow;
+        parent->curOrder=curOrder;
+        parent->totalLoops=totalLoops;
+        parent->isFadingOut=isFadingOut;
+      }
+    }
+  }
+
+  delete[] outBufFinal;
+  for (int i=0; i<exportOutputs; i++) {
+    delete[] outBuf[i];
+  }
+
+  if (sfWrap.doClose()!=0) {
+    logE("could not close audio file!");
+  }
+  return true;
+}
+
 void DivEngine::runExportThread() {
   size_t fadeOutSamples=got.rate*exportFadeOut;
   size_t curFadeOutSample=0;
@@ -320,104 +449,11 @@ void DivEngine::runExportThread() {
 
       curExportChan=0;
 
-      float* outBuf[DIV_MAX_OUTPUTS];
-      float* outBufFinal;
-      for (int i=0; i<exportOutputs; i++) {
-        outBuf[i]=new float[EXPORT_BUFSIZE];
-      }
-      outBufFinal=new float[EXPORT_BUFSIZE*exportOutputs];
-
-      logI("rendering to files...");
-      
+      // collect channels to render. consecutive channels of type 5 (FM operators) go to the same file
+      std::vector<int> stems;
       for (int i=0; i<chans; i++) {
         if (!exportChannelMask[i]) continue;
-
-        SNDFILE* sf;
-        SF_INFO si;
-        SFWrapper sfWrap;
-        String fname=fmt::sprintf("%s_c%02d.wav",exportPath,i+1);
-        logI("- %s",fname.c_str());
-        si.samplerate=got.rate;
-        si.channels=exportOutputs;
-        if (exportFormat==DIV_EXPORT_FORMAT_S16) {
-          si.format=SF_FORMAT_WAV|SF_FORMAT_PCM_16;
-        } else {
-          si.format=SF_FORMAT_WAV|SF_FORMAT_FLOAT;
-        }
-
-        sf=sfWrap.doOpen(fname.c_str(),SFM_WRITE,&si);
-        if (sf==NULL) {
-          logE("could not open file for writing! (%s)",sf_strerror(NULL));
-          break;
-        }
-
-        for (int j=0; j<chans; j++) {
-          bool mute=(j!=i);
-          isMuted[j]=mute;
-        }
-        if (getChannelType(i)==5) {
-          for (int j=i; j<chans; j++) {
-            if (getChannelType(j)!=5) break;
-            isMuted[j]=false;
-          }
-        }
-        for (int j=0; j<chans; j++) {
-          if (disCont[dispatchOfChan[j]].dispatch!=NULL) {
-            disCont[dispatchOfChan[j]].dispatch->muteChannel(dispatchChanOfChan[j],isMuted[j]);
-          }
-        }
-        
-        curOrder=0;
-        prevOrder=0;
-        curFadeOutSample=0;
-        lastLoopPos=-1;
-        totalLoops=0;
-        isFadingOut=false;
-        remainingLoops=-1;
-        playSub(false);
-
-        while (playing) {
-          size_t total=0;
-          nextBuf(NULL,outBuf,0,exportOutputs,EXPORT_BUFSIZE);
-          if (totalProcessed>EXPORT_BUFSIZE) {
-            logE("error: total processed is bigger than export bufsize! %d>%d",totalProcessed,EXPORT_BUFSIZE);
-            totalProcessed=EXPORT_BUFSIZE;
-          }
-          int fi=0;
-          for (int j=0; j<(int)totalProcessed; j++) {
-            total++;
-            if (isFadingOut) {
-              double mul=(1.0-((double)curFadeOutSample/(double)fadeOutSamples));
-              for (int k=0; k<exportOutputs; k++) {
-                outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]))*mul;
-              }
-              if (++curFadeOutSample>=fadeOutSamples) {
-                playing=false;
-                break;
-              }
-            } else {
-              for (int k=0; k<exportOutputs; k++) {
-                outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]));
-              }
-              if (lastLoopPos>-1 && j>=lastLoopPos && totalLoops>=exportLoopCount) {
-                logD("start fading out...");
-                isFadingOut=true;
-                if (fadeOutSamples==0) break;
-              }
-            }
-          }
-          if (sf_writef_float(sf,outBufFinal,total)!=(int)total) {
-            logE("error: failed to write entire buffer!");
-            break;
-          }
-        }
-
-        curExportChan++;
-
-        if (sfWrap.doClose()!=0) {
-          logE("could not close audio file!");
-        }
-
+        stems.push_back(i);
         if (getChannelType(i)==5) {
           i++;
           while (true) {
@@ -427,13 +463,56 @@ void DivEngine::runExportThread() {
           }
           i--;
         }
-
-        if (stopExport) break;
       }
 
-      delete[] outBufFinal;
-      for (int i=0; i<exportOutputs; i++) {
-        delete[] outBuf[i];
+      unsigned int howManyThreads=std::thread::hardware_concurrency();
+      if (howManyThreads>renderPoolThreads) howManyThreads=renderPoolThreads;
+      if (howManyThreads>stems.size()) howManyThreads=stems.size();
+
+      logI("rendering to files...");
+
+      if (howManyThreads<2) {
+        for (int i: stems) {
+          if (!renderExportStem(i,this,false)) break;
+          curExportChan++;
+          if (stopExport) break;
+        }
+      } else {
+        // render several channels at once, each in its own copy of the engine
+        logI("using %d threads",howManyThreads);
+        SafeWriter* songData=saveFur();
+        if (songData==NULL) {
+          logE("could not copy song for export! (%s)",lastError);
+        } else {
+          DivStemExportState state(this,songData,stems);
+          DivWorkPool* stemPool=new DivWorkPool(howManyThreads);
+          for (unsigned int i=0; i<howManyThreads; i++) {
+            stemPool->push([](void* d) {
+              DivStemExportState* s=(DivStemExportState*)d;
+              // the first worker drives the progress display
+              bool reportProgress=(s->workerCount++==0);
+              DivEngine* worker=new DivEngine;
+              if (worker->initExportWorker(s->parent,s->songData)) {
+                while (!s->parent->stopExport) {
+                  size_t next=s->nextStem++;
+                  if (next>=s->stems.size()) break;
+                  if (!worker->renderExportStem(s->stems[next],s->parent,reportProgress)) break;
+                  s->progressLock.lock();
+                  s->parent->curExportChan++;
+                  s->progressLock.unlock();
+                }
+              } else {
+                logE("could not initialize export worker!");
+              }
+              worker->quitExportWorker();
+              delete worker;
+            },&state);
+          }
+          stemPool->wait();
+          delete stemPool;
+          songData->finish();
+          delete songData;
+        }
       }
 
       for (int i=0; i<chans; i++) {
@@ -462,10 +541,81 @@ void DivEngine::runExportThread() {
   stopExport=false;
 }
 #else
+bool DivEngine::renderExportStem(int chan, DivEngine* parent, bool reportProgress) {
+  return false;
+}
+
 void DivEngine::runExportThread() {
 }
 #endif
 
+bool DivEngine::initExportWorker(DivEngine* parent, SafeWriter* songData) {
+  exportPath=parent->exportPath;
+  exportMode=parent->exportMode;
+  exportFormat=parent->exportFormat;
+  exportFadeOut=parent->exportFadeOut;
+  exportOutputs=parent->exportOutputs;
+  exportLoopCount=parent->exportLoopCount;
+  exporting=true;
+
+  // load() takes ownership of the buffer
+  unsigned char* data=new unsigned char[songData->size()];
+  memcpy(data,songData->getFinalBuf(),songData->size());
+  return initWorker(parent,data,songData->size(),NULL,parent->curSubSongIndex,0);
+}
+
+bool DivEngine::initWorker(DivEngine* parent, unsigned char* data, size_t len, const char* nameHint, int subSong, int rate) {
+  // copy configuration (chip cores, quality) but never touch the config file or audio devices
+  conf=parent->conf;
+  configLoaded=true;
+  systemsRegistered=true;
+  romExportsRegistered=true;
+  hasLoadedSomething=true;
+  renderPoolThreads=0;
+  got=parent->got;
+  if (rate>0) got.rate=rate;
+
+  if (!load(data,len,nameHint)) {
+    return false;
+  }
+  if (subSong<0 || subSong>=(int)song.subsong.size()) {
+    lastError="invalid sub-song";
+    return false;
+  }
+  changeSong(subSong);
+  repeatPattern=false;
+  remainingLoops=-1;
+
+  loadSampleROMs();
+  if (!initRenderBuffers()) return false;
+
+  initDispatch(true);
+  renderSamples();
+  reset();
+  active=true;
+  return true;
+}
+
+void DivEngine::quitExportWorker() {
+  quit(false);
+  if (samp_bb!=NULL) {
+    blip_delete(samp_bb);
+    samp_bb=NULL;
+  }
+  if (samp_bbOut!=NULL) {
+    delete[] samp_bbOut;
+    samp_bbOut=NULL;
+  }
+  if (samp_bbIn!=NULL) {
+    delete[] samp_bbIn;
+    samp_bbIn=NULL;
+  }
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+}
+
 bool DivEngine::shallSwitchCores() {
   return true;
 }
@@ -20,92 +20,93 @@
 #include "workPool.h"
 #include "../ta-log.h"
 #include <thread>
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+#endif
+
+// how many times to look for work before going to sleep
+#define DIV_WORK_SPIN_COUNT 512
 
 void* _workThread(void* inst) {
   ((DivWorkThread*)inst)->run();
   return NULL;
 }
 
-void DivWorkThread::run() {
-  //std::unique_lock<std::mutex> unique(selfLock);
-  DivPendingTask task;
-  bool setFuckingPromise=false;
+bool DivWorkQueue::push(void (*what)(void*), void* arg) {
+  size_t t=tail.load(std::memory_order_relaxed);
+  if (t-head.load(std::memory_order_acquire)>=DIV_WORK_QUEUE_SIZE) {
+    return false;
+  }
+  func[t&(DIV_WORK_QUEUE_SIZE-1)].store(what,std::memory_order_relaxed);
+  funcArg[t&(DIV_WORK_QUEUE_SIZE-1)].store(arg,std::memory_order_relaxed);
+  tail.store(t+1,std::memory_order_release);
+  return true;
+}
 
+bool DivWorkQueue::pop(DivPendingTask& task) {
+  size_t h=head.load(std::memory_order_acquire);
+  while (true) {
+    if (h>=tail.load(std::memory_order_acquire)) return false;
+    // if the slot gets overwritten after we read it, head has moved and the exchange fails
+    void (*what)(void*)=func[h&(DIV_WORK_QUEUE_SIZE-1)].load(std::memory_order_relaxed);
+    void* arg=funcArg[h&(DIV_WORK_QUEUE_SIZE-1)].load(std::memory_order_relaxed);
+    if (head.compare_exchange_weak(h,h+1,std::memory_order_acq_rel,std::memory_order_acquire)) {
+      task.func=what;
+      task.funcArg=arg;
+      return true;
+    }
+  }
+}
+
+bool DivWorkQueue::empty() {
+  return head.load(std::memory_order_acquire)>=tail.load(std::memory_order_acquire);
+}
+
+void DivWorkThread::run() {
   logV("running work thread");
 
   while (true) {
-    lock.lock();
-    if (tasks.empty()) {
-      lock.unlock();
-      isBusy=false;
-      if (setFuckingPromise) {
-        parent->notify.set_value();
-        setFuckingPromise=false;
-        //std::this_thread::yield();
-      }
-      if (terminate) {
+    if (parent->runOne(index)) continue;
+
+    // spin for a while before sleeping
+    bool gotWork=false;
+    for (int i=0; i<DIV_WORK_SPIN_COUNT; i++) {
+      if (parent->queued>0 || terminate) {
+        gotWork=true;
         break;
       }
-      std::future<void> future=notify.get_future();
-      future.wait();
-      lock.lock();
-      notify=std::promise<void>();
-      promiseAlreadySet=false;
-      lock.unlock();
+      std::this_thread::yield();
+    }
+    if (gotWork) {
+      if (terminate && parent->queued<=0) break;
       continue;
-    } else {
-      task=tasks.front();
-      tasks.pop();
-      lock.unlock();
-
-      task.func(task.funcArg);
-
-      int busyCount=--parent->busyCount;
-      if (busyCount<0) {
-        logE("oh no PROBLEM...");
-      }
-      if (busyCount==0) {
-        setFuckingPromise=true;
-      }
     }
-  }
-}
 
-bool DivWorkThread::assign(void (*what)(void*), void* arg) {
-  lock.lock();
-  if (tasks.size()>=30) {
-    lock.unlock();
-    return false;
+    std::unique_lock<std::mutex> unique(parent->parkLock);
+    parent->sleeping++;
+    parent->parkCond.wait(unique,[this]() {
+      return parent->queued>0 || terminate;
+    });
+    parent->sleeping--;
+    if (terminate && parent->queued<=0) break;
   }
-  tasks.push(DivPendingTask(what,arg));
-  parent->busyCount++;
-  isBusy=true;
-  lock.unlock();
-  return true;
-}
-
-void DivWorkThread::wait() {
-  if (!isBusy) return;
-}
-
-bool DivWorkThread::busy() {
-  return isBusy;
 }
 
 void DivWorkThread::finish() {
-  lock.lock();
   terminate=true;
-  try {
-    notify.set_value();
-  } catch (std::future_error& e) {
-    logE("future error! beware!");
-  }
-  lock.unlock();
+  parent->parkLock.lock();
+  parent->parkCond.notify_all();
+  parent->parkLock.unlock();
   thread->join();
+  delete thread;
+  thread=NULL;
 }
 
-bool DivWorkThread::init(DivWorkPool* p) {
+bool DivWorkThread::init(DivWorkPool* p, unsigned int i) {
   parent=p;
+  index=i;
   try {
     thread=new std::thread(_workThread,this);
   } catch (std::system_error& e) {
@@ -116,6 +117,35 @@ bool DivWorkThread::init(DivWorkPool* p) {
   return true;
 }
 
+bool DivWorkPool::runOne(int first) {
+  DivPendingTask task;
+  bool got=false;
+
+  if (queued<=0) return false;
+
+  // own queue first, then steal from the others
+  unsigned int start=(first<0)?0:first;
+  for (unsigned int i=0; i<count; i++) {
+    if (workThreads[(start+i)%count].tasks.pop(task)) {
+      got=true;
+      break;
+    }
+  }
+  if (!got) return false;
+
+  queued--;
+  task.func(task.funcArg);
+
+  if (--pending==0) {
+    if (waiterSleeping) {
+      parkLock.lock();
+      waitCond.notify_all();
+      parkLock.unlock();
+    }
+  }
+  return true;
+}
+
 void DivWorkPool::push(void (*what)(void*), void* arg) {
   // if no work threads, just execute
   if (!threaded) {
@@ -123,66 +153,73 @@ void DivWorkPool::push(void (*what)(void*), void* arg) {
     return;
   }
 
+  pending++;
+  queued++;
   for (unsigned int tryCount=0; tryCount<count; tryCount++) {
     if (pos>=count) pos=0;
-    if (workThreads[pos++].assign(what,arg)) return;
+    if (workThreads[pos++].tasks.push(what,arg)) {
+      if (sleeping>0) {
+        parkLock.lock();
+        parkCond.notify_one();
+        parkLock.unlock();
+      }
+      return;
+    }
   }
+  queued--;
 
-  // all threads are busy
+  // all queues are full
   logW("DivWorkPool: all work threads busy!");
   what(arg);
+  pending--;
 }
 
 bool DivWorkPool::busy() {
   if (!threaded) return false;
-  for (unsigned int i=0; i<count; i++) {
-    if (workThreads[i].busy()) return true;
-  }
-  return false;
+  return pending>0;
 }
 
 void DivWorkPool::wait() {
   if (!threaded) return;
 
-  if (busyCount==0) {
-    return;
-  }
-
-  std::future<void> future=notify.get_future();
+  while (pending>0) {
+    // help out
+    if (runOne(-1)) continue;
 
-  // start running
-  for (unsigned int i=0; i<count; i++) {
-    if (!workThreads[i].promiseAlreadySet && !workThreads[i].tasks.empty()) {
-      try {
-        workThreads[i].lock.lock();
-        workThreads[i].promiseAlreadySet=true;
-        workThreads[i].notify.set_value();
-        workThreads[i].lock.unlock();
-      } catch (std::exception& e) {
-        logE("ERROR IN THREAD SYNC! %s",e.what());
-        abort();
+    // spin for a while before sleeping
+    bool done=false;
+    for (int i=0; i<DIV_WORK_SPIN_COUNT; i++) {
+      if (pending<=0 || queued>0) {
+        done=true;
+        break;
       }
+      std::this_thread::yield();
     }
-  }
-  //std::this_thread::yield();
-
-  // wait
-  future.wait();
+    if (done) continue;
 
-  notify=std::promise<void>();
+    std::unique_lock<std::mutex> unique(parkLock);
+    waiterSleeping=true;
+    waitCond.wait(unique,[this]() {
+      return pending<=0;
+    });
+    waiterSleeping=false;
+  }
 
   pos=0;
 }
 
-DivWorkPool::DivWorkPool(unsigned int threads):
+DivWorkPool::DivWorkPool(unsigned int threads, bool pinThreads):
   threaded(threads>0),
   count(threads),
   pos(0),
-  busyCount(0) {
+  queued(0),
+  pending(0),
+  sleeping(0),
+  waiterSleeping(false) {
   if (threaded) {
     workThreads=new DivWorkThread[threads];
     for (unsigned int i=0; i<count; i++) {
-      if (!workThreads[i].init(this)) { 
+      if (!workThreads[i].init(this,i)) { 
         count=i;
         break;
       }
@@ -192,6 +229,33 @@ DivWorkPool::DivWorkPool(unsigned int threads):
       delete[] workThreads;
       threaded=false;
       workThreads=NULL;
+    } else if (pinThreads) {
+#if defined(__linux__) && !defined(__ANDROID__)
+      // only use the cores we are allowed to run on (taskset, cgroups...)
+      std::vector<int> allowed;
+      cpu_set_t procSet;
+      CPU_ZERO(&procSet);
+      if (sched_getaffinity(0,sizeof(cpu_set_t),&procSet)==0) {
+        for (int i=0; i<CPU_SETSIZE; i++) {
+          if (CPU_ISSET(i,&procSet)) allowed.push_back(i);
+        }
+      }
+      // the first allowed core is kept free of workers so that the calling thread
+      // (the audio thread for the render pool) is never preempted by one.
+      // don't pin if that would put two workers on a core.
+      if (allowed.size()<(size_t)count+1) {
+        logV("DivWorkPool: not pinning %d threads to %d allowed cores",count,(int)allowed.size());
+      } else for (unsigned int i=0; i<count; i++) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(allowed[i+1],&cpuSet);
+        if (pthread_setaffinity_np(workThreads[i].thread->native_handle(),sizeof(cpu_set_t),&cpuSet)!=0) {
+          logW("DivWorkPool: could not pin thread %d to a core",i);
+        }
+      }
+#else
+      logV("DivWorkPool: thread pinning not supported on this platform");
+#endif
     }
   } else {
     workThreads=NULL;
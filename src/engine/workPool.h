@@ -22,10 +22,11 @@
 
 #include <thread>
 #include <atomic>
-#include <functional>
-#include <future>
+#include <mutex>
+#include <condition_variable>
 
-#include "../fixedQueue.h"
+// must be a power of 2
+#define DIV_WORK_QUEUE_SIZE 64
 
 class DivWorkPool;
 
@@ -40,32 +41,47 @@ struct DivPendingTask {
     funcArg(NULL) {}
 };
 
+/**
+ * a lock-free bounded task queue.
+ * only one thread may push, but any thread may pop (steal) from it.
+ */
+struct DivWorkQueue {
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  std::atomic<void (*)(void*)> func[DIV_WORK_QUEUE_SIZE];
+  std::atomic<void*> funcArg[DIV_WORK_QUEUE_SIZE];
+
+  bool push(void (*what)(void*), void* arg);
+  bool pop(DivPendingTask& task);
+  bool empty();
+  DivWorkQueue():
+    head(0),
+    tail(0) {}
+};
+
 struct DivWorkThread {
   DivWorkPool* parent;
-  std::mutex lock;
   std::thread* thread;
-  std::promise<void> notify;
-  FixedQueue<DivPendingTask,32> tasks;
-  std::atomic<bool> isBusy;
-  bool terminate;
-  bool promiseAlreadySet;
+  DivWorkQueue tasks;
+  unsigned int index;
+  std::atomic<bool> terminate;
 
   void run();
-  bool assign(void (*what)(void*), void* arg);
-  void wait();
-  bool busy();
   void finish();
 
-  bool init(DivWorkPool* p);
+  bool init(DivWorkPool* p, unsigned int i);
   DivWorkThread():
     parent(NULL),
-    isBusy(false),
-    terminate(false),
-    promiseAlreadySet(false) {}
+    thread(NULL),
+    index(0),
+    terminate(false) {}
 };
 
 /**
  * this class provides an implementation of a "thread pool" for executing tasks in parallel.
+ * tasks are distributed among per-thread queues. idle threads steal work from the others,
+ * and the calling thread helps out while waiting.
+ * push() and wait() shall be called from the same thread.
  * it is highly recommended to use `new` when allocating a DivWorkPool.
  */
 class DivWorkPool {
@@ -73,13 +89,28 @@ class DivWorkPool {
   unsigned int count;
   unsigned int pos;
   DivWorkThread* workThreads;
+
+  // tasks in queues, and tasks which have not finished yet
+  std::atomic<int> queued;
+  std::atomic<int> pending;
+
+  // parking
+  std::mutex parkLock;
+  std::condition_variable parkCond;
+  std::atomic<int> sleeping;
+  std::condition_variable waitCond;
+  std::atomic<bool> waiterSleeping;
+
+  friend struct DivWorkThread;
+
+  // run one task, looking in the queue of the specified thread first (-1 for any).
+  // returns whether a task was run.
+  bool runOne(int first);
   public:
-    std::promise<void> notify;
-    std::atomic<int> busyCount;
-    
     /**
      * push a new job to this work pool.
-     * if all work threads are busy, this will block until one is free.
+     * the job may start running immediately.
+     * if all queues are full, the job is executed on the calling thread.
      */
     void push(void (*what)(void*), void* arg);
     
@@ -89,11 +120,16 @@ class DivWorkPool {
     bool busy();
 
     /**
-     * wait for all work threads to finish.
+     * wait for all jobs to finish.
+     * the calling thread runs pending jobs as well.
      */
     void wait();
 
-    DivWorkPool(unsigned int threads=0);
+    /**
+     * @param threads number of work threads. 0 runs every job on the calling thread.
+     * @param pinThreads whether to bind each thread to its own CPU core, leaving one free for the calling thread (where supported).
+     */
+    DivWorkPool(unsigned int threads=0, bool pinThreads=false);
     ~DivWorkPool();
 };
 
@@ -0,0 +1,266 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "zlibOps.h"
+#include "workPool.h"
+#include "../ta-log.h"
+#include <zlib.h>
+#include <string.h>
+#include <fmt/printf.h>
+
+#define DIV_INFLATE_MIN_SIZE 131072
+// zlib takes 32-bit lengths
+#define DIV_INFLATE_MAX_STEP 0x40000000
+
+bool divInflate(const unsigned char* data, size_t len, unsigned char*& out, size_t& outLen, String& error) {
+  z_stream zl;
+  memset(&zl,0,sizeof(z_stream));
+
+  zl.avail_in=len;
+  zl.next_in=(Bytef*)data;
+  zl.zalloc=NULL;
+  zl.zfree=NULL;
+  zl.opaque=NULL;
+
+  int nextErr;
+  nextErr=inflateInit(&zl);
+  if (nextErr!=Z_OK) {
+    if (zl.msg==NULL) {
+      logD("zlib error: unknown! %d",nextErr);
+    } else {
+      logD("zlib error: %s",zl.msg);
+    }
+    inflateEnd(&zl);
+    error="not a .dmf/.fur song";
+    return false;
+  }
+
+  // decompress straight into one buffer, growing it when full.
+  // modules usually compress to a fraction of their size, so start with a guess.
+  size_t bufLen=len*4;
+  if (bufLen<DIV_INFLATE_MIN_SIZE) bufLen=DIV_INFLATE_MIN_SIZE;
+  size_t bufPos=0;
+  unsigned char* buf=new unsigned char[bufLen];
+
+  while (true) {
+    if (bufPos>=bufLen) {
+      size_t newLen=bufLen*2;
+      unsigned char* newBuf=new unsigned char[newLen];
+      memcpy(newBuf,buf,bufPos);
+      delete[] buf;
+      buf=newBuf;
+      bufLen=newLen;
+    }
+    size_t step=bufLen-bufPos;
+    if (step>DIV_INFLATE_MAX_STEP) step=DIV_INFLATE_MAX_STEP;
+    zl.next_out=&buf[bufPos];
+    zl.avail_out=step;
+
+    nextErr=inflate(&zl,Z_NO_FLUSH);
+    bufPos+=step-zl.avail_out;
+    if (nextErr==Z_STREAM_END) break;
+    // Z_BUF_ERROR with room left means the input ended before the stream did
+    if (nextErr!=Z_OK && !(nextErr==Z_BUF_ERROR && zl.avail_out==0)) {
+      if (zl.msg==NULL) {
+        logD("zlib error: unknown error! %d",nextErr);
+        error="unknown decompression error";
+      } else {
+        logD("zlib inflate: %s",zl.msg);
+        error=fmt::sprintf("decompression error: %s",zl.msg);
+      }
+      delete[] buf;
+      inflateEnd(&zl);
+      return false;
+    }
+  }
+  nextErr=inflateEnd(&zl);
+  if (nextErr!=Z_OK) {
+    if (zl.msg==NULL) {
+      logD("zlib end error: unknown error! %d",nextErr);
+      error="unknown decompression finish error";
+    } else {
+      logD("zlib end: %s",zl.msg);
+      error=fmt::sprintf("decompression finish error: %s",zl.msg);
+    }
+    delete[] buf;
+    return false;
+  }
+
+  if (bufPos<1) {
+    logD("compressed too small!");
+    error="file too small";
+    delete[] buf;
+    return false;
+  }
+
+  out=buf;
+  outLen=bufPos;
+  return true;
+}
+
+struct DivDeflateChunk {
+  const unsigned char* data;
+  size_t len;
+  size_t dictLen;
+  int level;
+  bool last, gzip;
+
+  unsigned char* out;
+  size_t outLen;
+  unsigned long check;
+  bool ok;
+
+  DivDeflateChunk():
+    data(NULL),
+    len(0),
+    dictLen(0),
+    level(Z_DEFAULT_COMPRESSION),
+    last(false),
+    gzip(false),
+    out(NULL),
+    outLen(0),
+    check(0),
+    ok(false) {}
+  ~DivDeflateChunk() {
+    if (out!=NULL) delete[] out;
+  }
+};
+
+// compress one chunk as a raw deflate stream.
+// every chunk but the last ends with a sync flush, which leaves the output
+// byte-aligned and without a final block so that the next chunk can follow.
+static void deflateChunk(void* arg) {
+  DivDeflateChunk* c=(DivDeflateChunk*)arg;
+  z_stream zl;
+  memset(&zl,0,sizeof(z_stream));
+
+  if (c->gzip) {
+    c->check=crc32(0L,c->data,c->len);
+  } else {
+    c->check=adler32(1L,c->data,c->len);
+  }
+
+  if (deflateInit2(&zl,c->level,Z_DEFLATED,-MAX_WBITS,8,Z_DEFAULT_STRATEGY)!=Z_OK) {
+    return;
+  }
+  if (c->dictLen>0) {
+    if (deflateSetDictionary(&zl,c->data-c->dictLen,c->dictLen)!=Z_OK) {
+      deflateEnd(&zl);
+      return;
+    }
+  }
+
+  // room for the worst case plus the empty stored block of a sync flush
+  size_t outSize=deflateBound(&zl,c->len)+16;
+  c->out=new unsigned char[outSize];
+  zl.next_in=(Bytef*)c->data;
+  zl.avail_in=c->len;
+  zl.next_out=c->out;
+  zl.avail_out=outSize;
+
+  int ret=deflate(&zl,c->last?Z_FINISH:Z_SYNC_FLUSH);
+  if (ret!=(c->last?Z_STREAM_END:Z_OK) || zl.avail_in>0 || zl.avail_out==0) {
+    deflateEnd(&zl);
+    return;
+  }
+  c->outLen=outSize-zl.avail_out;
+  deflateEnd(&zl);
+  c->ok=true;
+}
+
+SafeWriter* divDeflate(const unsigned char* data, size_t len, int level, bool gzip, unsigned int threads) {
+  size_t chunkCount=(len+DIV_DEFLATE_CHUNK_SIZE-1)/DIV_DEFLATE_CHUNK_SIZE;
+  if (chunkCount<1) chunkCount=1;
+
+  if (threads==0) threads=std::thread::hardware_concurrency();
+  if (threads>DIV_DEFLATE_MAX_THREADS) threads=DIV_DEFLATE_MAX_THREADS;
+  if (threads>chunkCount) threads=chunkCount;
+  if (threads<2) threads=0;
+
+  DivDeflateChunk* chunks=new DivDeflateChunk[chunkCount];
+  for (size_t i=0; i<chunkCount; i++) {
+    size_t pos=i*DIV_DEFLATE_CHUNK_SIZE;
+    chunks[i].data=data+pos;
+    chunks[i].len=MIN(len-pos,DIV_DEFLATE_CHUNK_SIZE);
+    chunks[i].dictLen=MIN(pos,32768);
+    chunks[i].level=level;
+    chunks[i].last=(i==chunkCount-1);
+    chunks[i].gzip=gzip;
+  }
+
+  if (threads==0) {
+    for (size_t i=0; i<chunkCount; i++) {
+      deflateChunk(&chunks[i]);
+    }
+  } else {
+    DivWorkPool* pool=new DivWorkPool(threads);
+    for (size_t i=0; i<chunkCount; i++) {
+      pool->push(deflateChunk,&chunks[i]);
+    }
+    pool->wait();
+    delete pool;
+  }
+
+  // stitch the chunks together and combine the checksums
+  unsigned long check=gzip?crc32(0L,NULL,0):adler32(0L,NULL,0);
+  for (size_t i=0; i<chunkCount; i++) {
+    if (!chunks[i].ok) {
+      logE("could not compress chunk %d!",(int)i);
+      delete[] chunks;
+      return NULL;
+    }
+    if (gzip) {
+      check=crc32_combine(check,chunks[i].check,chunks[i].len);
+    } else {
+      check=adler32_combine(check,chunks[i].check,chunks[i].len);
+    }
+  }
+
+  SafeWriter* w=new SafeWriter;
+  w->init();
+  if (gzip) {
+    // magic, deflate, no flags, no time, no extra flags, unknown OS
+    static const unsigned char gzHeader[10]={0x1f,0x8b,8,0,0,0,0,0,0,0xff};
+    w->write(gzHeader,10);
+  } else {
+    int levelFlags=3;
+    if (level==Z_DEFAULT_COMPRESSION || level==6) {
+      levelFlags=2;
+    } else if (level<2) {
+      levelFlags=0;
+    } else if (level<6) {
+      levelFlags=1;
+    }
+    unsigned short header=(0x78<<8)|(levelFlags<<6);
+    header+=31-(header%31);
+    w->writeS_BE(header);
+  }
+  for (size_t i=0; i<chunkCount; i++) {
+    w->write(chunks[i].out,chunks[i].outLen);
+  }
+  if (gzip) {
+    w->writeI(check);
+    w->writeI(len&0xffffffff);
+  } else {
+    w->writeI_BE(check);
+  }
+
+  delete[] chunks;
+  return w;
+}
@@ -0,0 +1,57 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2024 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _ZLIBOPS_H
+#define _ZLIBOPS_H
+
+#include "safeWriter.h"
+#include "../ta-utils.h"
+
+// input is split into chunks of this size which are compressed independently
+#define DIV_DEFLATE_CHUNK_SIZE 131072
+
+#define DIV_DEFLATE_MAX_THREADS 8
+
+/**
+ * decompress a zlib stream into a single buffer.
+ * @param data the compressed data.
+ * @param len its length.
+ * @param out on success, set to a buffer allocated with new[] which the caller shall delete[].
+ * its size may be larger than outLen.
+ * @param outLen on success, set to the decompressed length.
+ * @param error on failure, set to a description of the error.
+ * @return whether decompression succeeded.
+ */
+bool divInflate(const unsigned char* data, size_t len, unsigned char*& out, size_t& outLen, String& error);
+
+/**
+ * compress data into a zlib (or gzip) stream.
+ * the input is split into chunks which are compressed in parallel, with each chunk
+ * using the last 32KB of the previous one as dictionary. the result is a single
+ * valid stream which any zlib/gzip decoder can read.
+ * @param data the data to compress.
+ * @param len its length.
+ * @param level the compression level (0-9, or -1 for default).
+ * @param gzip whether to write a gzip stream instead of a zlib one.
+ * @param threads number of threads to use. 0 picks a number automatically.
+ * @return a SafeWriter with the compressed stream, or NULL on error.
+ */
+SafeWriter* divDeflate(const unsigned char* data, size_t len, int level=-1, bool gzip=false, unsigned int threads=0);
+
+#endif
@@ -1106,7 +1106,7 @@ void FurnaceGUI::doAction(int what) {
 
       if (end-start<1) break;
 
-      sample->prepareUndo(true);
+      sample->prepareUndoRange(start,end,0);
 
       if (sampleClipboard!=NULL) {
         delete[] sampleClipboard;
@@ -1116,6 +1116,7 @@ void FurnaceGUI::doAction(int what) {
       memcpy(sampleClipboard,&(sample->data16[start]),sizeof(short)*(end-start));
 
       e->lockEngine([this,sample,start,end]() {
+
         sample->strip(start,end);
         updateSampleTex=true;
 
@@ -1147,10 +1148,10 @@ void FurnaceGUI::doAction(int what) {
       if (sampleClipboard==NULL || sampleClipboardLen<1) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
       int pos=(sampleSelStart==-1 || sampleSelStart==sampleSelEnd)?sample->samples:sampleSelStart;
       if (pos>=(int)sample->samples) pos=sample->samples-1;
       if (pos<0) pos=0;
+      sample->prepareUndoRange(pos,pos,sampleClipboardLen);
       logV("paste position: %d",pos);
 
       e->lockEngine([this,sample,pos]() {
@@ -1178,10 +1179,11 @@ void FurnaceGUI::doAction(int what) {
       if (sampleClipboard==NULL || sampleClipboardLen<1) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
       int pos=(sampleSelStart==-1 || sampleSelStart==sampleSelEnd)?0:sampleSelStart;
       if (pos>=(int)sample->samples) pos=sample->samples-1;
       if (pos<0) pos=0;
+      unsigned int pasteEnd=MIN(pos+sampleClipboardLen,sample->samples);
+      sample->prepareUndoRange(pos,pasteEnd,pasteEnd-pos);
 
       e->lockEngine([this,sample,pos]() {
         if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
@@ -1209,10 +1211,11 @@ void FurnaceGUI::doAction(int what) {
       if (sampleClipboard==NULL || sampleClipboardLen<1) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
       int pos=(sampleSelStart==-1 || sampleSelStart==sampleSelEnd)?0:sampleSelStart;
       if (pos>=(int)sample->samples) pos=sample->samples-1;
       if (pos<0) pos=0;
+      unsigned int pasteEnd=MIN(pos+sampleClipboardLen,sample->samples);
+      sample->prepareUndoRange(pos,pasteEnd,pasteEnd-pos);
 
       e->lockEngine([this,sample,pos]() {
         if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
@@ -1265,9 +1268,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
         float maxVal=0.0f;
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
@@ -1313,9 +1316,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1344,9 +1347,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1379,9 +1382,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1404,9 +1407,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,0);
+      e->lockEngine([this,sample,start,end]() {
 
         sample->strip(start,end);
         updateSampleTex=true;
@@ -1440,9 +1443,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1473,9 +1476,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1500,9 +1503,9 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
+      SAMPLE_OP_BEGIN;
+      sample->prepareUndoRange(start,end,end-start);
+      e->lockEngine([this,sample,start,end]() {
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1640,10 +1643,10 @@ void FurnaceGUI::doAction(int what) {
     case GUI_ACTION_SAMPLE_SET_LOOP: {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
-      sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
-        SAMPLE_OP_BEGIN;
-
+      SAMPLE_OP_BEGIN;
+      // no sample data changes
+      sample->prepareUndoRange(0,0,0);
+      e->lockEngine([this,sample,start,end]() {
         sample->loopStart=start;
         sample->loopEnd=end;
         sample->loop=true;
@@ -52,6 +52,32 @@ const char* FurnaceGUI::noteNameNormal(short note, short octave) {
   return noteNames[seek];
 }
 
+// find the first order affected by an undo step, so that only seek keyframes after it are invalidated.
+static int firstOrderOfUndoStep(DivEngine* e, const UndoStep& us) {
+  if (!us.other.empty()) return 0;
+  if (us.oldPatLen!=us.newPatLen) return 0;
+
+  int ret=DIV_MAX_PATTERNS;
+  if (us.oldOrdersLen!=us.newOrdersLen) {
+    ret=MAX(0,MIN(us.oldOrdersLen,us.newOrdersLen)-1);
+  }
+  for (const UndoOrderData& i: us.ord) {
+    if (i.subSong!=(int)e->getCurrentSubSong()) return 0;
+    if (i.ord<ret) ret=i.ord;
+  }
+  for (const UndoPatternData& i: us.pat) {
+    if (i.subSong!=(int)e->getCurrentSubSong()) return 0;
+    // patterns may be used in more than one order
+    for (int j=0; j<e->curSubSong->ordersLen && j<ret; j++) {
+      if (e->curOrders->ord[i.chan][j]==i.pat) {
+        ret=j;
+        break;
+      }
+    }
+  }
+  return ret;
+}
+
 void FurnaceGUI::prepareUndo(ActionType action, UndoRegion region) {
   if (region.begin.ord==-1) {
     region.begin.ord=curOrder;
@@ -191,8 +217,8 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
     case GUI_UNDO_PATTERN_DRAG:
       for (int h=region.begin.ord; h<=region.end.ord; h++) {
         for (int i=region.begin.x; i<=region.end.x; i++) {
-          DivPattern* p=e->curPat[i].getPattern(e->curOrders->ord[i][h],false);
-          DivPattern* op=NULL;
+          const DivPattern* p=e->curPat[i].getPattern(e->curOrders->ord[i][h],false);
+          const DivPattern* op=NULL;
           unsigned short id=h|(i<<8);
 
           auto it=oldPatMap.find(id);
@@ -241,7 +267,8 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
       break;
   }
   if (doPush) {
-    MARK_MODIFIED;
+    modified=true;
+    e->invalidateSeekIndex(firstOrderOfUndoStep(e,s));
     undoHist.push_back(s);
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
@@ -1741,6 +1768,7 @@ void FurnaceGUI::doCollapseSong(int divider) {
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
   }
+  e->invalidateSeekIndex();
   
   if (e->isPlaying()) e->play();
 }
@@ -1821,6 +1849,7 @@ void FurnaceGUI::doExpandSong(int multiplier) {
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
   }
+  e->invalidateSeekIndex();
 
   if (e->isPlaying()) e->play();
 }
@@ -1916,7 +1945,8 @@ void FurnaceGUI::doUndo() {
   if (undoHist.empty()) return;
   UndoStep& us=undoHist.back();
   redoHist.push_back(us);
-  MARK_MODIFIED;
+  modified=true;
+  e->invalidateSeekIndex(firstOrderOfUndoStep(e,us));
 
   switch (us.type) {
     case GUI_UNDO_CHANGE_ORDER:
@@ -1992,7 +2022,8 @@ void FurnaceGUI::doRedo() {
   if (redoHist.empty()) return;
   UndoStep& us=redoHist.back();
   undoHist.push_back(us);
-  MARK_MODIFIED;
+  modified=true;
+  e->invalidateSeekIndex(firstOrderOfUndoStep(e,us));
 
   switch (us.type) {
     case GUI_UNDO_CHANGE_ORDER:
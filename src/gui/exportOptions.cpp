@@ -200,6 +200,14 @@ void FurnaceGUI::drawExportVGM(bool onWindow) {
       "at the cost of a massive increase in file size."
     ));
   }
+  ImGui::Checkbox(_("optimize"),&vgmExportOptimize);
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(_(
+      "removes register writes which don't change anything,\n"
+      "merges consecutive waits and stores identical samples only once."
+    ));
+  }
+  ImGui::Checkbox(_("compress (.vgz)"),&vgmExportCompress);
   ImGui::Text(_("chips to export:"));
   bool hasOneAtLeast=false;
   for (int i=0; i<e->song.systemLen; i++) {
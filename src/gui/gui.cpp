@@ -38,7 +38,7 @@
 #include "scaling.h"
 #include "introTune.h"
 #include <stdint.h>
-#include <zlib.h>
+#include "../engine/zlibOps.h"
 #include <fmt/printf.h>
 #include <stdexcept>
 
@@ -2028,7 +2028,7 @@ void FurnaceGUI::openFileDialog(FurnaceGUIFileDialogs type) {
       if (!dirExists(workingDirVGMExport)) workingDirVGMExport=getHomeDir();
       hasOpened=fileDialog->openSave(
         _("Export VGM"),
-        {_("VGM file"), "*.vgm"},
+        vgmExportCompress?std::vector<String>({_("compressed VGM file"), "*.vgz"}):std::vector<String>({_("VGM file"), "*.vgm"}),
         workingDirVGMExport,
         dpiScale,
         (settings.autoFillSave)?shortName:""
@@ -2266,6 +2266,8 @@ void FurnaceGUI::openFileDialog(FurnaceGUIFileDialogs type) {
 
 int FurnaceGUI::save(String path, int dmfVersion) {
   SafeWriter* w;
+  // only one save may be in flight
+  finishSave(true);
   logD("saving file...");
   if (dmfVersion) {
     if (dmfVersion<24) dmfVersion=24;
@@ -2278,84 +2280,51 @@ int FurnaceGUI::save(String path, int dmfVersion) {
     logE("couldn't save! %s",lastError);
     return 3;
   }
+  // the song may have been mapped from the file we are about to overwrite
+  e->unmapSamples(path.c_str());
   logV("opening file for writing...");
   FILE* outFile=ps_fopen(path.c_str(),"wb");
   if (outFile==NULL) {
     lastError=strerror(errno);
     logE("couldn't save! %s",lastError);
     w->finish();
+    delete w;
     return 1;
   }
-  if (settings.compress) {
-    unsigned char zbuf[131072];
-    int ret;
-    z_stream zl;
-    memset(&zl,0,sizeof(z_stream));
-    ret=deflateInit(&zl,Z_DEFAULT_COMPRESSION);
-    if (ret!=Z_OK) {
-      logE("zlib error!");
-      lastError=_("compression error");
-      fclose(outFile);
+
+  // w is a snapshot of the song, so compressing and writing it
+  // may happen in the background.
+  bool compress=settings.compress;
+  saveTask=std::async(std::launch::async,[this,w,outFile,compress]() -> int {
+    SafeWriter* out=w;
+    if (compress) {
+      out=divDeflate(w->getFinalBuf(),w->size());
       w->finish();
-      return 2;
-    }
-    zl.avail_in=w->size();
-    zl.next_in=w->getFinalBuf();
-    while (zl.avail_in>0) {
-      zl.avail_out=131072;
-      zl.next_out=zbuf;
-      if ((ret=deflate(&zl,Z_NO_FLUSH))==Z_STREAM_ERROR) {
-        logE("zlib stream error!");
-        lastError=_("zlib stream error");
-        deflateEnd(&zl);
+      delete w;
+      if (out==NULL) {
+        logE("zlib error!");
+        saveError=_("compression error");
         fclose(outFile);
-        w->finish();
         return 2;
       }
-      size_t amount=131072-zl.avail_out;
-      if (amount>0) {
-        if (fwrite(zbuf,1,amount,outFile)!=amount) {
-          logE("did not write entirely: %s!",strerror(errno));
-          lastError=strerror(errno);
-          deflateEnd(&zl);
-          fclose(outFile);
-          w->finish();
-          return 1;
-        }
-      }
-    }
-    zl.avail_out=131072;
-    zl.next_out=zbuf;
-    if ((ret=deflate(&zl,Z_FINISH))==Z_STREAM_ERROR) {
-      logE("zlib finish stream error!");
-      lastError=_("zlib finish stream error");
-      deflateEnd(&zl);
-      fclose(outFile);
-      w->finish();
-      return 2;
-    }
-    if (131072-zl.avail_out>0) {
-      if (fwrite(zbuf,1,131072-zl.avail_out,outFile)!=(131072-zl.avail_out)) {
-        logE("did not write entirely: %s!",strerror(errno));
-        lastError=strerror(errno);
-        deflateEnd(&zl);
-        fclose(outFile);
-        w->finish();
-        return 1;
-      }
     }
-    deflateEnd(&zl);
-  } else {
-    if (fwrite(w->getFinalBuf(),1,w->size(),outFile)!=w->size()) {
+    int ret=0;
+    if (fwrite(out->getFinalBuf(),1,out->size(),outFile)!=out->size()) {
       logE("did not write entirely: %s!",strerror(errno));
-      lastError=strerror(errno);
-      fclose(outFile);
-      w->finish();
-      return 1;
-    }
-  }
-  fclose(outFile);
-  w->finish();
+      saveError=strerror(errno);
+      ret=1;
+    }
+    if (fclose(outFile)!=0 && ret==0) {
+      logE("could not close file: %s!",strerror(errno));
+      saveError=strerror(errno);
+      ret=1;
+    }
+    out->finish();
+    delete out;
+    if (ret==0) logD("save complete.");
+    return ret;
+  });
+
   backupLock.lock();
   curFileName=path;
   backupLock.unlock();
@@ -2366,63 +2335,86 @@ int FurnaceGUI::save(String path, int dmfVersion) {
   }
   pushRecentFile(path);
   pushRecentSys(path.c_str());
-  logD("save complete.");
   return 0;
 }
 
+bool FurnaceGUI::finishSave(bool wait) {
+  if (!saveTask.valid()) return true;
+  if (!wait) {
+    if (saveTask.wait_for(std::chrono::seconds(0))!=std::future_status::ready) return true;
+  }
+  if (saveTask.get()>0) {
+    // the song was not written after all
+    modified=true;
+    updateWindowTitle();
+    showError(fmt::sprintf(_("Error while saving file! (%s)"),saveError));
+    return false;
+  }
+  return true;
+}
+
 int FurnaceGUI::load(String path) {
   bool wasPlaying=e->isPlaying();
   if (!path.empty()) {
     logI("loading module...");
-    FILE* f=ps_fopen(path.c_str(),"rb");
-    if (f==NULL) {
-      perror("error");
-      lastError=strerror(errno);
-      return 1;
-    }
-    if (fseek(f,0,SEEK_END)<0) {
-      perror("size error");
-      lastError=fmt::sprintf(_("on seek: %s"),strerror(errno));
-      fclose(f);
-      return 1;
-    }
-    ssize_t len=ftell(f);
-    if (len==(SIZE_MAX>>1)) {
-      perror("could not get file length");
-      lastError=fmt::sprintf(_("on pre tell: %s"),strerror(errno));
-      fclose(f);
+    // large uncompressed songs are mapped rather than read
+    int mapResult=e->loadMapped(path.c_str());
+    if (mapResult<0) {
+      lastError=e->getLastError();
+      logE("could not open file!");
       return 1;
     }
-    if (len<1) {
-      if (len==0) {
-        logE("that file is empty!");
-        lastError=_("file is empty");
-      } else {
-        perror("tell error");
-        lastError=fmt::sprintf(_("on tell: %s"),strerror(errno));
+    if (mapResult==0) {
+      FILE* f=ps_fopen(path.c_str(),"rb");
+      if (f==NULL) {
+        perror("error");
+        lastError=strerror(errno);
+        return 1;
+      }
+      if (fseek(f,0,SEEK_END)<0) {
+        perror("size error");
+        lastError=fmt::sprintf(_("on seek: %s"),strerror(errno));
+        fclose(f);
+        return 1;
+      }
+      ssize_t len=ftell(f);
+      if (len==(SIZE_MAX>>1)) {
+        perror("could not get file length");
+        lastError=fmt::sprintf(_("on pre tell: %s"),strerror(errno));
+        fclose(f);
+        return 1;
+      }
+      if (len<1) {
+        if (len==0) {
+          logE("that file is empty!");
+          lastError=_("file is empty");
+        } else {
+          perror("tell error");
+          lastError=fmt::sprintf(_("on tell: %s"),strerror(errno));
+        }
+        fclose(f);
+        return 1;
+      }
+      if (fseek(f,0,SEEK_SET)<0) {
+        perror("size error");
+        lastError=fmt::sprintf(_("on get size: %s"),strerror(errno));
+        fclose(f);
+        return 1;
+      }
+      unsigned char* file=new unsigned char[len];
+      if (fread(file,1,(size_t)len,f)!=(size_t)len) {
+        perror("read error");
+        lastError=fmt::sprintf(_("on read: %s"),strerror(errno));
+        fclose(f);
+        delete[] file;
+        return 1;
       }
       fclose(f);
-      return 1;
-    }
-    if (fseek(f,0,SEEK_SET)<0) {
-      perror("size error");
-      lastError=fmt::sprintf(_("on get size: %s"),strerror(errno));
-      fclose(f);
-      return 1;
-    }
-    unsigned char* file=new unsigned char[len];
-    if (fread(file,1,(size_t)len,f)!=(size_t)len) {
-      perror("read error");
-      lastError=fmt::sprintf(_("on read: %s"),strerror(errno));
-      fclose(f);
-      delete[] file;
-      return 1;
-    }
-    fclose(f);
-    if (!e->load(file,(size_t)len,path.c_str())) {
-      lastError=e->getLastError();
-      logE("could not open file!");
-      return 1;
+      if (!e->load(file,(size_t)len,path.c_str())) {
+        lastError=e->getLastError();
+        logE("could not open file!");
+        return 1;
+      }
     }
   }
   backupLock.lock();
@@ -2804,6 +2796,9 @@ void FurnaceGUI::processDrags(int dragX, int dragY) {
           if (val>127) val=127;
           for (int i=x; i<=x1; i++) ((signed char*)sampleDragTarget)[i]=val;
         }
+        if (curSample>=0 && curSample<(int)e->song.sample.size()) {
+          e->song.sample[curSample]->invalidatePeaks(x,x1+1);
+        }
         updateSampleTex=true;
       }
     } else { // select
@@ -5149,7 +5144,7 @@ bool FurnaceGUI::loop() {
             checkExtension(".raw");
           }
           if (curFileDialog==GUI_FILE_EXPORT_VGM) {
-            checkExtension(".vgm");
+            checkExtension(vgmExportCompress?".vgz":".vgm");
           }
           if (curFileDialog==GUI_FILE_EXPORT_ROM) {
             checkExtension(romFilterExt.c_str());
@@ -5188,6 +5183,9 @@ bool FurnaceGUI::loop() {
               if (save(copyOfName,0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
                 saveWasSuccessful=false;
+              } else if (postWarnAction!=GUI_WARN_GENERIC) {
+                // the song is about to go away, so make sure it was written
+                saveWasSuccessful=finishSave(true);
               }
               if (saveWasSuccessful && postWarnAction!=GUI_WARN_GENERIC) {
                 switch (postWarnAction) {
@@ -5216,8 +5214,10 @@ bool FurnaceGUI::loop() {
                     break;
                 }
                 postWarnAction=GUI_WARN_GENERIC;
-              } else if (postWarnAction==GUI_WARN_OPEN_DROP) {
-                nextFile="";
+              } else if (postWarnAction!=GUI_WARN_GENERIC) {
+                // cancel the pending action
+                if (postWarnAction==GUI_WARN_OPEN_DROP) nextFile="";
+                postWarnAction=GUI_WARN_GENERIC;
               }
               break;
             }
@@ -5609,7 +5609,17 @@ bool FurnaceGUI::loop() {
               break;
             }
             case GUI_FILE_EXPORT_VGM: {
-              SafeWriter* w=e->saveVGM(willExport,vgmExportLoop,vgmExportVersion,vgmExportPatternHints,vgmExportDirectStream,vgmExportTrailingTicks);
+              SafeWriter* w=e->saveVGM(willExport,vgmExportLoop,vgmExportVersion,vgmExportPatternHints,vgmExportDirectStream,vgmExportTrailingTicks,vgmExportOptimize);
+              if (w!=NULL && vgmExportCompress) {
+                SafeWriter* compressed=divDeflate(w->getFinalBuf(),w->size(),9,true);
+                w->finish();
+                delete w;
+                w=compressed;
+                if (w==NULL) {
+                  showError(_("could not compress VGM!"));
+                  break;
+                }
+              }
               if (w!=NULL) {
                 FILE* f=ps_fopen(copyOfName.c_str(),"wb");
                 if (f!=NULL) {
@@ -6067,7 +6077,7 @@ bool FurnaceGUI::loop() {
             } else {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
-              } else {
+              } else if (finishSave(true)) {
                 quit=true;
               }
             }
@@ -6091,7 +6101,7 @@ bool FurnaceGUI::loop() {
             } else {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
-              } else {
+              } else if (finishSave(true)) {
                 displayNew=true;
               }
             }
@@ -6115,7 +6125,7 @@ bool FurnaceGUI::loop() {
             } else {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
-              } else {
+              } else if (finishSave(true)) {
                 openFileDialog(GUI_FILE_OPEN);
               }
             }
@@ -6139,7 +6149,7 @@ bool FurnaceGUI::loop() {
             } else {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
-              } else {
+              } else if (finishSave(true)) {
                 cvOpen=true;
               }
             }
@@ -6163,7 +6173,7 @@ bool FurnaceGUI::loop() {
             } else {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
-              } else {
+              } else if (finishSave(true)) {
                 openFileDialog(GUI_FILE_OPEN_BACKUP);
               }
             }
@@ -6188,11 +6198,13 @@ bool FurnaceGUI::loop() {
               if (save(curFileName,e->song.isDMF?e->song.version:0)>0) {
                 showError(fmt::sprintf(_("Error while saving file! (%s)"),lastError));
                 nextFile="";
-              } else {
+              } else if (finishSave(true)) {
                 if (load(nextFile)>0) {
                   showError(fmt::sprintf(_("Error while loading file! (%s)"),lastError));
                 }
                 nextFile="";
+              } else {
+                nextFile="";
               }
             }
           }
@@ -6313,11 +6325,7 @@ bool FurnaceGUI::loop() {
               e->lockEngine([this]() {
                 for (int i=0; i<e->getTotalChannelCount(); i++) {
                   DivPattern* pat=e->curPat[i].getPattern(e->curOrders->ord[i][curOrder],true);
-                  memset(pat->data,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
-                  for (int j=0; j<DIV_MAX_ROWS; j++) {
-                    pat->data[j][0]=0;
-                    pat->data[j][1]=0;
-                  }
+                  pat->clear();
                 }
               });
               MARK_MODIFIED;
@@ -7015,17 +7023,32 @@ bool FurnaceGUI::loop() {
 
     layoutTimeEnd=SDL_GetPerformanceCounter();
 
+    // report errors from a background save
+    finishSave(false);
+
     // backup trigger
     if (modified && settings.backupEnable) {
       if (backupTimer>0) {
         backupTimer=(backupTimer-ImGui::GetIO().DeltaTime);
         if (backupTimer<=0) {
-          backupTask=std::async(std::launch::async,[this]() -> bool {
+          // take a snapshot of the song here. the rest happens in the background
+          SafeWriter* backupData=NULL;
+          if (curFileName.find(backupPath)!=0) {
+            logD("saving backup...");
+            backupData=e->saveFur(true,true);
+          }
+          bool compress=settings.compress;
+          backupTask=std::async(std::launch::async,[this,backupData,compress]() -> bool {
+            SafeWriter* w=backupData;
             backupLock.lock();
             logV("backupPath: %s",backupPath);
             logV("curFileName: %s",curFileName);
             if (curFileName.find(backupPath)==0) {
               logD("backup file open. not saving backup.");
+              if (w!=NULL) {
+                w->finish();
+                delete w;
+              }
               backupTimer=settings.backupInterval;
               backupLock.unlock();
               return true;
@@ -7033,13 +7056,26 @@ bool FurnaceGUI::loop() {
             if (!dirExists(backupPath.c_str())) {
               if (!makeDir(backupPath.c_str())) {
                 logW("could not create backup directory!");
+                if (w!=NULL) {
+                  w->finish();
+                  delete w;
+                }
                 backupTimer=settings.backupInterval;
                 backupLock.unlock();
                 return false;
               }
             }
-            logD("saving backup...");
-            SafeWriter* w=e->saveFur(true,true);
+            if (w!=NULL && compress) {
+              // favor speed over size for backups
+              SafeWriter* compressed=divDeflate(w->getFinalBuf(),w->size(),1);
+              if (compressed!=NULL) {
+                w->finish();
+                delete w;
+                w=compressed;
+              } else {
+                logW("could not compress backup!");
+              }
+            }
             logV("writing file...");
 
             if (w!=NULL) {
@@ -7097,6 +7133,7 @@ bool FurnaceGUI::loop() {
                 logW("could not save backup: %s!",strerror(errno));
               }
               w->finish();
+              delete w;
 
               // delete previous backup if there are too many
               delFirstBackup(backupBaseName);
@@ -8255,6 +8292,12 @@ bool FurnaceGUI::finish(bool saveConfig) {
     oscValuesAverage=NULL;
   }
 
+  if (saveTask.valid()) {
+    if (saveTask.get()>0) {
+      logE("error while saving file! (%s)",saveError);
+    }
+  }
+
   if (backupTask.valid()) {
     backupTask.get();
   }
@@ -8267,6 +8310,8 @@ bool FurnaceGUI::finish(bool saveConfig) {
 }
 
 bool FurnaceGUI::requestQuit() {
+  // a save may still be in flight. if it fails, stay open so the error can be seen
+  if (!finishSave(true)) return false;
   if (modified && !cvOpen) {
     showWarning(_("Unsaved changes! Save changes before quitting?"),GUI_WARN_QUIT);
   } else {
@@ -8299,6 +8344,8 @@ FurnaceGUI::FurnaceGUI():
   vgmExportLoop(true),
   vgmExportPatternHints(false),
   vgmExportDirectStream(false),
+  vgmExportOptimize(true),
+  vgmExportCompress(false),
   displayInsTypeList(false),
   portrait(false),
   injectBackUp(false),
@@ -44,13 +44,13 @@
 #define handleUnimportant if (settings.insFocusesPattern && patternOpen) {nextWindow=GUI_WINDOW_PATTERN;}
 #define unimportant(x) if (x) {handleUnimportant}
 
-#define MARK_MODIFIED modified=true;
+#define MARK_MODIFIED modified=true; e->invalidateSeekIndex();
 #define WAKE_UP drawHalt=5;
 
 #define RESET_WAVE_MACRO_ZOOM \
   for (DivInstrument* _wi: e->song.ins) { \
-    _wi->std.waveMacro.vZoom=-1; \
-    _wi->std.waveMacro.vScroll=-1; \
+    getMacroView(&_wi->std.waveMacro).vZoom=-1; \
+    getMacroView(&_wi->std.waveMacro).vScroll=-1; \
   }
 
 #define CHECK_LONG_HOLD (mobileUI && ImGui::GetIO().MouseDown[ImGuiMouseButton_Left] && ImGui::GetIO().MouseDownDuration[ImGuiMouseButton_Left]>=longThreshold && ImGui::GetIO().MouseDownDurationPrev[ImGuiMouseButton_Left]<longThreshold && ImGui::GetIO().MouseDragMaxDistanceSqr[ImGuiMouseButton_Left]<=ImGui::GetIO().ConfigInertialScrollToleranceSqr)
@@ -1386,6 +1386,18 @@ struct FurnaceGUIMacroDesc {
   }
 };
 
+// view state of a macro in the instrument editor
+struct FurnaceGUIMacroView {
+  int vScroll, vZoom;
+  // values of the other macro type (sequence or ADSR/LFO)
+  int typeMemory[16];
+  FurnaceGUIMacroView():
+    vScroll(0),
+    vZoom(-1) {
+    memset(typeMemory,0,16*sizeof(int));
+  }
+};
+
 struct FurnaceGUIMacroEditState {
   int selectedMacro;
   FurnaceGUIMacroEditState():
@@ -1611,6 +1623,7 @@ class FurnaceGUI {
 
   FurnaceGUITexture* sampleTex;
   int sampleTexW, sampleTexH;
+  std::vector<unsigned int> sampleTexData;
   bool updateSampleTex;
 
   String workingDir, fileName, clipboard, warnString, errorString, lastError, curFileName, nextFile, sysSearchQuery, newSongQuery, paletteQuery, sampleBankSearchQuery;
@@ -1635,7 +1648,7 @@ class FurnaceGUI {
   std::vector<String> availAudioDrivers;
 
   bool quit, warnQuit, willCommit, edit, editClone, isPatUnique, modified, displayError, displayExporting, vgmExportLoop, vgmExportPatternHints;
-  bool vgmExportDirectStream, displayInsTypeList, displayWaveSizeList;
+  bool vgmExportDirectStream, vgmExportOptimize, vgmExportCompress, displayInsTypeList, displayWaveSizeList;
   bool portrait, injectBackUp, mobileMenuOpen, warnColorPushed;
   bool wantCaptureKeyboard, oldWantCaptureKeyboard, displayMacroMenu;
   bool displayNew, displayExport, displayPalette, fullScreen, preserveChanPos, sysDupCloneChannels, sysDupEnd, noteInputPoly, notifyWaveChange;
@@ -1706,6 +1719,9 @@ class FurnaceGUI {
   std::atomic<double> backupTimer;
   std::future<bool> backupTask;
   std::mutex backupLock;
+  // compression and writing of the last saved song
+  std::future<int> saveTask;
+  String saveError;
   String backupPath;
 
   std::vector<FurnaceGUIBackupEntry> backupEntries;
@@ -1815,6 +1831,10 @@ class FurnaceGUI {
     int swanQualityRender;
     int vbQualityRender;
     int pcSpeakerOutMethod;
+    int brrEncoder;
+    int sampleCacheSize;
+    int sampleCacheDisk;
+    int sampleCacheDiskSize;
     String yrw801Path;
     String tg100Path;
     String mu5Path;
@@ -1960,6 +1980,7 @@ class FurnaceGUI {
     int wasapiEx;
     int chanOscThreads;
     int renderPoolThreads;
+    int renderPoolPinThreads;
     int writeInsNames;
     int readInsNames;
     int fontBackend;
@@ -2078,6 +2099,10 @@ class FurnaceGUI {
       swanQualityRender(3),
       vbQualityRender(3),
       pcSpeakerOutMethod(0),
+      brrEncoder(0),
+      sampleCacheSize(64),
+      sampleCacheDisk(0),
+      sampleCacheDiskSize(256),
       yrw801Path(""),
       tg100Path(""),
       mu5Path(""),
@@ -2220,6 +2245,7 @@ class FurnaceGUI {
       wasapiEx(0),
       chanOscThreads(0),
       renderPoolThreads(0),
+      renderPoolPinThreads(0),
       writeInsNames(0),
       readInsNames(1),
       fontBackend(1),
@@ -2296,6 +2322,7 @@ class FurnaceGUI {
 
   DivInstrument* prevInsData;
   DivInstrument cachedCurIns;
+  std::unordered_map<const DivInstrumentMacro*,FurnaceGUIMacroView> macroViews;
   DivInstrument* cachedCurInsPtr;
   bool insEditMayBeDirty;
 
@@ -2807,6 +2834,8 @@ class FurnaceGUI {
 
   void patternRow(int i, bool isPlaying, float lineHeight, int chans, int ord, const DivPattern** patCache, bool inhibitSel);
 
+  FurnaceGUIMacroView& getMacroView(const DivInstrumentMacro* macro);
+  void pruneMacroViews();
   void drawMacroEdit(FurnaceGUIMacroDesc& i, int totalFit, float availableWidth, int index);
   void drawMacros(std::vector<FurnaceGUIMacroDesc>& macros, FurnaceGUIMacroEditState& state);
   void alterSampleMap(int column, int val);
@@ -2995,6 +3024,7 @@ class FurnaceGUI {
 
   void openFileDialog(FurnaceGUIFileDialogs type);
   int save(String path, int dmfVersion);
+  bool finishSave(bool wait);
   int load(String path);
   int loadStream(String path);
   void openRecentFile(String path);
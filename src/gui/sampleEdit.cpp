@@ -557,7 +557,7 @@ void FurnaceGUI::drawSampleEdit() {
           if (sample->depth==DIV_SAMPLE_DEPTH_BRR || isThereSNES) {
             bool be=sample->brrEmphasis;
             if (ImGui::Checkbox(_("BRR emphasis"),&be)) {
-              sample->prepareUndo(true);
+              sample->prepareUndoRange(0,0,0);
               sample->brrEmphasis=be;
               e->renderSamplesP(curSample);
               updateSampleTex=true;
@@ -574,7 +574,7 @@ void FurnaceGUI::drawSampleEdit() {
           if (sample->depth!=DIV_SAMPLE_DEPTH_BRR && isThereSNES) {
             bool bf=sample->brrNoFilter;
             if (ImGui::Checkbox(_("no BRR filters"),&bf)) {
-              sample->prepareUndo(true);
+              sample->prepareUndoRange(0,0,0);
               sample->brrNoFilter=bf;
               e->renderSamplesP(curSample);
               updateSampleTex=true;
@@ -587,7 +587,7 @@ void FurnaceGUI::drawSampleEdit() {
           if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && e->getSampleFormatMask()&(1L<<DIV_SAMPLE_DEPTH_8BIT)) {
             bool di=sample->dither;
             if (ImGui::Checkbox(_("8-bit dither"),&di)) {
-              sample->prepareUndo(true);
+              sample->prepareUndoRange(0,0,0);
               sample->dither=di;
               e->renderSamplesP(curSample);
               updateSampleTex=true;
@@ -719,7 +719,7 @@ void FurnaceGUI::drawSampleEdit() {
             for (int i=0; i<DIV_SAMPLE_LOOP_MAX; i++) {
               if (sampleLoopModes[i]==NULL) continue;
               if (ImGui::Selectable(sampleLoopModes[i])) {
-                sample->prepareUndo(true);
+                sample->prepareUndoRange(0,0,0);
                 sample->loopMode=(DivSampleLoopMode)i;
                 e->renderSamplesP(curSample);
                 updateSampleTex=true;
@@ -943,7 +943,8 @@ void FurnaceGUI::drawSampleEdit() {
           if (resizeSize>16777215) resizeSize=16777215;
         }
         if (ImGui::Button(_("Resize"))) {
-          sample->prepareUndo(true);
+          unsigned int resizeStart=MIN((unsigned int)resizeSize,sample->samples);
+          sample->prepareUndoRange(resizeStart,sample->samples,resizeSize-resizeStart);
           e->lockEngine([this,sample]() {
             if (!sample->resize(resizeSize)) {
               showError(_("couldn't resize! make sure your sample is 8 or 16-bit."));
@@ -1051,9 +1052,9 @@ void FurnaceGUI::drawSampleEdit() {
         ImGui::SameLine();
         ImGui::Text("(%.1fdB)",20.0*log10(amplifyVol/100.0f));
         if (ImGui::Button(_("Apply"))) {
-          sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
-            SAMPLE_OP_BEGIN;
+          SAMPLE_OP_BEGIN;
+          sample->prepareUndoRange(start,end,end-start);
+          e->lockEngine([this,sample,start,end]() {
             float vol=amplifyVol/100.0f;
 
             if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
@@ -1118,7 +1119,7 @@ void FurnaceGUI::drawSampleEdit() {
         }
         if (ImGui::Button(_("Go"))) {
           int pos=(sampleSelStart==-1 || sampleSelStart==sampleSelEnd)?sample->samples:sampleSelStart;
-          sample->prepareUndo(true);
+          sample->prepareUndoRange(pos,pos,silenceSize);
           e->lockEngine([this,sample,pos]() {
             if (!sample->insert(pos,silenceSize)) {
               showError(_("couldn't insert! make sure your sample is 8 or 16-bit."));
@@ -1238,9 +1239,9 @@ void FurnaceGUI::drawSampleEdit() {
         }
 
         if (ImGui::Button(_("Apply"))) {
-          sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
-            SAMPLE_OP_BEGIN;
+          SAMPLE_OP_BEGIN;
+          sample->prepareUndoRange(start,end,end-start);
+          e->lockEngine([this,sample,start,end]() {
             float res=1.0-pow(sampleFilterRes,0.5f);
             float low=0;
             float band=0;
@@ -1329,7 +1330,7 @@ void FurnaceGUI::drawSampleEdit() {
             showError(_("Crossfade: length would overflow loopStart. Try a smaller random value."));
             ImGui::CloseCurrentPopup();
           } else {
-            sample->prepareUndo(true);
+            sample->prepareUndoRange(sample->loopEnd-sampleCrossFadeLoopLength,sample->loopEnd,sampleCrossFadeLoopLength);
             e->lockEngine([this,sample] {
               SAMPLE_OP_BEGIN;
               double l=1.0/(double)sampleCrossFadeLoopLength;
@@ -1547,7 +1548,10 @@ void FurnaceGUI::drawSampleEdit() {
           if (!rend->lockTexture(sampleTex,(void**)&dataT,&pitch)) {
             logE("error while locking sample texture! %s",SDL_GetError());
           } else {
-            unsigned int* data=new unsigned int[sampleTexW*sampleTexH];
+            if (sampleTexData.size()!=(size_t)(sampleTexW*sampleTexH)) {
+              sampleTexData.resize(sampleTexW*sampleTexH);
+            }
+            unsigned int* data=sampleTexData.data();
 
             ImU32 bgColor=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_BG]);
             ImU32 bgColorLoop=ImGui::GetColorU32(uiColors[GUI_COLOR_SAMPLE_LOOP]);
@@ -1602,32 +1606,17 @@ void FurnaceGUI::drawSampleEdit() {
               int y1, y2;
               int candMin=INT_MAX;
               int candMax=INT_MIN;
-              int totalAdvance=0;
-              if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-              } else {
-                if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-              }
+              unsigned int totalAdvance=0;
               xFine+=xAdvanceFine;
               if (xFine>=16777216) {
                 xFine-=16777216;
                 totalAdvance++;
               }
               totalAdvance+=xAdvanceCoarse;
-              if (xCoarse>=sample->samples) break;
-              do {
-                if (xCoarse>=sample->samples) break;
-                if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                  if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                  if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-                } else {
-                  if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                  if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-                }
-                if (totalAdvance>0) xCoarse++;
-              } while ((totalAdvance--)>0);
+              // the column covers xCoarse to xCoarse+totalAdvance, both inclusive
+              sample->getPeak(xCoarse,MIN(xCoarse+totalAdvance+1,sample->samples),candMin,candMax);
+              xCoarse+=totalAdvance;
+              if (candMin>candMax) break;
               if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
                 y1=(((unsigned char)candMin^0x80)*availY)>>8;
                 y2=(((unsigned char)candMax^0x80)*availY)>>8;
@@ -1665,7 +1654,6 @@ void FurnaceGUI::drawSampleEdit() {
               }
             }
             rend->unlockTexture(sampleTex);
-            delete[] data;
           }
           updateSampleTex=false;
         }
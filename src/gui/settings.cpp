@@ -226,6 +226,12 @@ const char* pcspkrOutMethods[]={
   _N("outb()")
 };
 
+const char* brrEncoders[]={
+  _N("Fast"),
+  _N("Trellis (better quality)"),
+  _N("Trellis (best quality, slow)")
+};
+
 const char* valueInputStyles[]={
   _N("Disabled/custom"),
   _N("Two octaves (0 is C-4, F is D#5)"),
@@ -1450,6 +1456,15 @@ void FurnaceGUI::drawSettings() {
             }
           }
           popWarningColor();
+
+          bool renderPoolPinThreadsB=settings.renderPoolPinThreads;
+          if (ImGui::Checkbox(_("Pin threads to CPU cores"),&renderPoolPinThreadsB)) {
+            settings.renderPoolPinThreads=renderPoolPinThreadsB;
+            settingsChanged=true;
+          }
+          if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip(_("binds each render thread to a CPU core.\nmay reduce stuttering on some systems.\n\nonly supported on Linux."));
+          }
         }
 
         bool lowLatencyB=settings.lowLatency;
@@ -2153,6 +2168,39 @@ void FurnaceGUI::drawSettings() {
         ImGui::SameLine();
         if (ImGui::Combo("##PCSOutMethod",&settings.pcSpeakerOutMethod,LocalizedComboGetter,pcspkrOutMethods,5)) settingsChanged=true;
 
+        ImGui::AlignTextToFramePadding();
+        ImGui::Text(_("BRR encoder"));
+        ImGui::SameLine();
+        if (ImGui::Combo("##BRREncoder",&settings.brrEncoder,LocalizedComboGetter,brrEncoders,3)) settingsChanged=true;
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("the trellis encoders try several block sequences and keep the one with the lowest total error.\nthis improves the quality of SNES samples at the same size, but encoding takes longer."));
+        }
+
+        if (ImGui::InputInt(_("Sample conversion cache size (MB)"),&settings.sampleCacheSize)) {
+          if (settings.sampleCacheSize<0) settings.sampleCacheSize=0;
+          if (settings.sampleCacheSize>4096) settings.sampleCacheSize=4096;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("keeps the result of converting samples to chip formats (e.g. ADPCM or BRR) in memory,\nso that they don't have to be encoded again when nothing changed.\n\nset to 0 to disable."));
+        }
+
+        bool sampleCacheDiskB=settings.sampleCacheDisk;
+        if (ImGui::Checkbox(_("Store sample conversion cache on disk"),&sampleCacheDiskB)) {
+          settings.sampleCacheDisk=sampleCacheDiskB;
+          settingsChanged=true;
+        }
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("speeds up loading songs with many samples after the first time."));
+        }
+        if (sampleCacheDiskB) {
+          if (ImGui::InputInt(_("Disk cache size (MB)"),&settings.sampleCacheDiskSize)) {
+            if (settings.sampleCacheDiskSize<1) settings.sampleCacheDiskSize=1;
+            if (settings.sampleCacheDiskSize>65536) settings.sampleCacheDiskSize=65536;
+            settingsChanged=true;
+          }
+        }
+
         ImGui::Separator();
         ImGui::Text(_("Sample ROMs:"));
 
@@ -4763,6 +4811,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     settings.chanOscThreads=conf.getInt("chanOscThreads",0);
     settings.renderPoolThreads=conf.getInt("renderPoolThreads",0);
+    settings.renderPoolPinThreads=conf.getInt("renderPoolPinThreads",0);
     settings.shaderOsc=conf.getInt("shaderOsc",0);
     settings.writeInsNames=conf.getInt("writeInsNames",0);
     settings.readInsNames=conf.getInt("readInsNames",1);
@@ -5087,6 +5136,11 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     settings.vbQualityRender=conf.getInt("vbQualityRender",3);
 
     settings.pcSpeakerOutMethod=conf.getInt("pcSpeakerOutMethod",0);
+    settings.brrEncoder=conf.getInt("brrEncoder",0);
+
+    settings.sampleCacheSize=conf.getInt("sampleCacheSize",64);
+    settings.sampleCacheDisk=conf.getInt("sampleCacheDisk",0);
+    settings.sampleCacheDiskSize=conf.getInt("sampleCacheDiskSize",256);
 
     settings.yrw801Path=conf.getString("yrw801Path","");
     settings.tg100Path=conf.getString("tg100Path","");
@@ -5158,6 +5212,10 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.swanQualityRender,0,5);
   clampSetting(settings.vbQualityRender,0,5);
   clampSetting(settings.pcSpeakerOutMethod,0,4);
+  clampSetting(settings.brrEncoder,0,2);
+  clampSetting(settings.sampleCacheSize,0,4096);
+  clampSetting(settings.sampleCacheDisk,0,1);
+  clampSetting(settings.sampleCacheDiskSize,1,65536);
   clampSetting(settings.mainFont,0,6);
   clampSetting(settings.patFont,0,6);
   clampSetting(settings.patRowsBase,0,1);
@@ -5287,6 +5345,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
   clampSetting(settings.wasapiEx,0,1);
   clampSetting(settings.chanOscThreads,0,256);
   clampSetting(settings.renderPoolThreads,0,DIV_MAX_CHIPS);
+  clampSetting(settings.renderPoolPinThreads,0,1);
   clampSetting(settings.writeInsNames,0,1);
   clampSetting(settings.readInsNames,0,1);
   clampSetting(settings.fontBackend,0,1);
@@ -5357,6 +5416,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     conf.set("chanOscThreads",settings.chanOscThreads);
     conf.set("renderPoolThreads",settings.renderPoolThreads);
+    conf.set("renderPoolPinThreads",settings.renderPoolPinThreads);
     conf.set("shaderOsc",settings.shaderOsc);
     conf.set("writeInsNames",settings.writeInsNames);
     conf.set("readInsNames",settings.readInsNames);
@@ -5682,6 +5742,11 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
     conf.set("vbQualityRender",settings.vbQualityRender);
 
     conf.set("pcSpeakerOutMethod",settings.pcSpeakerOutMethod);
+    conf.set("brrEncoder",settings.brrEncoder);
+
+    conf.set("sampleCacheSize",settings.sampleCacheSize);
+    conf.set("sampleCacheDisk",settings.sampleCacheDisk);
+    conf.set("sampleCacheDiskSize",settings.sampleCacheDiskSize);
 
     conf.set("yrw801Path",settings.yrw801Path);
     conf.set("tg100Path",settings.tg100Path);
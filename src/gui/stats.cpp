@@ -36,6 +36,65 @@ void FurnaceGUI::drawStats() {
     ImGui::Text(_("Audio load"));
     ImGui::SameLine();
     ImGui::ProgressBar((double)lastProcTime/maxGot,ImVec2(-FLT_MIN,0),procStr.c_str());
+
+    DivRenderStats stats=e->getRenderStats();
+    const char* stageNames[DIV_RENDER_STAGE_MAX]={
+      _("Total"),
+      _("MIDI input"),
+      _("Sample preview"),
+      _("Sequencer"),
+      _("Chips"),
+      _("Metronome"),
+      _("Patchbay"),
+      _("Output")
+    };
+
+    ImGui::Text(_("Render time (µs)"));
+    if (ImGui::BeginTable("RenderStats",5,ImGuiTableFlags_Borders|ImGuiTableFlags_RowBg)) {
+      ImGui::TableSetupColumn("c0",ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("c1",ImGuiTableColumnFlags_WidthFixed);
+      ImGui::TableSetupColumn("c2",ImGuiTableColumnFlags_WidthFixed);
+      ImGui::TableSetupColumn("c3",ImGuiTableColumnFlags_WidthFixed);
+      ImGui::TableSetupColumn("c4",ImGuiTableColumnFlags_WidthFixed);
+
+      ImGui::TableNextRow(ImGuiTableRowFlags_Headers);
+      ImGui::TableNextColumn();
+      ImGui::Text(_("Stage"));
+      ImGui::TableNextColumn();
+      ImGui::Text(_("min"));
+      ImGui::TableNextColumn();
+      ImGui::Text(_("avg"));
+      ImGui::TableNextColumn();
+      ImGui::Text(_("p99"));
+      ImGui::TableNextColumn();
+      ImGui::Text(_("load"));
+
+      auto drawStatRow=[&stats](const String& name, const DivRenderStat& stat) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(name.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f",(double)stat.min/1000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f",(double)stat.avg/1000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f",(double)stat.p99/1000.0);
+        ImGui::TableNextColumn();
+        if (stats.budget>0) {
+          ImGui::Text("%.1f%%",100.0*(double)stat.avg/(double)stats.budget);
+        }
+      };
+
+      for (int i=0; i<DIV_RENDER_STAGE_MAX; i++) {
+        drawStatRow(stageNames[i],stats.stage[i]);
+      }
+      for (int i=0; i<stats.chips && i<e->song.systemLen; i++) {
+        String chipName=fmt::sprintf("%d. %s",i+1,e->getSystemName(e->song.system[i]));
+        drawStatRow(fmt::sprintf(_("%s: emulation"),chipName),stats.acquire[i]);
+        drawStatRow(fmt::sprintf(_("%s: resampling"),chipName),stats.fillBuf[i]);
+      }
+      ImGui::EndTable();
+    }
   }
   if (ImGui::IsWindowFocused(ImGuiFocusedFlags_ChildWindows)) curWindow=GUI_WINDOW_STATS;
   ImGui::End();
@@ -26,6 +26,7 @@
 #include "ta-log.h"
 #include "fileutils.h"
 #include "engine/engine.h"
+#include "engine/zlibOps.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -38,6 +39,8 @@ typedef HRESULT (WINAPI *SPDA)(PROCESS_DPI_AWARENESS);
 #else
 #include <signal.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
 
 struct sigaction termsa;
 #endif
@@ -86,9 +89,16 @@ FurnaceCLI cli;
 String outName;
 String vgmOutName;
 String cmdOutName;
+String romOutName;
+String profileName;
+String benchOutName;
+String batchName;
 int benchMode=0;
+int batchJobs=0;
 int subsong=-1;
 DivAudioExportOptions exportOptions;
+DivBatchExportFormats batchFormat=DIV_BATCH_WAV;
+DivROMExportOptions romTarget=DIV_ROM_MAX;
 
 #ifdef HAVE_GUI
 bool consoleMode=false;
@@ -409,20 +419,38 @@ TAParamResult pBenchmark(String val) {
     benchMode=1;
   } else if (val=="seek") {
     benchMode=2;
+  } else if (val=="pool") {
+    benchMode=3;
+  } else if (val=="chips") {
+    benchMode=4;
+  } else if (val=="tiuna") {
+    benchMode=5;
+  } else if (val=="resample") {
+    benchMode=6;
   } else {
-    logE("invalid value for benchmark! valid values are: render and seek.");
+    logE("invalid value for benchmark! valid values are: render, seek, pool, chips, tiuna and resample.");
     return TA_PARAM_ERROR;
   }
   e.setAudio(DIV_AUDIO_DUMMY);
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pBenchOut(String val) {
+  benchOutName=val;
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pOutput(String val) {
   outName=val;
   e.setAudio(DIV_AUDIO_DUMMY);
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pProfile(String val) {
+  profileName=val;
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pVGMOut(String val) {
   vgmOutName=val;
   e.setAudio(DIV_AUDIO_DUMMY);
@@ -435,6 +463,70 @@ TAParamResult pCmdOut(String val) {
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pROMOut(String val) {
+  romOutName=val;
+  e.setAudio(DIV_AUDIO_DUMMY);
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pROMTarget(String val) {
+  if (val=="amiga") {
+    romTarget=DIV_ROM_AMIGA_VALIDATION;
+  } else if (val=="zsm") {
+    romTarget=DIV_ROM_ZSM;
+  } else if (val=="tiuna") {
+    romTarget=DIV_ROM_TIUNA;
+  } else {
+    logE("invalid value for romtarget! valid values are: amiga, zsm and tiuna.");
+    return TA_PARAM_ERROR;
+  }
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pBatch(String val) {
+  batchName=val;
+  e.setAudio(DIV_AUDIO_DUMMY);
+  return TA_PARAM_SUCCESS;
+}
+
+bool parseBatchFormat(String val, DivBatchExportFormats& format) {
+  if (val=="wav") {
+    format=DIV_BATCH_WAV;
+  } else if (val=="vgm") {
+    format=DIV_BATCH_VGM;
+  } else if (val=="vgz") {
+    format=DIV_BATCH_VGZ;
+  } else if (val=="cmd") {
+    format=DIV_BATCH_CMD;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+TAParamResult pBatchFormat(String val) {
+  if (!parseBatchFormat(val,batchFormat)) {
+    logE("invalid value for batchformat! valid values are: wav, vgm, vgz and cmd.");
+    return TA_PARAM_ERROR;
+  }
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pBatchJobs(String val) {
+  try {
+    int v=std::stoi(val);
+    if (v<1) {
+      logE("job count shall be 1 or higher.");
+      return TA_PARAM_ERROR;
+    }
+    batchJobs=v;
+  } catch (std::exception& e) {
+    logE("job count shall be a number.");
+    return TA_PARAM_ERROR;
+  }
+  return TA_PARAM_SUCCESS;
+}
+
 bool needsValue(String param) {
   for (size_t i=0; i<params.size(); i++) {
     if (params[i].name==param) {
@@ -449,9 +541,14 @@ void initParams() {
 
   params.push_back(TAParam("a","audio",true,pAudio,"jack|sdl|portaudio|pipe","set audio engine (SDL by default)"));
   params.push_back(TAParam("o","output",true,pOutput,"<filename>","output audio to file"));
-  params.push_back(TAParam("O","vgmout",true,pVGMOut,"<filename>","output .vgm data"));
+  params.push_back(TAParam("O","vgmout",true,pVGMOut,"<filename>","output .vgm data (.vgz for compressed)"));
   params.push_back(TAParam("D","direct",false,pDirect,"","set VGM export direct stream mode"));
   params.push_back(TAParam("C","cmdout",true,pCmdOut,"<filename>","output command stream"));
+  params.push_back(TAParam("R","romout",true,pROMOut,"<filename|directory>","export ROM (see -romtarget). with -vgmout the song is only played once for both"));
+  params.push_back(TAParam("T","romtarget",true,pROMTarget,"amiga|zsm|tiuna","set ROM export target"));
+  params.push_back(TAParam("x","batch",true,pBatch,"<manifest|pattern>","export several songs at once (- to read manifest from standard input)"));
+  params.push_back(TAParam("X","batchformat",true,pBatchFormat,"wav|vgm|vgz|cmd","set default batch export format (wav by default)"));
+  params.push_back(TAParam("J","batchjobs",true,pBatchJobs,"<count>","set number of songs to export at once (one per CPU core by default)"));
   params.push_back(TAParam("L","loglevel",true,pLogLevel,"debug|info|warning|error","set the log level (info by default)"));
   params.push_back(TAParam("v","view",true,pView,"pattern|commands|nothing","set visualization (nothing by default)"));
   params.push_back(TAParam("i","info",false,pInfo,"","get info about a song"));
@@ -466,12 +563,183 @@ void initParams() {
   params.push_back(TAParam("S","safemode",false,pSafeMode,"","enable safe mode (software rendering and no audio)"));
   params.push_back(TAParam("A","safeaudio",false,pSafeModeAudio,"","enable safe mode (with audio"));
 
-  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek","run performance test"));
+  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek|pool|chips|tiuna|resample","run performance test"));
+  params.push_back(TAParam("b","benchout",true,pBenchOut,"<filename>","write chip benchmark results (JSON) to file (- for standard output)"));
+  params.push_back(TAParam("P","profile",true,pProfile,"<filename>","write render statistics (JSON) after playback/export/benchmark (- for standard output)"));
 
   params.push_back(TAParam("V","version",false,pVersion,"","view information about Furnace."));
   params.push_back(TAParam("W","warranty",false,pWarranty,"","view warranty disclaimer."));
 }
 
+void writeBenchmarkResults() {
+  if (benchOutName.empty()) return;
+  String json=e.getBenchmarkJSON();
+  if (benchOutName=="-") {
+    fputs(json.c_str(),stdout);
+    return;
+  }
+  FILE* f=ps_fopen(benchOutName.c_str(),"w");
+  if (f==NULL) {
+    logE("could not write benchmark results! (%s)",strerror(errno));
+    return;
+  }
+  fputs(json.c_str(),f);
+  fclose(f);
+}
+
+void writeRenderStats() {
+  if (profileName.empty()) return;
+  String json=e.getRenderStatsJSON();
+  if (profileName=="-") {
+    fputs(json.c_str(),stdout);
+    return;
+  }
+  FILE* f=ps_fopen(profileName.c_str(),"w");
+  if (f==NULL) {
+    logE("could not write render statistics! (%s)",strerror(errno));
+    return;
+  }
+  fputs(json.c_str(),f);
+  fclose(f);
+}
+
+// expand a wildcard pattern (in the file name only) into a sorted list of files
+bool expandBatchPattern(const String& pattern, std::vector<String>& files) {
+  if (pattern.find_first_of("*?")==String::npos) {
+    files.push_back(pattern);
+    return true;
+  }
+  size_t prevSize=files.size();
+#ifdef _WIN32
+  String dir;
+  size_t sepPos=pattern.find_last_of("/\\");
+  if (sepPos!=String::npos) dir=pattern.substr(0,sepPos+1);
+  WIN32_FIND_DATAW entry;
+  HANDLE h=FindFirstFileW(utf8To16(pattern.c_str()).c_str(),&entry);
+  if (h!=INVALID_HANDLE_VALUE) {
+    do {
+      if (entry.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY) continue;
+      files.push_back(dir+utf16To8(entry.cFileName));
+    } while (FindNextFileW(h,&entry));
+    FindClose(h);
+  }
+#else
+  String dir=".";
+  String prefix;
+  String namePattern=pattern;
+  size_t sepPos=pattern.rfind('/');
+  if (sepPos!=String::npos) {
+    dir=pattern.substr(0,sepPos+1);
+    prefix=dir;
+    namePattern=pattern.substr(sepPos+1);
+  }
+  DIR* d=opendir(dir.c_str());
+  if (d!=NULL) {
+    struct dirent* entry;
+    while ((entry=readdir(d))!=NULL) {
+      if (fnmatch(namePattern.c_str(),entry->d_name,FNM_PERIOD)!=0) continue;
+      String path=prefix+entry->d_name;
+      if (dirExists(path.c_str())) continue;
+      files.push_back(path);
+    }
+    closedir(d);
+  }
+#endif
+  if (files.size()==prevSize) {
+    logE("%s: no files match.",pattern);
+    return false;
+  }
+  std::sort(files.begin()+prevSize,files.end());
+  return true;
+}
+
+// read a batch export manifest. each line is:
+// input[<TAB>sub-song|all[<TAB>wav|vgm|vgz|cmd[<TAB>output]]]
+// empty fields take the default. lines starting with # are ignored.
+bool readBatchManifest(FILE* f, std::vector<DivBatchJob>& jobs) {
+  char line[4096];
+  int lineNum=0;
+  bool ok=true;
+  while (fgets(line,4096,f)!=NULL) {
+    lineNum++;
+    String l=line;
+    while (!l.empty() && (l.back()=='\n' || l.back()=='\r')) l.pop_back();
+    if (l.empty() || l[0]=='#') continue;
+
+    std::vector<String> fields;
+    size_t pos=0;
+    while (true) {
+      size_t next=l.find('\t',pos);
+      fields.push_back(l.substr(pos,next-pos));
+      if (next==String::npos) break;
+      pos=next+1;
+    }
+
+    DivBatchJob job;
+    job.format=batchFormat;
+    if (fields.size()>1 && !fields[1].empty() && fields[1]!="all") {
+      try {
+        job.subSong=std::stoi(fields[1]);
+      } catch (std::exception& e) {
+        job.subSong=-1;
+      }
+      if (job.subSong<0) {
+        logE("line %d: invalid sub-song.",lineNum);
+        ok=false;
+        continue;
+      }
+    }
+    if (fields.size()>2 && !fields[2].empty()) {
+      if (!parseBatchFormat(fields[2],job.format)) {
+        logE("line %d: invalid format. valid values are: wav, vgm, vgz and cmd.",lineNum);
+        ok=false;
+        continue;
+      }
+    }
+    if (fields.size()>3) job.outPath=fields[3];
+
+    std::vector<String> files;
+    if (!expandBatchPattern(fields[0],files)) {
+      ok=false;
+      continue;
+    }
+    if (files.size()>1 && !job.outPath.empty()) {
+      logW("line %d: pattern matches several files. ignoring output name.",lineNum);
+      job.outPath="";
+    }
+    for (String& i: files) {
+      job.inPath=i;
+      jobs.push_back(job);
+    }
+  }
+  return ok;
+}
+
+bool loadBatchJobs(const String& name, std::vector<DivBatchJob>& jobs) {
+  if (name=="-") {
+    return readBatchManifest(stdin,jobs);
+  }
+  if (name.find_first_of("*?")!=String::npos) {
+    std::vector<String> files;
+    if (!expandBatchPattern(name,files)) return false;
+    for (String& i: files) {
+      DivBatchJob job;
+      job.inPath=i;
+      job.format=batchFormat;
+      jobs.push_back(job);
+    }
+    return true;
+  }
+  FILE* f=ps_fopen(name.c_str(),"r");
+  if (f==NULL) {
+    logE("could not open batch manifest! (%s)",strerror(errno));
+    return false;
+  }
+  bool ret=readBatchManifest(f,jobs);
+  fclose(f);
+  return ret;
+}
+
 #ifdef _WIN32
 void reportError(String what) {
   logE("%s",what);
@@ -554,6 +822,7 @@ int main(int argc, char** argv) {
   outName="";
   vgmOutName="";
   cmdOutName="";
+  romOutName="";
 
   // load config for locale
   e.prePreInit();
@@ -716,19 +985,19 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if (fileName.empty() && consoleMode) {
+  if (fileName.empty() && consoleMode && (benchMode<3 || benchMode==5) && batchName=="") {
     logI("usage: %s file",argv[0]);
     return 1;
   }
 
-  if (fileName.empty() && (benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="")) {
+  if (fileName.empty() && ((benchMode>0 && benchMode<3) || benchMode==5 || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="")) {
     logE("provide a file!");
     return 1;
   }
 
 #ifdef HAVE_GUI
-  if (e.preInit(consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="")) {
-    if (consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="") {
+  if (e.preInit(consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="" || batchName!="")) {
+    if (consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="" || batchName!="") {
       logW("engine wants safe mode, but Furnace GUI is not going to start.");
     } else {
       safeMode=true;
@@ -740,7 +1009,7 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if (safeMode && (consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="")) {
+  if (safeMode && (consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="" || batchName!="")) {
     logE("you can't use safe mode and console/export mode together.");
     return 1;
   }
@@ -749,64 +1018,74 @@ int main(int argc, char** argv) {
     e.setAudio(DIV_AUDIO_DUMMY);
   }
 
-  if (!fileName.empty() && ((!e.getConfBool("tutIntroPlayed",TUT_INTRO_PLAYED)) || e.getConfInt("alwaysPlayIntro",0)!=3 || consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="")) {
+  if (!fileName.empty() && ((!e.getConfBool("tutIntroPlayed",TUT_INTRO_PLAYED)) || e.getConfInt("alwaysPlayIntro",0)!=3 || consoleMode || benchMode || infoMode || outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="" || batchName!="")) {
     logI("loading module...");
-    FILE* f=ps_fopen(fileName.c_str(),"rb");
-    if (f==NULL) {
-      reportError(fmt::sprintf(_("couldn't open file! (%s)"),strerror(errno)));
-      e.everythingOK();
-      finishLogFile();
-      return 1;
-    }
-    if (fseek(f,0,SEEK_END)<0) {
-      reportError(fmt::sprintf(_("couldn't open file! (couldn't get file size: %s)"),strerror(errno)));
-      e.everythingOK();
-      fclose(f);
-      finishLogFile();
-      return 1;
-    }
-    ssize_t len=ftell(f);
-    if (len==(SIZE_MAX>>1)) {
-      reportError(fmt::sprintf(_("couldn't open file! (couldn't get file length: %s)"),strerror(errno)));
+    // large uncompressed songs are mapped rather than read
+    int mapResult=e.loadMapped(fileName.c_str());
+    if (mapResult<0) {
+      reportError(fmt::sprintf(_("could not open file! (%s)"),e.getLastError()));
       e.everythingOK();
-      fclose(f);
       finishLogFile();
       return 1;
     }
-    if (len<1) {
-      if (len==0) {
-        reportError(_("that file is empty!"));
-      } else {
-        reportError(fmt::sprintf(_("couldn't open file! (tell error: %s)"),strerror(errno)));
+    if (mapResult==0) {
+      FILE* f=ps_fopen(fileName.c_str(),"rb");
+      if (f==NULL) {
+        reportError(fmt::sprintf(_("couldn't open file! (%s)"),strerror(errno)));
+        e.everythingOK();
+        finishLogFile();
+        return 1;
+      }
+      if (fseek(f,0,SEEK_END)<0) {
+        reportError(fmt::sprintf(_("couldn't open file! (couldn't get file size: %s)"),strerror(errno)));
+        e.everythingOK();
+        fclose(f);
+        finishLogFile();
+        return 1;
+      }
+      ssize_t len=ftell(f);
+      if (len==(SIZE_MAX>>1)) {
+        reportError(fmt::sprintf(_("couldn't open file! (couldn't get file length: %s)"),strerror(errno)));
+        e.everythingOK();
+        fclose(f);
+        finishLogFile();
+        return 1;
+      }
+      if (len<1) {
+        if (len==0) {
+          reportError(_("that file is empty!"));
+        } else {
+          reportError(fmt::sprintf(_("couldn't open file! (tell error: %s)"),strerror(errno)));
+        }
+        e.everythingOK();
+        fclose(f);
+        finishLogFile();
+        return 1;
+      }
+      unsigned char* file=new unsigned char[len];
+      if (fseek(f,0,SEEK_SET)<0) {
+        reportError(fmt::sprintf(_("couldn't open file! (size error: %s)"),strerror(errno)));
+        e.everythingOK();
+        fclose(f);
+        delete[] file;
+        finishLogFile();
+        return 1;
+      }
+      if (fread(file,1,(size_t)len,f)!=(size_t)len) {
+        reportError(fmt::sprintf(_("couldn't open file! (read error: %s)"),strerror(errno)));
+        e.everythingOK();
+        fclose(f);
+        delete[] file;
+        finishLogFile();
+        return 1;
       }
-      e.everythingOK();
-      fclose(f);
-      finishLogFile();
-      return 1;
-    }
-    unsigned char* file=new unsigned char[len];
-    if (fseek(f,0,SEEK_SET)<0) {
-      reportError(fmt::sprintf(_("couldn't open file! (size error: %s)"),strerror(errno)));
-      e.everythingOK();
-      fclose(f);
-      delete[] file;
-      finishLogFile();
-      return 1;
-    }
-    if (fread(file,1,(size_t)len,f)!=(size_t)len) {
-      reportError(fmt::sprintf(_("couldn't open file! (read error: %s)"),strerror(errno)));
-      e.everythingOK();
       fclose(f);
-      delete[] file;
-      finishLogFile();
-      return 1;
-    }
-    fclose(f);
-    if (!e.load(file,(size_t)len,fileName.c_str())) {
-      reportError(fmt::sprintf(_("could not open file! (%s)"),e.getLastError()));
-      e.everythingOK();
-      finishLogFile();
-      return 1;
+      if (!e.load(file,(size_t)len,fileName.c_str())) {
+        reportError(fmt::sprintf(_("could not open file! (%s)"),e.getLastError()));
+        e.everythingOK();
+        finishLogFile();
+        return 1;
+      }
     }
   }
   if (infoMode) {
@@ -830,18 +1109,68 @@ int main(int argc, char** argv) {
     e.changeSongP(subsong);
   }
 
+  if (batchName!="") {
+    std::vector<DivBatchJob> jobs;
+    if (!loadBatchJobs(batchName,jobs)) {
+      reportError(_("could not read batch export list!"));
+      finishLogFile();
+      return 1;
+    }
+    int failed=e.batchExport(jobs,exportOptions,vgmOutDirect,batchJobs);
+    finishLogFile();
+    return (failed>0)?1:0;
+  }
+
   if (benchMode) {
     logI("starting benchmark!");
-    if (benchMode==2) {
+    if (benchMode==6) {
+      e.benchmarkResample();
+    } else if (benchMode==5) {
+      e.benchmarkTiuna();
+    } else if (benchMode==4) {
+      e.benchmarkChips();
+      writeBenchmarkResults();
+    } else if (benchMode==3) {
+      e.benchmarkWorkPool();
+    } else if (benchMode==2) {
       e.benchmarkSeek();
     } else {
       e.benchmarkPlayback();
     }
+    writeRenderStats();
     finishLogFile();
     return 0;
   }
 
-  if (outName!="" || vgmOutName!="" || cmdOutName!="") {
+  if (outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="") {
+    DivROMExport* romExport=NULL;
+    DivRegTimeline* timeline=NULL;
+    if (romOutName!="") {
+      if (romTarget==DIV_ROM_MAX) {
+        reportError(_("no ROM export target! (use -romtarget)"));
+      } else {
+        romExport=e.buildROM(romTarget);
+        if (romExport==NULL) {
+          reportError(_("could not create exporter!"));
+        } else {
+          DivConfig romConf;
+          romExport->setConf(romConf);
+          // play the song once and give the register writes to both the VGM and the ROM
+          if (vgmOutName!="" && !vgmOutDirect && (romTarget==DIV_ROM_ZSM || romTarget==DIV_ROM_TIUNA)) {
+            timeline=e.captureRegTimeline(44100,-1);
+            romExport->setTimeline(timeline);
+          }
+          if (romExport->go(&e)) {
+            // without a timeline it plays the song by itself, so let it finish first
+            if (timeline==NULL) romExport->wait();
+          } else {
+            reportError(_("could not begin exporting ROM!"));
+            delete romExport;
+            romExport=NULL;
+          }
+        }
+      }
+    }
     if (cmdOutName!="") {
       SafeWriter* w=e.saveCommand();
       if (w!=NULL) {
@@ -859,7 +1188,16 @@ int main(int argc, char** argv) {
       }
     }
     if (vgmOutName!="") {
-      SafeWriter* w=e.saveVGM(NULL,true,0x171,false,vgmOutDirect);
+      SafeWriter* w=e.saveVGM(NULL,true,0x171,false,vgmOutDirect,-1,true,timeline);
+      // write a compressed file if the extension asks for it
+      String vgmOutExt=(vgmOutName.size()>=4)?vgmOutName.substr(vgmOutName.size()-4):"";
+      for (char& i: vgmOutExt) i=tolower(i);
+      if (w!=NULL && vgmOutExt==".vgz") {
+        SafeWriter* compressed=divDeflate(w->getFinalBuf(),w->size(),9,true);
+        w->finish();
+        delete w;
+        w=compressed;
+      }
       if (w!=NULL) {
         FILE* f=fopen(vgmOutName.c_str(),"wb");
         if (f!=NULL) {
@@ -874,10 +1212,44 @@ int main(int argc, char** argv) {
         reportError(_("could not write VGM!"));
       }
     }
+    if (romExport!=NULL) {
+      // otherwise it was waited for already
+      if (timeline!=NULL) romExport->wait();
+      if (romExport->hasFailed()) {
+        for (String& i: romExport->exportLog) {
+          logE("%s",i);
+        }
+        reportError(_("could not export ROM!"));
+      }
+      // several files go into a directory
+      const DivROMExportDef* romDef=e.getROMExportDef(romTarget);
+      for (DivROMExportOutput& i: romExport->getResult()) {
+        if (i.data==NULL) continue;
+        if (!romExport->hasFailed()) {
+          String path=romOutName;
+          if (romDef!=NULL && romDef->multiOutput) {
+            path+=DIR_SEPARATOR_STR;
+            path+=i.name;
+          }
+          FILE* f=ps_fopen(path.c_str(),"wb");
+          if (f!=NULL) {
+            fwrite(i.data->getFinalBuf(),1,i.data->size(),f);
+            fclose(f);
+          } else {
+            reportError(fmt::sprintf(_("could not open file! (%s)"),strerror(errno)));
+          }
+        }
+        i.data->finish();
+        delete i.data;
+      }
+      delete romExport;
+    }
+    if (timeline!=NULL) delete timeline;
     if (outName!="") {
       e.setConsoleMode(true);
       e.saveAudio(outName.c_str(),exportOptions);
       e.waitAudioFile();
+      writeRenderStats();
     }
     finishLogFile();
     return 0;
@@ -902,6 +1274,7 @@ int main(int argc, char** argv) {
     if (cliSuccess) {
       cli.loop();
       cli.finish();
+      writeRenderStats();
       e.quit();
       finishLogFile();
       return 0;